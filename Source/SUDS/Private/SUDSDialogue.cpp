@@ -7,6 +7,10 @@
 #include "SUDSScriptNodeGosub.h"
 #include "SUDSScriptNodeSet.h"
 #include "SUDSScriptNodeText.h"
+#include "SUDSStats.h"
+#include "SUDSSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
 
 DEFINE_LOG_CATEGORY(LogSUDSDialogue);
 
@@ -43,6 +47,18 @@ void USUDSDialogue::Initialise(const USUDSScript* Script)
 {
 	BaseScript = Script;
 	CurrentSpeakerNode = nullptr;
+	if (!Subsystem)
+	{
+		Subsystem = GetSUDSSubsystem(GetWorld());
+	}
+	if (Subsystem)
+	{
+		Subsystem->RegisterDialogue(this);
+	}
+
+	const int NumSpeakers = BaseScript ? BaseScript->GetSpeakers().Num() : 0;
+	SpeakerDisplayNameCache.SetNum(NumSpeakers);
+	SpeakerDisplayNameCacheValid.Init(false, NumSpeakers);
 
 	InitVariables();
 
@@ -50,11 +66,181 @@ void USUDSDialogue::Initialise(const USUDSScript* Script)
 
 }
 
+void USUDSDialogue::BeginDestroy()
+{
+	SetCountedAsActive(false);
+	Super::BeginDestroy();
+}
+
+void USUDSDialogue::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	SIZE_T Bytes = Participants.GetAllocatedSize() +
+		VariableState.GetAllocatedSize() +
+		GosubReturnStack.GetAllocatedSize() +
+		ChoicesTaken.GetAllocatedSize() +
+		CurrentRequestedParamNames.GetAllocatedSize() +
+		SpeakerDisplayNameCache.GetAllocatedSize() +
+		SpeakerDisplayNameCacheValid.GetAllocatedSize() +
+		CurrentChoices.GetAllocatedSize() +
+		CurrentChoiceSources.GetAllocatedSize() +
+		VariableVersions.GetAllocatedSize() +
+		CurrentChoiceTextCache.GetAllocatedSize() +
+		QueuedEvents.GetAllocatedSize() +
+		QueuedEventArgs.GetAllocatedSize() +
+		DispatchEventArgs.GetAllocatedSize() +
+		EventArgsScratch.GetAllocatedSize();
+	for (const auto& Scratch : EventArgsScratch)
+	{
+		Bytes += Scratch.GetAllocatedSize();
+	}
+	for (const auto& TextID : ChoicesTaken)
+	{
+		Bytes += TextID.GetAllocatedSize();
+	}
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(Bytes);
+}
+
+void USUDSDialogue::SetCountedAsActive(bool bActive)
+{
+	if (bActive != bCountedAsActive)
+	{
+		bCountedAsActive = bActive;
+		if (bActive)
+		{
+			INC_DWORD_STAT(STAT_SUDS_ActiveDialogues);
+		}
+		else
+		{
+			DEC_DWORD_STAT(STAT_SUDS_ActiveDialogues);
+		}
+	}
+}
+
+void USUDSDialogue::ResetForReuse()
+{
+	OnSpeakerLine.Clear();
+	OnChoice.Clear();
+	OnProceeding.Clear();
+	OnEvent.Clear();
+	OnVariableChanged.Clear();
+	OnVariableRequested.Clear();
+	OnStarting.Clear();
+	OnFinished.Clear();
+	OnSpeakerLineNative.Clear();
+	OnChoiceNative.Clear();
+	OnProceedingNative.Clear();
+	OnEventNative.Clear();
+	OnVariableChangedNative.Clear();
+	OnVariableRequestedNative.Clear();
+	OnStartingNative.Clear();
+	OnFinishedNative.Clear();
+#if WITH_EDITOR
+	InternalOnSpeakerLine.Unbind();
+	InternalOnChoice.Unbind();
+	InternalOnProceeding.Unbind();
+	InternalOnEvent.Unbind();
+	InternalOnSetVar.Unbind();
+	InternalOnSetVarByCode.Unbind();
+	InternalOnSelectEval.Unbind();
+	InternalOnStarting.Unbind();
+	InternalOnFinished.Unbind();
+#endif
+
+	// Pooled dialogues mustn't keep their script loaded; the next owner's Initialise sets it again
+	BaseScript = nullptr;
+	// Reset rather than Empty everything so that allocations are kept for next time
+	CurrentSpeakerNode = nullptr;
+	CurrentRootChoiceNode = nullptr;
+	Participants.Reset();
+	VariableState.Reset();
+	GosubReturnStack.Reset();
+	ChoicesTaken.Reset();
+	CurrentRequestedParamNames.Reset();
+	bParamNamesExtracted = false;
+	CurrentChoices.Reset();
+	CurrentChoiceSources.Reset();
+	CurrentChoiceTextCache.Reset();
+	CurrentTextCache = FResolvedTextCacheEntry();
+	VariableVersions.Reset();
+	TextCacheHits = 0;
+	TextCacheMisses = 0;
+	CurrentSourceLineNo = 0;
+	ClearPendingExecution();
+	RunawayStepCount = 0;
+	ExecutionNodeBudget = 0;
+	ExecutionTimeBudgetMs = 0;
+	RunawayStepLimit = DefaultRunawayStepLimit;
+	QueuedEvents.Reset();
+	QueuedEventArgs.Reset();
+	// Queued modes would hold back events from the next owner's listeners
+	EventDispatchMode = ESUDSEventDispatchMode::Immediate;
+}
+
 void USUDSDialogue::InitVariables()
 {
-	VariableState.Empty();
+	// Reset not Empty, keeps the allocation when dialogues are reused
+	VariableState.Reset();
+	AllVariableStateChanged();
 	// Run header nodes immediately (only set nodes)
-	RunUntilNextSpeakerNodeOrEnd(BaseScript->GetHeaderNode(), false);
+	RunUntilNextSpeakerNodeOrEnd(BaseScript->GetHeaderNode(), false, false);
+}
+
+const TMap<FName, FSUDSValue>* USUDSDialogue::GetGlobalVariables() const
+{
+	return Subsystem ? &Subsystem->GetGlobalVariables() : nullptr;
+}
+
+const FSUDSValue* USUDSDialogue::FindVariable(FName Name) const
+{
+	if (USUDSSubsystem::IsGlobalVariableName(Name))
+	{
+		return Subsystem ? Subsystem->GetGlobalVariables().Find(Name) : nullptr;
+	}
+	return VariableState.Find(Name);
+}
+
+bool USUDSDialogue::SetGlobalVariableImpl(FName Name, const FSUDSValue& Value, bool bFromScript)
+{
+	if (!USUDSSubsystem::IsGlobalVariableName(Name))
+		return false;
+
+	if (Subsystem)
+	{
+		Subsystem->SetGlobalVariable(Name, Value, bFromScript);
+	}
+	else
+	{
+		UE_LOG(LogSUDSDialogue,
+		       Error,
+		       TEXT("Error in %s: cannot set global variable %s, dialogue has no subsystem"),
+		       BaseScript ? *BaseScript->GetName() : TEXT("?"),
+		       *Name.ToString());
+	}
+	return true;
+}
+
+void USUDSDialogue::VariableStateChanged(const FName& Name)
+{
+	VariableVersions.Add(Name, ++VariableVersionCounter);
+	
+	if (BaseScript)
+	{
+		const int SpeakerIdx = BaseScript->FindSpeakerIndexByDisplayNameKey(Name);
+		if (SpeakerDisplayNameCacheValid.IsValidIndex(SpeakerIdx))
+		{
+			SpeakerDisplayNameCacheValid[SpeakerIdx] = false;
+		}
+	}
+}
+
+void USUDSDialogue::AllVariableStateChanged()
+{
+	// Everything counts as changed at this version, so individual versions can be dropped
+	VariableVersions.Reset();
+	VariableBulkChangeVersion = ++VariableVersionCounter;
+	SpeakerDisplayNameCacheValid.SetRange(0, SpeakerDisplayNameCacheValid.Num(), false);
 }
 
 void USUDSDialogue::Start(FName Label)
@@ -103,14 +289,57 @@ void USUDSDialogue::SortParticipants()
 	}
 }
 
-void USUDSDialogue::RunUntilNextSpeakerNodeOrEnd(USUDSScriptNode* NextNode, bool bRaiseAtEnd)
+void USUDSDialogue::RunUntilNextSpeakerNodeOrEnd(USUDSScriptNode* NextNode, bool bRaiseAtEnd, bool bAllowYield)
+{
+	// Anything pending is superseded
+	ClearPendingExecution();
+	RunawayStepCount = 0;
+	RunNodesUntilSpeakerNodeOrEnd(NextNode, bRaiseAtEnd, bAllowYield);
+}
+
+void USUDSDialogue::RunNodesUntilSpeakerNodeOrEnd(USUDSScriptNode* NextNode, bool bRaiseAtEnd, bool bAllowYield)
 {
+	SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_RunUntilSpeakerLine, "SUDS Run", BaseScript, NextNode ? NextNode->GetSourceLineNo() : 0);
+	
+	const bool bNodeBudget = bAllowYield && ExecutionNodeBudget > 0;
+	const bool bTimeBudget = bAllowYield && ExecutionTimeBudgetMs > 0;
+	const double EndTime = bTimeBudget ? FPlatformTime::Seconds() + ExecutionTimeBudgetMs * 0.001 : 0;
+	int NodesRun = 0;
+	
 	// We run through nodes which don't require a speaker line prompt
 	// E.g. set nodes, select nodes which are all automatically resolved
 	// Starting with this node
 	while (NextNode && !IsChoiceOrTextNode(NextNode->GetNodeType()))
 	{
+		if (RunawayStepLimit > 0 && ++RunawayStepCount > RunawayStepLimit)
+		{
+			UE_LOG(LogSUDSDialogue,
+			       Error,
+			       TEXT("Error in %s line %d: ran %d nodes without reaching a speaker line, probably an infinite loop. Ending dialogue."),
+			       *BaseScript->GetName(),
+			       NextNode->GetSourceLineNo(),
+			       RunawayStepLimit);
+			NextNode = nullptr;
+			break;
+		}
+		
+		// Always run at least one node per call so we make progress
+		if (NodesRun > 0 &&
+			((bNodeBudget && NodesRun >= ExecutionNodeBudget) ||
+			 (bTimeBudget && FPlatformTime::Seconds() >= EndTime)))
+		{
+			PendingExecutionNode = NextNode;
+			bPendingExecutionRaiseAtEnd = bRaiseAtEnd;
+			bExecutionPending = true;
+			if (Subsystem)
+			{
+				Subsystem->AddPendingExecution(this);
+			}
+			return;
+		}
+		
 		NextNode = RunNode(NextNode);
+		++NodesRun;
 	}
 
 	if (NextNode)
@@ -140,6 +369,7 @@ void USUDSDialogue::RunUntilNextSpeakerNodeOrEnd(USUDSScriptNode* NextNode, bool
 
 USUDSScriptNode* USUDSDialogue::RunNode(USUDSScriptNode* Node)
 {
+	INC_DWORD_STAT(STAT_SUDS_NodesExecuted);
 	CurrentSourceLineNo = Node->GetSourceLineNo();
 	switch (Node->GetNodeType())
 	{
@@ -174,7 +404,7 @@ USUDSScriptNode* USUDSDialogue::RunSelectNode(USUDSScriptNode* Node)
 		{
 			// use the first satisfied edge
 			RaiseExpressionVariablesRequested(Edge.GetCondition(), Edge.GetSourceLineNo());
-			const bool bSuccess = Edge.GetCondition().EvaluateBoolean(VariableState, BaseScript->GetName());
+			const bool bSuccess = Edge.GetCondition().EvaluateBoolean(VariableState, nullptr, BaseScript->GetName(), GetGlobalVariables());
 #if WITH_EDITOR
 			InternalOnSelectEval.ExecuteIfBound(this, Edge.GetCondition().GetSourceString(), bSuccess, Edge.GetSourceLineNo());
 #endif
@@ -194,35 +424,100 @@ USUDSScriptNode* USUDSDialogue::RunEventNode(USUDSScriptNode* Node)
 {
 	if (USUDSScriptNodeEvent* EvtNode = Cast<USUDSScriptNodeEvent>(Node))
 	{
-		// Build a resolved args list, because we need to evaluate  expressions
-		TArray<FSUDSValue> ArgsResolved;
-		
-		for (auto& Expr : EvtNode->GetArgs())
+		INC_DWORD_STAT(STAT_SUDS_EventsRaised);
+		if (EvtNode->AreArgsAllLiteral())
 		{
-			RaiseExpressionVariablesRequested(Expr, EvtNode->GetSourceLineNo());
-			ArgsResolved.Add(Expr.Evaluate(VariableState));
+			// Nothing to evaluate or request, use the shared args
+			if (ShouldQueueEvents())
+			{
+				auto& Evt = QueueEvent(EQueuedEventType::Event, EvtNode->GetEventName(), 0, EvtNode->GetSourceLineNo());
+				Evt.NumArgs = EvtNode->GetLiteralArgs().Num();
+				QueuedEventArgs.Append(EvtNode->GetLiteralArgs());
+			}
+			else
+			{
+				DispatchEvent(EvtNode->GetEventName(), EvtNode->GetLiteralArgs(), EvtNode->GetSourceLineNo());
+			}
 		}
-		
+		else if (!ShouldQueueEvents() && !HasEventListeners())
+		{
+			// Nobody would receive the event or be asked for variables, don't build the payload
+		}
+		else if (ShouldQueueEvents())
+		{
+			// Evaluate everything first, variable requests could queue variable changes
+			TArray<FSUDSValue, TInlineAllocator<8>> ArgsResolved;
+			for (auto& Expr : EvtNode->GetArgs())
+			{
+				RaiseExpressionVariablesRequested(Expr, EvtNode->GetSourceLineNo());
+				ArgsResolved.Add(Expr.Evaluate(VariableState, nullptr, GetGlobalVariables()));
+			}
+			auto& Evt = QueueEvent(EQueuedEventType::Event, EvtNode->GetEventName(), 0, EvtNode->GetSourceLineNo());
+			Evt.NumArgs = ArgsResolved.Num();
+			QueuedEventArgs.Append(ArgsResolved);
+		}
+		else
+		{
+			// Build a resolved args list, because we need to evaluate  expressions
+			// Re-use an array rather than allocating every time
+			const int Depth = EventArgsScratchDepth++;
+			if (EventArgsScratch.Num() <= Depth)
+			{
+				EventArgsScratch.Add(new TArray<FSUDSValue>());
+			}
+			TArray<FSUDSValue>& ArgsResolved = EventArgsScratch[Depth];
+			ArgsResolved.Reset();
+			
+			for (auto& Expr : EvtNode->GetArgs())
+			{
+				RaiseExpressionVariablesRequested(Expr, EvtNode->GetSourceLineNo());
+				ArgsResolved.Add(Expr.Evaluate(VariableState, nullptr, GetGlobalVariables()));
+			}
+			DispatchEvent(EvtNode->GetEventName(), ArgsResolved, EvtNode->GetSourceLineNo());
+			--EventArgsScratchDepth;
+		}
+	}
+	return GetNextNode(Node);
+}
+
+bool USUDSDialogue::HasEventListeners() const
+{
+	return Participants.Num() > 0 ||
+		OnEvent.IsBound() ||
+		OnEventNative.IsBound() ||
+		OnVariableRequested.IsBound() ||
+		OnVariableRequestedNative.IsBound()
+#if WITH_EDITOR
+		|| InternalOnEvent.IsBound()
+#endif
+		;
+}
+
+void USUDSDialogue::DispatchEvent(FName EventName, const TArray<FSUDSValue>& Args, int LineNo)
+{
+	if (Participants.Num() > 0)
+	{
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantEvent, "SUDS Participants Event", BaseScript, LineNo);
 		for (const auto P : Participants)
 		{
 			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
 			{
-				ISUDSParticipant::Execute_OnDialogueEvent(P, this, EvtNode->GetEventName(), ArgsResolved);
+				ISUDSParticipant::Execute_OnDialogueEvent(P, this, EventName, Args);
 			}
 		}
-		OnEvent.Broadcast(this, EvtNode->GetEventName(), ArgsResolved);
+	}
+	OnEventNative.Broadcast(this, EventName, Args);
+	OnEvent.Broadcast(this, EventName, Args);
 #if WITH_EDITOR
-		InternalOnEvent.ExecuteIfBound(this, EvtNode->GetEventName(), ArgsResolved, EvtNode->GetSourceLineNo());
+	InternalOnEvent.ExecuteIfBound(this, EventName, Args, LineNo);
 #endif
-	}
-	return GetNextNode(Node);
 }
 
 USUDSScriptNode* USUDSDialogue::RunGosubNode(USUDSScriptNode* Node)
 {
 	if (USUDSScriptNodeGosub* GosubNode = Cast<USUDSScriptNodeGosub>(Node))
 	{
-		if (auto TargetNode = BaseScript->GetNodeByLabel(GosubNode->GetLabelName()))
+		if (auto TargetNode = BaseScript->GetGosubTargetNode(GosubNode))
 		{
 			// Push this gosub node to the return stack, then jump
 			GosubReturnStack.Push(GosubNode);
@@ -265,21 +560,12 @@ USUDSScriptNode* USUDSDialogue::RunSetVariableNode(USUDSScriptNode* Node)
 {
 	if (USUDSScriptNodeSet* SetNode = Cast<USUDSScriptNodeSet>(Node))
 	{
-		if (SetNode->GetExpression().IsValid())
+		RunSetAssignment(SetNode->GetIdentifier(), SetNode->GetExpression(), SetNode->GetSourceLineNo());
+		// Optimised scripts merge runs of set nodes into one; each keeps its own line number
+		for (const auto& Assignment : SetNode->GetMergedAssignments())
 		{
-			RaiseExpressionVariablesRequested(SetNode->GetExpression(), SetNode->GetSourceLineNo());
-			FSUDSValue Value = SetNode->GetExpression().Evaluate(VariableState);
-			SetVariableImpl(SetNode->GetIdentifier(), Value, true, SetNode->GetSourceLineNo());
-#if WITH_EDITOR
-			// We do this here so that we have access to the expression
-			InternalOnSetVar.ExecuteIfBound(this,
-			                                SetNode->GetIdentifier(),
-			                                Value,
-			                                SetNode->GetExpression().IsLiteral()
-				                                ? ""
-				                                : SetNode->GetExpression().GetSourceString(),
-			                                SetNode->GetSourceLineNo());
-#endif
+			CurrentSourceLineNo = Assignment.SourceLineNo;
+			RunSetAssignment(Assignment.Identifier, Assignment.Expression, Assignment.SourceLineNo);
 		}
 	}
 
@@ -288,15 +574,55 @@ USUDSScriptNode* USUDSDialogue::RunSetVariableNode(USUDSScriptNode* Node)
 	
 }
 
+void USUDSDialogue::RunSetAssignment(const FName& Identifier, const FSUDSExpression& Expression, int LineNo)
+{
+	if (Expression.IsValid())
+	{
+		RaiseExpressionVariablesRequested(Expression, LineNo);
+		FSUDSValue Value = Expression.Evaluate(VariableState, nullptr, GetGlobalVariables());
+		SetVariableImpl(Identifier, Value, true, LineNo);
+#if WITH_EDITOR
+		// We do this here so that we have access to the expression
+		InternalOnSetVar.ExecuteIfBound(this,
+		                                Identifier,
+		                                Value,
+		                                Expression.IsLiteral()
+			                                ? ""
+			                                : Expression.GetSourceString(),
+		                                LineNo);
+#endif
+	}
+}
+
 void USUDSDialogue::RaiseVariableChange(const FName& VarName, const FSUDSValue& Value, bool bFromScript, int LineNo)
 {
-	for (const auto P : Participants)
+	if (ShouldQueueEvents())
+	{
+		auto& Evt = QueueEvent(EQueuedEventType::VariableChanged, VarName, 0, LineNo);
+		Evt.bFromScript = bFromScript;
+		Evt.NumArgs = 1;
+		QueuedEventArgs.Add(Value);
+	}
+	else
+	{
+		DispatchVariableChange(VarName, Value, bFromScript, LineNo);
+	}
+}
+
+void USUDSDialogue::DispatchVariableChange(const FName& VarName, const FSUDSValue& Value, bool bFromScript, int LineNo)
+{
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantVariableChanged, "SUDS Participants Variable Changed", BaseScript, LineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueVariableChanged(P, this, VarName, Value, bFromScript);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueVariableChanged(P, this, VarName, Value, bFromScript);
+			}
 		}
 	}
+	OnVariableChangedNative.Broadcast(this, VarName, Value, bFromScript);
 	OnVariableChanged.Broadcast(this, VarName, Value, bFromScript);
 #if WITH_EDITOR
 	if (!bFromScript)
@@ -310,13 +636,24 @@ void USUDSDialogue::RaiseVariableChange(const FName& VarName, const FSUDSValue&
 
 void USUDSDialogue::RaiseVariableRequested(const FName& VarName, int LineNo)
 {
+	// Global variables are resolved directly from the subsystem, nothing to ask for
+	if (USUDSSubsystem::IsGlobalVariableName(VarName))
+		return;
+
+	INC_DWORD_STAT(STAT_SUDS_VariablesRequested);
+	
 	// Because variables set by participants should "win", raise event first
+	OnVariableRequestedNative.Broadcast(this, VarName);
 	OnVariableRequested.Broadcast(this, VarName);
-	for (const auto P : Participants)
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantVariableRequested, "SUDS Participants Variable Requested", BaseScript, LineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueVariableRequested(P, this, VarName);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueVariableRequested(P, this, VarName);
+			}
 		}
 	}
 }
@@ -332,9 +669,10 @@ void USUDSDialogue::RaiseExpressionVariablesRequested(const FSUDSExpression& Exp
 void USUDSDialogue::SetCurrentSpeakerNode(USUDSScriptNodeText* Node, bool bQuietly)
 {
 	CurrentSpeakerNode = Node;
+	SetCountedAsActive(Node != nullptr);
 
-	CurrentSpeakerDisplayName = FText::GetEmpty();
 	bParamNamesExtracted = false;
+	CurrentTextCache.bValid = false;
 	if (Node)
 	{
 		CurrentSourceLineNo = Node->GetSourceLineNo();
@@ -355,28 +693,75 @@ void USUDSDialogue::SetCurrentSpeakerNode(USUDSScriptNodeText* Node, bool bQuiet
 
 }
 
-FText USUDSDialogue::ResolveParameterisedText(const TArray<FName> Params, const FTextFormat& TextFormat, int LineNo)
+FText USUDSDialogue::ResolveParameterisedText(const TArray<FName>& Params,
+                                              const TArray<FString>& ParamStrings,
+                                              const FTextFormat& TextFormat,
+                                              int LineNo,
+                                              FResolvedTextCacheEntry& Cache)
 {
+	SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ResolveText, "SUDS Resolve Text", BaseScript, LineNo);
+	
+	// Always request, participants may change values on demand, which will invalidate the cache
 	for (const auto& P : Params)
 	{
 		RaiseVariableRequested(P, LineNo);
 	}
+
+	if (IsTextCacheEntryCurrent(Cache, Params))
+	{
+		++TextCacheHits;
+		return Cache.Text;
+	}
+	++TextCacheMisses;
+
 	// Need to make a temp arg list for compatibility
 	// Also lets us just set the ones we need to
 	FFormatNamedArguments Args;
-	GetTextFormatArgs(Params, Args);
-	return FText::Format(TextFormat, Args);
+	Args.Reserve(Params.Num());
+	GetTextFormatArgs(Params, ParamStrings, Args);
+	Cache.Text = FText::Format(TextFormat, MoveTemp(Args));
+	Cache.Version = VariableVersionCounter;
+	Cache.GlobalVersion = Subsystem ? Subsystem->GetGlobalVariablesVersion() : 0;
+	Cache.bValid = true;
+	return Cache.Text;
 	
 }
 
-void USUDSDialogue::GetTextFormatArgs(const TArray<FName>& ArgNames, FFormatNamedArguments& OutArgs) const
+bool USUDSDialogue::IsTextCacheEntryCurrent(const FResolvedTextCacheEntry& Cache, const TArray<FName>& Params) const
+{
+	if (!Cache.bValid || Cache.Version < VariableBulkChangeVersion)
+		return false;
+
+	if (Subsystem && Subsystem->GetGlobalVariablesVersion() != Cache.GlobalVersion)
+		return false;
+
+	for (const auto& P : Params)
+	{
+		const uint32* pVersion = VariableVersions.Find(P);
+		if (pVersion && *pVersion > Cache.Version)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void USUDSDialogue::GetTextFormatArgs(const TArray<FName>& ArgNames,
+                                      const TArray<FString>& ArgNameStrings,
+                                      FFormatNamedArguments& OutArgs) const
 {
-	for (auto& Name : ArgNames)
+	check(ArgNames.Num() == ArgNameStrings.Num());
+	for (int i = 0; i < ArgNames.Num(); ++i)
 	{
-		if (const FSUDSValue* Value = VariableState.Find(Name))
+		const FSUDSValue* Value = VariableState.Find(ArgNames[i]);
+		if (!Value && Subsystem)
+		{
+			Value = Subsystem->GetGlobalVariables().Find(ArgNames[i]);
+		}
+		if (Value)
 		{
 			// Use the operator conversion
-			OutArgs.Add(Name.ToString(), Value->ToFormatArg());
+			OutArgs.Add(ArgNameStrings[i], Value->ToFormatArg());
 		}
 	}
 }
@@ -388,8 +773,10 @@ FText USUDSDialogue::GetText()
 		if (CurrentSpeakerNode->HasParameters())
 		{
 			return ResolveParameterisedText(CurrentSpeakerNode->GetParameterNames(),
+			                                CurrentSpeakerNode->GetParameterNameStrings(),
 			                                CurrentSpeakerNode->GetTextFormat(),
-			                                CurrentSpeakerNode->GetSourceLineNo());
+			                                CurrentSpeakerNode->GetSourceLineNo(),
+			                                CurrentTextCache);
 		}
 		else
 		{
@@ -399,6 +786,41 @@ FText USUDSDialogue::GetText()
 	return DummyText;
 }
 
+void USUDSDialogue::NotifyTextFormatsChanged()
+{
+	CurrentTextCache.bValid = false;
+	for (auto& Entry : CurrentChoiceTextCache)
+	{
+		Entry.bValid = false;
+	}
+	// Choices are copies, so re-copy to pick up the new formats from the script
+	check(CurrentChoices.Num() == CurrentChoiceSources.Num());
+	for (int i = 0; i < CurrentChoices.Num(); ++i)
+	{
+		// Only if the source is still the edge we copied, the script may have been reimported since
+		const FSUDSScriptEdge* Source = CurrentChoiceSources[i].GetEdge();
+		if (Source &&
+			Source->GetType() == CurrentChoices[i].GetType() &&
+			Source->GetTextID() == CurrentChoices[i].GetTextID())
+		{
+			CurrentChoices[i] = *Source;
+		}
+	}
+	bParamNamesExtracted = false;
+}
+
+float USUDSDialogue::GetTextCacheHitRate() const
+{
+	const int Total = TextCacheHits + TextCacheMisses;
+	return Total > 0 ? (float)TextCacheHits / (float)Total : 0.f;
+}
+
+void USUDSDialogue::ResetTextCacheStats()
+{
+	TextCacheHits = 0;
+	TextCacheMisses = 0;
+}
+
 const FString& USUDSDialogue::GetSpeakerID() const
 {
 	if (CurrentSpeakerNode)
@@ -409,18 +831,26 @@ const FString& USUDSDialogue::GetSpeakerID() const
 
 FText USUDSDialogue::GetSpeakerDisplayName() const
 {
-	if (CurrentSpeakerDisplayName.IsEmpty())
+	const int SpeakerIdx = CurrentSpeakerNode ? CurrentSpeakerNode->GetSpeakerIndex() : INDEX_NONE;
+	if (!SpeakerDisplayNameCacheValid.IsValidIndex(SpeakerIdx))
+	{
+		// Not a known speaker, nothing to cache against
+		return FText::FromString(GetSpeakerID());
+	}
+
+	if (!SpeakerDisplayNameCacheValid[SpeakerIdx])
 	{
 		// Derive speaker display name
 		// Is just a special variable "SpeakerName.SpeakerID"
 		// or just the SpeakerID if none specified
-		static const FString SpeakerIDPrefix = "SpeakerName.";
-		FName Key(SpeakerIDPrefix + GetSpeakerID());
+		FText& DisplayName = SpeakerDisplayNameCache[SpeakerIdx];
+		DisplayName = FText::GetEmpty();
+		const FName Key = BaseScript->GetSpeakerDisplayNameKey(SpeakerIdx);
 		if (auto Arg = VariableState.Find(Key))
 		{
 			if (Arg->GetType() == ESUDSValueType::Text)
 			{
-				CurrentSpeakerDisplayName = Arg->GetTextValue();
+				DisplayName = Arg->GetTextValue();
 			}
 			else
 			{
@@ -431,13 +861,14 @@ FText USUDSDialogue::GetSpeakerDisplayName() const
 				       *Key.ToString());
 			}
 		}
-		if (CurrentSpeakerDisplayName.IsEmpty())
+		if (DisplayName.IsEmpty())
 		{
 			// If no display name was specified, use the (non-localised) speaker ID
-			CurrentSpeakerDisplayName = FText::FromString(GetSpeakerID());
+			DisplayName = FText::FromString(GetSpeakerID());
 		}
+		SpeakerDisplayNameCacheValid[SpeakerIdx] = true;
 	}
-	return CurrentSpeakerDisplayName;
+	return SpeakerDisplayNameCache[SpeakerIdx];
 }
 
 USUDSScriptNode* USUDSDialogue::GetNextNode(USUDSScriptNode* Node)
@@ -453,7 +884,7 @@ USUDSScriptNode* USUDSDialogue::GetNextNode(USUDSScriptNode* Node)
 	}
 }
 
-bool USUDSDialogue::IsChoiceOrTextNode(ESUDSScriptNodeType Type)
+bool USUDSDialogue::IsChoiceOrTextNode(ESUDSScriptNodeType Type) const
 {
 	return Type == ESUDSScriptNodeType::Text || Type == ESUDSScriptNodeType::Choice;
 }
@@ -470,7 +901,8 @@ const USUDSScriptNode* USUDSDialogue::WalkToNextChoiceNode(USUDSScriptNode* From
 			TempGosubStack.Append(GosubReturnStack);
 		}
 		
-		const auto ResultNode = RecurseWalkToNextChoiceOrTextNode(NextNode, bExecute, bExecute ? GosubReturnStack : TempGosubStack);
+		int StepCount = 0;
+		const auto ResultNode = RecurseWalkToNextChoiceOrTextNode(NextNode, bExecute, bExecute ? GosubReturnStack : TempGosubStack, StepCount);
 		if (ResultNode && ResultNode->GetNodeType() == ESUDSScriptNodeType::Choice)
 		{
 			return ResultNode;
@@ -479,11 +911,26 @@ const USUDSScriptNode* USUDSDialogue::WalkToNextChoiceNode(USUDSScriptNode* From
 	return nullptr;
 }
 
-USUDSScriptNode* USUDSDialogue::RecurseWalkToNextChoiceOrTextNode(USUDSScriptNode* Node, bool bExecute, TArray<USUDSScriptNodeGosub*>& LocalGosubStack)
+USUDSScriptNode* USUDSDialogue::RecurseWalkToNextChoiceOrTextNode(USUDSScriptNode* Node,
+                                                                  bool bExecute,
+                                                                  TArray<USUDSScriptNodeGosub*>& LocalGosubStack,
+                                                                  int& StepCount)
 {
 	auto NextNode = Node;
 	while (NextNode && !IsChoiceOrTextNode(NextNode->GetNodeType()))
 	{
+		// Same protection against loops with no speaker lines as RunNodesUntilSpeakerNodeOrEnd
+		if (RunawayStepLimit > 0 && ++StepCount > RunawayStepLimit)
+		{
+			UE_LOG(LogSUDSDialogue,
+			       Error,
+			       TEXT("Error in %s line %d: ran %d nodes looking for choices without reaching a speaker line, probably an infinite loop."),
+			       *BaseScript->GetName(),
+			       NextNode->GetSourceLineNo(),
+			       RunawayStepLimit);
+			return nullptr;
+		}
+		
 		// Special case gosub/return in non-execute mode, since only RunNode will explore them
 		if (!bExecute)
 		{
@@ -492,10 +939,10 @@ USUDSScriptNode* USUDSDialogue::RecurseWalkToNextChoiceOrTextNode(USUDSScriptNod
 				// We need to special case Gosubs, since to find the choice we have to go into them and potentially out again
 				if (USUDSScriptNodeGosub* GosubNode = Cast<USUDSScriptNodeGosub>(NextNode))
 				{
-					if (auto SubNode = BaseScript->GetNodeByLabel(GosubNode->GetLabelName()))
+					if (auto SubNode = BaseScript->GetGosubTargetNode(GosubNode))
 					{
 						LocalGosubStack.Add(GosubNode);
-						NextNode = RecurseWalkToNextChoiceOrTextNode(SubNode, bExecute, LocalGosubStack);
+						NextNode = RecurseWalkToNextChoiceOrTextNode(SubNode, bExecute, LocalGosubStack, StepCount);
 						continue;
 					}
 				}
@@ -507,7 +954,7 @@ USUDSScriptNode* USUDSDialogue::RecurseWalkToNextChoiceOrTextNode(USUDSScriptNod
 				{
 					// We try to find the next choice node after the gosub, which temporarily redirected
 					const auto GoSubNode = LocalGosubStack.Pop();
-					NextNode = RecurseWalkToNextChoiceOrTextNode(GetNextNode(GoSubNode), bExecute, LocalGosubStack);
+					NextNode = RecurseWalkToNextChoiceOrTextNode(GetNextNode(GoSubNode), bExecute, LocalGosubStack, StepCount);
 					continue;
 				}
 				else
@@ -544,7 +991,16 @@ const TArray<FSUDSScriptEdge>& USUDSDialogue::GetChoices() const
 	return CurrentChoices;
 }
 
-void USUDSDialogue::RecurseAppendChoices(const USUDSScriptNode* Node, TArray<FSUDSScriptEdge>& OutChoices)
+const FSUDSScriptEdge* USUDSDialogue::FChoiceSource::GetEdge() const
+{
+	if (const USUDSScriptNode* SourceNode = Node.Get())
+	{
+		return SourceNode->GetEdge(EdgeIndex);
+	}
+	return nullptr;
+}
+
+void USUDSDialogue::RecurseAppendChoices(const USUDSScriptNode* Node, TArray<FChoiceSource>& OutChoices)
 {
 	if (!Node)
 		return;
@@ -556,19 +1012,23 @@ void USUDSDialogue::RecurseAppendChoices(const USUDSScriptNode* Node, TArray<FSU
 		return;
 	}
 	
-	for (auto& Edge : Node->GetEdges())
+	const TArray<FSUDSScriptEdge>& Edges = Node->GetEdges();
+	for (int EdgeIdx = 0; EdgeIdx < Edges.Num(); ++EdgeIdx)
 	{
+		const FSUDSScriptEdge& Edge = Edges[EdgeIdx];
 		switch (Edge.GetType())
 		{
 		case ESUDSEdgeType::Decision:
-			OutChoices.Add(Edge);
+			// Extract the format on the script's edge before copying, so it's only done once and not per copy
+			Edge.HasParameters();
+			OutChoices.Emplace(Node, EdgeIdx);
 			break;
 		case ESUDSEdgeType::Condition:
 			// Conditional edges are under selects
 			if (Edge.GetCondition().IsValid())
 			{
 				RaiseExpressionVariablesRequested(Edge.GetCondition(), Edge.GetSourceLineNo());
-				if (Edge.GetCondition().EvaluateBoolean(VariableState, BaseScript->GetName()))
+				if (Edge.GetCondition().EvaluateBoolean(VariableState, nullptr, BaseScript->GetName(), GetGlobalVariables()))
 				{
 					RecurseAppendChoices(Edge.GetTargetNode().Get(), OutChoices);
 					// When we choose a path on a select, we don't check the other paths, we can only go down one
@@ -588,15 +1048,64 @@ void USUDSDialogue::RecurseAppendChoices(const USUDSScriptNode* Node, TArray<FSU
 	}
 }
 
+void USUDSDialogue::AppendPlannedChoices(const FSUDSChoicePlan& Plan, TArray<FChoiceSource>& OutChoices)
+{
+	// Conditions are only evaluated when a choice needs them, at most once each; since choices are in the same order
+	// as the select paths, the same conditions get evaluated as when walking the selects
+	TArray<int8, TInlineAllocator<16>> ConditionResults;
+	ConditionResults.SetNumZeroed(Plan.Conditions.Num());
+	for (const FSUDSChoicePlanEntry& Entry : Plan.Choices)
+	{
+		bool bPass = true;
+		for (int i = Entry.FirstGuard; bPass && i < Entry.FirstGuard + Entry.NumGuards; ++i)
+		{
+			const FSUDSChoicePlanGuard& Guard = Plan.Guards[i];
+			int8& Result = ConditionResults[Guard.ConditionIndex];
+			if (Result == 0)
+			{
+				const FSUDSChoicePlanCondition& Condition = Plan.Conditions[Guard.ConditionIndex];
+				const FSUDSScriptEdge* Edge = Condition.SelectNode->GetEdge(Condition.EdgeIndex);
+				RaiseExpressionVariablesRequested(Edge->GetCondition(), Edge->GetSourceLineNo());
+				Result = Edge->GetCondition().EvaluateBoolean(VariableState, nullptr, BaseScript->GetName(), GetGlobalVariables()) ? 1 : -1;
+			}
+			bPass = (Result > 0) == Guard.bExpected;
+		}
+		if (bPass)
+		{
+			const FSUDSScriptEdge* Edge = Entry.ChoiceNode->GetEdge(Entry.EdgeIndex);
+			// Extract the format on the script's edge before copying, so it's only done once and not per copy
+			Edge->HasParameters();
+			OutChoices.Emplace(Entry.ChoiceNode, Entry.EdgeIndex);
+		}
+	}
+}
+
 void USUDSDialogue::UpdateChoices()
 {
+	SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_UpdateChoices, "SUDS Update Choices", BaseScript, CurrentSourceLineNo);
+	
 	CurrentChoices.Reset();
+	CurrentChoiceSources.Reset();
 	CurrentRootChoiceNode = nullptr;
 	if (CurrentSpeakerNode)
 	{
+		const FSUDSChoicePlan& Plan = CurrentSpeakerNode->GetChoicePlan();
+		if (Plan.bIsValid)
+		{
+			// The choices were flattened at import, we just need to run what's in between and check conditions
+			if (Plan.RootChoiceNode)
+			{
+				CurrentRootChoiceNode = Plan.RootChoiceNode;
+				for (const auto Node : Plan.PreludeNodes)
+				{
+					RunNode(Node);
+				}
+				AppendPlannedChoices(Plan, CurrentChoiceSources);
+			}
+		}
 		// If we've either found choices through static checking (on one or other select paths), we look for them now
 		// We also check if we're inside a gosub, since the call site changes whether there may be choices or not
-		if (CurrentSpeakerNode->MayHaveChoices() ||
+		else if (CurrentSpeakerNode->MayHaveChoices() ||
 			GosubReturnStack.Num() > 0)
 		{
 			// We MIGHT have a choice; conditionals can result in HasChoices() being true but the current state not actually
@@ -610,19 +1119,204 @@ void USUDSDialogue::UpdateChoices()
 
 				// Once we've found & run up to the root choice, there can be potentially a tree of mixed choice/select nodes
 				// for supporting conditional choices
-				RecurseAppendChoices(CurrentRootChoiceNode, CurrentChoices);
+				RecurseAppendChoices(CurrentRootChoiceNode, CurrentChoiceSources);
 			}
 		}
 
-		if (CurrentChoices.Num() == 0)
+		if (CurrentChoiceSources.Num() == 0)
 		{
-			if (auto Edge = CurrentSpeakerNode->GetEdge(0))
+			if (CurrentSpeakerNode->GetEdgeCount() > 0)
 			{
 				// Simple no-choice progression
 				// May occur if HasChoices was true but in current state no choice was found
-				CurrentChoices.Add(*Edge);
+				CurrentChoiceSources.Emplace(CurrentSpeakerNode, 0);
 			}			
 		}
+
+		CurrentChoices.Reserve(CurrentChoiceSources.Num());
+		for (const auto& Source : CurrentChoiceSources)
+		{
+			CurrentChoices.Add(*Source.GetEdge());
+		}
+	}
+
+	CurrentChoiceTextCache.Reset();
+	CurrentChoiceTextCache.SetNum(CurrentChoices.Num());
+}
+
+
+FSUDSValue USUDSDialogue::EvaluateHypothetical(const FSUDSExpression& Expression,
+                                               const TMap<FName, FSUDSValue>& Overrides) const
+{
+	if (!Expression.IsValid())
+	{
+		return FSUDSValue();
+	}
+	return Expression.Evaluate(VariableState, &Overrides, GetGlobalVariables());
+}
+
+TArray<FSUDSScriptEdge> USUDSDialogue::GetHypotheticalChoices(const TMap<FName, FSUDSValue>& Overrides) const
+{
+	TArray<const FSUDSScriptEdge*> Found;
+	FindHypotheticalChoices(Overrides, Found);
+
+	TArray<FSUDSScriptEdge> Ret;
+	Ret.Reserve(Found.Num());
+	for (const auto Edge : Found)
+	{
+		Ret.Add(*Edge);
+	}
+	return Ret;
+}
+
+int USUDSDialogue::FindHypotheticalChoices(const TMap<FName, FSUDSValue>& Overrides,
+                                           TArray<const FSUDSScriptEdge*>& OutChoices) const
+{
+	OutChoices.Reset();
+	if (!CurrentSpeakerNode)
+		return 0;
+
+	// Same logic as UpdateChoices, except nothing is executed for real; set nodes only write to a local overlay
+	if (CurrentSpeakerNode->MayHaveChoices() ||
+		GosubReturnStack.Num() > 0)
+	{
+		// Only copy the overrides if there's something to write in there
+		FSUDSValueMap LocalOverrides;
+		const FSUDSValueMap* EffectiveOverrides = &Overrides;
+		bool bCopied = false;
+		// If UpdateChoices found choices it has already run the nodes between the text and the choices for real, so
+		// running them again on the overlay would apply them twice; start from the choices instead
+		const USUDSScriptNode* Node = CurrentRootChoiceNode;
+		if (!Node && CurrentSpeakerNode->GetEdgeCount() == 1)
+		{
+			Node = GetHypotheticalNextNode(CurrentSpeakerNode, Overrides);
+		}
+
+		TArray<const USUDSScriptNodeGosub*, TInlineAllocator<4>> LocalGosubStack;
+		LocalGosubStack.Append(GosubReturnStack);
+		while (Node && !IsChoiceOrTextNode(Node->GetNodeType()))
+		{
+			switch (Node->GetNodeType())
+			{
+			case ESUDSScriptNodeType::SetVariable:
+				if (auto SetNode = Cast<USUDSScriptNodeSet>(Node))
+				{
+					auto ApplyAssignment = [&](const FName& Identifier, const FSUDSExpression& Expression)
+					{
+						if (Expression.IsValid())
+						{
+							if (!bCopied)
+							{
+								LocalOverrides = Overrides;
+								EffectiveOverrides = &LocalOverrides;
+								bCopied = true;
+							}
+							const FSUDSValue Value = Expression.Evaluate(VariableState, &LocalOverrides, GetGlobalVariables());
+							LocalOverrides.Add(Identifier, Value);
+						}
+					};
+					ApplyAssignment(SetNode->GetIdentifier(), SetNode->GetExpression());
+					for (const auto& Assignment : SetNode->GetMergedAssignments())
+					{
+						ApplyAssignment(Assignment.Identifier, Assignment.Expression);
+					}
+				}
+				Node = BaseScript->GetNextNode(Node);
+				break;
+			case ESUDSScriptNodeType::Gosub:
+				if (auto GosubNode = Cast<USUDSScriptNodeGosub>(Node))
+				{
+					if (auto SubNode = BaseScript->GetGosubTargetNode(GosubNode))
+					{
+						LocalGosubStack.Push(GosubNode);
+						Node = SubNode;
+						break;
+					}
+				}
+				Node = BaseScript->GetNextNode(Node);
+				break;
+			case ESUDSScriptNodeType::Return:
+				Node = LocalGosubStack.Num() > 0 ? BaseScript->GetNextNode(LocalGosubStack.Pop(false)) : nullptr;
+				break;
+			default:
+				// Events are simply skipped, selects are evaluated against the overlay
+				Node = GetHypotheticalNextNode(Node, *EffectiveOverrides);
+				break;
+			}
+		}
+
+		if (Node && Node->GetNodeType() == ESUDSScriptNodeType::Choice)
+		{
+			RecurseAppendHypotheticalChoices(Node, *EffectiveOverrides, OutChoices);
+		}
+	}
+
+	if (OutChoices.Num() == 0)
+	{
+		if (auto Edge = CurrentSpeakerNode->GetEdge(0))
+		{
+			OutChoices.Add(Edge);
+		}
+	}
+	return OutChoices.Num();
+}
+
+const USUDSScriptNode* USUDSDialogue::GetHypotheticalNextNode(const USUDSScriptNode* Node,
+                                                              const FSUDSValueMap& Overrides) const
+{
+	if (Node->GetNodeType() == ESUDSScriptNodeType::Select)
+	{
+		for (auto& Edge : Node->GetEdges())
+		{
+			if (Edge.GetCondition().IsValid() &&
+				Edge.GetCondition().EvaluateBoolean(VariableState, &Overrides, BaseScript->GetName(), GetGlobalVariables()))
+			{
+				return Edge.GetTargetNode().Get();
+			}
+		}
+		return nullptr;
+	}
+	return BaseScript->GetNextNode(Node);
+}
+
+void USUDSDialogue::RecurseAppendHypotheticalChoices(const USUDSScriptNode* Node,
+                                                     const FSUDSValueMap& Overrides,
+                                                     TArray<const FSUDSScriptEdge*>& OutChoices) const
+{
+	if (!Node)
+		return;
+
+	// Mirror of RecurseAppendChoices, without variable requests
+	if(Node->GetNodeType() != ESUDSScriptNodeType::Choice &&
+		Node->GetNodeType() != ESUDSScriptNodeType::Select)
+	{
+		return;
+	}
+	
+	for (auto& Edge : Node->GetEdges())
+	{
+		switch (Edge.GetType())
+		{
+		case ESUDSEdgeType::Decision:
+			OutChoices.Add(&Edge);
+			break;
+		case ESUDSEdgeType::Condition:
+			if (Edge.GetCondition().IsValid())
+			{
+				if (Edge.GetCondition().EvaluateBoolean(VariableState, &Overrides, BaseScript->GetName(), GetGlobalVariables()))
+				{
+					RecurseAppendHypotheticalChoices(Edge.GetTargetNode().Get(), Overrides, OutChoices);
+					return;
+				}
+			}
+			break;
+		case ESUDSEdgeType::Chained:
+			RecurseAppendHypotheticalChoices(Edge.GetTargetNode().Get(), Overrides, OutChoices);
+			break;
+		default:
+		case ESUDSEdgeType::Continue:
+			break;
+		};
 	}
 }
 
@@ -645,7 +1339,11 @@ FText USUDSDialogue::GetChoiceText(int Index)
 		auto& Choice = CurrentChoices[Index];
 		if (Choice.HasParameters())
 		{
-			return ResolveParameterisedText(Choice.GetParameterNames(), Choice.GetTextFormat(), Choice.GetSourceLineNo());
+			return ResolveParameterisedText(Choice.GetParameterNames(),
+			                                Choice.GetParameterNameStrings(),
+			                                Choice.GetTextFormat(),
+			                                Choice.GetSourceLineNo(),
+			                                CurrentChoiceTextCache[Index]);
 		}
 		else
 		{
@@ -685,6 +1383,12 @@ bool USUDSDialogue::Continue()
 
 bool USUDSDialogue::Choose(int Index)
 {
+	if (bExecutionPending)
+	{
+		UE_LOG(LogSUDSDialogue, Warning, TEXT("Cannot choose or continue in %s while execution is pending"), *BaseScript->GetName());
+		return false;
+	}
+	
 	if (CurrentChoices.IsValidIndex(Index))
 	{
 		// ONLY run to choice node if there is one!
@@ -703,6 +1407,7 @@ bool USUDSDialogue::Choose(int Index)
 		}
 		// Then choose path
 		RunUntilNextSpeakerNodeOrEnd(CurrentChoices[Index].GetTargetNode().Get(), true);
+		AutoFlushQueuedEvents();
 		return !IsEnded();
 	}
 	else
@@ -724,7 +1429,34 @@ bool USUDSDialogue::IsEnded() const
 
 void USUDSDialogue::End(bool bQuietly)
 {
+	ClearPendingExecution();
 	SetCurrentSpeakerNode(nullptr, bQuietly);
+	AutoFlushQueuedEvents();
+}
+
+void USUDSDialogue::SetExecutionBudget(int MaxNodes, float MaxMilliseconds)
+{
+	ExecutionNodeBudget = FMath::Max(0, MaxNodes);
+	ExecutionTimeBudgetMs = FMath::Max(0.f, MaxMilliseconds);
+}
+
+bool USUDSDialogue::ResumeExecution()
+{
+	if (bExecutionPending)
+	{
+		USUDSScriptNode* Node = PendingExecutionNode;
+		const bool bRaiseAtEnd = bPendingExecutionRaiseAtEnd;
+		ClearPendingExecution();
+		RunNodesUntilSpeakerNodeOrEnd(Node, bRaiseAtEnd, true);
+		AutoFlushQueuedEvents();
+	}
+	return bExecutionPending;
+}
+
+void USUDSDialogue::ClearPendingExecution()
+{
+	PendingExecutionNode = nullptr;
+	bExecutionPending = false;
 }
 
 int USUDSDialogue::GetCurrentSourceLine() const
@@ -763,10 +1495,15 @@ FSUDSDialogueState USUDSDialogue::GetSavedState() const
 
 void USUDSDialogue::RestoreSavedState(const FSUDSDialogueState& State)
 {
+	// Anything pending belongs to the state we're replacing
+	ClearPendingExecution();
+	RunawayStepCount = 0;
+	
 	// Don't just empty variables
 	// Re-run init to ensure header state is initialised then merge; important for it script is altered since state saved
 	InitVariables();
 	VariableState.Append(State.GetVariables());
+	AllVariableStateChanged();
 	ChoicesTaken.Empty();
 	ChoicesTaken.Append(State.GetChoicesTaken());
 	GosubReturnStack.Empty();
@@ -807,7 +1544,7 @@ void USUDSDialogue::Restart(bool bResetState, FName StartLabel, bool bReRunHeade
 	if (!bResetState && bReRunHeader)
 	{
 		// Run header nodes but don't re-init
-		RunUntilNextSpeakerNodeOrEnd(BaseScript->GetHeaderNode(), false);
+		RunUntilNextSpeakerNodeOrEnd(BaseScript->GetHeaderNode(), false, false);
 	}
 
 	if (StartLabel != NAME_None)
@@ -835,6 +1572,7 @@ void USUDSDialogue::Restart(bool bResetState, FName StartLabel, bool bReRunHeade
 	{
 		RunUntilNextSpeakerNodeOrEnd(BaseScript->GetFirstNode(), true);
 	}
+	AutoFlushQueuedEvents();
 	
 }
 
@@ -863,30 +1601,166 @@ TSet<FName> USUDSDialogue::GetParametersInUse()
 	
 }
 
+USUDSDialogue::FQueuedEvent& USUDSDialogue::QueueEvent(EQueuedEventType Type, FName Name, int Index, int LineNo)
+{
+	auto& Evt = QueuedEvents.AddDefaulted_GetRef();
+	Evt.Type = Type;
+	Evt.bFromScript = false;
+	Evt.Name = Name;
+	Evt.Index = Index;
+	Evt.LineNo = LineNo;
+	Evt.ArgsStart = QueuedEventArgs.Num();
+	Evt.NumArgs = 0;
+	return Evt;
+}
+
+void USUDSDialogue::SetEventDispatchMode(ESUDSEventDispatchMode Mode)
+{
+	EventDispatchMode = Mode;
+	if (Mode == ESUDSEventDispatchMode::Immediate)
+	{
+		FlushQueuedEvents();
+	}
+}
+
+void USUDSDialogue::AutoFlushQueuedEvents()
+{
+	if (EventDispatchMode == ESUDSEventDispatchMode::DeferredAutoFlush)
+	{
+		FlushQueuedEvents();
+	}
+}
+
+void USUDSDialogue::FlushQueuedEvents()
+{
+	// Listeners can cause more events while we're flushing, the loop below will get to those
+	if (bFlushingQueuedEvents)
+		return;
+
+	bFlushingQueuedEvents = true;
+	// Index loop; the queue can grow while we're going
+	for (int i = 0; i < QueuedEvents.Num(); ++i)
+	{
+		// Copy, dispatching can re-allocate the queue
+		const FQueuedEvent Evt = QueuedEvents[i];
+		DispatchQueuedEvent(Evt);
+	}
+	// Keep the allocations for next time
+	QueuedEvents.Reset();
+	QueuedEventArgs.Reset();
+	bFlushingQueuedEvents = false;
+}
+
+void USUDSDialogue::DispatchQueuedEvent(const FQueuedEvent& Evt)
+{
+	switch (Evt.Type)
+	{
+	case EQueuedEventType::Starting:
+		DispatchStarting(Evt.Name);
+		break;
+	case EQueuedEventType::Finished:
+		DispatchFinished();
+		break;
+	case EQueuedEventType::SpeakerLine:
+		DispatchNewSpeakerLine(Evt.LineNo);
+		break;
+	case EQueuedEventType::ChoiceMade:
+		DispatchChoiceMade(Evt.Index, Evt.LineNo);
+		break;
+	case EQueuedEventType::Proceeding:
+		DispatchProceeding();
+		break;
+	case EQueuedEventType::Event:
+		{
+			// Copy out, listeners can add to QueuedEventArgs
+			DispatchEventArgs.Reset();
+			DispatchEventArgs.Append(QueuedEventArgs.GetData() + Evt.ArgsStart, Evt.NumArgs);
+			DispatchEvent(Evt.Name, DispatchEventArgs, Evt.LineNo);
+			break;
+		}
+	case EQueuedEventType::VariableChanged:
+		{
+			const FSUDSValue Value = QueuedEventArgs[Evt.ArgsStart];
+			DispatchVariableChange(Evt.Name, Value, Evt.bFromScript, Evt.LineNo);
+			break;
+		}
+	}
+}
+
 void USUDSDialogue::RaiseStarting(FName StartLabel)
 {
-	for (const auto P : Participants)
+	if (ShouldQueueEvents())
+		QueueEvent(EQueuedEventType::Starting, StartLabel);
+	else
+		DispatchStarting(StartLabel);
+}
+
+void USUDSDialogue::RaiseFinished()
+{
+	if (ShouldQueueEvents())
+		QueueEvent(EQueuedEventType::Finished);
+	else
+		DispatchFinished();
+}
+
+void USUDSDialogue::RaiseNewSpeakerLine()
+{
+	if (ShouldQueueEvents())
+		QueueEvent(EQueuedEventType::SpeakerLine, NAME_None, 0, GetCurrentSourceLine());
+	else
+		DispatchNewSpeakerLine(GetCurrentSourceLine());
+}
+
+void USUDSDialogue::RaiseChoiceMade(int Index, int LineNo)
+{
+	if (ShouldQueueEvents())
+		QueueEvent(EQueuedEventType::ChoiceMade, NAME_None, Index, LineNo);
+	else
+		DispatchChoiceMade(Index, LineNo);
+}
+
+void USUDSDialogue::RaiseProceeding()
+{
+	if (ShouldQueueEvents())
+		QueueEvent(EQueuedEventType::Proceeding);
+	else
+		DispatchProceeding();
+}
+
+void USUDSDialogue::DispatchStarting(FName StartLabel)
+{
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantStarting, "SUDS Participants Starting", BaseScript, CurrentSourceLineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueStarting(P, this, StartLabel);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueStarting(P, this, StartLabel);
+			}
 		}
 	}
+	OnStartingNative.Broadcast(this, StartLabel);
 	OnStarting.Broadcast(this, StartLabel);
 #if WITH_EDITOR
 	InternalOnStarting.ExecuteIfBound(this, StartLabel);
 #endif
 }
 
-void USUDSDialogue::RaiseFinished()
+void USUDSDialogue::DispatchFinished()
 {
-	for (const auto P : Participants)
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantFinished, "SUDS Participants Finished", BaseScript, CurrentSourceLineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueFinished(P, this);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueFinished(P, this);
+			}
 		}
 	}
+	OnFinishedNative.Broadcast(this);
 	OnFinished.Broadcast(this);
 #if WITH_EDITOR
 	InternalOnFinished.ExecuteIfBound(this);
@@ -894,58 +1768,95 @@ void USUDSDialogue::RaiseFinished()
 
 }
 
-void USUDSDialogue::RaiseNewSpeakerLine()
+void USUDSDialogue::DispatchNewSpeakerLine(int LineNo)
 {
-	for (const auto P : Participants)
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantSpeakerLine, "SUDS Participants Speaker Line", BaseScript, LineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueSpeakerLine(P, this);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueSpeakerLine(P, this);
+			}
 		}
 	}
 	
 	// Event listeners get it after
+	OnSpeakerLineNative.Broadcast(this);
 	OnSpeakerLine.Broadcast(this);
 #if WITH_EDITOR
-	InternalOnSpeakerLine.ExecuteIfBound(this, GetCurrentSourceLine());
+	InternalOnSpeakerLine.ExecuteIfBound(this, LineNo);
 #endif
 }
 
-void USUDSDialogue::RaiseChoiceMade(int Index, int LineNo)
+void USUDSDialogue::DispatchChoiceMade(int Index, int LineNo)
 {
-	for (const auto P : Participants)
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantChoiceMade, "SUDS Participants Choice Made", BaseScript, LineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueChoiceMade(P, this, Index);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueChoiceMade(P, this, Index);
+			}
 		}
 	}
 	// Event listeners get it after
+	OnChoiceNative.Broadcast(this, Index);
 	OnChoice.Broadcast(this, Index);
 #if WITH_EDITOR
 	InternalOnChoice.ExecuteIfBound(this, Index, LineNo);
 #endif
 }
 
-void USUDSDialogue::RaiseProceeding()
+void USUDSDialogue::DispatchProceeding()
 {
-	for (const auto P : Participants)
+	if (Participants.Num() > 0)
 	{
-		if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+		SUDS_SCOPE_CYCLE_COUNTER_LINE(STAT_SUDS_ParticipantProceeding, "SUDS Participants Proceeding", BaseScript, CurrentSourceLineNo);
+		for (const auto P : Participants)
 		{
-			ISUDSParticipant::Execute_OnDialogueProceeding(P, this);
+			if (P->GetClass()->ImplementsInterface(USUDSParticipant::StaticClass()))
+			{
+				ISUDSParticipant::Execute_OnDialogueProceeding(P, this);
+			}
 		}
 	}
 	// Event listeners get it after
+	OnProceedingNative.Broadcast(this);
 	OnProceeding.Broadcast(this);
 #if WITH_EDITOR
 	InternalOnProceeding.ExecuteIfBound(this);
 #endif
 }
 
-FText USUDSDialogue::GetVariableText(FName Name) const
+FSUDSValue USUDSDialogue::GetVariable(FName Name) const
 {
+	if (USUDSSubsystem::IsGlobalVariableName(Name))
+	{
+		return Subsystem ? Subsystem->GetGlobalVariable(Name) : FSUDSValue();
+	}
 	if (const auto Arg = VariableState.Find(Name))
+	{
+		return *Arg;
+	}
+	return FSUDSValue();
+}
+
+bool USUDSDialogue::IsVariableSet(FName Name) const
+{
+	if (USUDSSubsystem::IsGlobalVariableName(Name))
+	{
+		return Subsystem && Subsystem->IsGlobalVariableSet(Name);
+	}
+	return VariableState.Contains(Name);
+}
+
+FText USUDSDialogue::GetVariableText(FName Name) const
+{
+	if (const auto Arg = FindVariable(Name))
 	{
 		if (Arg->GetType() == ESUDSValueType::Text)
 		{
@@ -966,7 +1877,7 @@ void USUDSDialogue::SetVariableInt(FName Name, int32 Value)
 
 int USUDSDialogue::GetVariableInt(FName Name) const
 {
-	if (const auto Arg = VariableState.Find(Name))
+	if (const auto Arg = FindVariable(Name))
 	{
 		switch (Arg->GetType())
 		{
@@ -991,7 +1902,7 @@ void USUDSDialogue::SetVariableFloat(FName Name, float Value)
 
 float USUDSDialogue::GetVariableFloat(FName Name) const
 {
-	if (const auto Arg = VariableState.Find(Name))
+	if (const auto Arg = FindVariable(Name))
 	{
 		switch (Arg->GetType())
 		{
@@ -1015,7 +1926,7 @@ void USUDSDialogue::SetVariableGender(FName Name, ETextGender Value)
 
 ETextGender USUDSDialogue::GetVariableGender(FName Name) const
 {
-	if (const auto Arg = VariableState.Find(Name))
+	if (const auto Arg = FindVariable(Name))
 	{
 		switch (Arg->GetType())
 		{
@@ -1039,7 +1950,7 @@ void USUDSDialogue::SetVariableBoolean(FName Name, bool Value)
 
 bool USUDSDialogue::GetVariableBoolean(FName Name) const
 {
-	if (const auto Arg = VariableState.Find(Name))
+	if (const auto Arg = FindVariable(Name))
 	{
 		switch (Arg->GetType())
 		{
@@ -1064,7 +1975,7 @@ void USUDSDialogue::SetVariableName(FName Name, FName Value)
 
 FName USUDSDialogue::GetVariableName(FName Name) const
 {
-	if (const auto Arg = VariableState.Find(Name))
+	if (const auto Arg = FindVariable(Name))
 	{
 		if (Arg->GetType() == ESUDSValueType::Name)
 		{
@@ -1080,5 +1991,16 @@ FName USUDSDialogue::GetVariableName(FName Name) const
 
 void USUDSDialogue::UnSetVariable(FName Name)
 {
-	VariableState.Remove(Name);
+	if (USUDSSubsystem::IsGlobalVariableName(Name))
+	{
+		if (Subsystem)
+		{
+			Subsystem->UnSetGlobalVariable(Name);
+		}
+		return;
+	}
+	if (VariableState.Remove(Name) > 0)
+	{
+		VariableStateChanged(Name);
+	}
 }
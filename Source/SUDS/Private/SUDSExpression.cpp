@@ -1,5 +1,6 @@
 ﻿#include "SUDSExpression.h"
 
+#include "SUDSStats.h"
 #include "Misc/DefaultValueHelper.h"
 
 bool FSUDSExpression::ParseFromString(const FString& Expression, FString* OutParseError)
@@ -293,7 +294,7 @@ bool FSUDSExpression::Validate()
 				return false;
 			Arg1 = EvalStack.Pop();
 
-			EvalStack.Push(EvaluateOperator(Item.GetType(), Arg1, Arg2, TempVariables));
+			EvalStack.Push(EvaluateOperator(Item.GetType(), Arg1, Arg2, TempVariables, nullptr, nullptr));
 		}
 		else
 		{
@@ -306,15 +307,27 @@ bool FSUDSExpression::Validate()
 	
 }
 
-FSUDSValue FSUDSExpression::Evaluate(const TMap<FName, FSUDSValue>& Variables) const
+FSUDSValue FSUDSExpression::Evaluate(const TMap<FName, FSUDSValue>& Variables,
+                                     const TMap<FName, FSUDSValue>* OverrideVariables,
+                                     const TMap<FName, FSUDSValue>* GlobalVariables) const
 {
 	checkf(bIsValid, TEXT("Cannot execute an invalid expression tree"));
+	SUDS_SCOPE_CYCLE_COUNTER(STAT_SUDS_EvaluateExpression, "SUDS Evaluate Expression");
+	INC_DWORD_STAT(STAT_SUDS_ExpressionsEvaluated);
 
 	// Blanks are mostly used for conditionals, for simplicity always return true
 	if (Queue.IsEmpty())
 		return FSUDSValue(true);
 
-	TArray<FSUDSExpressionItem> EvalStack;
+	// Single literal / variable is very common (set nodes, event args), skip the stack entirely
+	if (Queue.Num() == 1)
+	{
+		checkf(Queue[0].IsOperand(), TEXT("Single item expression should be an operand"));
+		return EvaluateOperand(Queue[0].GetOperandValue(), Variables, OverrideVariables, GlobalVariables);
+	}
+
+	// Expressions are short, so keep the working stack off the heap; this gets called a lot
+	TArray<FSUDSExpressionItem, TInlineAllocator<8>> EvalStack;
 	// We could pre-optimise all literal expressions, but let's not for now
 	for (auto& Item : Queue)
 	{
@@ -325,11 +338,11 @@ FSUDSValue FSUDSExpression::Evaluate(const TMap<FName, FSUDSValue>& Variables) c
 			if (Item.IsBinaryOperator())
 			{
 				checkf(!EvalStack.IsEmpty(), TEXT("Args missing before operator, bad expression"));
-				Arg2 = EvalStack.Pop();
+				Arg2 = EvalStack.Pop(false);
 			}
 			checkf(!EvalStack.IsEmpty(), TEXT("Args missing before operator, bad expression"));
-			Arg1 = EvalStack.Pop();
-			EvalStack.Push(EvaluateOperator(Item.GetType(), Arg1, Arg2, Variables));
+			Arg1 = EvalStack.Pop(false);
+			EvalStack.Push(EvaluateOperator(Item.GetType(), Arg1, Arg2, Variables, OverrideVariables, GlobalVariables));
 		}
 		else
 		{
@@ -339,12 +352,15 @@ FSUDSValue FSUDSExpression::Evaluate(const TMap<FName, FSUDSValue>& Variables) c
 	
 	checkf(EvalStack.Num() == 1, TEXT("We should end with a single item in the eval stack and it should be an operand"));
 
-	return EvaluateOperand(EvalStack.Top().GetOperandValue(), Variables);
+	return EvaluateOperand(EvalStack.Top().GetOperandValue(), Variables, OverrideVariables, GlobalVariables);
 }
 
-bool FSUDSExpression::EvaluateBoolean(const TMap<FName, FSUDSValue>& Variables, const FString& ErrorContext) const
+bool FSUDSExpression::EvaluateBoolean(const TMap<FName, FSUDSValue>& Variables,
+                                      const TMap<FName, FSUDSValue>* OverrideVariables,
+                                      const FString& ErrorContext,
+                                      const TMap<FName, FSUDSValue>* GlobalVariables) const
 {
-	const auto Result = Evaluate(Variables);
+	const auto Result = Evaluate(Variables, OverrideVariables, GlobalVariables);
 
 	if (Result.GetType() != ESUDSValueType::Boolean &&
 		Result.GetType() != ESUDSValueType::Variable) // Allow unresolved variable, will assume false
@@ -358,13 +374,15 @@ bool FSUDSExpression::EvaluateBoolean(const TMap<FName, FSUDSValue>& Variables,
 FSUDSExpressionItem FSUDSExpression::EvaluateOperator(ESUDSExpressionItemType Op,
                                                       const FSUDSExpressionItem& Arg1,
                                                       const FSUDSExpressionItem& Arg2,
-                                                      const TMap<FName, FSUDSValue>& Variables) const
+                                                      const TMap<FName, FSUDSValue>& Variables,
+                                                      const TMap<FName, FSUDSValue>* OverrideVariables,
+                                                      const TMap<FName, FSUDSValue>* GlobalVariables) const
 {
-	const FSUDSValue Val1 = EvaluateOperand(Arg1.GetOperandValue(), Variables);
+	const FSUDSValue Val1 = EvaluateOperand(Arg1.GetOperandValue(), Variables, OverrideVariables, GlobalVariables);
 	FSUDSValue Val2;
 	if (Arg1.IsBinaryOperator())
 	{
-		Val2 = EvaluateOperand(Arg2.GetOperandValue(), Variables);
+		Val2 = EvaluateOperand(Arg2.GetOperandValue(), Variables, OverrideVariables, GlobalVariables);
 	}
 
 	switch (Op)
@@ -408,15 +426,32 @@ FSUDSExpressionItem FSUDSExpression::EvaluateOperator(ESUDSExpressionItemType Op
 }
 
 FSUDSValue FSUDSExpression::EvaluateOperand(const FSUDSValue& Operand,
-	const TMap<FName, FSUDSValue>& Variables) const
+	const TMap<FName, FSUDSValue>& Variables,
+	const TMap<FName, FSUDSValue>* OverrideVariables,
+	const TMap<FName, FSUDSValue>* GlobalVariables) const
 {
 	// Simplify conversion to variable values
 	if (Operand.IsVariable())
 	{
+		if (OverrideVariables)
+		{
+			if (const auto OverrideVar = OverrideVariables->Find(Operand.GetVariableNameValue()))
+			{
+				return *OverrideVar;
+			}
+		}
 		if (const auto Var = Variables.Find(Operand.GetVariableNameValue()))
 		{
 			return *Var;
 		}
+		// Global variable names are always prefixed so never clash with local ones
+		if (GlobalVariables)
+		{
+			if (const auto GlobalVar = GlobalVariables->Find(Operand.GetVariableNameValue()))
+			{
+				return *GlobalVar;
+			}
+		}
 		// Note: we're NOT warning about unset variables here, and just defaulting to initial values (false, 0 etc)
 		// This is more usable in practice than complaining about it
 	}
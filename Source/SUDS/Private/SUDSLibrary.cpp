@@ -2,11 +2,25 @@
 
 #include "SUDSDialogue.h"
 #include "SUDSScript.h"
+#include "SUDSSubsystem.h"
+#include "Engine/GameInstance.h"
+#include "Engine/World.h"
 
-USUDSDialogue* USUDSLibrary::CreateDialogue(UObject* Owner, USUDSScript* Script, bool bStartImmediately, FName StartLabel)
+USUDSDialogue* USUDSLibrary::CreateDialogue(UObject* Owner,
+                                            USUDSScript* Script,
+                                            bool bStartImmediately,
+                                            FName StartLabel,
+                                            bool bFromPool)
 {
 	if (IsValid(Script))
 	{
+		if (bFromPool)
+		{
+			if (auto Sub = GetSUDSSubsystem(IsValid(Owner) ? Owner->GetWorld() : nullptr))
+			{
+				return Sub->AcquireDialogue(Script, TArray<UObject*>(), bStartImmediately, StartLabel);
+			}
+		}
 		if (!IsValid(Owner))
 		{
 			Owner = GetTransientPackage();
@@ -26,10 +40,17 @@ USUDSDialogue* USUDSLibrary::CreateDialogue(UObject* Owner, USUDSScript* Script,
 
 USUDSDialogue* USUDSLibrary::CreateDialogueWithParticipants(UObject* Owner,
 	USUDSScript* Script,
-	const TArray<UObject*>& Participants, bool bStartImmediately, FName StartLabel)
+	const TArray<UObject*>& Participants, bool bStartImmediately, FName StartLabel, bool bFromPool)
 {
 	if (IsValid(Script))
 	{
+		if (bFromPool)
+		{
+			if (auto Sub = GetSUDSSubsystem(IsValid(Owner) ? Owner->GetWorld() : nullptr))
+			{
+				return Sub->AcquireDialogue(Script, Participants, bStartImmediately, StartLabel);
+			}
+		}
 		if (!IsValid(Owner))
 		{
 			Owner = GetTransientPackage();
@@ -54,11 +75,24 @@ USUDSDialogue* USUDSLibrary::CreateDialogueWithParticipant(UObject* Owner,
 	USUDSScript* Script,
 	UObject* Participant,
 	bool bStartImmediately,
-	FName StartLabel)
+	FName StartLabel,
+	bool bFromPool)
 {
 	TArray<UObject*> Participants;
 	Participants.Add(Participant);
-	return CreateDialogueWithParticipants(Owner, Script, Participants, bStartImmediately, StartLabel);
+	return CreateDialogueWithParticipants(Owner, Script, Participants, bStartImmediately, StartLabel, bFromPool);
+}
+
+void USUDSLibrary::ReleaseDialogue(USUDSDialogue* Dialogue)
+{
+	if (IsValid(Dialogue))
+	{
+		// Pooled dialogues are always owned by the subsystem
+		if (auto Sub = Cast<USUDSSubsystem>(Dialogue->GetOuter()))
+		{
+			Sub->ReleaseDialogue(Dialogue);
+		}
+	}
 }
 
 bool USUDSLibrary::GetDialogueValueAsText(const FSUDSValue& Value, FText& TextValue)
@@ -1,18 +1,29 @@
 ﻿#include "SUDSScript.h"
 
 #include "SUDSScriptNode.h"
+#include "SUDSScriptNodeEvent.h"
 #include "SUDSScriptNodeGosub.h"
+#include "SUDSScriptNodeSet.h"
 #include "SUDSScriptNodeText.h"
 #include "EditorFramework/AssetImportData.h"
 
-PRAGMA_DISABLE_OPTIMIZATION
-
 void USUDSScript::StartImport(TArray<USUDSScriptNode*>** ppNodes,
                               TArray<USUDSScriptNode*>** ppHeaderNodes,
                               TMap<FName, int>** ppLabelList,
                               TMap<FName, int>** ppHeaderLabelList,
                               TArray<FString>** ppSpeakerList)
 {
+	// On reimport the previous nodes are still here; the importer may re-use some of them via the import blocks
+	Nodes.Empty();
+	HeaderNodes.Empty();
+	LabelList.Empty();
+	HeaderLabelList.Empty();
+	Speakers.Empty();
+	VariableAccessNames.Empty();
+	NodeVariableAccess.Empty();
+	ChoiceRegionVariableAccess.Empty();
+	NodeVariableAccessIndex.Empty();
+	
 	*ppNodes = &Nodes;
 	*ppHeaderNodes = &HeaderNodes;
 	*ppLabelList = &LabelList;
@@ -41,7 +52,9 @@ USUDSScriptNode* USUDSScript::GetNextNode(const USUDSScriptNode* Node) const
 #define kChoiceNotFoundBeforeEnd 0 
 
 
-bool USUDSScript::DoesAnyPathAfterLeadToChoice(USUDSScriptNode* FromNode)
+#define kNoCycle MAX_int32
+
+bool USUDSScript::DoesAnyPathAfterLeadToChoice(USUDSScriptNode* FromNode, FChoiceLookahead& Lookahead) const
 {
 	// Look for any possible choice following a node (text or gosub)
 	// If it's possible to find a choice in one of the paths ahead, before another text node, the return true
@@ -50,26 +63,53 @@ bool USUDSScript::DoesAnyPathAfterLeadToChoice(USUDSScriptNode* FromNode)
 	// For a gosub this is looking for the next after a return, not inside the sub
 	USUDSScriptNode* CurrNode = GetNextNode(FromNode);
 
-	return RecurseLookForChoice(CurrNode) == kChoiceFound;
+	int32 CycleDepth = kNoCycle;
+	return RecurseLookForChoice(CurrNode, Lookahead, CycleDepth) == kChoiceFound;
 }
 
 
-int USUDSScript::RecurseLookForChoice(USUDSScriptNode* CurrNode)
+int USUDSScript::RecurseLookForChoice(USUDSScriptNode* CurrNode, FChoiceLookahead& Lookahead, int32& OutCycleDepth) const
 {
 	// Return int so that we can differentiate:
 	// 1  = we found a choice
 	// 0  = we didn't find a choice, but also didn't hit another text node (reached end, or gosub return)
 	// -1 = we hit a text node
-	while (CurrNode)
+	// The result from any node doesn't depend on how we got there, so results are cached per node. Every node
+	// we walk through in this call leads to the same result, so they all get it.
+	// Looping back to a node already on the path (a goto loop, or recursive gosubs) can't reach anything we
+	// won't find another way, so contributes nothing. Results which relied on that are only cached once the
+	// node at the start of the loop is resolved; OutCycleDepth reports the earliest such node on the path.
+	const int32 PathStart = Lookahead.Path.Num();
+	int32 CycleDepth = kNoCycle;
+	int Result = kChoiceNotFoundBeforeEnd;
+	bool bDone = false;
+	while (CurrNode && !bDone)
 	{
+		if (const int8* pKnown = Lookahead.NodeResults.Find(CurrNode))
+		{
+			Result = *pKnown;
+			break;
+		}
+		if (const int32* pDepth = Lookahead.PathDepth.Find(CurrNode))
+		{
+			CycleDepth = FMath::Min(CycleDepth, *pDepth);
+			break;
+		}
+		Lookahead.PathDepth.Add(CurrNode, Lookahead.Path.Num());
+		Lookahead.Path.Add(CurrNode);
+
 		switch (CurrNode->GetNodeType())
 		{
 		case ESUDSScriptNodeType::Text:
 			// if we hit a text node, there was no choice
-			return kChoiceNotFoundBeforeText;
+			Result = kChoiceNotFoundBeforeText;
+			bDone = true;
+			break;
 		case ESUDSScriptNodeType::Choice:
 			// we found a choice
-			return kChoiceFound;
+			Result = kChoiceFound;
+			bDone = true;
+			break;
 		case ESUDSScriptNodeType::Select:
 			{
 				// Explore all possible routes
@@ -79,13 +119,18 @@ int USUDSScript::RecurseLookForChoice(USUDSScriptNode* CurrNode)
 					auto TargetNode = Edge.GetTargetNode();
 					if (TargetNode.IsValid())
 					{
-						const int ConditionalPath = RecurseLookForChoice(TargetNode.Get());
+						const int ConditionalPath = RecurseLookForChoice(TargetNode.Get(), Lookahead, CycleDepth);
 						if (ConditionalPath == kChoiceFound)
-							return kChoiceFound;
+						{
+							WorstResult = kChoiceFound;
+							break;
+						}
 						WorstResult = FMath::Min(ConditionalPath, WorstResult);
 					}
 				}
-				return WorstResult;
+				Result = WorstResult;
+				bDone = true;
+				break;
 			}
 		case ESUDSScriptNodeType::Event:
 		case ESUDSScriptNodeType::SetVariable:
@@ -95,11 +140,13 @@ int USUDSScript::RecurseLookForChoice(USUDSScriptNode* CurrNode)
 			// When we hit a gosub here we go into it, not after it
 			if (auto GosubNode = Cast<USUDSScriptNodeGosub>(CurrNode))
 			{
-				int SubResult = RecurseLookForChoice(GetNodeByLabel(GosubNode->GetLabelName()));
-				if (SubResult != 0)
+				const int SubResult = LookForChoiceInSub(GosubNode, Lookahead, CycleDepth);
+				if (SubResult != kChoiceNotFoundBeforeEnd)
 				{
 					// Found definitive result (choice or text) inside sub
-					return SubResult;
+					Result = SubResult;
+					bDone = true;
+					break;
 				}
 			}
 			// Otherwise, we didn't conclude within the sub, continue following it
@@ -108,24 +155,99 @@ int USUDSScript::RecurseLookForChoice(USUDSScriptNode* CurrNode)
 		default: ;
 		case ESUDSScriptNodeType::Return:
 			// this is when we're exploring a sub for the choice
-			return kChoiceNotFoundBeforeEnd; 
+			Result = kChoiceNotFoundBeforeEnd;
+			bDone = true;
+			break;
 		};
 	}
 
-	return kChoiceNotFoundBeforeEnd;
+	// Nodes after the start of a loop we're still inside of aren't final yet, the others are
+	for (int32 i = Lookahead.Path.Num() - 1; i >= PathStart; --i)
+	{
+		const USUDSScriptNode* Node = Lookahead.Path[i];
+		if (CycleDepth >= i)
+		{
+			Lookahead.NodeResults.Add(Node, Result);
+		}
+		Lookahead.PathDepth.Remove(Node);
+	}
+	Lookahead.Path.SetNum(PathStart, false);
+
+	if (CycleDepth < PathStart)
+	{
+		OutCycleDepth = FMath::Min(OutCycleDepth, CycleDepth);
+	}
+	return Result;
+}
+
+int USUDSScript::LookForChoiceInSub(const USUDSScriptNodeGosub* GosubNode, FChoiceLookahead& Lookahead, int32& OutCycleDepth) const
+{
+	const FName Label = GosubNode->GetLabelName();
+	if (const int8* pKnown = Lookahead.SubResults.Find(Label))
+	{
+		return *pKnown;
+	}
+
+	int32 CycleDepth = kNoCycle;
+	const int Result = RecurseLookForChoice(GetGosubTargetNode(GosubNode), Lookahead, CycleDepth);
+	if (CycleDepth == kNoCycle)
+	{
+		Lookahead.SubResults.Add(Label, Result);
+	}
+	else
+	{
+		OutCycleDepth = FMath::Min(OutCycleDepth, CycleDepth);
+	}
+	return Result;
+}
+
+void USUDSScript::BuildSpeakerLookups()
+{
+	static const FString SpeakerIDPrefix = "SpeakerName.";
+
+	SpeakerDisplayNameKeys.Reset(Speakers.Num());
+	SpeakerIndexByDisplayNameKey.Reset();
+	for (int i = 0; i < Speakers.Num(); ++i)
+	{
+		const FName Key(SpeakerIDPrefix + Speakers[i]);
+		SpeakerDisplayNameKeys.Add(Key);
+		SpeakerIndexByDisplayNameKey.Add(Key, i);
+	}
+}
+
+void USUDSScript::PostLoad()
+{
+	Super::PostLoad();
+
+	BuildSpeakerLookups();
+	BuildVariableAccessLookups();
+}
+
+const FString& USUDSScript::GetSpeakerID(int SpeakerIndex) const
+{
+	if (Speakers.IsValidIndex(SpeakerIndex))
+	{
+		return Speakers[SpeakerIndex];
+	}
+	static const FString EmptyString;
+	return EmptyString;
 }
 
 void USUDSScript::FinishImport()
 {
+	BuildSpeakerLookups();
+	
 	// As an optimisation, make all text/gosub nodes pre-scan their follow-on nodes for choice nodes
 	// We can actually have intermediate nodes, for example set nodes which run for all choices that are placed
 	// between the text and the first choice. Resolve whether they exist now
+	// Results are shared between all the nodes we check, so each part of the graph is only walked once
+	FChoiceLookahead Lookahead;
 	for (auto Node : Nodes)
 	{
 		if (Node->GetNodeType() == ESUDSScriptNodeType::Text ||
 			Node->GetNodeType() == ESUDSScriptNodeType::Gosub)
 		{
-			if (DoesAnyPathAfterLeadToChoice(Node))
+			if (DoesAnyPathAfterLeadToChoice(Node, Lookahead))
 			{
 				switch (Node->GetNodeType())
 				{
@@ -150,7 +272,361 @@ void USUDSScript::FinishImport()
 			}
 		}
 	}
+
+	// Flatten the choices after each text node, where that doesn't depend on runtime state
+	for (auto Node : Nodes)
+	{
+		if (auto TextNode = Cast<USUDSScriptNodeText>(Node))
+		{
+			BuildChoicePlan(TextNode);
+		}
+	}
+
+	BuildVariableAccess();
+}
+
+void USUDSScript::BuildChoicePlan(USUDSScriptNodeText* TextNode) const
+{
+	FSUDSChoicePlan Plan;
+	if (TextNode->GetEdgeCount() == 1)
+	{
+		// Only set / event nodes may be between the text and the choices, since they always run the same way
+		// Selects, gosubs and returns mean the route depends on the state at the time, so there's no plan for those
+		// Only membership is needed to spot loops; the prelude order is kept in the plan itself
+		TSet<const USUDSScriptNode*> Path;
+		USUDSScriptNode* CurrNode = GetNextNode(TextNode);
+		while (CurrNode && !Path.Contains(CurrNode))
+		{
+			const ESUDSScriptNodeType Type = CurrNode->GetNodeType();
+			if (Type == ESUDSScriptNodeType::SetVariable || Type == ESUDSScriptNodeType::Event)
+			{
+				Path.Add(CurrNode);
+				Plan.PreludeNodes.Add(CurrNode);
+				CurrNode = GetNextNode(CurrNode);
+				continue;
+			}
+			
+			if (Type == ESUDSScriptNodeType::Choice)
+			{
+				TArray<FSUDSChoicePlanGuard> GuardStack;
+				Path.Reset();
+				Plan.RootChoiceNode = CurrNode;
+				Plan.bIsValid = RecurseBuildChoicePlan(CurrNode, Plan, GuardStack, Path);
+			}
+			else if (Type == ESUDSScriptNodeType::Text)
+			{
+				// Never any choices, the prelude won't be run until we continue
+				Plan.bIsValid = true;
+			}
+			break;
+		}
+		if (!CurrNode)
+		{
+			// Reached the end
+			Plan.bIsValid = true;
+		}
+		if (!Plan.bIsValid || !Plan.RootChoiceNode)
+		{
+			// Nothing is run ahead of time without choices
+			Plan.PreludeNodes.Empty();
+			Plan.RootChoiceNode = nullptr;
+			Plan.Choices.Empty();
+			Plan.Guards.Empty();
+			Plan.Conditions.Empty();
+		}
+	}
+	TextNode->SetChoicePlan(MoveTemp(Plan));
+}
+
+bool USUDSScript::RecurseBuildChoicePlan(USUDSScriptNode* Node,
+                                         FSUDSChoicePlan& Plan,
+                                         TArray<FSUDSChoicePlanGuard>& GuardStack,
+                                         TSet<const USUDSScriptNode*>& Path) const
+{
+	// Mirrors USUDSDialogue::RecurseAppendChoices, but records the select conditions on the way instead of evaluating them
+	if (!Node ||
+		(Node->GetNodeType() != ESUDSScriptNodeType::Choice &&
+		Node->GetNodeType() != ESUDSScriptNodeType::Select))
+	{
+		return true;
+	}
+	bool bAlreadyOnPath = false;
+	Path.Add(Node, &bAlreadyOnPath);
+	if (bAlreadyOnPath)
+	{
+		// Shouldn't happen in a choice tree, but don't try to plan it if it does
+		return false;
+	}
+
+	bool bOK = true;
+	const int GuardStackBase = GuardStack.Num();
+	const TArray<FSUDSScriptEdge>& Edges = Node->GetEdges();
+	for (int EdgeIdx = 0; EdgeIdx < Edges.Num() && bOK; ++EdgeIdx)
+	{
+		const FSUDSScriptEdge& Edge = Edges[EdgeIdx];
+		switch (Edge.GetType())
+		{
+		case ESUDSEdgeType::Decision:
+			{
+				FSUDSChoicePlanEntry& Entry = Plan.Choices.AddDefaulted_GetRef();
+				Entry.ChoiceNode = Node;
+				Entry.EdgeIndex = EdgeIdx;
+				Entry.FirstGuard = Plan.Guards.Num();
+				Entry.NumGuards = GuardStack.Num();
+				Plan.Guards.Append(GuardStack);
+				break;
+			}
+		case ESUDSEdgeType::Condition:
+			// Conditions with errors are never taken
+			if (Edge.GetCondition().IsValid())
+			{
+				FSUDSChoicePlanCondition& Condition = Plan.Conditions.AddDefaulted_GetRef();
+				Condition.SelectNode = Node;
+				Condition.EdgeIndex = EdgeIdx;
+				const int ConditionIndex = Plan.Conditions.Num() - 1;
+				
+				// Only the first satisfied path of a select is taken, so this path also needs all the previous ones
+				// to have failed; those are already on the stack
+				FSUDSChoicePlanGuard& Guard = GuardStack.AddDefaulted_GetRef();
+				Guard.ConditionIndex = ConditionIndex;
+				Guard.bExpected = true;
+				bOK = RecurseBuildChoicePlan(Edge.GetTargetNode().Get(), Plan, GuardStack, Path);
+				GuardStack.Last().bExpected = false;
+			}
+			break;
+		case ESUDSEdgeType::Chained:
+			bOK = RecurseBuildChoicePlan(Edge.GetTargetNode().Get(), Plan, GuardStack, Path);
+			break;
+		default:
+		case ESUDSEdgeType::Continue:
+			bOK = false;
+			break;
+		};
+	}
+	GuardStack.SetNum(GuardStackBase, false);
+	Path.Remove(Node);
+	return bOK;
+}
+
+void USUDSScript::BuildVariableAccess()
+{
+	VariableAccessNames.Reset();
+	NodeVariableAccess.Reset(Nodes.Num() + HeaderNodes.Num());
+	ChoiceRegionVariableAccess.Reset(Nodes.Num());
+
+	TArray<FName> Reads, Writes;
+	auto AddNodes = [&](const TArray<USUDSScriptNode*>& InNodes)
+	{
+		for (const auto Node : InNodes)
+		{
+			Reads.Reset();
+			Writes.Reset();
+			GatherNodeVariableAccess(Node, Reads, Writes);
+			AddVariableAccessRange(Reads, Writes, NodeVariableAccess);
+		}
+	};
+	AddNodes(Nodes);
+	AddNodes(HeaderNodes);
+
+	for (const auto Node : Nodes)
+	{
+		Reads.Reset();
+		Writes.Reset();
+		if (const auto TextNode = Cast<USUDSScriptNodeText>(Node))
+		{
+			GatherChoiceRegionVariableAccess(TextNode, Reads, Writes);
+		}
+		AddVariableAccessRange(Reads, Writes, ChoiceRegionVariableAccess);
+	}
+	VariableAccessNames.Shrink();
+
+	BuildVariableAccessLookups();
+}
+
+void USUDSScript::BuildVariableAccessLookups()
+{
+	NodeVariableAccessIndex.Reset();
+	// Older assets won't have the access lists
+	if (NodeVariableAccess.Num() != Nodes.Num() + HeaderNodes.Num())
+		return;
+
+	NodeVariableAccessIndex.Reserve(NodeVariableAccess.Num());
+	for (int i = 0; i < Nodes.Num(); ++i)
+	{
+		NodeVariableAccessIndex.Add(Nodes[i], i);
+	}
+	for (int i = 0; i < HeaderNodes.Num(); ++i)
+	{
+		NodeVariableAccessIndex.Add(HeaderNodes[i], Nodes.Num() + i);
+	}
+}
+
+void USUDSScript::AddVariableAccessRange(const TArray<FName>& Reads,
+                                         const TArray<FName>& Writes,
+                                         TArray<FSUDSVariableAccessRange>& OutRanges)
+{
+	FSUDSVariableAccessRange& Range = OutRanges.AddDefaulted_GetRef();
+	Range.FirstRead = VariableAccessNames.Num();
+	Range.NumReads = Reads.Num();
+	VariableAccessNames.Append(Reads);
+	Range.FirstWrite = VariableAccessNames.Num();
+	Range.NumWrites = Writes.Num();
+	VariableAccessNames.Append(Writes);
+}
+
+void USUDSScript::GatherNodeVariableAccess(const USUDSScriptNode* Node, TArray<FName>& OutReads, TArray<FName>& OutWrites)
+{
+	auto AddReads = [&OutReads](const TArray<FName>& Names)
+	{
+		for (const auto& Name : Names)
+		{
+			OutReads.AddUnique(Name);
+		}
+	};
 	
+	switch (Node->GetNodeType())
+	{
+	case ESUDSScriptNodeType::Text:
+		if (const auto TextNode = Cast<USUDSScriptNodeText>(Node))
+		{
+			AddReads(TextNode->GetParameterNames());
+		}
+		break;
+	case ESUDSScriptNodeType::Choice:
+		for (const auto& Edge : Node->GetEdges())
+		{
+			if (Edge.GetType() == ESUDSEdgeType::Decision)
+			{
+				AddReads(Edge.GetParameterNames());
+			}
+		}
+		break;
+	case ESUDSScriptNodeType::Select:
+		for (const auto& Edge : Node->GetEdges())
+		{
+			if (Edge.GetCondition().IsValid())
+			{
+				AddReads(Edge.GetCondition().GetVariableNames());
+			}
+		}
+		break;
+	case ESUDSScriptNodeType::SetVariable:
+		if (const auto SetNode = Cast<USUDSScriptNodeSet>(Node))
+		{
+			AddReads(SetNode->GetExpression().GetVariableNames());
+			OutWrites.AddUnique(SetNode->GetIdentifier());
+			for (const auto& Assignment : SetNode->GetMergedAssignments())
+			{
+				AddReads(Assignment.Expression.GetVariableNames());
+				OutWrites.AddUnique(Assignment.Identifier);
+			}
+		}
+		break;
+	case ESUDSScriptNodeType::Event:
+		if (const auto EventNode = Cast<USUDSScriptNodeEvent>(Node))
+		{
+			for (const auto& Arg : EventNode->GetArgs())
+			{
+				AddReads(Arg.GetVariableNames());
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void USUDSScript::GatherChoiceRegionVariableAccess(const USUDSScriptNodeText* TextNode,
+                                                   TArray<FName>& OutReads,
+                                                   TArray<FName>& OutWrites) const
+{
+	// Everything which can run or be evaluated between this text node and the next one: set, event and select nodes,
+	// gosubs (both into the sub and after it), and the choices. Not what follows once a choice is made.
+	// All paths are included, since which are taken depends on the state at the time
+	TArray<const USUDSScriptNode*, TInlineAllocator<16>> ToVisit;
+	TSet<const USUDSScriptNode*> Visited;
+	auto AddTargets = [&ToVisit](const USUDSScriptNode* Node, bool bIncludeDecisions)
+	{
+		for (const auto& Edge : Node->GetEdges())
+		{
+			if (bIncludeDecisions || Edge.GetType() != ESUDSEdgeType::Decision)
+			{
+				ToVisit.Add(Edge.GetTargetNode().Get());
+			}
+		}
+	};
+
+	AddTargets(TextNode, false);
+	while (ToVisit.Num() > 0)
+	{
+		const USUDSScriptNode* Node = ToVisit.Pop(false);
+		if (!Node || Node->GetNodeType() == ESUDSScriptNodeType::Text)
+			continue;
+
+		bool bAlreadyVisited = false;
+		Visited.Add(Node, &bAlreadyVisited);
+		if (bAlreadyVisited)
+			continue;
+
+		GatherNodeVariableAccess(Node, OutReads, OutWrites);
+		if (const auto GosubNode = Cast<USUDSScriptNodeGosub>(Node))
+		{
+			ToVisit.Add(GetGosubTargetNode(GosubNode));
+		}
+		// Don't follow choices once made, but do follow selects & more choices chained to them
+		AddTargets(Node, false);
+	}
+}
+
+TConstArrayView<FName> USUDSScript::GetVariableAccessNames(int First, int Num) const
+{
+	if (Num > 0 && First >= 0 && First + Num <= VariableAccessNames.Num())
+	{
+		return TConstArrayView<FName>(VariableAccessNames.GetData() + First, Num);
+	}
+	return TConstArrayView<FName>();
+}
+
+TConstArrayView<FName> USUDSScript::GetNodeVariableReads(const USUDSScriptNode* Node) const
+{
+	if (const int* pIdx = NodeVariableAccessIndex.Find(Node))
+	{
+		const FSUDSVariableAccessRange& Range = NodeVariableAccess[*pIdx];
+		return GetVariableAccessNames(Range.FirstRead, Range.NumReads);
+	}
+	return TConstArrayView<FName>();
+}
+
+TConstArrayView<FName> USUDSScript::GetNodeVariableWrites(const USUDSScriptNode* Node) const
+{
+	if (const int* pIdx = NodeVariableAccessIndex.Find(Node))
+	{
+		const FSUDSVariableAccessRange& Range = NodeVariableAccess[*pIdx];
+		return GetVariableAccessNames(Range.FirstWrite, Range.NumWrites);
+	}
+	return TConstArrayView<FName>();
+}
+
+TConstArrayView<FName> USUDSScript::GetChoiceRegionVariableReads(const USUDSScriptNodeText* TextNode) const
+{
+	const int* pIdx = NodeVariableAccessIndex.Find(TextNode);
+	if (pIdx && ChoiceRegionVariableAccess.IsValidIndex(*pIdx))
+	{
+		const FSUDSVariableAccessRange& Range = ChoiceRegionVariableAccess[*pIdx];
+		return GetVariableAccessNames(Range.FirstRead, Range.NumReads);
+	}
+	return TConstArrayView<FName>();
+}
+
+TConstArrayView<FName> USUDSScript::GetChoiceRegionVariableWrites(const USUDSScriptNodeText* TextNode) const
+{
+	const int* pIdx = NodeVariableAccessIndex.Find(TextNode);
+	if (pIdx && ChoiceRegionVariableAccess.IsValidIndex(*pIdx))
+	{
+		const FSUDSVariableAccessRange& Range = ChoiceRegionVariableAccess[*pIdx];
+		return GetVariableAccessNames(Range.FirstWrite, Range.NumWrites);
+	}
+	return TConstArrayView<FName>();
 }
 
 USUDSScriptNode* USUDSScript::GetHeaderNode() const
@@ -180,6 +656,16 @@ USUDSScriptNode* USUDSScript::GetNodeByLabel(const FName& Label) const
 	
 }
 
+USUDSScriptNode* USUDSScript::GetGosubTargetNode(const USUDSScriptNodeGosub* Node) const
+{
+	// Optimised scripts resolve the label at import
+	if (USUDSScriptNode* Target = Node->GetTargetNode())
+	{
+		return Target;
+	}
+	return GetNodeByLabel(Node->GetLabelName());
+}
+
 USUDSScriptNodeText* USUDSScript::GetNodeByTextID(const FString& TextID) const
 {
 	for (auto N : Nodes)
@@ -247,5 +733,3 @@ void USUDSScript::Serialize(FArchive& Ar)
 	}
 }
 #endif
-
-PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
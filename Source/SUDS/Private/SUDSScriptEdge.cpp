@@ -5,9 +5,9 @@ void FSUDSScriptEdge::ExtractFormat() const
 	// Only do this on demand, and only once
 	TextFormat = Text;
 	ParameterNames.Empty();
-	TArray<FString> TextParams;
-	TextFormat.GetFormatArgumentNames(TextParams);
-	for (auto Param : TextParams)
+	ParameterNameStrings.Empty();
+	TextFormat.GetFormatArgumentNames(ParameterNameStrings);
+	for (const auto& Param : ParameterNameStrings)
 	{
 		ParameterNames.Add(FName(Param));
 	}
@@ -45,6 +45,26 @@ const TArray<FName>& FSUDSScriptEdge::GetParameterNames() const
 	
 }
 
+const TArray<FString>& FSUDSScriptEdge::GetParameterNameStrings() const
+{
+	if (!bFormatExtracted)
+	{
+		ExtractFormat();
+	}
+	return ParameterNameStrings;
+	
+}
+
+void FSUDSScriptEdge::ApplyCompiledFormat(const FTextFormat& InFormat,
+                                          const TArray<FName>& InParameterNames,
+                                          const TArray<FString>& InParameterNameStrings) const
+{
+	TextFormat = InFormat;
+	ParameterNames = InParameterNames;
+	ParameterNameStrings = InParameterNameStrings;
+	bFormatExtracted = true;
+}
+
 bool FSUDSScriptEdge::HasParameters() const
 {
 	if (!bFormatExtracted)
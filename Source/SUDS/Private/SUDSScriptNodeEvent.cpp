@@ -6,5 +6,28 @@ void USUDSScriptNodeEvent::Init(const FString& EvtName, const TArray<FSUDSExpres
 	EventName = FName(EvtName);
 	Args = InArgs;
 	SourceLineNo = LineNo;
+	BuildLiteralArgs();
 	
 }
+
+void USUDSScriptNodeEvent::PostLoad()
+{
+	Super::PostLoad();
+	BuildLiteralArgs();
+}
+
+void USUDSScriptNodeEvent::BuildLiteralArgs()
+{
+	LiteralArgs.Reset();
+	bArgsAllLiteral = true;
+	for (const auto& Arg : Args)
+	{
+		if (!Arg.IsLiteral())
+		{
+			bArgsAllLiteral = false;
+			LiteralArgs.Empty();
+			return;
+		}
+		LiteralArgs.Add(Arg.GetLiteralValue());
+	}
+}
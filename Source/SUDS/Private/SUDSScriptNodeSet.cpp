@@ -6,4 +6,11 @@ void USUDSScriptNodeSet::Init(const FString& VarName, const FSUDSExpression& InE
 	Identifier = FName(VarName);
 	Expression = InExpression;
 	SourceLineNo = LineNo;
+	MergedAssignments.Reset();
+}
+
+void USUDSScriptNodeSet::AppendAssignments(const USUDSScriptNodeSet* Other)
+{
+	MergedAssignments.Add(FSUDSSetAssignment { Other->Identifier, Other->Expression, Other->SourceLineNo });
+	MergedAssignments.Append(Other->MergedAssignments);
 }
@@ -1,16 +1,48 @@
 ﻿#include "SUDSScriptNodeText.h"
 
-void USUDSScriptNodeText::Init(const FString& InSpeakerID, const FText& InText, int LineNo)
+#include "SUDSScript.h"
+
+void USUDSScriptNodeText::Init(int InSpeakerIndex, const FText& InText, int LineNo)
 {
 	NodeType = ESUDSScriptNodeType::Text;
-	SpeakerID = InSpeakerID;
+	SpeakerIndex = InSpeakerIndex;
 	Text = InText;
 	TextFormat = Text;
 	SourceLineNo = LineNo;
 	bFormatExtracted = false;
+	bHasChoices = false;
+	ChoicePlan = FSUDSChoicePlan();
 	
 }
 
+const FString& USUDSScriptNodeText::GetSpeakerID() const
+{
+	// Nodes are always owned by their script
+	if (const USUDSScript* Script = Cast<USUDSScript>(GetOuter()))
+	{
+		return Script->GetSpeakerID(SpeakerIndex);
+	}
+	static const FString EmptyString;
+	return EmptyString;
+}
+
+void USUDSScriptNodeText::PostLoad()
+{
+	Super::PostLoad();
+
+#if WITH_EDITORONLY_DATA
+	// Convert from when speaker IDs were stored on each node
+	if (SpeakerIndex == INDEX_NONE && !SpeakerID_DEPRECATED.IsEmpty())
+	{
+		if (const USUDSScript* Script = Cast<USUDSScript>(GetOuter()))
+		{
+			SpeakerIndex = Script->GetSpeakers().IndexOfByKey(SpeakerID_DEPRECATED);
+		}
+		SpeakerID_DEPRECATED.Empty();
+	}
+#endif
+}
+
 FString USUDSScriptNodeText::GetTextID() const
 {
 	return FTextInspector::GetTextId(Text).GetKey().GetChars();
@@ -34,6 +66,25 @@ const TArray<FName>& USUDSScriptNodeText::GetParameterNames() const
 	return ParameterNames;
 }
 
+const TArray<FString>& USUDSScriptNodeText::GetParameterNameStrings() const
+{
+	if (!bFormatExtracted)
+	{
+		ExtractFormat();
+	}
+	return ParameterNameStrings;
+}
+
+void USUDSScriptNodeText::ApplyCompiledFormat(const FTextFormat& InFormat,
+                                              const TArray<FName>& InParameterNames,
+                                              const TArray<FString>& InParameterNameStrings) const
+{
+	TextFormat = InFormat;
+	ParameterNames = InParameterNames;
+	ParameterNameStrings = InParameterNameStrings;
+	bFormatExtracted = true;
+}
+
 bool USUDSScriptNodeText::HasParameters() const
 {
 	if (!bFormatExtracted)
@@ -49,10 +100,10 @@ void USUDSScriptNodeText::ExtractFormat() const
 	// Only do this on demand, and only once
 	TextFormat = Text;
 	ParameterNames.Empty();
+	ParameterNameStrings.Empty();
 
-	TArray<FString> TextParams;
-	TextFormat.GetFormatArgumentNames(TextParams);
-	for (auto Param : TextParams)
+	TextFormat.GetFormatArgumentNames(ParameterNameStrings);
+	for (const auto& Param : ParameterNameStrings)
 	{
 		ParameterNames.Add(FName(Param));
 	}
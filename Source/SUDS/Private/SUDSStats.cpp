@@ -0,0 +1,30 @@
+﻿#include "SUDSStats.h"
+
+UE_TRACE_CHANNEL_DEFINE(SUDSChannel)
+
+DEFINE_STAT(STAT_SUDS_RunUntilSpeakerLine);
+DEFINE_STAT(STAT_SUDS_UpdateChoices);
+DEFINE_STAT(STAT_SUDS_EvaluateExpression);
+DEFINE_STAT(STAT_SUDS_ResolveText);
+DEFINE_STAT(STAT_SUDS_ParticipantStarting);
+DEFINE_STAT(STAT_SUDS_ParticipantFinished);
+DEFINE_STAT(STAT_SUDS_ParticipantSpeakerLine);
+DEFINE_STAT(STAT_SUDS_ParticipantChoiceMade);
+DEFINE_STAT(STAT_SUDS_ParticipantProceeding);
+DEFINE_STAT(STAT_SUDS_ParticipantEvent);
+DEFINE_STAT(STAT_SUDS_ParticipantVariableChanged);
+DEFINE_STAT(STAT_SUDS_ParticipantVariableRequested);
+
+DEFINE_STAT(STAT_SUDS_NodesExecuted);
+DEFINE_STAT(STAT_SUDS_ExpressionsEvaluated);
+DEFINE_STAT(STAT_SUDS_VariablesRequested);
+DEFINE_STAT(STAT_SUDS_EventsRaised);
+DEFINE_STAT(STAT_SUDS_ActiveDialogues);
+
+namespace SUDSStats
+{
+	FString MakeTraceEventName(const TCHAR* Scope, const UObject* Script, int LineNo)
+	{
+		return FString::Printf(TEXT("%s %s:%d"), Scope, Script ? *Script->GetName() : TEXT("None"), LineNo);
+	}
+}
@@ -1,14 +1,762 @@
 ﻿#include "SUDSSubsystem.h"
 
+#include "SUDSDialogue.h"
+#include "SUDSScript.h"
+#include "SUDSScriptNode.h"
+#include "SUDSScriptNodeText.h"
+#include "Async/Async.h"
+#include "Internationalization/Internationalization.h"
+
 DEFINE_LOG_CATEGORY(LogSUDSSubsystem)
 
+const FString USUDSSubsystem::GlobalVariablePrefix = TEXT("global.");
+
+FArchive& operator<<(FArchive& Ar, FSUDSGlobalState& Value)
+{
+	Ar << Value.Variables;
+	return Ar;
+}
+
+void operator<<(FStructuredArchive::FSlot Slot, FSUDSGlobalState& Value)
+{
+	FStructuredArchive::FRecord Record = Slot.EnterRecord();
+	Record << SA_VALUE(TEXT("Variables"), Value.Variables);
+}
+
+/// One text format to compile in the background, and the result
+struct FSUDSTextFormatCompileItem
+{
+	/// The node owning the text; only resolved on the game thread
+	TWeakObjectPtr<const USUDSScriptNode> Node;
+	/// Index of the edge whose text this is, or INDEX_NONE for the text of the node itself
+	int EdgeIndex = INDEX_NONE;
+	FText Text;
+
+	FTextFormat Format;
+	TArray<FName> ParameterNames;
+	TArray<FString> ParameterNameStrings;
+
+	FSUDSTextFormatCompileItem(const USUDSScriptNode* InNode, int InEdgeIndex, const FText& InText)
+		: Node(InNode),
+		  EdgeIndex(InEdgeIndex),
+		  Text(InText)
+	{
+	}
+};
+
+void USUDSSubsystem::AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector)
+{
+	USUDSSubsystem* This = CastChecked<USUDSSubsystem>(InThis);
+	for (auto& Pair : This->DialoguePools)
+	{
+		Collector.AddReferencedObjects(Pair.Value.Available, This);
+	}
+	Super::AddReferencedObjects(InThis, Collector);
+}
+
 void USUDSSubsystem::Initialize(FSubsystemCollectionBase& Collection)
 {
 	Super::Initialize(Collection);
+
+	FInternationalization::Get().OnCultureChanged().AddUObject(this, &USUDSSubsystem::OnCultureChanged);
 }
 
 void USUDSSubsystem::Deinitialize()
 {
+	FInternationalization::Get().OnCultureChanged().RemoveAll(this);
+	// Any batches still in flight will find this object gone and do nothing
+	TextFormatDialogues.Empty();
+	KnownDialogues.Empty();
+	EmptyDialoguePools();
+	PendingExecutionDialogues.Empty();
+	AmbientDialogues.Empty();
+
 	Super::Deinitialize();
 }
 
+void USUDSSubsystem::Tick(float DeltaTime)
+{
+	TickAmbientDialogues(DeltaTime);
+	
+	// Dialogues which still don't finish will add themselves back
+	TArray<TWeakObjectPtr<USUDSDialogue>> ToResume = MoveTemp(PendingExecutionDialogues);
+	PendingExecutionDialogues.Reset();
+	for (auto& WeakDlg : ToResume)
+	{
+		if (auto Dlg = WeakDlg.Get())
+		{
+			Dlg->ResumeExecution();
+		}
+	}
+}
+
+ETickableTickType USUDSSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool USUDSSubsystem::IsTickable() const
+{
+	return !PendingExecutionDialogues.IsEmpty() || !AmbientDialogues.IsEmpty();
+}
+
+TStatId USUDSSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USUDSSubsystem, STATGROUP_Tickables);
+}
+
+void USUDSSubsystem::AddPendingExecution(USUDSDialogue* Dialogue)
+{
+	PendingExecutionDialogues.AddUnique(Dialogue);
+}
+
+void USUDSSubsystem::AddAmbientDialogue(USUDSDialogue* Dialogue, float LineDuration, float Priority)
+{
+	if (!IsValid(Dialogue))
+		return;
+
+	FSUDSAmbientDialogue* Ambient = FindAmbientDialogue(Dialogue);
+	if (!Ambient)
+	{
+		Ambient = &AmbientDialogues.AddDefaulted_GetRef();
+		Ambient->Dialogue = Dialogue;
+	}
+	Ambient->LineDuration = FMath::Max(0.f, LineDuration);
+	Ambient->Priority = Priority;
+	Ambient->NextStepTime = AmbientTime + Ambient->LineDuration;
+	Ambient->DeferredFrames = 0;
+
+	if (Dialogue->IsEnded())
+	{
+		Dialogue->Start();
+	}
+	AmbientMetrics.ActiveCount = AmbientDialogues.Num();
+}
+
+void USUDSSubsystem::RemoveAmbientDialogue(USUDSDialogue* Dialogue)
+{
+	if (bSteppingAmbientDialogues)
+	{
+		// Probably called from an event while stepping; indexes must stay valid so just clear it for now
+		if (auto Ambient = FindAmbientDialogue(Dialogue))
+		{
+			Ambient->Dialogue = nullptr;
+			bAmbientDialoguesNeedCleanup = true;
+		}
+		return;
+	}
+	
+	AmbientDialogues.RemoveAll([Dialogue](const FSUDSAmbientDialogue& A) { return A.Dialogue == Dialogue; });
+	AmbientMetrics.ActiveCount = AmbientDialogues.Num();
+}
+
+void USUDSSubsystem::SetAmbientDialogueLocation(USUDSDialogue* Dialogue, FVector Location)
+{
+	if (auto Ambient = FindAmbientDialogue(Dialogue))
+	{
+		Ambient->Location = Location;
+		Ambient->bHasLocation = true;
+	}
+}
+
+void USUDSSubsystem::SetAmbientListenerLocation(FVector Location)
+{
+	AmbientListenerLocation = Location;
+	bHasAmbientListener = true;
+}
+
+void USUDSSubsystem::ResetAmbientDialogueMetrics()
+{
+	AmbientMetrics = FSUDSAmbientDialogueMetrics();
+	AmbientMetrics.ActiveCount = AmbientDialogues.Num();
+}
+
+FSUDSAmbientDialogue* USUDSSubsystem::FindAmbientDialogue(const USUDSDialogue* Dialogue)
+{
+	return AmbientDialogues.FindByPredicate([Dialogue](const FSUDSAmbientDialogue& A) { return A.Dialogue == Dialogue; });
+}
+
+void USUDSSubsystem::TickAmbientDialogues(float DeltaTime)
+{
+	AmbientTime += DeltaTime;
+	AmbientMetrics.StepsLastFrame = 0;
+	AmbientMetrics.DeferredLastFrame = 0;
+	AmbientMetrics.TimeLastFrameMs = 0;
+
+	if (AmbientDialogues.IsEmpty())
+		return;
+
+	const double StartTime = FPlatformTime::Seconds();
+	
+	// Find everything that's due, and score it
+	// Priority is the main thing, then each frame deferred and each 10m closer to the listener is worth 1 more
+	AmbientDueIndices.Reset();
+	for (int i = 0; i < AmbientDialogues.Num(); ++i)
+	{
+		auto& Ambient = AmbientDialogues[i];
+		if (!IsValid(Ambient.Dialogue) || Ambient.Dialogue->IsEnded())
+		{
+			// Ended outside our control, include so it's cleaned up
+			AmbientDueIndices.Add(i);
+			Ambient.Score = TNumericLimits<float>::Max();
+		}
+		else if (Ambient.NextStepTime <= AmbientTime && !Ambient.Dialogue->IsExecutionPending())
+		{
+			Ambient.Score = Ambient.Priority + Ambient.DeferredFrames;
+			if (Ambient.bHasLocation && bHasAmbientListener)
+			{
+				Ambient.Score -= FVector::Dist(Ambient.Location, AmbientListenerLocation) * 0.001f;
+			}
+			AmbientDueIndices.Add(i);
+		}
+	}
+	AmbientDueIndices.Sort([this](int A, int B)
+	{
+		return AmbientDialogues[A].Score > AmbientDialogues[B].Score;
+	});
+
+	// Step in priority order until the budget runs out
+	// Dialogue events may add or remove ambient dialogues while we do this, so only access by index
+	AmbientSteppedDialogues.Reset();
+	AmbientSteppedDispatchModes.Reset();
+	const double EndTime = StartTime + AmbientStepBudgetMs * 0.001;
+	bool bAnyEnded = false;
+	bSteppingAmbientDialogues = true;
+	for (const int Idx : AmbientDueIndices)
+	{
+		USUDSDialogue* Dlg = AmbientDialogues[Idx].Dialogue;
+		if (!IsValid(Dlg) || Dlg->IsEnded())
+		{
+			bAnyEnded = true;
+			continue;
+		}
+		
+		if (AmbientMetrics.StepsLastFrame > 0 && FPlatformTime::Seconds() >= EndTime)
+		{
+			const int Deferred = ++AmbientDialogues[Idx].DeferredFrames;
+			++AmbientMetrics.DeferredLastFrame;
+			AmbientMetrics.MaxDeferredFrames = FMath::Max(AmbientMetrics.MaxDeferredFrames, Deferred);
+			continue;
+		}
+
+		// Hold back notifications so that all participants hear about this frame together, after stepping
+		AmbientSteppedDispatchModes.Add(Dlg->GetEventDispatchMode());
+		Dlg->SetEventDispatchMode(ESUDSEventDispatchMode::DeferredManual);
+		if (Dlg->GetNumberOfChoices() > 1)
+		{
+			Dlg->Choose(0);
+		}
+		else
+		{
+			Dlg->Continue();
+		}
+		AmbientDialogues[Idx].NextStepTime = AmbientTime + AmbientDialogues[Idx].LineDuration;
+		AmbientDialogues[Idx].DeferredFrames = 0;
+		bAnyEnded |= Dlg->IsEnded();
+		AmbientSteppedDialogues.Add(Dlg);
+		++AmbientMetrics.StepsLastFrame;
+	}
+	AmbientMetrics.TotalSteps += AmbientMetrics.StepsLastFrame;
+	AmbientMetrics.TotalDeferred += AmbientMetrics.DeferredLastFrame;
+
+	// Now send everything that was held back. Still counts as stepping, since listeners may add or remove
+	// ambient dialogues
+	for (int i = 0; i < AmbientSteppedDialogues.Num(); ++i)
+	{
+		USUDSDialogue* Dlg = AmbientSteppedDialogues[i];
+		const ESUDSEventDispatchMode PrevMode = AmbientSteppedDispatchModes[i];
+		// If a listener released the dialogue it's been reset already
+		if (IsValid(Dlg) && Dlg->GetEventDispatchMode() == ESUDSEventDispatchMode::DeferredManual &&
+			PrevMode != ESUDSEventDispatchMode::DeferredManual)
+		{
+			// Back to Immediate sends everything queued
+			Dlg->SetEventDispatchMode(PrevMode);
+			if (PrevMode == ESUDSEventDispatchMode::DeferredAutoFlush)
+			{
+				Dlg->FlushQueuedEvents();
+			}
+		}
+	}
+	bSteppingAmbientDialogues = false;
+	bAnyEnded |= bAmbientDialoguesNeedCleanup;
+	bAmbientDialoguesNeedCleanup = false;
+
+	// One notification for everything
+	if (!AmbientSteppedDialogues.IsEmpty())
+	{
+		OnAmbientDialoguesStepped.Broadcast(AmbientSteppedDialogues);
+	}
+
+	if (bAnyEnded)
+	{
+		for (int i = AmbientDialogues.Num() - 1; i >= 0; --i)
+		{
+			USUDSDialogue* Dlg = AmbientDialogues[i].Dialogue;
+			if (!IsValid(Dlg) || Dlg->IsEnded())
+			{
+				AmbientDialogues.RemoveAtSwap(i, 1, false);
+				if (IsValid(Dlg) && Dlg->GetOuter() == this)
+				{
+					ReleaseDialogue(Dlg);
+				}
+			}
+		}
+	}
+	
+	AmbientMetrics.ActiveCount = AmbientDialogues.Num();
+	AmbientMetrics.TimeLastFrameMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+}
+
+bool USUDSSubsystem::IsGlobalVariableName(FName Name)
+{
+	// Avoid allocating, this is called for every variable set
+	TStringBuilder<128> Builder;
+	Name.AppendString(Builder);
+	return Builder.ToView().StartsWith(GlobalVariablePrefix, ESearchCase::IgnoreCase);
+}
+
+FName USUDSSubsystem::MakeGlobalVariableName(FName Name)
+{
+	if (IsGlobalVariableName(Name))
+		return Name;
+
+	return FName(GlobalVariablePrefix + Name.ToString());
+}
+
+void USUDSSubsystem::SetGlobalVariable(FName Name, FSUDSValue Value, bool bFromScript)
+{
+	Name = MakeGlobalVariableName(Name);
+	const FSUDSValue* OldValue = GlobalVariables.Find(Name);
+	if (!OldValue || (*OldValue != Value).GetBooleanValue())
+	{
+		GlobalVariables.Add(Name, Value);
+		++GlobalVariablesVersion;
+		OnGlobalVariableChanged.Broadcast(Name, Value, bFromScript);
+	}
+}
+
+FSUDSValue USUDSSubsystem::GetGlobalVariable(FName Name) const
+{
+	if (const auto Value = GlobalVariables.Find(MakeGlobalVariableName(Name)))
+	{
+		return *Value;
+	}
+	return FSUDSValue();
+}
+
+bool USUDSSubsystem::IsGlobalVariableSet(FName Name) const
+{
+	return GlobalVariables.Contains(MakeGlobalVariableName(Name));
+}
+
+void USUDSSubsystem::UnSetGlobalVariable(FName Name)
+{
+	Name = MakeGlobalVariableName(Name);
+	if (GlobalVariables.Remove(Name) > 0)
+	{
+		++GlobalVariablesVersion;
+		// Unset reads back as an empty value, so that's what listeners get
+		OnGlobalVariableChanged.Broadcast(Name, FSUDSValue(), false);
+	}
+}
+
+FSUDSGlobalState USUDSSubsystem::GetSavedGlobalState() const
+{
+	return FSUDSGlobalState(GlobalVariables);
+}
+
+void USUDSSubsystem::RestoreSavedGlobalState(const FSUDSGlobalState& State)
+{
+	TMap<FName, FSUDSValue> OldVariables = MoveTemp(GlobalVariables);
+	GlobalVariables.Reset();
+	// Be tolerant of names saved without the prefix
+	for (const auto& Pair : State.GetVariables())
+	{
+		GlobalVariables.Add(MakeGlobalVariableName(Pair.Key), Pair.Value);
+	}
+	++GlobalVariablesVersion;
+
+	// Notify the same way as individual sets / unsets would, but only for variables which actually changed
+	for (const auto& Pair : GlobalVariables)
+	{
+		const FSUDSValue* OldValue = OldVariables.Find(Pair.Key);
+		if (!OldValue || (*OldValue != Pair.Value).GetBooleanValue())
+		{
+			OnGlobalVariableChanged.Broadcast(Pair.Key, Pair.Value, false);
+		}
+	}
+	for (const auto& Pair : OldVariables)
+	{
+		if (!GlobalVariables.Contains(Pair.Key))
+		{
+			OnGlobalVariableChanged.Broadcast(Pair.Key, FSUDSValue(), false);
+		}
+	}
+}
+
+USUDSDialogue* USUDSSubsystem::AcquireDialogue(USUDSScript* Script,
+                                               const TArray<UObject*>& Participants,
+                                               bool bStartImmediately,
+                                               FName StartLabel)
+{
+	if (!IsValid(Script))
+	{
+		UE_LOG(LogSUDSSubsystem, Error, TEXT("Called AcquireDialogue with an invalid script"))
+		return nullptr;
+	}
+
+	++DialoguePoolStats.Acquired;
+
+	USUDSDialogue* Dlg = nullptr;
+	if (auto Pool = DialoguePools.Find(TObjectKey<USUDSScript>(Script)))
+	{
+		while (!Dlg && !Pool->Available.IsEmpty())
+		{
+			Dlg = Pool->Available.Pop(false);
+			--DialoguePoolStats.Pooled;
+			if (!IsValid(Dlg))
+			{
+				Dlg = nullptr;
+			}
+		}
+	}
+
+	if (Dlg)
+	{
+		++DialoguePoolStats.Reused;
+	}
+	else
+	{
+		++DialoguePoolStats.Created;
+		const FName Name = MakeUniqueObjectName(this, USUDSDialogue::StaticClass(), Script->GetFName());
+		Dlg = NewObject<USUDSDialogue>(this, Name);
+	}
+
+	// Participants before init, same as USUDSLibrary::CreateDialogueWithParticipants
+	Dlg->SetParticipants(Participants);
+	Dlg->SetSubsystem(this);
+	Dlg->Initialise(Script);
+	if (bStartImmediately)
+	{
+		Dlg->Start(StartLabel);
+	}
+	return Dlg;
+	
+}
+
+void USUDSSubsystem::ReleaseDialogue(USUDSDialogue* Dialogue)
+{
+	if (!IsValid(Dialogue))
+		return;
+
+	if (Dialogue->GetOuter() != this)
+	{
+		UE_LOG(LogSUDSSubsystem, Warning, TEXT("ReleaseDialogue called on %s which wasn't acquired from the pool, ignoring"), *Dialogue->GetName())
+		return;
+	}
+
+	// Released dialogues have their script cleared, which is also how we spot them being released again
+	const USUDSScript* Script = Dialogue->GetScript();
+	if (!Script)
+	{
+		UE_LOG(LogSUDSSubsystem, Warning, TEXT("ReleaseDialogue called on %s which is already released, ignoring"), *Dialogue->GetName())
+		return;
+	}
+	const TObjectKey<USUDSScript> ScriptKey(Script);
+	const bool bScriptValid = IsValid(Script);
+
+	++DialoguePoolStats.Released;
+	// It mustn't carry on being stepped, it could be given to someone else before the next tick
+	RemoveAmbientDialogue(Dialogue);
+	if (!Dialogue->IsEnded())
+	{
+		Dialogue->End(true);
+	}
+	Dialogue->ResetForReuse();
+
+	FSUDSDialoguePool* Pool = DialoguePools.Find(ScriptKey);
+	if (!Pool && bScriptValid)
+	{
+		PruneDialoguePools();
+		Pool = &DialoguePools.Add(ScriptKey);
+	}
+	if (Pool && Pool->Available.Num() < MaxPooledDialoguesPerScript)
+	{
+		Pool->Available.Add(Dialogue);
+		++DialoguePoolStats.Pooled;
+	}
+	else
+	{
+		// Nothing else references it now, GC will clean it up
+		++DialoguePoolStats.Discarded;
+	}
+	
+}
+
+void USUDSSubsystem::PruneDialoguePools()
+{
+	for (auto It = DialoguePools.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().ResolveObjectPtr())
+		{
+			// Script has been unloaded, these can never be reused
+			DialoguePoolStats.Pooled -= It.Value().Available.Num();
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void USUDSSubsystem::SetMaxPooledDialoguesPerScript(int Max)
+{
+	MaxPooledDialoguesPerScript = FMath::Max(0, Max);
+	for (auto& Pair : DialoguePools)
+	{
+		auto& Available = Pair.Value.Available;
+		if (Available.Num() > MaxPooledDialoguesPerScript)
+		{
+			DialoguePoolStats.Pooled -= Available.Num() - MaxPooledDialoguesPerScript;
+			Available.SetNum(MaxPooledDialoguesPerScript);
+		}
+	}
+}
+
+void USUDSSubsystem::ResetDialoguePoolStats()
+{
+	const int Pooled = DialoguePoolStats.Pooled;
+	DialoguePoolStats = FSUDSDialoguePoolStats();
+	DialoguePoolStats.Pooled = Pooled;
+}
+
+void USUDSSubsystem::EmptyDialoguePools()
+{
+	DialoguePools.Empty();
+	DialoguePoolStats.Pooled = 0;
+}
+
+void USUDSSubsystem::RegisterDialogue(USUDSDialogue* Dialogue)
+{
+	KnownDialogues.Add(Dialogue);
+	if (KnownDialogues.Num() >= KnownDialoguesPruneThreshold)
+	{
+		for (auto It = KnownDialogues.CreateIterator(); It; ++It)
+		{
+			if (!It->IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+		KnownDialoguesPruneThreshold = FMath::Max(64, KnownDialogues.Num() * 2);
+	}
+}
+
+void USUDSSubsystem::OnCultureChanged()
+{
+	RecompileTextFormatsImpl(true);
+}
+
+void USUDSSubsystem::RecompileTextFormats()
+{
+	RecompileTextFormatsImpl(false);
+}
+
+void USUDSSubsystem::RecompileTextFormatsImpl(bool bSkipUpToDateScripts)
+{
+	check(IsInGameThread());
+	
+	++TextFormatRevision;
+
+	// Only our own dialogues; other game instances (e.g. PIE) have their own subsystem to deal with theirs
+	// Resolved text in dialogues is stale now whatever happens, so invalidate that straight away. Until the new
+	// formats arrive the existing ones are still correct, they just recompile themselves lazily if used.
+	TextFormatDialogues.Reset();
+	TSet<const USUDSScript*> Scripts;
+	for (auto& WeakDlg : KnownDialogues)
+	{
+		USUDSDialogue* Dlg = WeakDlg.Get();
+		if (IsValid(Dlg))
+		{
+			Dlg->NotifyTextFormatsChanged();
+			if (const USUDSScript* Script = Dlg->GetScript())
+			{
+				Scripts.Add(Script);
+			}
+			if (!Dlg->IsEnded())
+			{
+				TextFormatDialogues.Add(Dlg);
+			}
+		}
+	}
+	for (auto& Pair : DialoguePools)
+	{
+		if (const USUDSScript* Script = Pair.Key.ResolveObjectPtr())
+		{
+			Scripts.Add(Script);
+		}
+	}
+
+	// Several subsystems may be reacting to the same culture change, only compile each script once
+	const FString Culture = FInternationalization::Get().GetCurrentLanguage()->GetName() + TEXT("|") +
+		FInternationalization::Get().GetCurrentLocale()->GetName();
+	for (auto It = Scripts.CreateIterator(); It; ++It)
+	{
+		if (bSkipUpToDateScripts && (*It)->GetTextFormatsCulture() == Culture)
+		{
+			It.RemoveCurrent();
+		}
+		else
+		{
+			(*It)->SetTextFormatsCulture(Culture);
+		}
+	}
+
+	// Lines that active dialogues are about to show go first, on high priority threads
+	TSet<const USUDSScriptNode*> Gathered;
+	TArray<FSUDSTextFormatCompileItem> Items;
+	for (auto& WeakDlg : TextFormatDialogues)
+	{
+		const auto Dlg = WeakDlg.Get();
+		if (Dlg && Scripts.Contains(Dlg->GetScript()))
+		{
+			GatherTextFormatsNear(Dlg->GetCurrentSpeakerNode(), Gathered, Items);
+		}
+	}
+	DispatchTextFormatBatch(MoveTemp(Items), true);
+
+	// Everything else in those scripts
+	Items.Reset();
+	for (const USUDSScript* Script : Scripts)
+	{
+		for (const auto Node : Script->GetNodes())
+		{
+			if (Node && !Gathered.Contains(Node))
+			{
+				AddTextFormatCompileItems(Node, Items);
+				if (Items.Num() >= TextFormatBatchSize)
+				{
+					DispatchTextFormatBatch(MoveTemp(Items), false);
+					Items.Reset();
+				}
+			}
+		}
+	}
+	DispatchTextFormatBatch(MoveTemp(Items), false);
+}
+
+void USUDSSubsystem::GatherTextFormatsNear(const USUDSScriptNode* StartNode,
+                                           TSet<const USUDSScriptNode*>& Gathered,
+                                           TArray<FSUDSTextFormatCompileItem>& OutItems)
+{
+	if (!StartNode)
+		return;
+
+	// Breadth first so that the closest lines come first
+	TArray<const USUDSScriptNode*, TInlineAllocator<TextFormatPriorityNodeCount>> Queue;
+	Queue.Add(StartNode);
+	for (int i = 0; i < Queue.Num() && i < TextFormatPriorityNodeCount; ++i)
+	{
+		const USUDSScriptNode* Node = Queue[i];
+		bool bAlreadyGathered = false;
+		Gathered.Add(Node, &bAlreadyGathered);
+		if (bAlreadyGathered)
+			continue;
+
+		AddTextFormatCompileItems(Node, OutItems);
+		for (auto& Edge : Node->GetEdges())
+		{
+			if (const auto Target = Edge.GetTargetNode().Get())
+			{
+				Queue.AddUnique(Target);
+			}
+		}
+	}
+}
+
+void USUDSSubsystem::AddTextFormatCompileItems(const USUDSScriptNode* Node,
+                                               TArray<FSUDSTextFormatCompileItem>& OutItems)
+{
+	if (const auto TextNode = Cast<USUDSScriptNodeText>(Node))
+	{
+		OutItems.Emplace(Node, INDEX_NONE, TextNode->GetText());
+	}
+	const auto& Edges = Node->GetEdges();
+	for (int i = 0; i < Edges.Num(); ++i)
+	{
+		if (!Edges[i].GetText().IsEmpty())
+		{
+			OutItems.Emplace(Node, i, Edges[i].GetText());
+		}
+	}
+}
+
+void USUDSSubsystem::DispatchTextFormatBatch(TArray<FSUDSTextFormatCompileItem>&& Items, bool bHighPriority)
+{
+	if (Items.IsEmpty())
+		return;
+
+	++PendingTextFormatBatches;
+
+	auto Batch = MakeShared<TArray<FSUDSTextFormatCompileItem>, ESPMode::ThreadSafe>(MoveTemp(Items));
+	const uint32 Revision = TextFormatRevision;
+	TWeakObjectPtr<USUDSSubsystem> WeakThis(this);
+	AsyncTask(bHighPriority ? ENamedThreads::AnyHiPriThreadHiPriTask : ENamedThreads::AnyBackgroundThreadNormalTask,
+	          [Batch, Revision, WeakThis]()
+	          {
+		          // Only touch the text, the nodes are left alone until we're back on the game thread
+		          for (auto& Item : *Batch)
+		          {
+			          Item.Format = FTextFormat(Item.Text);
+			          Item.Format.GetFormatArgumentNames(Item.ParameterNameStrings);
+			          Item.ParameterNames.Reserve(Item.ParameterNameStrings.Num());
+			          for (auto& Name : Item.ParameterNameStrings)
+			          {
+				          Item.ParameterNames.Add(FName(Name));
+			          }
+		          }
+
+		          AsyncTask(ENamedThreads::GameThread,
+		                    [Batch, Revision, WeakThis]()
+		                    {
+			                    if (auto This = WeakThis.Get())
+			                    {
+				                    This->ApplyTextFormatBatch(*Batch, Revision);
+			                    }
+		                    });
+	          });
+}
+
+void USUDSSubsystem::ApplyTextFormatBatch(const TArray<FSUDSTextFormatCompileItem>& Items, uint32 Revision)
+{
+	--PendingTextFormatBatches;
+
+	// If the culture changed again while this batch was compiling, a newer one is on its way
+	if (Revision != TextFormatRevision)
+		return;
+
+	for (auto& Item : Items)
+	{
+		const USUDSScriptNode* Node = Item.Node.Get();
+		if (!Node)
+			continue;
+
+		if (Item.EdgeIndex == INDEX_NONE)
+		{
+			if (const auto TextNode = Cast<USUDSScriptNodeText>(Node))
+			{
+				TextNode->ApplyCompiledFormat(Item.Format, Item.ParameterNames, Item.ParameterNameStrings);
+			}
+		}
+		else if (const auto Edge = Node->GetEdge(Item.EdgeIndex))
+		{
+			Edge->ApplyCompiledFormat(Item.Format, Item.ParameterNames, Item.ParameterNameStrings);
+		}
+	}
+
+	// Choices in active dialogues are copies so need to pick up the new formats
+	for (auto& WeakDlg : TextFormatDialogues)
+	{
+		if (auto Dlg = WeakDlg.Get())
+		{
+			Dlg->NotifyTextFormatsChanged();
+		}
+	}
+}
@@ -6,9 +6,11 @@
 #include "UObject/Object.h"
 #include "SUDSDialogue.generated.h"
 
+class USUDSSubsystem;
 class USUDSScriptNodeGosub;
 class USUDSScriptNodeText;
 struct FSUDSScriptEdge;
+struct FSUDSChoicePlan;
 class USUDSScriptNode;
 class USUDSScript;
 
@@ -22,6 +24,16 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnDialogueEvent, class USUDSDial
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_FourParams(FOnVariableChangedEvent, class USUDSDialogue*, Dialogue, FName, VariableName, const FSUDSValue&, Value, bool, bFromScript);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnVariableRequestedEvent, class USUDSDialogue*, Dialogue, FName, VariableName);
 
+// Native equivalents for C++ listeners, avoid the reflection / ProcessEvent overhead of the dynamic versions
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnDialogueSpeakerLineNative, class USUDSDialogue* /*Dialogue*/);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnDialogueChoiceNative, class USUDSDialogue* /*Dialogue*/, int /*ChoiceIndex*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnDialogueProceedingNative, class USUDSDialogue* /*Dialogue*/);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnDialogueStartingNative, class USUDSDialogue* /*Dialogue*/, FName /*AtLabel*/);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnDialogueFinishedNative, class USUDSDialogue* /*Dialogue*/);
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnDialogueEventNative, class USUDSDialogue* /*Dialogue*/, FName /*EventName*/, TArrayView<const FSUDSValue> /*Arguments*/);
+DECLARE_MULTICAST_DELEGATE_FourParams(FOnVariableChangedNative, class USUDSDialogue* /*Dialogue*/, FName /*VariableName*/, const FSUDSValue& /*Value*/, bool /*bFromScript*/);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnVariableRequestedNative, class USUDSDialogue* /*Dialogue*/, FName /*VariableName*/);
+
 #if WITH_EDITOR
 	// Non-dynamic events for editor use
 	DECLARE_DELEGATE_TwoParams(FOnDialogueSpeakerLineInternal, class USUDSDialogue* /* Dialogue */, int /*SourceLineNo*/);
@@ -37,6 +49,19 @@ DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnVariableRequestedEvent, class US
 
 DECLARE_LOG_CATEGORY_EXTERN(LogSUDSDialogue, Verbose, All);
 
+/// When a dialogue notifies participants and listeners of what's happening
+UENUM(BlueprintType)
+enum class ESUDSEventDispatchMode : uint8
+{
+	/// Notifications are sent immediately, in the middle of running the script (the default)
+	Immediate,
+	/// Notifications are queued while running the script, then all sent at the end of the call which caused them
+	/// (Start, Continue, Choose, Restart, End, SetVariable etc)
+	DeferredAutoFlush,
+	/// Notifications are queued until you call FlushQueuedEvents
+	DeferredManual
+};
+
 /// Copy of the internal state of a dialogue
 USTRUCT(BlueprintType)
 struct FSUDSDialogueState
@@ -135,6 +160,17 @@ public:
 	/// Event raised when the dialogue finishes
 	UPROPERTY(BlueprintAssignable)
 	FOnDialogueFinished OnFinished;
+
+	/// Native versions of the events above, for C++ listeners. These are raised at the same points as their dynamic
+	/// counterparts (immediately before them) but don't go through reflection / ProcessEvent.
+	FOnDialogueSpeakerLineNative OnSpeakerLineNative;
+	FOnDialogueChoiceNative OnChoiceNative;
+	FOnDialogueProceedingNative OnProceedingNative;
+	FOnDialogueEventNative OnEventNative;
+	FOnVariableChangedNative OnVariableChangedNative;
+	FOnVariableRequestedNative OnVariableRequestedNative;
+	FOnDialogueStartingNative OnStartingNative;
+	FOnDialogueFinishedNative OnFinishedNative;
 protected:
 	UPROPERTY()
 	const USUDSScript* BaseScript;
@@ -146,6 +182,10 @@ protected:
 	/// External objects which want to closely participate in the dialogue (not just listen to events)
 	UPROPERTY()
 	TArray<UObject*> Participants;
+
+	/// Subsystem holding global variables, may be null
+	UPROPERTY()
+	USUDSSubsystem* Subsystem;
 	
 
 	/// All of the dialogue variables
@@ -166,51 +206,187 @@ protected:
 	bool bParamNamesExtracted;
 	
 	/// Cached derived info
-	mutable FText CurrentSpeakerDisplayName;
+	/// Speaker display names, indexed like USUDSScript::GetSpeakers(). Only invalidated when the related
+	/// SpeakerName.X variable changes
+	mutable TArray<FText> SpeakerDisplayNameCache;
+	mutable TBitArray<> SpeakerDisplayNameCacheValid;
 	/// All valid choices
 	TArray<FSUDSScriptEdge> CurrentChoices;
+	/// Where a current choice was copied from. This is the node & edge index rather than a pointer to the edge, because
+	/// reimporting a script can rebuild the edges of its nodes while a dialogue is running
+	struct FChoiceSource
+	{
+		TWeakObjectPtr<const USUDSScriptNode> Node;
+		int EdgeIndex = INDEX_NONE;
+
+		FChoiceSource() {}
+		FChoiceSource(const USUDSScriptNode* InNode, int InEdgeIndex) : Node(InNode), EdgeIndex(InEdgeIndex) {}
+		/// Get the edge, or null if the node has gone or no longer has it
+		const FSUDSScriptEdge* GetEdge() const;
+	};
+	/// The script edges that CurrentChoices were copied from
+	TArray<FChoiceSource> CurrentChoiceSources;
+
+	/// Version stamp of the last change to each variable, for invalidating cached text
+	TMap<FName, uint32> VariableVersions;
+	/// Incremented every time any variable changes
+	uint32 VariableVersionCounter = 0;
+	/// Version at which all variables were last changed in bulk (reset, restore)
+	uint32 VariableBulkChangeVersion = 0;
+
+	/// Resolved parameterised text, valid until one of the parameters changes
+	struct FResolvedTextCacheEntry
+	{
+		FText Text;
+		uint32 Version = 0;
+		/// Global variables version at the time, any global change invalidates
+		uint32 GlobalVersion = 0;
+		bool bValid = false;
+	};
+	FResolvedTextCacheEntry CurrentTextCache;
+	/// Same indexes as CurrentChoices
+	TArray<FResolvedTextCacheEntry> CurrentChoiceTextCache;
+	int TextCacheHits = 0;
+	int TextCacheMisses = 0;
+
 	int CurrentSourceLineNo;
+	/// Whether this dialogue is currently included in the active dialogues stat
+	bool bCountedAsActive = false;
+
+	ESUDSEventDispatchMode EventDispatchMode = ESUDSEventDispatchMode::Immediate;
+	enum class EQueuedEventType : uint8
+	{
+		Starting,
+		Finished,
+		SpeakerLine,
+		ChoiceMade,
+		Proceeding,
+		Event,
+		VariableChanged
+	};
+	/// A queued notification. Any values are stored in QueuedEventArgs so this stays small
+	struct FQueuedEvent
+	{
+		EQueuedEventType Type;
+		bool bFromScript;
+		/// Label, event name or variable name
+		FName Name;
+		/// Choice index
+		int Index;
+		int LineNo;
+		/// Range of QueuedEventArgs
+		int ArgsStart;
+		int NumArgs;
+	};
+	/// Queued notifications in order, and their argument values. Both are Reset() not freed when flushed
+	TArray<FQueuedEvent> QueuedEvents;
+	TArray<FSUDSValue> QueuedEventArgs;
+	/// Re-used when dispatching queued event arguments
+	TArray<FSUDSValue> DispatchEventArgs;
+	/// Re-used for evaluating event arguments, one array per level of re-entrancy (listeners can cause events).
+	/// Indirect so that adding a level doesn't move arrays which are in use.
+	TIndirectArray<TArray<FSUDSValue>> EventArgsScratch;
+	int EventArgsScratchDepth = 0;
+	bool bFlushingQueuedEvents = false;
+
+	/// Execution budget per call, 0 means unlimited. See SetExecutionBudget
+	int ExecutionNodeBudget = 0;
+	float ExecutionTimeBudgetMs = 0;
+	/// Number of nodes run without reaching a speaker line before we give up, 0 means unlimited
+	static constexpr int DefaultRunawayStepLimit = 100000;
+	int RunawayStepLimit = DefaultRunawayStepLimit;
+	/// Nodes run so far in the current continuation, across yields
+	int RunawayStepCount = 0;
+	/// Where to resume execution from if it yielded because of the budget
+	UPROPERTY()
+	USUDSScriptNode* PendingExecutionNode;
+	bool bExecutionPending = false;
+	bool bPendingExecutionRaiseAtEnd = false;
+
 	static const FText DummyText;
 	static const FString DummyString;
 
 	void InitVariables();
-	void RunUntilNextSpeakerNodeOrEnd(USUDSScriptNode* FromNode, bool bRaiseAtEnd);
+	void RunUntilNextSpeakerNodeOrEnd(USUDSScriptNode* FromNode, bool bRaiseAtEnd, bool bAllowYield = true);
+	void RunNodesUntilSpeakerNodeOrEnd(USUDSScriptNode* NextNode, bool bRaiseAtEnd, bool bAllowYield);
+	void ClearPendingExecution();
 	const USUDSScriptNode* WalkToNextChoiceNode(USUDSScriptNode* FromNode, bool bExecute);
-	USUDSScriptNode* RecurseWalkToNextChoiceOrTextNode(USUDSScriptNode* Node, bool bExecute, TArray<USUDSScriptNodeGosub*>& LocalGosubStack);
+	USUDSScriptNode* RecurseWalkToNextChoiceOrTextNode(USUDSScriptNode* Node, bool bExecute, TArray<USUDSScriptNodeGosub*>& LocalGosubStack, int& StepCount);
 	const USUDSScriptNode* RunUntilNextChoiceNode(USUDSScriptNode* FromTextNode);
 	const USUDSScriptNode* FindNextChoiceNode(USUDSScriptNode* FromNode);
 	void SetCurrentSpeakerNode(USUDSScriptNodeText* Node, bool bQuietly);
 	void SortParticipants();
+	/// Track this dialogue in the active dialogues stat
+	void SetCountedAsActive(bool bActive);
+	bool ShouldQueueEvents() const { return EventDispatchMode != ESUDSEventDispatchMode::Immediate; }
+	/// Whether anything would observe a script event, including variable requests made while building its arguments
+	bool HasEventListeners() const;
+	FQueuedEvent& QueueEvent(EQueuedEventType Type, FName Name = NAME_None, int Index = 0, int LineNo = 0);
+	void AutoFlushQueuedEvents();
+	void DispatchQueuedEvent(const FQueuedEvent& Evt);
 	void RaiseStarting(FName StartLabel);
 	void RaiseFinished();
 	void RaiseNewSpeakerLine();
 	void RaiseChoiceMade(int Index, int LineNo);
 	void RaiseProceeding();
 	void RaiseVariableChange(const FName& VarName, const FSUDSValue& Value, bool bFromScript, int LineNo);
+	void DispatchStarting(FName StartLabel);
+	void DispatchFinished();
+	void DispatchNewSpeakerLine(int LineNo);
+	void DispatchChoiceMade(int Index, int LineNo);
+	void DispatchProceeding();
+	void DispatchEvent(FName EventName, const TArray<FSUDSValue>& Args, int LineNo);
+	void DispatchVariableChange(const FName& VarName, const FSUDSValue& Value, bool bFromScript, int LineNo);
 	void RaiseVariableRequested(const FName& VarName, int LineNo);
 	void RaiseExpressionVariablesRequested(const FSUDSExpression& Expression, int LineNo);
 
 	USUDSScriptNode* GetNextNode(USUDSScriptNode* Node);
-	bool IsChoiceOrTextNode(ESUDSScriptNodeType Type);
+	bool IsChoiceOrTextNode(ESUDSScriptNodeType Type) const;
 	USUDSScriptNode* RunNode(USUDSScriptNode* Node);
 	USUDSScriptNode* RunSelectNode(USUDSScriptNode* Node);
 	USUDSScriptNode* RunSetVariableNode(USUDSScriptNode* Node);
+	void RunSetAssignment(const FName& Identifier, const FSUDSExpression& Expression, int LineNo);
 	USUDSScriptNode* RunEventNode(USUDSScriptNode* Node);
 	USUDSScriptNode* RunGosubNode(USUDSScriptNode* Node);
 	USUDSScriptNode* RunReturnNode(USUDSScriptNode* Node);
 	void UpdateChoices();
-	void RecurseAppendChoices(const USUDSScriptNode* Node, TArray<FSUDSScriptEdge>& OutChoices);
-
-	FText ResolveParameterisedText(const TArray<FName> Params, const FTextFormat& TextFormat, int LineNo);
-	void GetTextFormatArgs(const TArray<FName>& ArgNames, FFormatNamedArguments& OutArgs) const;
+	void RecurseAppendChoices(const USUDSScriptNode* Node, TArray<FChoiceSource>& OutChoices);
+	void AppendPlannedChoices(const FSUDSChoicePlan& Plan, TArray<FChoiceSource>& OutChoices);
+
+	const USUDSScriptNode* GetHypotheticalNextNode(const USUDSScriptNode* Node, const FSUDSValueMap& Overrides) const;
+	void RecurseAppendHypotheticalChoices(const USUDSScriptNode* Node,
+	                                      const FSUDSValueMap& Overrides,
+	                                      TArray<const FSUDSScriptEdge*>& OutChoices) const;
+
+	FText ResolveParameterisedText(const TArray<FName>& Params,
+	                               const TArray<FString>& ParamStrings,
+	                               const FTextFormat& TextFormat,
+	                               int LineNo,
+	                               FResolvedTextCacheEntry& Cache);
+	bool IsTextCacheEntryCurrent(const FResolvedTextCacheEntry& Cache, const TArray<FName>& Params) const;
+	void GetTextFormatArgs(const TArray<FName>& ArgNames, const TArray<FString>& ArgNameStrings, FFormatNamedArguments& OutArgs) const;
 	bool CurrentNodeHasChoices() const;
+	/// Called whenever a single variable is changed or removed, to invalidate anything derived from it
+	void VariableStateChanged(const FName& Name);
+	/// Called when variable state has been changed in bulk, invalidates everything derived from it
+	void AllVariableStateChanged();
+	const TMap<FName, FSUDSValue>* GetGlobalVariables() const;
+	/// Find a variable by name, looking in the subsystem for names with the global prefix
+	const FSUDSValue* FindVariable(FName Name) const;
+	/// Set a global variable if Name has the global prefix and return true, otherwise return false
+	bool SetGlobalVariableImpl(FName Name, const FSUDSValue& Value, bool bFromScript);
 	void SetVariableImpl(FName Name, const FSUDSValue& Value, bool bFromScript, int LineNo)
 	{
+		// Global variables live in the subsystem and raise their own change event, once
+		if (SetGlobalVariableImpl(Name, Value, bFromScript))
+			return;
+		
 		const FSUDSValue OldValue = GetVariable(Name);
 		if (!IsVariableSet(Name) ||
 			(OldValue != Value).GetBooleanValue())
 		{
 			VariableState.Add(Name, Value);
+			VariableStateChanged(Name);
 			RaiseVariableChange(Name, Value, bFromScript, LineNo);
 		}
 		
@@ -223,10 +399,35 @@ public:
 	//		UE_LOG(LogTemp, Warning, TEXT("*********** Destroyed Dialogue!"));
 	// }
 	void Initialise(const USUDSScript* Script);
+	virtual void BeginDestroy() override;
+	/// Includes memory allocated for variables, choices, caches and queues, not the script it's running
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
+	/**
+	 * Set the subsystem which holds global variables ({global.X}) for this dialogue. You don't normally need to
+	 * call this, Initialise finds the subsystem for the dialogue's world. Call it before Initialise if the dialogue
+	 * isn't owned by something in a game world.
+	 */
+	void SetSubsystem(USUDSSubsystem* InSubsystem) { Subsystem = InSubsystem; }
 
 	/// Get the script asset this dialogue is based on
 	UFUNCTION(BlueprintCallable, BlueprintPure)
 	const USUDSScript* GetScript() const { return BaseScript; }
+
+	/// Get the speaker node the dialogue is currently on, or null if ended
+	const USUDSScriptNodeText* GetCurrentSpeakerNode() const { return CurrentSpeakerNode; }
+
+	/// Called when compiled text formats have changed (e.g. the culture changed). Invalidates any resolved text
+	/// and refreshes the formats on the current choices.
+	void NotifyTextFormatsChanged();
+
+	/**
+	 * Return this dialogue to a blank state so that it can be re-initialised for another conversation, without
+	 * releasing memory already allocated for variables, choices etc. All participants and event bindings are removed,
+	 * and the script is cleared so that a pooled dialogue doesn't keep it loaded.
+	 * Used by the dialogue pool in USUDSSubsystem; you probably want USUDSSubsystem::ReleaseDialogue instead.
+	 */
+	void ResetForReuse();
 	
 	/**
 	 * Begin the dialogue. Make sure you've added all participants before calling this.
@@ -345,6 +546,59 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure)
 	bool IsEnded() const;
 
+	/**
+	 * Limit how much script is run in a single call when the dialogue progresses (Continue, Choose, Start etc).
+	 * If the limit is reached before the next speaker line, execution yields and is resumed later, either by the
+	 * SUDS subsystem on the next tick or by you calling ResumeExecution. While execution is pending the dialogue
+	 * is still on the previous speaker line, and you can't Continue or Choose. OnSpeakerLine is raised as usual
+	 * when the next line is reached. The header section always runs in full.
+	 * @param MaxNodes Maximum number of nodes to run per call, 0 for no limit
+	 * @param MaxMilliseconds Maximum time to spend per call, 0 for no limit
+	 */
+	UFUNCTION(BlueprintCallable)
+	void SetExecutionBudget(int MaxNodes, float MaxMilliseconds);
+
+	/**
+	 * Set the maximum number of nodes which can be run without reaching a speaker line. If this is exceeded the
+	 * script is assumed to be stuck in a loop; an error is logged and the dialogue ends.
+	 * @param MaxSteps The step limit, 0 for no limit
+	 */
+	UFUNCTION(BlueprintCallable)
+	void SetRunawayStepLimit(int MaxSteps) { RunawayStepLimit = FMath::Max(0, MaxSteps); }
+
+	/// Returns true if execution yielded because of the execution budget and hasn't reached the next line yet
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool IsExecutionPending() const { return bExecutionPending; }
+
+	/**
+	 * Change when this dialogue notifies participants and event listeners. In the deferred modes notifications
+	 * are queued while the script runs, so that participants which call back into the dialogue can't interfere
+	 * with it mid-step. Variable requests are always made immediately since the script needs the answer.
+	 * Switching back to Immediate sends anything still queued.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void SetEventDispatchMode(ESUDSEventDispatchMode Mode);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	ESUDSEventDispatchMode GetEventDispatchMode() const { return EventDispatchMode; }
+
+	/// Send all queued notifications, in the order they happened. Notifications caused by listeners while this
+	/// is happening are sent too, before returning.
+	UFUNCTION(BlueprintCallable)
+	void FlushQueuedEvents();
+
+	/// Get the number of notifications waiting to be sent
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	int GetNumQueuedEvents() const { return QueuedEvents.Num(); }
+
+	/**
+	 * Resume execution which yielded because of the execution budget. This is called automatically by the SUDS
+	 * subsystem each tick, you only need to call it yourself if you want to progress sooner.
+	 * @return True if execution is still pending after this call
+	 */
+	UFUNCTION(BlueprintCallable)
+	bool ResumeExecution();
+
 	/// End the dialogue early
 	UFUNCTION(BlueprintCallable)
 	void End(bool bQuietly);
@@ -406,6 +660,56 @@ public:
 	UFUNCTION(BlueprintCallable)
 	TSet<FName> GetParametersInUse();
 
+	/**
+	 * Get the proportion of parameterised GetText / GetChoiceText calls which were served from the resolved text cache
+	 * rather than re-formatting the text. Text is only re-formatted when one of the variables it uses has changed.
+	 * @return Hit rate between 0 and 1, or 0 if no parameterised text has been requested yet
+	 */
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	float GetTextCacheHitRate() const;
+
+	/// Get the raw resolved text cache hit / miss counts
+	void GetTextCacheStats(int& OutHits, int& OutMisses) const
+	{
+		OutHits = TextCacheHits;
+		OutMisses = TextCacheMisses;
+	}
+
+	/// Reset the resolved text cache hit / miss counts
+	UFUNCTION(BlueprintCallable)
+	void ResetTextCacheStats();
+
+	/**
+	 * Evaluate an expression against the current dialogue state, with some hypothetical variable values layered on top.
+	 * The dialogue is not changed in any way and no events are raised (not even variable requests), so this is safe
+	 * to call often, e.g. from AI planning or UI previews.
+	 * @param Expression The expression to evaluate
+	 * @param Overrides Variable values which take precedence over the dialogue's own variables
+	 * @return The result of the expression
+	 */
+	UFUNCTION(BlueprintCallable)
+	FSUDSValue EvaluateHypothetical(const FSUDSExpression& Expression, const TMap<FName, FSUDSValue>& Overrides) const;
+
+	/**
+	 * Get the choices which *would* be available from the current speaker line if the variables in Overrides had
+	 * those values. Any set nodes between the speaker line and the choices are applied to a temporary copy of the
+	 * overrides, but the dialogue itself is not changed and no events or variable requests are raised.
+	 * @param Overrides Variable values which take precedence over the dialogue's own variables
+	 * @return The choices which would be available. Like GetChoices(), this contains a single blank choice for a
+	 * simple continue, and is empty if the dialogue has ended.
+	 */
+	UFUNCTION(BlueprintCallable)
+	TArray<FSUDSScriptEdge> GetHypotheticalChoices(const TMap<FName, FSUDSValue>& Overrides) const;
+
+	/**
+	 * Native version of GetHypotheticalChoices which avoids copying the edges.
+	 * @param Overrides Variable values which take precedence over the dialogue's own variables
+	 * @param OutChoices Array which will be filled with pointers to the edges which would be available. Pointers
+	 * remain valid for as long as the script asset does.
+	 * @return The number of choices found
+	 */
+	int FindHypotheticalChoices(const TMap<FName, FSUDSValue>& Overrides, TArray<const FSUDSScriptEdge*>& OutChoices) const;
+
 
 	/// Set a variable in dialogue state
 	/// This is mostly only useful if you happen to already have a general purpose FSUDSValue.
@@ -414,26 +718,18 @@ public:
 	void SetVariable(FName Name, FSUDSValue Value)
 	{
 		SetVariableImpl(Name, Value, false, 0);
+		AutoFlushQueuedEvents();
 	}
 
 	/// Get a variable in dialogue state as a general value type
 	/// See GetDialogueText, GetDialogueInt etc for more type friendly versions, but if you want to access the state
 	/// as a type-flexible value then you can do so with this function.
+	/// Names with the "global." prefix are read from the subsystem.
 	UFUNCTION(BlueprintCallable)
-	FSUDSValue GetVariable(FName Name) const
-	{
-		if (const auto Arg = VariableState.Find(Name))
-		{
-			return *Arg;
-		}
-		return FSUDSValue();
-	}
+	FSUDSValue GetVariable(FName Name) const;
 
 	UFUNCTION(BlueprintCallable)
-	bool IsVariableSet(FName Name) const
-	{
-		return VariableState.Contains(Name);
-	}
+	bool IsVariableSet(FName Name) const;
 
 	/// Get all variables
 	UFUNCTION(BlueprintCallable)
@@ -96,8 +96,13 @@ protected:
 	FSUDSExpressionItem EvaluateOperator(ESUDSExpressionItemType Op,
 	                                       const FSUDSExpressionItem& Arg1,
 	                                       const FSUDSExpressionItem& Arg2,
-	                                       const TMap<FName, FSUDSValue>& Variables) const;
-	FSUDSValue EvaluateOperand(const FSUDSValue& Operand, const TMap<FName, FSUDSValue>& Variables) const;
+	                                       const TMap<FName, FSUDSValue>& Variables,
+	                                       const TMap<FName, FSUDSValue>* OverrideVariables,
+	                                       const TMap<FName, FSUDSValue>* GlobalVariables) const;
+	FSUDSValue EvaluateOperand(const FSUDSValue& Operand,
+	                           const TMap<FName, FSUDSValue>& Variables,
+	                           const TMap<FName, FSUDSValue>* OverrideVariables,
+	                           const TMap<FName, FSUDSValue>* GlobalVariables) const;
 
 	bool Validate();
 
@@ -123,10 +128,35 @@ public:
 	bool ParseFromString(const FString& Expression, FString* OutParseError);
 
 	/// Evaluate the expression and return the result, using a given variable state 
-	FSUDSValue Evaluate(const TMap<FName, FSUDSValue>& Variables) const;
+	FSUDSValue Evaluate(const TMap<FName, FSUDSValue>& Variables) const
+	{
+		return Evaluate(Variables, nullptr);
+	}
+
+	/**
+	 * Evaluate the expression and return the result, using a given variable state plus an optional set of overrides.
+	 * Any variable present in OverrideVariables takes precedence over the same variable in Variables, which lets you
+	 * ask "what if" questions without touching the real state.
+	 * @param Variables The base variable state
+	 * @param OverrideVariables Optional overlay of variable values which take precedence, may be null
+	 * @param GlobalVariables Optional global variables, used for anything not found in the other two, may be null
+	 */
+	FSUDSValue Evaluate(const TMap<FName, FSUDSValue>& Variables,
+	                    const TMap<FName, FSUDSValue>* OverrideVariables,
+	                    const TMap<FName, FSUDSValue>* GlobalVariables = nullptr) const;
 
 	/// Evaluate the expression and return the result as a boolean, using a given variable state 
-	bool EvaluateBoolean(const TMap<FName, FSUDSValue>& Variables, const FString& ErrorContext) const;
+	bool EvaluateBoolean(const TMap<FName, FSUDSValue>& Variables, const FString& ErrorContext) const
+	{
+		return EvaluateBoolean(Variables, nullptr, ErrorContext);
+	}
+
+	/// Evaluate the expression and return the result as a boolean, using a given variable state plus optional overrides
+	/// and global variables
+	bool EvaluateBoolean(const TMap<FName, FSUDSValue>& Variables,
+	                     const TMap<FName, FSUDSValue>* OverrideVariables,
+	                     const FString& ErrorContext,
+	                     const TMap<FName, FSUDSValue>* GlobalVariables = nullptr) const;
 
 	/// Get the original source of the expression as a string
 	const FString& GetSourceString() const { return SourceString; }
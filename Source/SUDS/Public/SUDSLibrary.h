@@ -22,13 +22,17 @@ public:
 	* @param Script The script to base this dialogue on
 	* @param bStartImmediately Whether to call Start() on the dialogue automatically before returning
 	* @param StartLabel If set to start immediately, which label to start from (None means start from the beginning)
+	* @param bFromPool If true, reuse a dialogue from the pool in USUDSSubsystem if possible. The dialogue is then owned
+	*   by the subsystem rather than Owner (which is only used to find the world), and you should call ReleaseDialogue
+	*   when you're finished with it. Falls back on creating a new instance if there's no subsystem.
 	* @return The dialogue instance. 
 	*/
 	UFUNCTION(BlueprintCallable, Category="SUDS")
 	static USUDSDialogue* CreateDialogue(UObject* Owner,
 	                                     USUDSScript* Script,
 	                                     bool bStartImmediately = false,
-	                                     FName StartLabel = NAME_None);
+	                                     FName StartLabel = NAME_None,
+	                                     bool bFromPool = false);
 
 	/**
 	* Create a dialogue instance based on a script, with an initial set of participants.
@@ -40,6 +44,9 @@ public:
 	*	Other objects can subscribe to events separately but do not have as much control.
 	* @param bStartImmediately Whether to call Start() on the dialogue automatically before returning
 	* @param StartLabel If set to start immediately, which label to start from (None means start from the beginning)
+	* @param bFromPool If true, reuse a dialogue from the pool in USUDSSubsystem if possible. The dialogue is then owned
+	*   by the subsystem rather than Owner (which is only used to find the world), and you should call ReleaseDialogue
+	*   when you're finished with it. Falls back on creating a new instance if there's no subsystem.
 	* @return The dialogue instance. 
 	*/
 	UFUNCTION(BlueprintCallable, Category="SUDS")
@@ -47,7 +54,8 @@ public:
 	                                                     USUDSScript* Script,
 	                                                     const TArray<UObject*>& Participants,
 	                                                     bool bStartImmediately = false,
-	                                                     FName StartLabel = NAME_None);
+	                                                     FName StartLabel = NAME_None,
+	                                                     bool bFromPool = false);
 
 
 	/**
@@ -60,6 +68,9 @@ public:
 	*	Other objects can subscribe to events separately but do not have as much control.
 	* @param bStartImmediately Whether to call Start() on the dialogue automatically before returning
 	* @param StartLabel If set to start immediately, which label to start from (None means start from the beginning)
+	* @param bFromPool If true, reuse a dialogue from the pool in USUDSSubsystem if possible. The dialogue is then owned
+	*   by the subsystem rather than Owner (which is only used to find the world), and you should call ReleaseDialogue
+	*   when you're finished with it. Falls back on creating a new instance if there's no subsystem.
 	* @return The dialogue instance. 
 	*/
 	UFUNCTION(BlueprintCallable, Category="SUDS")
@@ -67,7 +78,16 @@ public:
 														 USUDSScript* Script,
 														 UObject* Participant,
 														 bool bStartImmediately = false,
-														 FName StartLabel = NAME_None);
+														 FName StartLabel = NAME_None,
+														 bool bFromPool = false);
+
+	/**
+	* Finish with a dialogue created with bFromPool = true, giving it back to the pool for reuse. Don't use the
+	* dialogue after calling this. Does nothing for dialogues which didn't come from the pool.
+	* @param Dialogue The dialogue to release
+	*/
+	UFUNCTION(BlueprintCallable, Category="SUDS")
+	static void ReleaseDialogue(USUDSDialogue* Dialogue);
 	
 	/**
 	 * Try to extract a text value from a general SUDS value.
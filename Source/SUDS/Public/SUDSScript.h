@@ -7,6 +7,42 @@
 class USUDSScriptNode;
 class USUDSScriptNodeText;
 class USUDSScriptNodeGosub;
+struct FSUDSChoicePlan;
+struct FSUDSChoicePlanGuard;
+
+/// A label-delimited block of nodes, recorded at import so that a reimport can keep the nodes of unchanged blocks
+USTRUCT()
+struct SUDS_API FSUDSScriptImportBlock
+{
+	GENERATED_BODY()
+
+	/// The label which starts this block, or None for the nodes before the first label
+	UPROPERTY()
+	FName Label;
+	/// Hash of the parsed content of the block, not including line numbers
+	UPROPERTY()
+	FString Hash;
+	/// Nodes created from this block, in order
+	UPROPERTY()
+	TArray<USUDSScriptNode*> Nodes;
+};
+
+/// Ranges in USUDSScript's variable access list, for the variables read and written by one node or choice region
+USTRUCT()
+struct SUDS_API FSUDSVariableAccessRange
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	int FirstRead = 0;
+	UPROPERTY()
+	int NumReads = 0;
+	UPROPERTY()
+	int FirstWrite = 0;
+	UPROPERTY()
+	int NumWrites = 0;
+};
+
 /**
  * A single SUDS script asset.
  */
@@ -36,8 +72,63 @@ protected:
 	UPROPERTY(BlueprintReadOnly, VisibleDefaultsOnly)
 	TArray<FString> Speakers;
 
-	bool DoesAnyPathAfterLeadToChoice(USUDSScriptNode* FromNode);
-	int RecurseLookForChoice(USUDSScriptNode* CurrNode);
+	/// "SpeakerName.<SpeakerID>" variable names, in the same order as Speakers (derived, not saved)
+	TArray<FName> SpeakerDisplayNameKeys;
+	/// Reverse lookup of SpeakerDisplayNameKeys to speaker index (derived, not saved)
+	TMap<FName, int> SpeakerIndexByDisplayNameKey;
+
+#if WITH_EDITORONLY_DATA
+	/// Label-delimited blocks from the last import, so that reimporting only has to replace blocks which changed
+	UPROPERTY()
+	TArray<FSUDSScriptImportBlock> ImportBlocks;
+	UPROPERTY()
+	TArray<FSUDSScriptImportBlock> HeaderImportBlocks;
+#endif
+
+	/// Working state for the choice lookahead done in FinishImport
+	struct FChoiceLookahead
+	{
+		/// Known results per node, so shared paths (e.g. sub bodies with many callers) are only walked once
+		TMap<const USUDSScriptNode*, int8> NodeResults;
+		/// Known results per gosub label
+		TMap<FName, int8> SubResults;
+		/// Depth of the nodes on the path currently being walked, to detect cycles
+		TMap<const USUDSScriptNode*, int32> PathDepth;
+		TArray<const USUDSScriptNode*> Path;
+	};
+
+	/// Names of variables read / written by nodes, referenced in ranges by NodeVariableAccess & ChoiceRegionVariableAccess
+	UPROPERTY()
+	TArray<FName> VariableAccessNames;
+	/// Variables read / written by each node; Nodes first, then HeaderNodes
+	UPROPERTY()
+	TArray<FSUDSVariableAccessRange> NodeVariableAccess;
+	/// Variables read / written after each text node until the next, including its choices; same order as Nodes
+	/// Only text nodes have anything in here
+	UPROPERTY()
+	TArray<FSUDSVariableAccessRange> ChoiceRegionVariableAccess;
+	/// Index of each node in NodeVariableAccess (derived, not saved)
+	TMap<const USUDSScriptNode*, int> NodeVariableAccessIndex;
+
+	/// Culture that text formats were last recompiled for in the background (derived, not saved). Lets several
+	/// subsystems (e.g. PIE instances) responding to the same culture change compile each script only once.
+	mutable FString TextFormatsCulture;
+
+	void BuildSpeakerLookups();
+	void BuildVariableAccess();
+	void BuildVariableAccessLookups();
+	void AddVariableAccessRange(const TArray<FName>& Reads, const TArray<FName>& Writes, TArray<FSUDSVariableAccessRange>& OutRanges);
+	static void GatherNodeVariableAccess(const USUDSScriptNode* Node, TArray<FName>& OutReads, TArray<FName>& OutWrites);
+	void GatherChoiceRegionVariableAccess(const USUDSScriptNodeText* TextNode, TArray<FName>& OutReads, TArray<FName>& OutWrites) const;
+	TConstArrayView<FName> GetVariableAccessNames(int First, int Num) const;
+	bool DoesAnyPathAfterLeadToChoice(USUDSScriptNode* FromNode, FChoiceLookahead& Lookahead) const;
+	int RecurseLookForChoice(USUDSScriptNode* CurrNode, FChoiceLookahead& Lookahead, int32& OutCycleDepth) const;
+	int LookForChoiceInSub(const USUDSScriptNodeGosub* GosubNode, FChoiceLookahead& Lookahead, int32& OutCycleDepth) const;
+	void BuildChoicePlan(USUDSScriptNodeText* TextNode) const;
+	bool RecurseBuildChoicePlan(USUDSScriptNode* Node,
+	                            FSUDSChoicePlan& Plan,
+	                            TArray<FSUDSChoicePlanGuard>& GuardStack,
+	                            TSet<const USUDSScriptNode*>& Path) const;
 	
 public:
 	void StartImport(TArray<USUDSScriptNode*>** Nodes,
@@ -69,6 +160,9 @@ public:
 	UFUNCTION(BlueprintCallable)
 	USUDSScriptNode* GetNodeByLabel(const FName& Label) const;
 
+	/// Get the node a gosub jumps to, or null if its label wasn't found
+	USUDSScriptNode* GetGosubTargetNode(const USUDSScriptNodeGosub* Node) const;
+
 	/// Try to find a speaker node by its text ID
 	UFUNCTION(BlueprintCallable)
 	USUDSScriptNodeText* GetNodeByTextID(const FString& TextID) const;
@@ -77,9 +171,42 @@ public:
 	USUDSScriptNodeGosub* GetNodeByGosubID(const FString& ID) const;
 
 
+	/// Get the variables a node reads, from its expressions and text parameters (computed at import)
+	TConstArrayView<FName> GetNodeVariableReads(const USUDSScriptNode* Node) const;
+	/// Get the variables a node writes (computed at import)
+	TConstArrayView<FName> GetNodeVariableWrites(const USUDSScriptNode* Node) const;
+	/// Get the variables which may be read after a text node, until the next text node; this covers set / event nodes
+	/// run in between, conditions, gosubs and the text of the choices (computed at import). Useful to prefetch values
+	/// before a line is shown.
+	TConstArrayView<FName> GetChoiceRegionVariableReads(const USUDSScriptNodeText* TextNode) const;
+	/// Get the variables which may be written after a text node, until the next text node (computed at import)
+	TConstArrayView<FName> GetChoiceRegionVariableWrites(const USUDSScriptNodeText* TextNode) const;
+
 	/// Get the list of speakers
 	const TArray<FString>& GetSpeakers() const { return Speakers; }
 
+	const FString& GetTextFormatsCulture() const { return TextFormatsCulture; }
+	void SetTextFormatsCulture(const FString& Culture) const { TextFormatsCulture = Culture; }
+
+	/// Get a speaker ID by index, returns an empty string if out of range
+	const FString& GetSpeakerID(int SpeakerIndex) const;
+
+	/// Get the name of the variable which holds the display name of a speaker, i.e. "SpeakerName.<SpeakerID>"
+	FName GetSpeakerDisplayNameKey(int SpeakerIndex) const
+	{
+		return SpeakerDisplayNameKeys.IsValidIndex(SpeakerIndex) ? SpeakerDisplayNameKeys[SpeakerIndex] : NAME_None;
+	}
+
+	/// If a variable name is a speaker display name ("SpeakerName.<SpeakerID>"), return the index of that speaker.
+	/// Otherwise returns INDEX_NONE
+	int FindSpeakerIndexByDisplayNameKey(const FName& VariableName) const
+	{
+		const int* pIdx = SpeakerIndexByDisplayNameKey.Find(VariableName);
+		return pIdx ? *pIdx : INDEX_NONE;
+	}
+
+	virtual void PostLoad() override;
+
 #if WITH_EDITORONLY_DATA
 	// Import data for this 
 	UPROPERTY(VisibleAnywhere, Instanced, Category=ImportSettings)
@@ -87,6 +214,10 @@ public:
 	
 	// UObject interface
 	virtual void PostInitProperties() override;
+	
+	/// Import blocks from the last import, for incremental reimport
+	TArray<FSUDSScriptImportBlock>& GetImportBlocks(bool bHeader) { return bHeader ? HeaderImportBlocks : ImportBlocks; }
+	
 	virtual void GetAssetRegistryTags(TArray<FAssetRegistryTag>& OutTags) const override;
 	virtual void Serialize(FArchive& Ar) override;
 	// End of UObject interface
@@ -48,6 +48,8 @@ protected:
 
 	mutable bool bFormatExtracted = false; 
 	mutable TArray<FName> ParameterNames;
+	/// String versions of ParameterNames, precomputed for building format arguments
+	mutable TArray<FString> ParameterNameStrings;
 	mutable FTextFormat TextFormat;
 
 	void ExtractFormat() const;
@@ -84,5 +86,12 @@ public:
 
 	const FTextFormat& GetTextFormat() const;
 	const TArray<FName>& GetParameterNames() const;
+	/// Get the parameter names as strings, in the same order as GetParameterNames
+	const TArray<FString>& GetParameterNameStrings() const;
 	bool HasParameters() const;
+
+	/// Replace the compiled text format, e.g. with one compiled in the background after a culture change
+	void ApplyCompiledFormat(const FTextFormat& InFormat,
+	                         const TArray<FName>& InParameterNames,
+	                         const TArray<FString>& InParameterNameStrings) const;
 };
\ No newline at end of file
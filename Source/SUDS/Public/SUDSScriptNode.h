@@ -60,6 +60,9 @@ public:
 	int GetSourceLineNo() const { return SourceLineNo; }
 
 	void AddEdge(const FSUDSScriptEdge& NewEdge);
+	void ResetEdges() { Edges.Reset(); }
+	/// Direct access to edges, only for import-time graph changes
+	TArray<FSUDSScriptEdge>& GetMutableEdges() { return Edges; }
 	void InitChoice(int LineNo);
 	void InitSelect(int LineNo);
 	void InitReturn(int LineNo);
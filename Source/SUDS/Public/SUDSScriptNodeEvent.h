@@ -21,11 +21,23 @@ protected:
 	UPROPERTY(BlueprintReadOnly)
 	TArray<FSUDSExpression> Args;
 
+	/// Whether every argument is a literal, in which case LiteralArgs has them all pre-evaluated
+	bool bArgsAllLiteral = false;
+	/// Pre-evaluated arguments, shared by every time this event is raised. Derived, not saved.
+	TArray<FSUDSValue> LiteralArgs;
+
+	void BuildLiteralArgs();
+
 public:
 
 	void Init(const FString& EvtName, const TArray<FSUDSExpression>& InArgs, int LineNo);
+	virtual void PostLoad() override;
 	FName GetEventName() const { return EventName; }
 	const TArray<FSUDSExpression>& GetArgs() const { return Args; }
+	/// Return whether all the arguments are literals, so GetLiteralArgs can be used instead of evaluating them
+	bool AreArgsAllLiteral() const { return bArgsAllLiteral; }
+	/// Get the pre-evaluated arguments, only valid if AreArgsAllLiteral()
+	const TArray<FSUDSValue>& GetLiteralArgs() const { return LiteralArgs; }
 	
 	
 };
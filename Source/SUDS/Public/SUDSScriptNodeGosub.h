@@ -26,6 +26,10 @@ protected:
 	/// This flag is to let us know to look for choices, but if conditionals apply we may not find any using actual dialogue state.
 	UPROPERTY(BlueprintReadOnly)
 	bool bHasChoices = false;
+
+	/// The node the label leads to, if it was resolved at import (only when the script was optimised)
+	UPROPERTY()
+	USUDSScriptNode* TargetNode = nullptr;
 	
 public:
 
@@ -35,6 +39,8 @@ public:
 		LabelName = FName(Label);
 		GosubID = ID;
 		SourceLineNo = LineNo;
+		bHasChoices = false;
+		TargetNode = nullptr;
 	}
 	FName GetLabelName() const { return LabelName; }
 	const FString& GetGosubID() const { return GosubID; }
@@ -44,4 +50,7 @@ public:
 	
 	void NotifyMayHaveChoices() { bHasChoices = true; }
 
+	USUDSScriptNode* GetTargetNode() const { return TargetNode; }
+	void SetTargetNode(USUDSScriptNode* Node) { TargetNode = Node; }
+
 };
@@ -5,6 +5,23 @@
 #include "SUDSScriptNode.h"
 #include "SUDSScriptNodeSet.generated.h"
 
+/// An assignment from a following set node, merged into this one by the import optimiser
+USTRUCT(BlueprintType)
+struct SUDS_API FSUDSSetAssignment
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+	FName Identifier;
+
+	UPROPERTY(BlueprintReadOnly)
+	FSUDSExpression Expression;
+
+	/// The line number in the script that this assignment came from
+	UPROPERTY(BlueprintReadOnly)
+	int SourceLineNo = 0;
+};
+
 /**
 * Set variable node 
 */
@@ -22,10 +39,18 @@ protected:
 	UPROPERTY(BlueprintReadOnly)
 	FSUDSExpression Expression;
 
+	/// Further assignments to run in order after this one (only present if the script was optimised on import)
+	UPROPERTY(BlueprintReadOnly)
+	TArray<FSUDSSetAssignment> MergedAssignments;
+
 public:
 
 	void Init(const FString& VarName, const FSUDSExpression& InExpression, int LineNo);
 	const FName& GetIdentifier() const { return Identifier; }
 	const FSUDSExpression& GetExpression() const { return Expression; }
+	const TArray<FSUDSSetAssignment>& GetMergedAssignments() const { return MergedAssignments; }
+
+	/// Append all the assignments of another set node to this one, to run after our own
+	void AppendAssignments(const USUDSScriptNodeSet* Other);
 	
 };
@@ -4,6 +4,93 @@
 #include "SUDSScriptNode.h"
 #include "SUDSScriptNodeText.generated.h"
 
+/// A select condition which a planned choice depends on; see FSUDSChoicePlan
+USTRUCT()
+struct SUDS_API FSUDSChoicePlanCondition
+{
+	GENERATED_BODY()
+
+	/// The select node the condition is on
+	UPROPERTY()
+	USUDSScriptNode* SelectNode = nullptr;
+
+	/// The edge of the select node which has the condition
+	UPROPERTY()
+	int EdgeIndex = 0;
+};
+
+/// One term of a planned choice's guard: a condition and the result it must have
+USTRUCT()
+struct SUDS_API FSUDSChoicePlanGuard
+{
+	GENERATED_BODY()
+
+	/// Index into FSUDSChoicePlan::Conditions
+	UPROPERTY()
+	int ConditionIndex = 0;
+
+	/// True if the condition's select edge must be taken, false if it's an earlier edge which must not be
+	UPROPERTY()
+	bool bExpected = true;
+};
+
+/// A candidate choice in a choice plan
+USTRUCT()
+struct SUDS_API FSUDSChoicePlanEntry
+{
+	GENERATED_BODY()
+
+	/// The choice node the choice edge is on
+	UPROPERTY()
+	USUDSScriptNode* ChoiceNode = nullptr;
+
+	/// The choice edge of the choice node
+	UPROPERTY()
+	int EdgeIndex = 0;
+
+	/// Range in FSUDSChoicePlan::Guards which must all pass for this choice to be offered
+	UPROPERTY()
+	int FirstGuard = 0;
+
+	UPROPERTY()
+	int NumGuards = 0;
+};
+
+/**
+* The choices following a text node, flattened at import so they don't have to be found by walking the graph at runtime.
+* Only built when the route from the text node to its choices doesn't depend on runtime state (no conditionals or
+* gosubs in between); otherwise it's not valid and the dialogue walks the graph as before.
+*/
+USTRUCT()
+struct SUDS_API FSUDSChoicePlan
+{
+	GENERATED_BODY()
+
+	/// Whether this plan can be used
+	UPROPERTY()
+	bool bIsValid = false;
+
+	/// Set / event nodes between the text and the choices, which must be run before the choices are offered
+	UPROPERTY()
+	TArray<USUDSScriptNode*> PreludeNodes;
+
+	/// The first choice node, or null if a valid plan has no choices
+	UPROPERTY()
+	USUDSScriptNode* RootChoiceNode = nullptr;
+
+	/// Candidate choices, in the order they'd be offered
+	UPROPERTY()
+	TArray<FSUDSChoicePlanEntry> Choices;
+
+	/// Guard terms for all choices, each choice uses a contiguous range
+	UPROPERTY()
+	TArray<FSUDSChoicePlanGuard> Guards;
+
+	/// Unique select conditions referenced by guards, so each need only be evaluated once
+	UPROPERTY()
+	TArray<FSUDSChoicePlanCondition> Conditions;
+};
+
 /**
 * A node which contains speaker text 
 */
@@ -13,9 +100,15 @@ class SUDS_API USUDSScriptNodeText : public USUDSScriptNode
 	GENERATED_BODY()
 
 protected:
-	/// Identifier of the speaker for text nodes
+	/// Index of the speaker in the owning script's speaker list
 	UPROPERTY(BlueprintReadOnly)
-	FString SpeakerID;
+	int SpeakerIndex = INDEX_NONE;
+
+#if WITH_EDITORONLY_DATA
+	/// Speaker IDs used to be stored per node, this is only here to convert older assets
+	UPROPERTY()
+	FString SpeakerID_DEPRECATED;
+#endif
 	/// Text, always references a string table. Parameters will not have been completed.
 	UPROPERTY(BlueprintReadOnly)
 	FText Text;
@@ -29,26 +122,47 @@ protected:
 	/// This flag is to let us know to look for choices, but if conditionals apply we may not find any using actual dialogue state.
 	UPROPERTY(BlueprintReadOnly)
 	bool bHasChoices = false;
+
+	/// Choices following this node, precomputed at import
+	UPROPERTY()
+	FSUDSChoicePlan ChoicePlan;
 	
 	mutable bool bFormatExtracted = false; 
 	mutable TArray<FName> ParameterNames;
+	/// String versions of ParameterNames, precomputed for building format arguments
+	mutable TArray<FString> ParameterNameStrings;
 	mutable FTextFormat TextFormat;
 
 	void ExtractFormat() const;
 
 public:
-	const FString& GetSpeakerID() const { return SpeakerID; }
+	/// Get the speaker ID, resolved via the owning script
+	const FString& GetSpeakerID() const;
+	/// Get the index of the speaker in the owning script's speaker list (see USUDSScript::GetSpeakers)
+	int GetSpeakerIndex() const { return SpeakerIndex; }
 	const FText& GetText() const { return Text; }
 	FString GetTextID() const;
 	/// Whether on one select path or another a choice was found
 	/// Doesn't help if within a Gosub as call site may be anywhere
 	bool MayHaveChoices() const { return bHasChoices; }
 
-	void Init(const FString& SpeakerID, const FText& Text, int LineNo);
+	void Init(int InSpeakerIndex, const FText& Text, int LineNo);
 	const FTextFormat& GetTextFormat() const;
 	const TArray<FName>& GetParameterNames() const;	
+	/// Get the parameter names as strings, in the same order as GetParameterNames
+	const TArray<FString>& GetParameterNameStrings() const;
 	bool HasParameters() const;
+	/// Replace the compiled text format, e.g. with one compiled in the background after a culture change
+	void ApplyCompiledFormat(const FTextFormat& InFormat,
+	                         const TArray<FName>& InParameterNames,
+	                         const TArray<FString>& InParameterNameStrings) const;
 
 	void NotifyMayHaveChoices() { bHasChoices = true; }
 
+	/// Get the choices following this node, as precomputed at import. Check bIsValid before using.
+	const FSUDSChoicePlan& GetChoicePlan() const { return ChoicePlan; }
+	void SetChoicePlan(FSUDSChoicePlan&& InPlan) { ChoicePlan = MoveTemp(InPlan); }
+
+	virtual void PostLoad() override;
+
 };
@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+// Trace channel for SUDS CPU events in Unreal Insights, enable with -trace=cpu,SUDS
+UE_TRACE_CHANNEL_EXTERN(SUDSChannel, SUDS_API)
+
+// "stat SUDS" in game
+DECLARE_STATS_GROUP(TEXT("SUDS"), STATGROUP_SUDS, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Run Until Speaker Line"), STAT_SUDS_RunUntilSpeakerLine, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Choices"), STAT_SUDS_UpdateChoices, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Evaluate Expression"), STAT_SUDS_EvaluateExpression, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Resolve Parameterised Text"), STAT_SUDS_ResolveText, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Starting"), STAT_SUDS_ParticipantStarting, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Finished"), STAT_SUDS_ParticipantFinished, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Speaker Line"), STAT_SUDS_ParticipantSpeakerLine, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Choice Made"), STAT_SUDS_ParticipantChoiceMade, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Proceeding"), STAT_SUDS_ParticipantProceeding, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Event"), STAT_SUDS_ParticipantEvent, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Variable Changed"), STAT_SUDS_ParticipantVariableChanged, STATGROUP_SUDS, SUDS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Participants: Variable Requested"), STAT_SUDS_ParticipantVariableRequested, STATGROUP_SUDS, SUDS_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Nodes Executed"), STAT_SUDS_NodesExecuted, STATGROUP_SUDS, SUDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Expressions Evaluated"), STAT_SUDS_ExpressionsEvaluated, STATGROUP_SUDS, SUDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Variables Requested"), STAT_SUDS_VariablesRequested, STATGROUP_SUDS, SUDS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events Raised"), STAT_SUDS_EventsRaised, STATGROUP_SUDS, SUDS_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active Dialogues"), STAT_SUDS_ActiveDialogues, STATGROUP_SUDS, SUDS_API);
+
+namespace SUDSStats
+{
+	/// Make a trace event name which identifies the script and line, e.g. "SUDS Run MyScript:12"
+	SUDS_API FString MakeTraceEventName(const TCHAR* Scope, const UObject* Script, int LineNo);
+}
+
+#if CPUPROFILERTRACE_ENABLED
+/// Scoped stat + trace event annotated with the script name and source line.
+/// The annotated name is only built if the SUDS trace channel is enabled.
+#define SUDS_SCOPE_CYCLE_COUNTER_LINE(Stat, Scope, Script, LineNo) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_TEXT_ON_CHANNEL( \
+		UE_TRACE_CHANNELEXPR_IS_ENABLED(SUDSChannel) ? *SUDSStats::MakeTraceEventName(TEXT(Scope), Script, LineNo) : TEXT(Scope), \
+		SUDSChannel)
+/// Scoped stat + trace event for hot paths where there's no script context
+#define SUDS_SCOPE_CYCLE_COUNTER(Stat, Scope) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR(Scope, SUDSChannel)
+#else
+#define SUDS_SCOPE_CYCLE_COUNTER_LINE(Stat, Scope, Script, LineNo) SCOPE_CYCLE_COUNTER(Stat)
+#define SUDS_SCOPE_CYCLE_COUNTER(Stat, Scope) SCOPE_CYCLE_COUNTER(Stat)
+#endif
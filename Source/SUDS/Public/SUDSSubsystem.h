@@ -1,25 +1,390 @@
 ﻿#pragma once
 
 #include "CoreMinimal.h"
+#include "SUDSDialogue.h"
+#include "SUDSValue.h"
+#include "Tickable.h"
+#include "UObject/ObjectKey.h"
 #include "Subsystems/GameInstanceSubsystem.h"
 #include "SUDSSubsystem.generated.h"
 
 class USUDSDialogue;
 class USUDSScript;
+class USUDSScriptNode;
+struct FSUDSTextFormatCompileItem;
 DECLARE_LOG_CATEGORY_EXTERN(LogSUDSSubsystem, Log, All);
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FOnGlobalVariableChangedEvent, FName, VariableName, const FSUDSValue&, Value, bool, bFromScript);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnAmbientDialoguesStepped, const TArray<USUDSDialogue*>&, Dialogues);
+
+/// An ambient dialogue (e.g. a bark) being run by the subsystem
+USTRUCT()
+struct FSUDSAmbientDialogue
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	USUDSDialogue* Dialogue = nullptr;
+	/// How long each line is shown before stepping on, in seconds
+	float LineDuration = 3.f;
+	/// Higher priority dialogues are stepped first when the budget is tight
+	float Priority = 0.f;
+	/// Where the dialogue is happening, if bHasLocation
+	FVector Location = FVector::ZeroVector;
+	bool bHasLocation = false;
+	/// Ambient time at which this dialogue should next step
+	double NextStepTime = 0;
+	/// How many frames this dialogue has been due but not stepped because of the budget
+	int DeferredFrames = 0;
+	/// Working value for sorting
+	float Score = 0.f;
+};
+
+/// Metrics for tuning the ambient dialogue budget
+USTRUCT(BlueprintType)
+struct FSUDSAmbientDialogueMetrics
+{
+	GENERATED_BODY()
+
+	/// Number of ambient dialogues currently running
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int ActiveCount = 0;
+	/// Number of dialogues stepped in the last frame
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int StepsLastFrame = 0;
+	/// Number of dialogues which were due in the last frame but deferred because the budget ran out
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int DeferredLastFrame = 0;
+	/// Time spent stepping ambient dialogues in the last frame
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	float TimeLastFrameMs = 0;
+	/// Highest number of frames any dialogue has been deferred for in a row
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int MaxDeferredFrames = 0;
+	/// Total number of steps since the metrics were reset
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int TotalSteps = 0;
+	/// Total number of deferrals since the metrics were reset
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int TotalDeferred = 0;
+};
+
+/// Copy of the global variable state shared by all dialogues
+USTRUCT(BlueprintType)
+struct FSUDSGlobalState
+{
+	GENERATED_BODY()
+protected:
+	UPROPERTY(BlueprintReadOnly, SaveGame)
+	TMap<FName, FSUDSValue> Variables;
+
+public:
+	FSUDSGlobalState() {}
+
+	FSUDSGlobalState(const TMap<FName, FSUDSValue>& InVars) : Variables(InVars)
+	{
+	}
+
+	const TMap<FName, FSUDSValue>& GetVariables() const { return Variables; }
+
+	SUDS_API friend FArchive& operator<<(FArchive& Ar, FSUDSGlobalState& Value);
+	SUDS_API friend void operator<<(FStructuredArchive::FSlot Slot, FSUDSGlobalState& Value);
+	bool Serialize(FStructuredArchive::FSlot Slot)
+	{
+		Slot << *this;
+		return true;
+	}
+	bool Serialize(FArchive& Ar)
+	{
+		Ar << *this;
+		return true;
+	}
+};
+
+/// Dialogue instances available for reuse, for a single script
+USTRUCT()
+struct FSUDSDialoguePool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<USUDSDialogue*> Available;
+};
+
+/// Statistics about dialogue pooling
+USTRUCT(BlueprintType)
+struct FSUDSDialoguePoolStats
+{
+	GENERATED_BODY()
+
+	/// Number of dialogues handed out by AcquireDialogue
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int Acquired = 0;
+	/// Number of acquired dialogues which had to be newly created
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int Created = 0;
+	/// Number of acquired dialogues which were reused from the pool
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int Reused = 0;
+	/// Number of dialogues given back with ReleaseDialogue
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int Released = 0;
+	/// Number of released dialogues which were discarded because the pool for that script was full
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int Discarded = 0;
+	/// Number of dialogues currently waiting in pools
+	UPROPERTY(BlueprintReadOnly, Category="SUDS")
+	int Pooled = 0;
+};
+
 /**
  * 
  */
 UCLASS()
-class SUDS_API USUDSSubsystem : public UGameInstanceSubsystem
+class SUDS_API USUDSSubsystem : public UGameInstanceSubsystem, public FTickableGameObject
 {
 	GENERATED_BODY()
 
+protected:
+	/// Ambient dialogues being stepped by this subsystem
+	UPROPERTY()
+	TArray<FSUDSAmbientDialogue> AmbientDialogues;
+	/// Time in ms per frame which can be spent stepping ambient dialogues
+	float AmbientStepBudgetMs = 1.f;
+	/// Location used to prioritise ambient dialogues by distance, if bHasAmbientListener
+	FVector AmbientListenerLocation = FVector::ZeroVector;
+	bool bHasAmbientListener = false;
+	/// Accumulated tick time, used for ambient dialogue timing
+	double AmbientTime = 0;
+	FSUDSAmbientDialogueMetrics AmbientMetrics;
+	/// Re-used between frames to avoid allocations
+	TArray<int> AmbientDueIndices;
+	TArray<USUDSDialogue*> AmbientSteppedDialogues;
+	/// Dispatch mode of each of AmbientSteppedDialogues before stepping; their notifications are held back while
+	/// stepping and sent together afterwards
+	TArray<ESUDSEventDispatchMode> AmbientSteppedDispatchModes;
+	/// True while stepping, when AmbientDialogues must not be re-ordered or shrunk
+	bool bSteppingAmbientDialogues = false;
+	bool bAmbientDialoguesNeedCleanup = false;
+
+	void TickAmbientDialogues(float DeltaTime);
+	FSUDSAmbientDialogue* FindAmbientDialogue(const USUDSDialogue* Dialogue);
+
+	/// Dialogues whose execution yielded because of their execution budget, resumed next tick
+	TArray<TWeakObjectPtr<USUDSDialogue>> PendingExecutionDialogues;
+
+	/// Global variables shared by all dialogues. Keys always include the "global." prefix, which is how
+	/// scripts refer to them, so they can be looked up directly during expression evaluation
+	TMap<FName, FSUDSValue> GlobalVariables;
+	/// Incremented every time a global variable changes, so dialogues can tell when cached text is stale
+	uint32 GlobalVariablesVersion = 0;
+
+	static FName MakeGlobalVariableName(FName Name);
+
+	/// Released dialogues available for reuse, per script. Keyed weakly so that pooling never keeps a script loaded
+	/// (released dialogues don't reference their script either); pools for scripts which have gone are pruned when
+	/// new pools are added. Pooled dialogues are kept alive by AddReferencedObjects.
+	TMap<TObjectKey<USUDSScript>, FSUDSDialoguePool> DialoguePools;
+
+	void PruneDialoguePools();
+
+	/// Maximum number of released dialogues kept for each script
+	int MaxPooledDialoguesPerScript = 8;
+
+	FSUDSDialoguePoolStats DialoguePoolStats;
+
+	/// How many nodes around each active dialogue's current position are recompiled first
+	static constexpr int TextFormatPriorityNodeCount = 32;
+	/// How many text formats are compiled in a single background task
+	static constexpr int TextFormatBatchSize = 256;
+
+	/// Incremented every time text formats are recompiled, so that results from stale batches are discarded
+	uint32 TextFormatRevision = 0;
+	/// Number of background compile batches which haven't been applied yet
+	int PendingTextFormatBatches = 0;
+	/// Dialogues which were active when the recompile started, which need to know when new formats arrive
+	TArray<TWeakObjectPtr<USUDSDialogue>> TextFormatDialogues;
+	/// Dialogues using this subsystem, so that text format recompiles only touch our own dialogues & their scripts.
+	/// Stale entries are pruned as new ones are added.
+	TSet<TWeakObjectPtr<USUDSDialogue>> KnownDialogues;
+	int KnownDialoguesPruneThreshold = 64;
+
+	void OnCultureChanged();
+	void RecompileTextFormatsImpl(bool bSkipUpToDateScripts);
+	void GatherTextFormatsNear(const USUDSScriptNode* StartNode,
+	                           TSet<const USUDSScriptNode*>& Gathered,
+	                           TArray<FSUDSTextFormatCompileItem>& OutItems);
+	void AddTextFormatCompileItems(const USUDSScriptNode* Node, TArray<FSUDSTextFormatCompileItem>& OutItems);
+	void DispatchTextFormatBatch(TArray<FSUDSTextFormatCompileItem>&& Items, bool bHighPriority);
+	void ApplyTextFormatBatch(const TArray<FSUDSTextFormatCompileItem>& Items, uint32 Revision);
+
 public:
+	/// Prefix used in scripts to refer to global variables, e.g. {global.Chapter}
+	static const FString GlobalVariablePrefix;
+
+	/// Event raised once when a global variable is changed, whether by code or by any dialogue's script
+	UPROPERTY(BlueprintAssignable)
+	FOnGlobalVariableChangedEvent OnGlobalVariableChanged;
+
+	static void AddReferencedObjects(UObject* InThis, FReferenceCollector& Collector);
+
 	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
 	virtual void Deinitialize() override;
 
-	
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+
+	/// Register a dialogue whose execution yielded, so that it's resumed on the next tick
+	void AddPendingExecution(USUDSDialogue* Dialogue);
+
+	/// Event raised once per frame with all the ambient dialogues which were stepped that frame, instead of
+	/// having to listen to each one. Dialogues which reached the end are included, and are removed afterwards.
+	/// Notifications from the dialogues themselves (participants & dialogue events) are also held back until
+	/// every dialogue due that frame has been stepped, then sent just before this.
+	UPROPERTY(BlueprintAssignable)
+	FOnAmbientDialoguesStepped OnAmbientDialoguesStepped;
+
+	/**
+	 * Hand over a dialogue to be run as an ambient dialogue, e.g. a bark. Ambient dialogues are progressed by the
+	 * subsystem, one line every LineDuration seconds, within a per-frame time budget. When a dialogue reaches the
+	 * end it is removed, and released back to the pool if it came from AcquireDialogue. Releasing a dialogue
+	 * yourself also stops it being run as ambient dialogue.
+	 * Lines with choices always take the first choice.
+	 * @param Dialogue The dialogue. Started if it isn't already running.
+	 * @param LineDuration How long each line should be shown for, in seconds
+	 * @param Priority Relative importance; higher priority dialogues are stepped first when the budget is tight
+	 */
+	UFUNCTION(BlueprintCallable)
+	void AddAmbientDialogue(USUDSDialogue* Dialogue, float LineDuration = 3.f, float Priority = 0.f);
+
+	/// Stop running a dialogue as ambient dialogue. The dialogue is left as it is.
+	UFUNCTION(BlueprintCallable)
+	void RemoveAmbientDialogue(USUDSDialogue* Dialogue);
+
+	/// Set where an ambient dialogue is taking place, so that ones closer to the listener are preferred
+	UFUNCTION(BlueprintCallable)
+	void SetAmbientDialogueLocation(USUDSDialogue* Dialogue, FVector Location);
+
+	/// Set the location of the listener (e.g. the player), used to prioritise ambient dialogues by distance
+	UFUNCTION(BlueprintCallable)
+	void SetAmbientListenerLocation(FVector Location);
+
+	/// Set the time in milliseconds per frame which can be spent stepping ambient dialogues. At least one
+	/// dialogue is always stepped each frame if any are due.
+	UFUNCTION(BlueprintCallable)
+	void SetAmbientStepBudget(float Milliseconds) { AmbientStepBudgetMs = FMath::Max(0.f, Milliseconds); }
+
+	/// Get metrics about ambient dialogue scheduling
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	FSUDSAmbientDialogueMetrics GetAmbientDialogueMetrics() const { return AmbientMetrics; }
+
+	/// Reset the cumulative ambient dialogue metrics
+	UFUNCTION(BlueprintCallable)
+	void ResetAmbientDialogueMetrics();
+
+	/// Return whether a variable name refers to a global variable, i.e. it starts with "global."
+	static bool IsGlobalVariableName(FName Name);
+
+	/**
+	 * Set a global variable, which is visible to all dialogues as {global.Name}. Unlike normal dialogue variables
+	 * these don't need to be supplied to each dialogue separately.
+	 * @param Name The name of the variable, with or without the "global." prefix
+	 * @param Value The value of the variable
+	 * @param bFromScript Whether this change came from a dialogue script
+	 */
+	UFUNCTION(BlueprintCallable)
+	void SetGlobalVariable(FName Name, FSUDSValue Value, bool bFromScript = false);
+
+	/// Get a global variable, with or without the "global." prefix. Returns an empty value if not set.
+	UFUNCTION(BlueprintCallable)
+	FSUDSValue GetGlobalVariable(FName Name) const;
+
+	/// Return whether a global variable is set, with or without the "global." prefix
+	UFUNCTION(BlueprintCallable)
+	bool IsGlobalVariableSet(FName Name) const;
+
+	/// Remove a global variable, with or without the "global." prefix
+	UFUNCTION(BlueprintCallable)
+	void UnSetGlobalVariable(FName Name);
+
+	/// Get all global variables. Names include the "global." prefix.
+	UFUNCTION(BlueprintCallable)
+	const TMap<FName, FSUDSValue>& GetGlobalVariables() const { return GlobalVariables; }
+
+	/// Get a number which changes every time any global variable changes
+	uint32 GetGlobalVariablesVersion() const { return GlobalVariablesVersion; }
+
+	/// Get a copy of the global variable state, for saving
+	UFUNCTION(BlueprintCallable)
+	FSUDSGlobalState GetSavedGlobalState() const;
+
+	/// Replace all global variables with previously saved state
+	UFUNCTION(BlueprintCallable)
+	void RestoreSavedGlobalState(const FSUDSGlobalState& State);
+
+	/// Called by dialogues when they're initialised with this subsystem
+	void RegisterDialogue(USUDSDialogue* Dialogue);
+
+	/**
+	 * Recompile the text formats of the scripts used by this subsystem's dialogues (and pools) in the background.
+	 * This is done automatically when the culture changes, so that the first line shown afterwards doesn't have to
+	 * compile its format on the game thread; scripts already recompiled for the new culture by another subsystem
+	 * are skipped then. Lines near the current position of active dialogues are compiled first.
+	 */
+	UFUNCTION(BlueprintCallable)
+	void RecompileTextFormats();
+
+	/// Return whether a background recompile of text formats is still in progress
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool IsRecompilingTextFormats() const { return PendingTextFormatBatches > 0; }
+
+	/**
+	 * Get a dialogue instance for a script, reusing a previously released one if possible. This avoids creating
+	 * a new object (and garbage to collect later) for dialogues which are started often, such as barks.
+	 * Pooled dialogues are owned by this subsystem; call ReleaseDialogue when you're done with it, and don't
+	 * keep any references to it after that.
+	 * @param Script The script to base this dialogue on
+	 * @param Participants List of participants, which must implement the ISUDSParticipant interface to be used.
+	 * @param bStartImmediately Whether to start the dialogue immediately.
+	 * @param StartLabel If starting immediately, the label to start from
+	 * @return The dialogue instance, freshly initialised
+	 */
+	UFUNCTION(BlueprintCallable)
+	USUDSDialogue* AcquireDialogue(USUDSScript* Script,
+	                               const TArray<UObject*>& Participants,
+	                               bool bStartImmediately = false,
+	                               FName StartLabel = NAME_None);
+
+	/**
+	 * Give a dialogue acquired with AcquireDialogue back to the pool. The dialogue is ended quietly if it's still
+	 * running, and all its state, participants and event bindings are removed.
+	 * @param Dialogue The dialogue to release
+	 */
+	UFUNCTION(BlueprintCallable)
+	void ReleaseDialogue(USUDSDialogue* Dialogue);
+
+	/// Set the maximum number of released dialogues which are kept for reuse for each script
+	UFUNCTION(BlueprintCallable)
+	void SetMaxPooledDialoguesPerScript(int Max);
+
+	/// Get the maximum number of released dialogues which are kept for reuse for each script
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	int GetMaxPooledDialoguesPerScript() const { return MaxPooledDialoguesPerScript; }
+
+	/// Get statistics about dialogue pooling
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	FSUDSDialoguePoolStats GetDialoguePoolStats() const { return DialoguePoolStats; }
+
+	/// Reset dialogue pooling statistics. Does not affect the count of pooled dialogues.
+	UFUNCTION(BlueprintCallable)
+	void ResetDialoguePoolStats();
+
+	/// Discard all pooled dialogues
+	UFUNCTION(BlueprintCallable)
+	void EmptyDialoguePools();
 	
 };
 
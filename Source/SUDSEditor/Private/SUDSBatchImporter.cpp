@@ -0,0 +1,158 @@
+﻿#include "SUDSBatchImporter.h"
+
+#include "SUDSEditor.h"
+#include "SUDSScript.h"
+#include "SUDSScriptFactory.h"
+#include "Editor.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+#include "EditorFramework/AssetImportData.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopedSlowTask.h"
+#include "Subsystems/ImportSubsystem.h"
+
+void FSUDSBatchImporter::ParseFiles(const TArray<FString>& Filenames,
+                                    const TArray<FString>& NamesForErrors,
+                                    TArray<TUniquePtr<FParseResult>>& OutResults)
+{
+	check(Filenames.Num() == NamesForErrors.Num());
+
+	OutResults.Reset(Filenames.Num());
+	for (int i = 0; i < Filenames.Num(); ++i)
+	{
+		TUniquePtr<FParseResult> Result = MakeUnique<FParseResult>();
+		Result->Filename = Filenames[i];
+		Result->NameForErrors = NamesForErrors[i];
+		OutResults.Add(MoveTemp(Result));
+	}
+
+	ParseResults(OutResults);
+}
+
+void FSUDSBatchImporter::ParseResults(TArray<TUniquePtr<FParseResult>>& Results)
+{
+	// Nothing in here touches UObjects, so every file can be processed independently
+	ParallelFor(Results.Num(), [&Results](int32 Index)
+	{
+		FParseResult& Result = *Results[Index];
+		if (!Result.bLoaded)
+		{
+			// Parse the file bytes as-is, no need to convert the whole file to TCHAR first
+			if (!FFileHelper::LoadFileToArray(Result.SourceBytes, *Result.Filename))
+			{
+				Result.Logger.Logf(ELogVerbosity::Error, TEXT("Error in %s: unable to load source file %s"), *Result.NameForErrors, *Result.Filename);
+				return;
+			}
+			Result.bLoaded = true;
+			// Hash of the file bytes, same as a single import so change detection is consistent
+			Result.Hash = FSUDSScriptImporter::CalculateHash(Result.SourceBytes);
+		}
+		Result.bParsed = Result.Importer.ImportFromUTF8Buffer(reinterpret_cast<const UTF8CHAR*>(Result.SourceBytes.GetData()),
+		                                                      Result.SourceBytes.Num(),
+		                                                      Result.NameForErrors,
+		                                                      &Result.Logger,
+		                                                      false);
+		// Parsed nodes don't refer back to the source, so no need to hang on to it
+		Result.SourceBytes.Empty();
+	});
+}
+
+int FSUDSBatchImporter::ReimportScripts(const TArray<USUDSScript*>& Scripts, FSUDSMessageLogger& Logger)
+{
+	check(IsInGameThread());
+
+	TArray<USUDSScript*> ValidScripts;
+	TArray<FString> Filenames;
+	TArray<FString> Names;
+	for (USUDSScript* Script : Scripts)
+	{
+		if (!IsValid(Script) || !Script->AssetImportData)
+		{
+			continue;
+		}
+		const FString Filename = Script->AssetImportData->GetFirstFilename();
+		if (Filename.IsEmpty())
+		{
+			Logger.Logf(ELogVerbosity::Error, TEXT("No source file associated with asset %s"), *Script->GetName());
+			continue;
+		}
+		ValidScripts.Add(Script);
+		Filenames.Add(Filename);
+		Names.Add(Script->GetName());
+	}
+
+	FScopedSlowTask SlowTask(ValidScripts.Num() + 1, NSLOCTEXT("SUDS", "BatchReimport", "Reimporting SUDS scripts"));
+	SlowTask.MakeDialog();
+
+	TArray<TUniquePtr<FParseResult>> Results;
+	SlowTask.EnterProgressFrame(1, NSLOCTEXT("SUDS", "BatchReimportParse", "Parsing scripts"));
+	ParseFiles(Filenames, Names, Results);
+
+	// UObject creation has to be on the game thread
+	int NumSucceeded = 0;
+	for (int i = 0; i < Results.Num(); ++i)
+	{
+		SlowTask.EnterProgressFrame(1);
+		FParseResult& Result = *Results[i];
+		USUDSScript* Script = ValidScripts[i];
+		Logger.Append(Result.Logger);
+
+		if (!Result.bParsed)
+		{
+			Logger.Logf(ELogVerbosity::Warning, TEXT("Failed to reimport %s"), *Script->GetName());
+			continue;
+		}
+
+		// Same flags as the reimport factory uses
+		UObject* Outer = Script->GetOuter();
+		USUDSScript* NewScript = USUDSScriptFactory::CreateScriptAssets(Result.Importer,
+		                                                                Outer,
+		                                                                Script->GetFName(),
+		                                                                RF_Public | RF_Standalone | RF_Transactional,
+		                                                                Result.Filename,
+		                                                                Result.Hash);
+		if (Outer)
+		{
+			Outer->MarkPackageDirty();
+		}
+		else
+		{
+			NewScript->MarkPackageDirty();
+		}
+		GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetReimport(NewScript);
+		++NumSucceeded;
+	}
+
+	UE_LOG(LogSUDSEditor, Log, TEXT("Batch reimported %d of %d scripts"), NumSucceeded, Scripts.Num());
+	return NumSucceeded;
+}
+
+int FSUDSBatchImporter::ReimportAllScripts(FSUDSMessageLogger& Logger)
+{
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	TArray<FAssetData> Assets;
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION > 0
+	AssetRegistry.GetAssetsByClass(USUDSScript::StaticClass()->GetClassPathName(), Assets);
+#else
+	AssetRegistry.GetAssetsByClass(USUDSScript::StaticClass()->GetFName(), Assets);
+#endif
+
+	TArray<USUDSScript*> Scripts;
+	for (const FAssetData& Asset : Assets)
+	{
+		if (USUDSScript* Script = Cast<USUDSScript>(Asset.GetAsset()))
+		{
+			Scripts.Add(Script);
+		}
+	}
+	return ReimportScripts(Scripts, Logger);
+}
+
+static FAutoConsoleCommand CCmdSUDSReimportAll(
+	TEXT("SUDS.ReimportAll"),
+	TEXT("Reimport every SUDS script in the project from its source file, parsing in parallel"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FSUDSMessageLogger Logger;
+		FSUDSBatchImporter::ReimportAllScripts(Logger);
+	}));
@@ -0,0 +1,302 @@
+﻿#include "SUDSCompileCommandlet.h"
+
+#include "SUDSBatchImporter.h"
+#include "SUDSEditor.h"
+#include "SUDSScript.h"
+#include "SUDSScriptFactory.h"
+#include "AssetRegistry/AssetRegistryModule.h"
+#include "Async/ParallelFor.h"
+#include "Dom/JsonObject.h"
+#include "EditorFramework/AssetImportData.h"
+#include "HAL/FileManager.h"
+#include "Logging/TokenizedMessage.h"
+#include "Misc/FileHelper.h"
+#include "Serialization/JsonSerializer.h"
+#include "UObject/SavePackage.h"
+
+namespace
+{
+	/// One .sud source file & its asset, if it has one yet
+	struct FSUDSCompileEntry
+	{
+		FString SourceFile;
+		FString PackageName;
+		FName AssetName;
+		/// The existing asset, if any; only loaded once we know it needs compiling
+		FAssetData Asset;
+		USUDSScript* Script = nullptr;
+		FMD5Hash StoredHash;
+		FMD5Hash SourceHash;
+		/// Source file contents, kept from hashing until parsed so the file is only read once
+		TArray<uint8> SourceBytes;
+		bool bNeedsCompile = true;
+	};
+
+	TSharedRef<FJsonObject> MakeEntryReport(const FSUDSCompileEntry& Entry, const FString& Status, const FSUDSMessageLogger* Logger)
+	{
+		TSharedRef<FJsonObject> Obj = MakeShared<FJsonObject>();
+		Obj->SetStringField(TEXT("source"), Entry.SourceFile);
+		Obj->SetStringField(TEXT("asset"), Entry.PackageName + TEXT(".") + Entry.AssetName.ToString());
+		Obj->SetStringField(TEXT("status"), Status);
+		TArray<TSharedPtr<FJsonValue>> Errors;
+		TArray<TSharedPtr<FJsonValue>> Warnings;
+		if (Logger)
+		{
+			for (const TSharedRef<FTokenizedMessage>& Msg : Logger->GetMessages())
+			{
+				if (Msg->GetSeverity() == EMessageSeverity::Error)
+				{
+					Errors.Add(MakeShared<FJsonValueString>(Msg->ToText().ToString()));
+				}
+				else if (Msg->GetSeverity() == EMessageSeverity::Warning || Msg->GetSeverity() == EMessageSeverity::PerformanceWarning)
+				{
+					Warnings.Add(MakeShared<FJsonValueString>(Msg->ToText().ToString()));
+				}
+			}
+		}
+		Obj->SetArrayField(TEXT("errors"), Errors);
+		Obj->SetArrayField(TEXT("warnings"), Warnings);
+		return Obj;
+	}
+
+	/// Same rules as UAssetImportData::ResolveImportFilename, but from the package name so the asset needn't be loaded
+	FString ResolveSourceFilename(const FString& RelativeFilename, const FString& PackageName)
+	{
+		const FString PathRelativeToPackage = FPaths::GetPath(FPackageName::LongPackageNameToFilename(PackageName)) / RelativeFilename;
+		if (FPaths::FileExists(PathRelativeToPackage))
+		{
+			return FPaths::ConvertRelativePathToFull(PathRelativeToPackage);
+		}
+		return FPaths::ConvertRelativePathToFull(RelativeFilename);
+	}
+}
+
+USUDSCompileCommandlet::USUDSCompileCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 USUDSCompileCommandlet::Main(const FString& Params)
+{
+	FString ContentPath = TEXT("/Game");
+	FParse::Value(*Params, TEXT("Path="), ContentPath);
+	ContentPath.RemoveFromEnd(TEXT("/"));
+	FString ReportFile = FPaths::ProjectSavedDir() / TEXT("SUDS/CompileReport.json");
+	FParse::Value(*Params, TEXT("Report="), ReportFile);
+	const bool bForce = FParse::Param(*Params, TEXT("Force"));
+	const bool bSave = !FParse::Param(*Params, TEXT("NoSave"));
+
+	FString ContentDir;
+	if (!FPackageName::TryConvertLongPackageNameToFilename(ContentPath + TEXT("/"), ContentDir))
+	{
+		UE_LOG(LogSUDSEditor, Error, TEXT("SUDSCompile: %s is not a valid content path"), *ContentPath);
+		return 1;
+	}
+
+	// Existing script assets, keyed by their full source filename
+	IAssetRegistry& AssetRegistry = FModuleManager::LoadModuleChecked<FAssetRegistryModule>("AssetRegistry").Get();
+	AssetRegistry.ScanPathsSynchronous({ ContentPath }, true);
+	FARFilter Filter;
+	Filter.PackagePaths.Add(FName(*ContentPath));
+	Filter.bRecursivePaths = true;
+#if ENGINE_MAJOR_VERSION == 5 && ENGINE_MINOR_VERSION > 0
+	Filter.ClassPaths.Add(USUDSScript::StaticClass()->GetClassPathName());
+#else
+	Filter.ClassNames.Add(USUDSScript::StaticClass()->GetFName());
+#endif
+	TArray<FAssetData> Assets;
+	AssetRegistry.GetAssets(Filter, Assets);
+
+	TArray<FSUDSCompileEntry> Entries;
+	TMap<FString, int> EntriesBySource;
+	for (const FAssetData& Asset : Assets)
+	{
+		FSUDSCompileEntry Entry;
+		Entry.PackageName = Asset.PackageName.ToString();
+		Entry.AssetName = Asset.AssetName;
+		Entry.Asset = Asset;
+		// The import data is in the registry tags, so up to date scripts never need loading
+		FString ImportDataJson;
+		TOptional<FAssetImportInfo> ImportInfo;
+		if (Asset.GetTagValue(UObject::SourceFileTagName(), ImportDataJson))
+		{
+			ImportInfo = FAssetImportInfo::FromJson(ImportDataJson);
+		}
+		if (ImportInfo.IsSet())
+		{
+			if (ImportInfo->SourceFiles.IsEmpty())
+			{
+				continue;
+			}
+			Entry.SourceFile = ResolveSourceFilename(ImportInfo->SourceFiles[0].RelativeFilename, Entry.PackageName);
+			Entry.StoredHash = ImportInfo->SourceFiles[0].FileHash;
+		}
+		else
+		{
+			// Saved before the tag was written, have to load it to find out
+			USUDSScript* Script = Cast<USUDSScript>(Asset.GetAsset());
+			if (!Script || !Script->AssetImportData || Script->AssetImportData->SourceData.SourceFiles.IsEmpty())
+			{
+				continue;
+			}
+			Entry.SourceFile = FPaths::ConvertRelativePathToFull(Script->AssetImportData->GetFirstFilename());
+			Entry.Script = Script;
+			Entry.StoredHash = Script->AssetImportData->SourceData.SourceFiles[0].FileHash;
+		}
+		EntriesBySource.Add(Entry.SourceFile, Entries.Add(Entry));
+	}
+
+	// Source files which haven't been imported yet go next to the source, as the editor's auto import would do
+	TArray<FString> SourceFiles;
+	IFileManager::Get().FindFilesRecursive(SourceFiles, *ContentDir, TEXT("*.sud"), true, false);
+	for (const FString& File : SourceFiles)
+	{
+		const FString FullFile = FPaths::ConvertRelativePathToFull(File);
+		if (EntriesBySource.Contains(FullFile))
+		{
+			continue;
+		}
+		FSUDSCompileEntry Entry;
+		Entry.SourceFile = FullFile;
+		Entry.AssetName = FName(FPaths::GetBaseFilename(FullFile));
+		if (!FPackageName::TryConvertFilenameToLongPackageName(FPaths::GetPath(FullFile) / Entry.AssetName.ToString(), Entry.PackageName))
+		{
+			UE_LOG(LogSUDSEditor, Warning, TEXT("SUDSCompile: cannot determine a package for %s, skipping"), *FullFile);
+			continue;
+		}
+		EntriesBySource.Add(Entry.SourceFile, Entries.Add(Entry));
+	}
+
+	// Hash sources in parallel, to find out which have changed
+	ParallelFor(Entries.Num(), [&Entries](int32 Index)
+	{
+		FSUDSCompileEntry& Entry = Entries[Index];
+		if (FFileHelper::LoadFileToArray(Entry.SourceBytes, *Entry.SourceFile))
+		{
+			Entry.SourceHash = FSUDSScriptImporter::CalculateHash(Entry.SourceBytes);
+		}
+	});
+
+	TArray<int> ToCompile;
+	TArray<TUniquePtr<FSUDSBatchImporter::FParseResult>> Results;
+	TArray<TSharedPtr<FJsonValue>> ScriptReports;
+	int NumSkipped = 0;
+	for (int i = 0; i < Entries.Num(); ++i)
+	{
+		FSUDSCompileEntry& Entry = Entries[i];
+		Entry.bNeedsCompile = bForce || !Entry.Asset.IsValid() || !Entry.SourceHash.IsValid() || Entry.SourceHash != Entry.StoredHash;
+		if (Entry.bNeedsCompile)
+		{
+			ToCompile.Add(i);
+			// Hand over the source we already loaded for hashing; if that failed, parsing will try again & report it
+			TUniquePtr<FSUDSBatchImporter::FParseResult> Result = MakeUnique<FSUDSBatchImporter::FParseResult>();
+			Result->Filename = Entry.SourceFile;
+			Result->NameForErrors = Entry.AssetName.ToString();
+			Result->bLoaded = Entry.SourceHash.IsValid();
+			Result->Hash = Entry.SourceHash;
+			Result->SourceBytes = MoveTemp(Entry.SourceBytes);
+			Results.Add(MoveTemp(Result));
+		}
+		else
+		{
+			Entry.SourceBytes.Empty();
+			++NumSkipped;
+			ScriptReports.Add(MakeShared<FJsonValueObject>(MakeEntryReport(Entry, TEXT("UpToDate"), nullptr)));
+		}
+	}
+
+	UE_LOG(LogSUDSEditor, Display, TEXT("SUDSCompile: %d scripts in %s, %d up to date, compiling %d"), Entries.Num(), *ContentPath, NumSkipped, ToCompile.Num());
+
+	FSUDSBatchImporter::ParseResults(Results);
+
+	// Creating & saving assets has to be on the game thread
+	int NumCompiled = 0;
+	int NumFailed = 0;
+	for (int i = 0; i < Results.Num(); ++i)
+	{
+		FSUDSBatchImporter::FParseResult& Result = *Results[i];
+		FSUDSCompileEntry& Entry = Entries[ToCompile[i]];
+
+		bool bOK = Result.bParsed && !Result.Logger.HasErrors();
+		if (bOK && Entry.Asset.IsValid() && !Entry.Script)
+		{
+			// Reimport into the existing asset
+			Entry.Script = Cast<USUDSScript>(Entry.Asset.GetAsset());
+			if (!Entry.Script)
+			{
+				Result.Logger.Logf(ELogVerbosity::Error, TEXT("Error in %s: failed to load %s"), *Result.NameForErrors, *Entry.PackageName);
+				bOK = false;
+			}
+		}
+		if (bOK)
+		{
+			UPackage* Package = Entry.Script ? Entry.Script->GetPackage() : CreatePackage(*Entry.PackageName);
+			Package->FullyLoad();
+			// This also runs all of the post-import analysis
+			USUDSScript* Script = USUDSScriptFactory::CreateScriptAssets(Result.Importer,
+			                                                             Package,
+			                                                             Entry.AssetName,
+			                                                             RF_Public | RF_Standalone,
+			                                                             Entry.SourceFile,
+			                                                             Result.Hash);
+			if (!Entry.Script)
+			{
+				FAssetRegistryModule::AssetCreated(Script);
+			}
+			Package->MarkPackageDirty();
+
+			if (bSave)
+			{
+				const FString PackageFile = FPackageName::LongPackageNameToFilename(Entry.PackageName, FPackageName::GetAssetPackageExtension());
+				FSavePackageArgs SaveArgs;
+				SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+				if (!UPackage::SavePackage(Package, nullptr, *PackageFile, SaveArgs))
+				{
+					Result.Logger.Logf(ELogVerbosity::Error, TEXT("Error in %s: failed to save %s"), *Result.NameForErrors, *PackageFile);
+					bOK = false;
+				}
+			}
+		}
+
+		if (bOK)
+		{
+			++NumCompiled;
+		}
+		else
+		{
+			++NumFailed;
+			UE_LOG(LogSUDSEditor, Error, TEXT("SUDSCompile: %s failed"), *Entry.SourceFile);
+			for (const TSharedRef<FTokenizedMessage>& Msg : Result.Logger.GetMessages())
+			{
+				UE_LOG(LogSUDSEditor, Error, TEXT("  %s"), *Msg->ToText().ToString());
+			}
+		}
+		ScriptReports.Add(MakeShared<FJsonValueObject>(MakeEntryReport(Entry, bOK ? TEXT("Compiled") : TEXT("Failed"), &Result.Logger)));
+	}
+
+	TSharedRef<FJsonObject> Report = MakeShared<FJsonObject>();
+	Report->SetStringField(TEXT("path"), ContentPath);
+	Report->SetNumberField(TEXT("scanned"), Entries.Num());
+	Report->SetNumberField(TEXT("upToDate"), NumSkipped);
+	Report->SetNumberField(TEXT("compiled"), NumCompiled);
+	Report->SetNumberField(TEXT("failed"), NumFailed);
+	Report->SetArrayField(TEXT("scripts"), ScriptReports);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	FJsonSerializer::Serialize(Report, Writer);
+	if (FFileHelper::SaveStringToFile(Json, *ReportFile))
+	{
+		UE_LOG(LogSUDSEditor, Display, TEXT("SUDSCompile: wrote report to %s"), *ReportFile);
+	}
+	else
+	{
+		UE_LOG(LogSUDSEditor, Error, TEXT("SUDSCompile: unable to write report to %s"), *ReportFile);
+	}
+
+	UE_LOG(LogSUDSEditor, Display, TEXT("SUDSCompile: %d compiled, %d failed, %d up to date"), NumCompiled, NumFailed, NumSkipped);
+	return NumFailed > 0 ? 1 : 0;
+}
@@ -831,6 +831,23 @@ void FSUDSEditorToolkit::OnPostReimport(UObject* Object, bool bSuccess)
 {
 	if (Object == Script)
 	{
+		// The script object is re-used on reimport, and nodes in unchanged blocks are kept, so a running preview can
+		// carry on from the same line as long as that line still exists
+		if (bSuccess && Dialogue && Dialogue->GetScript() == Script && !Dialogue->IsEnded())
+		{
+			const FSUDSDialogueState State = Dialogue->GetSavedState();
+			if (State.GetTextNodeID().IsEmpty() || Script->GetNodeByTextID(State.GetTextNodeID()))
+			{
+				Dialogue->RestoreSavedState(State);
+				AddDialogueStep(NAME_Start, 0,
+				                INVTEXT("Script reimported, continuing from current line"),
+				                INVTEXT("Reimport"));
+				UpdateChoiceButtons();
+				UpdateVariables();
+				return;
+			}
+		}
+		
 		// Destroy any dialogue instance, will not be valid post-import
 		DestroyDialogue();
 		Clear();
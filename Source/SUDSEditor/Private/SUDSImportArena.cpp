@@ -0,0 +1,59 @@
+﻿#include "SUDSImportArena.h"
+
+TCHAR* FSUDSImportStringArena::Allocate(int32 Len)
+{
+	check(Len >= 0);
+	if (Blocks.IsEmpty() || Blocks.Last().Size - Blocks.Last().Used < Len)
+	{
+		// Oversized requests (e.g. the whole source file) get a block of their own
+		FBlock& NewBlock = Blocks.AddDefaulted_GetRef();
+		NewBlock.Size = FMath::Max(Len, BlockSize);
+		NewBlock.Data = MakeUnique<TCHAR[]>(NewBlock.Size);
+	}
+
+	FBlock& Block = Blocks.Last();
+	TCHAR* Ret = Block.Data.Get() + Block.Used;
+	Block.Used += Len;
+	NumCharsUsed += Len;
+	return Ret;
+}
+
+FStringView FSUDSImportStringArena::Store(const FStringView& Str)
+{
+	const int32 Len = Str.Len();
+	if (Len == 0)
+	{
+		return FStringView();
+	}
+	TCHAR* Dest = Allocate(Len);
+	FMemory::Memcpy(Dest, Str.GetData(), Len * sizeof(TCHAR));
+	return FStringView(Dest, Len);
+}
+
+void FSUDSImportStringArena::Reset()
+{
+	// Keep one normal-sized block for re-use; blocks sized for a single big request aren't worth holding on to
+	const int32 KeepIdx = Blocks.IndexOfByPredicate([this](const FBlock& Block) { return Block.Size == BlockSize; });
+	if (KeepIdx != INDEX_NONE)
+	{
+		FBlock Kept = MoveTemp(Blocks[KeepIdx]);
+		Kept.Used = 0;
+		Blocks.Reset();
+		Blocks.Add(MoveTemp(Kept));
+	}
+	else
+	{
+		Blocks.Reset();
+	}
+	NumCharsUsed = 0;
+}
+
+SIZE_T FSUDSImportStringArena::GetAllocatedSize() const
+{
+	SIZE_T Ret = Blocks.GetAllocatedSize();
+	for (const FBlock& Block : Blocks)
+	{
+		Ret += Block.Size * sizeof(TCHAR);
+	}
+	return Ret;
+}
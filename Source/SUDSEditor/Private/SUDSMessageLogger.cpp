@@ -51,3 +51,8 @@ void FSUDSMessageLogger::AddMessage(EMessageSeverity::Type Severity, const FText
 	ErrorMessages.Add(FTokenizedMessage::Create(Severity, Text));
 }
 
+void FSUDSMessageLogger::Append(const FSUDSMessageLogger& Other)
+{
+	ErrorMessages.Append(Other.ErrorMessages);
+}
+
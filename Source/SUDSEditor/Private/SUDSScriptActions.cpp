@@ -1,5 +1,6 @@
 ﻿#include "SUDSScriptActions.h"
 
+#include "SUDSBatchImporter.h"
 #include "SUDSEditorToolkit.h"
 #include "SUDSMessageLogger.h"
 #include "SUDSScript.h"
@@ -77,6 +78,33 @@ void FSUDSScriptActions::GetActions(const TArray<UObject*>& InObjects, FToolMenu
 			FCanExecuteAction()
 		)
 	);
+
+	Section.AddMenuEntry(
+		"BatchReimport",
+		NSLOCTEXT("SUDS", "BatchReimport", "Reimport (batch)"),
+		NSLOCTEXT("SUDS",
+		          "BatchReimportTooltip",
+		          "Reimport all selected scripts from source, parsing them in parallel."),
+		FSlateIcon(FAppStyle::GetAppStyleSetName(), "Icons.Refresh"),
+		FUIAction(
+			FExecuteAction::CreateSP(this, &FSUDSScriptActions::BatchReimport, Scripts),
+			FCanExecuteAction()
+		)
+	);
+}
+
+void FSUDSScriptActions::BatchReimport(TArray<TWeakObjectPtr<USUDSScript>> Scripts)
+{
+	TArray<USUDSScript*> ValidScripts;
+	for (auto Script : Scripts)
+	{
+		if (Script.IsValid())
+		{
+			ValidScripts.Add(Script.Get());
+		}
+	}
+	FSUDSMessageLogger Logger;
+	FSUDSBatchImporter::ReimportScripts(ValidScripts, Logger);
 }
 
 void FSUDSScriptActions::WriteBackTextIDs(TArray<TWeakObjectPtr<USUDSScript>> Scripts)
@@ -207,6 +235,13 @@ bool FSUDSScriptActions::WriteBackTextIDsFromNodes(const TArray<USUDSScriptNode*
 					
 					bAnyChanges = WriteBackTextID(Literal, SN->GetSourceLineNo(), Lines, NameForErrors, Logger) || bAnyChanges;
 				}
+				for (const auto& Assignment : SN->GetMergedAssignments())
+				{
+					if (Assignment.Expression.IsTextLiteral())
+					{
+						bAnyChanges = WriteBackTextID(Assignment.Expression.GetTextLiteralValue(), Assignment.SourceLineNo, Lines, NameForErrors, Logger) || bAnyChanges;
+					}
+				}
 			}
 			
 		}
@@ -9,6 +9,11 @@
 #include "Internationalization/StringTable.h"
 #include "Misc/FeedbackContext.h"
 
+static TAutoConsoleVariable<bool> CVarSUDSOptimiseScripts(
+	TEXT("SUDS.OptimiseScripts"),
+	false,
+	TEXT("If true, imported SUDS scripts have their node graph optimised (fewer nodes, same behaviour)"));
+
 USUDSScriptFactory::USUDSScriptFactory()
 {
 	SupportedClass = USUDSScript::StaticClass();
@@ -47,24 +52,63 @@ UObject* USUDSScriptFactory::FactoryCreateText(UClass* InClass,
 	// Now parse this using utility
 	if(Importer.ImportFromBuffer(Buffer, BufferEnd - Buffer, NameForErrors, &Logger, false))
 	{
-		
-		// Populate with data
+		// Hash the file as stored, so batch reimport & the compile commandlet (which hash the file bytes) agree
+		FMD5Hash Hash = FMD5Hash::HashFile(*FactoryCurrentFilename);
+		if (!Hash.IsValid())
+		{
+			Hash = FSUDSScriptImporter::CalculateHash(Buffer, BufferEnd - Buffer);
+		}
+		Result = CreateScriptAssets(Importer, InParent, InName, Flags, FactoryCurrentFilename, Hash);
+	}
+
+	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, Result);
+
+	return Result;
+}
+
+USUDSScript* USUDSScriptFactory::CreateScriptAssets(FSUDSScriptImporter& Importer,
+                                                    UObject* InParent,
+                                                    FName InName,
+                                                    EObjectFlags Flags,
+                                                    const FString& SourceFilename,
+                                                    const FMD5Hash& SourceHash)
+{
+	// On reimport keep the existing script & string table objects, so that the importer can keep nodes and strings
+	// from parts of the script which haven't changed (and running dialogues don't lose their script)
+	USUDSScript* Result = FindObject<USUDSScript>(InParent, *InName.ToString());
+	if (Result)
+	{
+		// Changed in place, so it needs to be in the undo buffer & marked dirty like any other edit
+		Result->Modify();
+		Result->SetFlags(Flags);
+	}
+	else
+	{
 		Result = NewObject<USUDSScript>(InParent, InName, Flags);
-		// Build native language string table
-		const FName StringTableName = FName(InName.ToString() + "Strings");
+	}
+	// Build native language string table
+	const FName StringTableName = FName(InName.ToString() + "Strings");
+	UStringTable* StringTable = FindObject<UStringTable>(InParent, *StringTableName.ToString());
+	const bool bNewStringTable = StringTable == nullptr;
+	if (bNewStringTable)
+	{
 		// This constructor registers the string table with FStringTableRegistry
-		UStringTable* StringTable = NewObject<UStringTable>(InParent, StringTableName, Flags);
-		Importer.PopulateAsset(Result, StringTable);
-		
+		StringTable = NewObject<UStringTable>(InParent, StringTableName, Flags);
+	}
+	else
+	{
+		StringTable->Modify();
+		StringTable->SetFlags(Flags);
+	}
+	Importer.PopulateAsset(Result, StringTable, CVarSUDSOptimiseScripts.GetValueOnGameThread());
+	
+	if (bNewStringTable)
+	{
 		FAssetRegistryModule::AssetCreated(StringTable);
-
-		// Register source info
-		const FMD5Hash Hash = FSUDSScriptImporter::CalculateHash(Buffer, BufferEnd - Buffer);
-		Result->AssetImportData->Update(FactoryCurrentFilename, Hash);
-
 	}
 
-	GEditor->GetEditorSubsystem<UImportSubsystem>()->BroadcastAssetPostImport(this, Result);
+	// Register source info
+	Result->AssetImportData->Update(SourceFilename, SourceHash);
 
 	return Result;
 }
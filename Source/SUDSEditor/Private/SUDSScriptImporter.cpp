@@ -8,103 +8,239 @@
 #include "SUDSScriptNodeGosub.h"
 #include "SUDSScriptNodeSet.h"
 #include "SUDSScriptNodeText.h"
+#include "SUDSScriptOptimiser.h"
 #include "Internationalization/Regex.h"
 #include "Internationalization/StringTable.h"
 #include "Internationalization/StringTableCore.h"
 
 const FString FSUDSScriptImporter::EndGotoLabel = "end";
 const FString FSUDSScriptImporter::TreePathSeparator = "/";
+static const FName NAME_SpeakerMetadata("Speaker");
 
 DEFINE_LOG_CATEGORY(LogSUDSImporter)
 
-PRAGMA_DISABLE_OPTIMIZATION
-
-bool FSUDSScriptImporter::ImportFromBuffer(const TCHAR *Start, int32 Length, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent)
+namespace
 {
-	static const TCHAR* LineEndings[] =
-	{				
-		TEXT("\r\n"),
-		TEXT("\r"),
-		TEXT("\n"),	
+	/// A line found by ScanLines, offsets are relative to the start of the buffer
+	struct FSUDSScannedLine
+	{
+		int32 Start = 0;
+		int32 Len = 0;
+		/// Number of leading whitespace chars, and the indent level they represent (tabs count for more)
+		int32 IndentChars = 0;
+		int IndentLevel = 0;
+		/// Length after removing leading and trailing whitespace
+		int32 TrimmedLen = 0;
+		/// Whether the line contains any non-ASCII characters
+		bool bNonASCII = false;
 	};
-	constexpr int32 NumDelims = UE_ARRAY_COUNT(LineEndings);
-
-	int LineNumber = 1;
-	HeaderTree.Reset();
-	BodyTree.Reset();
-	PersistentMetadata.Empty();
-	TransientMetadata.Empty();
-	bHeaderDone = false;
-	bHeaderInProgress = false;
-	bTooLateForHeader = false;
-	bool bImportedOK = true;
-	ChoiceUniqueId = 0;
-	TextIDHighestNumber = 0;
-	if (Start)
-	{
-		int32 SubstringBeginIndex = 0;
 
-		// Iterate through string.
-		for(int32 i = 0; i < Length;)
+	/**
+	 * Split a buffer into lines on \r\n, \r or \n in a single forward pass, working out indentation and trailing
+	 * whitespace as we go. OnLine is called for every line including the last (which may be empty), and scanning
+	 * stops if it returns false.
+	 * For UTF-8 buffers non-ASCII bytes are never treated as whitespace; lines with bNonASCII set need re-trimming
+	 * once converted if exact Unicode whitespace handling is required.
+	 */
+	template <typename CharType, typename FuncType>
+	bool ScanLines(const CharType* Buffer, int32 Length, int TabIndentValue, FuncType&& OnLine)
+	{
+		FSUDSScannedLine Line;
+		bool bInIndent = true;
+		int32 LastNonWhitespace = INDEX_NONE;
+		int32 i = 0;
+		while (i < Length)
 		{
-			int32 SubstringEndIndex = INDEX_NONE;
-			int32 DelimiterLength = 0;
-
-			// Attempt each delimiter.
-			for(int32 DelimIndex = 0; DelimIndex < NumDelims; ++DelimIndex)
+			const uint32 C = static_cast<uint32>(Buffer[i]);
+			if (C == '\n' || C == '\r')
 			{
-				DelimiterLength = FCString::Strlen(LineEndings[DelimIndex]);
+				Line.Len = i - Line.Start;
+				Line.TrimmedLen = LastNonWhitespace == INDEX_NONE ? 0 : LastNonWhitespace + 1 - (Line.Start + Line.IndentChars);
+				if (!OnLine(Line))
+				{
+					return false;
+				}
+				i += (C == '\r' && i + 1 < Length && Buffer[i + 1] == '\n') ? 2 : 1;
+				Line = FSUDSScannedLine();
+				Line.Start = i;
+				bInIndent = true;
+				LastNonWhitespace = INDEX_NONE;
+				continue;
+			}
 
-				// If we found a delimiter...
-				if (FCString::Strncmp(Start + i, LineEndings[DelimIndex], DelimiterLength) == 0)
+			bool bWhitespace;
+			if (C > ' ' && C < 0x80)
+			{
+				// Common case
+				bWhitespace = false;
+			}
+			else if (C < 0x80)
+			{
+				bWhitespace = TChar<TCHAR>::IsWhitespace(static_cast<TCHAR>(C));
+			}
+			else
+			{
+				Line.bNonASCII = true;
+				if constexpr (sizeof(CharType) == sizeof(TCHAR))
 				{
-					// Mark the end of the substring.
-					SubstringEndIndex = i;
-					break;
+					bWhitespace = TChar<TCHAR>::IsWhitespace(static_cast<TCHAR>(C));
+				}
+				else
+				{
+					bWhitespace = false;
 				}
 			}
 
-			if (SubstringEndIndex != INDEX_NONE)
+			if (bWhitespace)
 			{
-				const int32 SubstringLength = SubstringEndIndex - SubstringBeginIndex;
-				FStringView Line = MakeStringView(Start + SubstringBeginIndex, SubstringLength);
-				if (!ParseLine(Line, LineNumber++, NameForErrors, Logger, bSilent))
+				if (bInIndent)
 				{
-					// Abort, error
-					bImportedOK = false;
-					break;
+					++Line.IndentChars;
+					Line.IndentLevel += C == '\t' ? TabIndentValue : 1;
 				}
-				
-				
-				// Next substring begins at the end of the discovered delimiter.
-				SubstringBeginIndex = SubstringEndIndex + DelimiterLength;
-				i = SubstringBeginIndex;
 			}
 			else
 			{
-				++i;
+				bInIndent = false;
+				LastNonWhitespace = i;
 			}
+			++i;
 		}
 
-		// Add any remaining characters after the last delimiter.
-		const int32 SubstringLength = Length - SubstringBeginIndex;
-		const FStringView Line = MakeStringView(Start + SubstringBeginIndex, SubstringLength);
-		bImportedOK = ParseLine(Line, LineNumber++, NameForErrors, Logger, bSilent) && bImportedOK;
+		// Last line, after the final delimiter
+		Line.Len = Length - Line.Start;
+		Line.TrimmedLen = LastNonWhitespace == INDEX_NONE ? 0 : LastNonWhitespace + 1 - (Line.Start + Line.IndentChars);
+		return OnLine(Line);
 	}
 
-	ConnectRemainingNodes(HeaderTree, NameForErrors, Logger, bSilent);
-	ConnectRemainingNodes(BodyTree, NameForErrors, Logger, bSilent);
+	/// Get the word after the '[' in a command line, e.g. "set" for "[set x 1]"
+	FStringView GetCommandKeyword(const FStringView& Line)
+	{
+		int32 End = 1;
+		while (End < Line.Len() && TChar<TCHAR>::IsAlpha(Line[End]))
+		{
+			++End;
+		}
+		return Line.Mid(1, End - 1);
+	}
+}
+
+bool FSUDSScriptImporter::ImportFromBuffer(const TCHAR *Start, int32 Length, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent)
+{
+	ResetImportState();
+	bool bImportedOK = true;
+	if (Start)
+	{
+		// Parsed nodes keep views into the source, so take our own copy of it
+		Start = StringArena.Store(FStringView(Start, Length)).GetData();
+		int LineNumber = 1;
+		bImportedOK = ScanLines(Start, Length, TabIndentValue, [&](const FSUDSScannedLine& L)
+		{
+			const FStringView Line(Start + L.Start, L.Len);
+			const FStringView TrimmedLine(Start + L.Start + L.IndentChars, L.TrimmedLen);
+			return ParseLine(Line, TrimmedLine, L.IndentLevel, LineNumber++, NameForErrors, Logger, bSilent);
+		});
+	}
+
+	FinishParsing(NameForErrors, Logger, bSilent);
 
 	return bImportedOK;
 	
 }
 
+bool FSUDSScriptImporter::ImportFromUTF8Buffer(const UTF8CHAR* Start, int32 Length, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent)
+{
+	ResetImportState();
+	bool bImportedOK = true;
+	if (Start)
+	{
+		// Skip BOM
+		if (Length >= 3 &&
+			static_cast<uint8>(Start[0]) == 0xEF &&
+			static_cast<uint8>(Start[1]) == 0xBB &&
+			static_cast<uint8>(Start[2]) == 0xBF)
+		{
+			Start += 3;
+			Length -= 3;
+		}
+
+		// Lines are converted one at a time, straight into the string arena since parsed nodes keep views into them
+		int LineNumber = 1;
+		bImportedOK = ScanLines(Start, Length, TabIndentValue, [&](const FSUDSScannedLine& L)
+		{
+			const UTF8CHAR* LineStart = Start + L.Start;
+			int IndentLevel;
+			FStringView TrimmedLine;
+			FStringView Line;
+			if (L.bNonASCII)
+			{
+				const int32 WideLen = FPlatformString::ConvertedLength<TCHAR>(LineStart, L.Len);
+				TCHAR* WideLine = StringArena.Allocate(WideLen);
+				FPlatformString::Convert(WideLine, WideLen, LineStart, L.Len);
+				Line = FStringView(WideLine, WideLen);
+				// Re-trim, there could be non-ASCII whitespace
+				TrimmedLine = TrimLine(Line, IndentLevel);
+			}
+			else
+			{
+				TCHAR* WideLine = StringArena.Allocate(L.Len);
+				for (int32 i = 0; i < L.Len; ++i)
+				{
+					WideLine[i] = static_cast<TCHAR>(LineStart[i]);
+				}
+				Line = FStringView(WideLine, L.Len);
+				TrimmedLine = FStringView(WideLine + L.IndentChars, L.TrimmedLen);
+				IndentLevel = L.IndentLevel;
+			}
+			return ParseLine(Line, TrimmedLine, IndentLevel, LineNumber++, NameForErrors, Logger, bSilent);
+		});
+	}
+
+	FinishParsing(NameForErrors, Logger, bSilent);
+
+	return bImportedOK;
+}
+
+void FSUDSScriptImporter::ResetImportState()
+{
+	HeaderTree.Reset();
+	BodyTree.Reset();
+	PersistentMetadata.Empty();
+	TransientMetadata.Empty();
+	LastTextMetadata.Reset();
+	bHeaderDone = false;
+	bHeaderInProgress = false;
+	bTooLateForHeader = false;
+	ChoiceUniqueId = 0;
+	TextIDHighestNumber = 0;
+	ReferencedSpeakers.Reset();
+	PendingStrings.Reset();
+	// Must come after the trees, since their nodes reference this
+	StringArena.Reset();
+}
+
+void FSUDSScriptImporter::FinishParsing(const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent)
+{
+	ConnectRemainingNodes(HeaderTree, NameForErrors, Logger, bSilent);
+	ConnectRemainingNodes(BodyTree, NameForErrors, Logger, bSilent);
+}
+
 bool FSUDSScriptImporter::ParseLine(const FStringView& Line, int LineNo, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent)
 {
 	// Trim off any whitespace, but record how much of it there is since it can be relevant
 	int IndentLevel;
 	const FStringView TrimmedLine = TrimLine(Line, IndentLevel);
+	return ParseLine(Line, TrimmedLine, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
+}
 
+bool FSUDSScriptImporter::ParseLine(const FStringView& Line,
+                                    const FStringView& TrimmedLine,
+                                    int IndentLevel,
+                                    int LineNo,
+                                    const FString& NameForErrors,
+                                    FSUDSMessageLogger* Logger,
+                                    bool bSilent)
+{
 	if (TrimmedLine.Len() == 0 && !bTextInProgress)
 	{
 		// We will skip any blank lines that aren't inside text
@@ -236,7 +372,7 @@ bool FSUDSScriptImporter::ParseCommentMetadataLine(const FStringView& Line,
 	
 }
 
-TMap<FName, FString> FSUDSScriptImporter::GetTextMetadataForNextEntry(int CurrentLineIndent)
+FSUDSParsedMetadataPtr FSUDSScriptImporter::GetTextMetadataForNextEntry(int CurrentLineIndent)
 {
 	TMap<FName, FString> Ret;
 
@@ -268,7 +404,16 @@ TMap<FName, FString> FSUDSScriptImporter::GetTextMetadataForNextEntry(int Curren
 	}
 	TransientMetadata.Empty();
 
-	return Ret;
+	if (Ret.IsEmpty())
+	{
+		return nullptr;
+	}
+	// Consecutive lines usually have the same metadata, so share it rather than storing a copy per line
+	if (!LastTextMetadata.IsValid() || !LastTextMetadata->OrderIndependentCompareEqual(Ret))
+	{
+		LastTextMetadata = MakeShared<TMap<FName, FString>>(MoveTemp(Ret));
+	}
+	return LastTextMetadata;
 }
 
 
@@ -341,17 +486,36 @@ bool FSUDSScriptImporter::ParseBodyLine(const FStringView& Line,
 	}
 	else if (Line.StartsWith(TEXT('[')))
 	{
-		bool bParsed = ParseConditionalLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
-		if (!bParsed)
-			bParsed = ParseGotoLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
-		if (!bParsed)
+		// Only try the parsers that the command word could match, rather than every pattern in turn
+		const FStringView Keyword = GetCommandKeyword(Line);
+		auto IsKeyword = [&Keyword](const TCHAR* Word) { return Keyword.Equals(Word, ESearchCase::CaseSensitive); };
+		bool bParsed = false;
+		bool bKnownKeyword = true;
+		if (IsKeyword(TEXT("if")) || IsKeyword(TEXT("elseif")) || IsKeyword(TEXT("else")) || IsKeyword(TEXT("endif")))
+			bParsed = ParseConditionalLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
+		else if (IsKeyword(TEXT("set")))
 			bParsed = ParseSetLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
-		if (!bParsed)
+		else if (IsKeyword(TEXT("event")))
 			bParsed = ParseEventLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
-		if (!bParsed)
+		else if (IsKeyword(TEXT("goto")))
+			bParsed = ParseGotoLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
+		else if (IsKeyword(TEXT("gosub")))
 			bParsed = ParseGosubLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
-		if (!bParsed)
+		else if (IsKeyword(TEXT("return")))
 			bParsed = ParseReturnLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
+		else
+			bKnownKeyword = false;
+
+		if (!bKnownKeyword)
+		{
+			// "go to", "go sub" or anything unusual, fall back on trying everything
+			bParsed = ParseConditionalLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent) ||
+				ParseGotoLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent) ||
+				ParseSetLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent) ||
+				ParseEventLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent) ||
+				ParseGosubLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent) ||
+				ParseReturnLine(Line, BodyTree, IndentLevel, LineNo, NameForErrors, Logger, bSilent);
+		}
 
 		if (!bParsed)
 		{
@@ -384,7 +548,7 @@ bool FSUDSScriptImporter::IsLastNodeOfType(const FSUDSScriptImporter::ParsedTree
 
 int FSUDSScriptImporter::FindLastChoiceNode(const ParsedTree& Tree, int IndentLevel)
 {
-	int Ret = FindLastChoiceNode(Tree, IndentLevel,Tree.Nodes.Num() - 1, GetCurrentTreeConditionalPath(Tree));
+	int Ret = FindLastChoiceNode(Tree, IndentLevel,Tree.Nodes.Num() - 1, GetCurrentTreeConditionalPathId(Tree));
 	// if (Ret == -1)
 	// {
 	// 	// Fallback to try to find from previous text
@@ -436,25 +600,25 @@ int FSUDSScriptImporter::FindChoiceAfterTextNode(const FSUDSScriptImporter::Pars
 }
 
 
-int FSUDSScriptImporter::FindLastChoiceNode(const ParsedTree& Tree, int IndentLevel, int FromIndex, const FString& ConditionPath)
+int FSUDSScriptImporter::FindLastChoiceNode(const ParsedTree& Tree, int IndentLevel, int FromIndex, int ConditionalPathId)
 {
 	// Scan backwards from end of tree looking for a choice node which has the same or higher indent and condition state as current
 	// But abort if we hit text nodes on that path
 
 	for (int i = FromIndex; i >= 0; --i)
 	{
-		auto& Node = Tree.Nodes[i];
+		const auto& Node = Tree.Nodes[i];
 
-		if (ConditionPath.StartsWith(Node.ConditionalPath) &&
-			Node.NodeType == ESUDSParsedNodeType::Text &&
-			Node.OriginalIndent <= IndentLevel)
+		if (Node.NodeType == ESUDSParsedNodeType::Text &&
+			Node.OriginalIndent <= IndentLevel &&
+			Tree.ConditionalPaths.IsAncestorOrSelf(Node.ConditionalPathId, ConditionalPathId))
 		{
 			// We hit a parent text node, we can't go back any further
 			return -1;
 		}
 		// Only consider nodes on the same conditional path
 		// Note: NOT containing the conditional path. We don't want to skip over an intervening select node
-		if (ConditionPath == Node.ConditionalPath)
+		if (ConditionalPathId == Node.ConditionalPathId)
 		{
 			// note that we allow indents < as well as ==
 			// This is so that if you choose to aesthetically indent choices it still works
@@ -520,10 +684,10 @@ bool FSUDSScriptImporter::ParseChoiceLine(const FStringView& Line,
 		
 		// Add a pending edge, with the choice text
 		// Following things fill in the edge details, the next node to be parsed will finalise the destination
-		FString ChoiceTextID;
+		FStringView ChoiceTextID;
 		auto ChoiceTextView = Line.SubStr(1, Line.Len() - 1).TrimStart();
 		RetrieveAndRemoveOrGenerateTextID(ChoiceTextView, ChoiceTextID);
-		const int EdgeIdx = ChoiceNode.Edges.Add(FSUDSParsedEdge(ChoiceNodeIdx, -1, LineNo, FString(ChoiceTextView), ChoiceTextID, GetTextMetadataForNextEntry(IndentLevel)));
+		const int EdgeIdx = ChoiceNode.Edges.Add(FSUDSParsedEdge(ChoiceNodeIdx, -1, LineNo, ChoiceTextView, ChoiceTextID, GetTextMetadataForNextEntry(IndentLevel)));
 		Tree.EdgeInProgressNodeIdx = ChoiceNodeIdx;
 		Tree.EdgeInProgressEdgeIdx = EdgeIdx;
 		
@@ -610,8 +774,8 @@ void FSUDSScriptImporter::EnsureChoiceNodeExistsAboveSelect(ParsedTree& Tree, in
 	// Add edge to the select, fixup the parent nodes for both
 	NewChoice.Edges.Add(FSUDSParsedEdge(InsertIdx, InsertIdx + 1, LineNo));
 	NewChoice.ParentNodeIdx = SelectNode.ParentNodeIdx;
-	NewChoice.ChoicePath = SelectNode.ChoicePath;
-	NewChoice.ConditionalPath = SelectNode.ConditionalPath;
+	NewChoice.ChoicePathId = SelectNode.ChoicePathId;
+	NewChoice.ConditionalPathId = SelectNode.ConditionalPathId;
 
 	// Now for every other node after this, we have to fix up indexes that are >= InsertIdx
 	// We don't fix up anything before, because we want things that pointed forward to the select to now point at the choice
@@ -685,6 +849,7 @@ bool FSUDSScriptImporter::ParseElseLine(const FStringView& Line,
 		{
 			Block.Stage = EConditionalStage::ElseStage;
 			Block.ConditionStr = "";
+			Block.PathId = GetConditionalBlockPathId(Tree, Block.PreviousBlockIdx, Block.ConditionStr);
 			const int NodeIdx = Block.SelectNodeIdx;
 				
 			auto& SelectNode = Tree.Nodes[NodeIdx];
@@ -773,8 +938,9 @@ bool FSUDSScriptImporter::ParseIfLine(const FStringView& Line,
 	Tree.EdgeInProgressNodeIdx = NewNodeIdx;
 	Tree.EdgeInProgressEdgeIdx = EdgeIdx;
 			
+	const int PathId = GetConditionalBlockPathId(Tree, Tree.CurrentConditionalBlockIdx, ConditionStr);
 	Tree.CurrentConditionalBlockIdx = Tree.ConditionalBlocks.Add(
-		ConditionalContext(NewNodeIdx, Tree.CurrentConditionalBlockIdx, EConditionalStage::IfStage, ConditionStr));
+		ConditionalContext(NewNodeIdx, Tree.CurrentConditionalBlockIdx, EConditionalStage::IfStage, ConditionStr, PathId));
 	
 	return true;
 	
@@ -803,6 +969,7 @@ bool FSUDSScriptImporter::ParseElseIfLine(const FStringView& Line,
 		{
 			Block.Stage = EConditionalStage::ElseIfStage;
 			Block.ConditionStr = ConditionStr;
+			Block.PathId = GetConditionalBlockPathId(Tree, Block.PreviousBlockIdx, Block.ConditionStr);
 			const int NodeIdx = Block.SelectNodeIdx;
 				
 			auto& SelectOrChoiceNode = Tree.Nodes[NodeIdx];
@@ -951,7 +1118,7 @@ bool FSUDSScriptImporter::ParseGotoLine(const FStringView& Line,
 			Tree.AliasedGotoLabels.Add(PendingLabel, Label);
 		}
 		Tree.PendingGotoLabels.Reset();
-		AppendNode(Tree, FSUDSParsedNode(Label, IndentLevel, LineNo));
+		AppendNode(Tree, FSUDSParsedNode(StringArena.Store(Label), IndentLevel, LineNo));
 		return true;
 	}
 	return false;
@@ -967,7 +1134,7 @@ bool FSUDSScriptImporter::ParseGosubLine(const FStringView& InLine,
 {
 	// Attempt to find existing ID
 	// We need these in order to save the return stack
-	FString GosubID;
+	FStringView GosubID;
 	FStringView Line = InLine;
 	// If this is a continuation line, we shouldn't generate one, but we need to trim it off if it's there
 	bool bFoundID = RetrieveAndRemoveGosubID(Line, GosubID);
@@ -997,7 +1164,7 @@ bool FSUDSScriptImporter::ParseGosubLine(const FStringView& InLine,
 			const auto& Ctx = Tree.IndentLevelStack.Top();
 			// A gosub will become a node of its own in the final runtime
 			// Therefore we don't need to alias labels like we do with gotos
-			AppendNode(Tree, FSUDSParsedNode(Label, GosubID, IndentLevel, LineNo));
+			AppendNode(Tree, FSUDSParsedNode(StringArena.Store(Label), GosubID, IndentLevel, LineNo));
 		}
 		return true;
 	}
@@ -1038,7 +1205,7 @@ bool FSUDSScriptImporter::ParseSetLine(const FStringView& InLine,
 	// Attempt to find existing text ID, for string literals
 	// For multiple lines, may not be present until last line (but in fact can be on any line)
 	// We generate anyway, because it can be overriden by later lines, but makes sure we have one always
-	FString TextID;
+	FStringView TextID;
 	FStringView Line = InLine;
 	RetrieveAndRemoveTextID(Line, TextID);
 	
@@ -1054,7 +1221,7 @@ bool FSUDSScriptImporter::ParseSetLine(const FStringView& InLine,
 		if (!bSilent)
 			UE_LOG(LogSUDSImporter, VeryVerbose, TEXT("%3d:%2d: SET   : %s"), LineNo, IndentLevel, *FString(Line));
 
-		FString Name = SetRegex.GetCaptureGroup(1);
+		const FStringView Name = GetCaptureGroupView(Line, SetRegex, 1);
 		FString ExprStr = SetRegex.GetCaptureGroup(2).TrimStartAndEnd(); // trim because capture accepts spaces in quotes
 
 		FSUDSExpression Expr;
@@ -1106,7 +1273,7 @@ bool FSUDSScriptImporter::ParseEventLine(const FStringView& Line,
 
 		FSUDSParsedNode Node(ESUDSParsedNodeType::Event, IndentLevel, LineNo);
 		
-		Node.Identifier = EventRegex.GetCaptureGroup(1);
+		Node.Identifier = GetCaptureGroupView(Line, EventRegex, 1);
 
 		if (EventRegex.GetCaptureGroupBeginning(2) != INDEX_NONE)
 		{
@@ -1157,7 +1324,7 @@ bool FSUDSScriptImporter::ParseTextLine(const FStringView& InLine,
 
 	// Attempt to find existing text ID
 	// For multiple lines, may not be present until last line (but in fact can be on any line)
-	FString TextID;
+	FStringView TextID;
 	FStringView Line = InLine;
 	// Retrieve, but don't generate text ID at this point
 	// If this is a continuation line, we shouldn't generate one, but we need to trim it off if it's there
@@ -1169,8 +1336,8 @@ bool FSUDSScriptImporter::ParseTextLine(const FStringView& InLine,
 	if (SpeakerRegex.FindNext())
 	{
 		// OK this is a speaker line, in which case this is a new text node
-		const FString Speaker = SpeakerRegex.GetCaptureGroup(1);
-		const FString Text = SpeakerRegex.GetCaptureGroup(2);
+		const FStringView Speaker = GetCaptureGroupView(Line, SpeakerRegex, 1);
+		const FStringView Text = GetCaptureGroupView(Line, SpeakerRegex, 2);
 		if (!bSilent)
 			UE_LOG(LogSUDSImporter, VeryVerbose, TEXT("%3d:%2d: TEXT  : %s"), LineNo, IndentLevel, *FString(Line));
 		// New text node
@@ -1182,7 +1349,10 @@ bool FSUDSScriptImporter::ParseTextLine(const FStringView& InLine,
 		}
 		Ctx.LastTextNodeIdx = AppendNode(Tree, FSUDSParsedNode(Speaker, Text, TextID, GetTextMetadataForNextEntry(IndentLevel), IndentLevel, LineNo));
 
-		ReferencedSpeakers.AddUnique(Speaker);
+		if (!ReferencedSpeakers.ContainsByPredicate([&Speaker](const FString& S) { return Speaker.Equals(S, ESearchCase::IgnoreCase); }))
+		{
+			ReferencedSpeakers.Add(FString(Speaker));
+		}
 		
 		return true;
 	}
@@ -1195,7 +1365,10 @@ bool FSUDSScriptImporter::ParseTextLine(const FStringView& InLine,
 		auto& Node = Tree.Nodes[Ctx.LastNodeIdx];
 		if (Node.NodeType == ESUDSParsedNodeType::Text)
 		{
-			Node.Text.Appendf(TEXT("\n%s"), *LineStr);
+			// The joined text doesn't exist in the source, so it needs its own space
+			TStringBuilder<512> JoinedText;
+			JoinedText << Node.Text << TEXT('\n') << Line;
+			Node.Text = StringArena.Store(JoinedText.ToView());
 		}
 		else
 		{
@@ -1210,7 +1383,7 @@ bool FSUDSScriptImporter::ParseTextLine(const FStringView& InLine,
 
 }
 
-void FSUDSScriptImporter::RetrieveAndRemoveOrGenerateTextID(FStringView& InOutLine, FString& OutTextID)
+void FSUDSScriptImporter::RetrieveAndRemoveOrGenerateTextID(FStringView& InOutLine, FStringView& OutTextID)
 {
 	if (!RetrieveAndRemoveTextID(InOutLine, OutTextID))
 	{
@@ -1218,10 +1391,9 @@ void FSUDSScriptImporter::RetrieveAndRemoveOrGenerateTextID(FStringView& InOutLi
 	}
 }
 
-bool FSUDSScriptImporter::RetrieveAndRemoveTextID(FStringView& InOutLine, FString& OutTextID)
+bool FSUDSScriptImporter::RetrieveAndRemoveTextID(FStringView& InOutLine, FStringView& OutTextID)
 {
 
-	FString LineWithout;
 	int Number;
 	if (RetrieveTextIDFromLine(InOutLine, OutTextID, Number))
 	{
@@ -1234,13 +1406,25 @@ bool FSUDSScriptImporter::RetrieveAndRemoveTextID(FStringView& InOutLine, FStrin
 }
 
 bool FSUDSScriptImporter::RetrieveTextIDFromLine(FStringView& InOutLine, FString& OutTextID, int& OutNumber)
+{
+	FStringView TextIDView;
+	if (RetrieveTextIDFromLine(InOutLine, TextIDView, OutNumber))
+	{
+		OutTextID = FString(TextIDView);
+		return true;
+	}
+	return false;
+}
+
+bool FSUDSScriptImporter::RetrieveTextIDFromLine(FStringView& InOutLine, FStringView& OutTextID, int& OutNumber)
 {
 	const FString LineStr(InOutLine);
 	const FRegexPattern TextIDPattern(TEXT("(\\@([0-9a-fA-F]+)\\@)"));
 	FRegexMatcher TextIDRegex(TextIDPattern, LineStr);
 	if (TextIDRegex.FindNext())
 	{
-		OutTextID = TextIDRegex.GetCaptureGroup(1);
+		// View into the original line, rather than a copy
+		OutTextID = GetCaptureGroupView(InOutLine, TextIDRegex, 1);
 		// Chop the incoming string to the left of the TextID
 		InOutLine = InOutLine.Left(TextIDRegex.GetCaptureGroupBeginning(1));
 		// Also trim right
@@ -1255,10 +1439,9 @@ bool FSUDSScriptImporter::RetrieveTextIDFromLine(FStringView& InOutLine, FString
 	
 }
 
-bool FSUDSScriptImporter::RetrieveAndRemoveGosubID(FStringView& InOutLine, FString& OutTextID)
+bool FSUDSScriptImporter::RetrieveAndRemoveGosubID(FStringView& InOutLine, FStringView& OutTextID)
 {
 
-	FString LineWithout;
 	int Number;
 	if (RetrieveGosubIDFromLine(InOutLine, OutTextID, Number))
 	{
@@ -1271,13 +1454,25 @@ bool FSUDSScriptImporter::RetrieveAndRemoveGosubID(FStringView& InOutLine, FStri
 }
 
 bool FSUDSScriptImporter::RetrieveGosubIDFromLine(FStringView& InOutLine, FString& OutID, int& OutNumber)
+{
+	FStringView IDView;
+	if (RetrieveGosubIDFromLine(InOutLine, IDView, OutNumber))
+	{
+		OutID = FString(IDView);
+		return true;
+	}
+	return false;
+}
+
+bool FSUDSScriptImporter::RetrieveGosubIDFromLine(FStringView& InOutLine, FStringView& OutID, int& OutNumber)
 {
 	const FString LineStr(InOutLine);
 	const FRegexPattern IDPattern(TEXT("(\\@GS([0-9a-fA-F]+)\\@)"));
 	FRegexMatcher IDRegex(IDPattern, LineStr);
 	if (IDRegex.FindNext())
 	{
-		OutID = IDRegex.GetCaptureGroup(1);
+		// View into the original line, rather than a copy
+		OutID = GetCaptureGroupView(InOutLine, IDRegex, 1);
 		// Chop the incoming string to the left of the TextID
 		InOutLine = InOutLine.Left(IDRegex.GetCaptureGroupBeginning(1));
 		// Also trim right
@@ -1292,15 +1487,68 @@ bool FSUDSScriptImporter::RetrieveGosubIDFromLine(FStringView& InOutLine, FStrin
 	
 }
 
-FString FSUDSScriptImporter::GenerateTextID(const FStringView& Line)
+FStringView FSUDSScriptImporter::GenerateTextID(const FStringView& Line)
 {
 	// Generate a new text ID just based on ascending numbers
 	// We don't actually base this on the line but we have it for future possible use
 	// Since it's a string, format exactly as in the sud file 
-	return FString::Printf(TEXT("@%04x@"), ++TextIDHighestNumber);
+	TStringBuilder<16> B;
+	B.Appendf(TEXT("@%04x@"), ++TextIDHighestNumber);
+	return StringArena.Store(B.ToView());
+}
+
+FStringView FSUDSScriptImporter::GetCaptureGroupView(const FStringView& Line, FRegexMatcher& Matcher, int32 Group)
+{
+	// Matchers run on an FString copy of the line, but the positions are the same
+	const int32 Begin = Matcher.GetCaptureGroupBeginning(Group);
+	const int32 End = Matcher.GetCaptureGroupEnding(Group);
+	if (Begin == INDEX_NONE || End < Begin)
+	{
+		return FStringView();
+	}
+	return Line.Mid(Begin, End - Begin);
+}
+
+int FSUDSScriptImporter::ParsedPathTable::Intern(int ParentId, const FString& Segment)
+{
+	const TPair<int, FString> Key(ParentId, Segment);
+	if (const int* pId = Lookup.Find(Key))
+	{
+		return *pId;
+	}
+	const int NewId = Entries.Add(Entry { ParentId, Entries[ParentId].Depth + 1, Segment });
+	Lookup.Add(Key, NewId);
+	return NewId;
+}
+
+bool FSUDSScriptImporter::ParsedPathTable::IsAncestorOrSelf(int AncestorId, int Id) const
+{
+	const int AncestorDepth = Entries[AncestorId].Depth;
+	while (Entries[Id].Depth > AncestorDepth)
+	{
+		Id = Entries[Id].ParentId;
+	}
+	return Id == AncestorId;
 }
 
-FString FSUDSScriptImporter::GetCurrentTreePath(const FSUDSScriptImporter::ParsedTree& Tree)
+FString FSUDSScriptImporter::ParsedPathTable::ToString(int Id) const
+{
+	// Root is "/", then every level adds "Segment/"
+	TArray<const FString*, TInlineAllocator<16>> Segments;
+	for (; Id != RootId; Id = Entries[Id].ParentId)
+	{
+		Segments.Add(&Entries[Id].Segment);
+	}
+	FString Ret = TreePathSeparator;
+	for (int i = Segments.Num() - 1; i >= 0; --i)
+	{
+		Ret.Append(*Segments[i]);
+		Ret.Append(TreePathSeparator);
+	}
+	return Ret;
+}
+
+int FSUDSScriptImporter::GetCurrentTreePathId(const FSUDSScriptImporter::ParsedTree& Tree)
 {
 	// This is just a path of all the choice / select nodes AND their edges leading to this point, for fallthrough
 	// * Choice (/C000/)
@@ -1309,33 +1557,31 @@ FString FSUDSScriptImporter::GetCurrentTreePath(const FSUDSScriptImporter::Parse
 	// * Choice (/C002/C003/)
 	//		Do NOT fallthrough to here
 	// Fallthrough to here instead (/)
+	// Each indent context already knows its full path, since it was built from its parent's when pushed
+	return Tree.IndentLevelStack.IsEmpty() ? ParsedPathTable::RootId : Tree.IndentLevelStack.Top().PathId;
+}
 
-	FStringBuilderBase B;
-	for (auto Indent : Tree.IndentLevelStack)
+int FSUDSScriptImporter::GetCurrentTreeConditionalPathId(const FSUDSScriptImporter::ParsedTree& Tree)
+{
+	// Like GetCurrentTreePathId, but for conditional blocks
+	// Cannot fall through to blocks that aren't on the same conditional path
+	if (Tree.ConditionalBlocks.IsValidIndex(Tree.CurrentConditionalBlockIdx))
 	{
-		B.Appendf(TEXT("%s%s"), *Indent.PathEntry, *TreePathSeparator);
+		return Tree.ConditionalBlocks[Tree.CurrentConditionalBlockIdx].PathId;
 	}
-	return B.ToString();
+	return ParsedPathTable::RootId;
 }
 
-FString FSUDSScriptImporter::GetCurrentTreeConditionalPath(const FSUDSScriptImporter::ParsedTree& Tree)
+int FSUDSScriptImporter::GetConditionalBlockPathId(FSUDSScriptImporter::ParsedTree& Tree,
+                                                   int PreviousBlockIdx,
+                                                   const FString& ConditionStr)
 {
-	// Like GetCurrentTreePath, but for conditional blocks
-	// Cannot fall through to blocks that aren't on the same conditional path
-	FStringBuilderBase B;
-	int BlockIdx = Tree.CurrentConditionalBlockIdx;
-	B.Append("/");
-	// work backwards, hence prepend
-	while (BlockIdx != -1)
-	{
-		const FString& ConditionStr = Tree.ConditionalBlocks[BlockIdx].ConditionStr;
-		// Note: add the "/" even if ConditionStr is empty, because it means it's an else level
-		// Not including it can cause an if block to fall through to its own else
-		B.Prepend(FString::Printf(TEXT("%s%s"), *TreePathSeparator, *ConditionStr));
-		BlockIdx = Tree.ConditionalBlocks[BlockIdx].PreviousBlockIdx;
-	}
-	return B.ToString();
-	
+	const int ParentId = Tree.ConditionalBlocks.IsValidIndex(PreviousBlockIdx)
+		                     ? Tree.ConditionalBlocks[PreviousBlockIdx].PathId
+		                     : ParsedPathTable::RootId;
+	// Note: add a level even if ConditionStr is empty, because it means it's an else level
+	// Not including it can cause an if block to fall through to its own else
+	return Tree.ConditionalPaths.Intern(ParentId, ConditionStr);
 }
 
 void FSUDSScriptImporter::SetFallthroughForNewNode(FSUDSScriptImporter::ParsedTree& Tree, FSUDSParsedNode& NewNode)
@@ -1377,8 +1623,8 @@ int FSUDSScriptImporter::AppendNode(FSUDSScriptImporter::ParsedTree& Tree, const
 
 	// Set the tree path of the node (post-add)
 	auto& NewNode = Tree.Nodes[NewIndex];
-	NewNode.ChoicePath = GetCurrentTreePath(Tree);
-	NewNode.ConditionalPath = GetCurrentTreeConditionalPath(Tree);
+	NewNode.ChoicePathId = GetCurrentTreePathId(Tree);
+	NewNode.ConditionalPathId = GetCurrentTreeConditionalPathId(Tree);
 
 	// Use pending edge if present; that could be because this is under a choice node, or a condition
 	if (auto E = GetEdgeInProgress(Tree))
@@ -1490,7 +1736,11 @@ void FSUDSScriptImporter::PopIndent(FSUDSScriptImporter::ParsedTree& Tree)
 
 void FSUDSScriptImporter::PushIndent(FSUDSScriptImporter::ParsedTree& Tree, int NodeIdx, int Indent, const FString& Path)
 {
-	Tree.IndentLevelStack.Push(IndentContext(NodeIdx, Indent, Path));
+	// The root level is the root path, everything else extends its parent
+	const int PathId = Tree.IndentLevelStack.IsEmpty()
+		                   ? ParsedPathTable::RootId
+		                   : Tree.ChoicePaths.Intern(Tree.IndentLevelStack.Top().PathId, Path);
+	Tree.IndentLevelStack.Push(IndentContext(NodeIdx, Indent, PathId));
 
 }
 
@@ -1536,6 +1786,9 @@ void FSUDSScriptImporter::ConnectRemainingNodes(FSUDSScriptImporter::ParsedTree&
 	}
 	Tree.AliasedGotoLabels.Reset();
 	
+	// Work out where every node would fall through to up-front, in one pass
+	TArray<int> FallthroughIndexes;
+	FindFallthroughNodeIndexes(Tree, FallthroughIndexes);
 
 	// We go through top-to-bottom, which is the order of lines in the file as well
 	// We don't need to cascade for this
@@ -1551,15 +1804,15 @@ void FSUDSScriptImporter::ConnectRemainingNodes(FSUDSScriptImporter::ParsedTree&
 				// Try to resolve goto now that we've parsed all labels
 				// We don't actually create edges here, the label is enough so long as it leads somewhere
 				// Check aliases first
-				FString Label = Node.Identifier;
+				FString Label(Node.Identifier);
 				// Special case 'end' which needs no further checking
 				if (Label != EndGotoLabel)
 				{
-					const int GotoNodeIdx = GetGotoTargetNodeIndex(Tree, Node.Identifier);
+					const int GotoNodeIdx = GetGotoTargetNodeIndex(Tree, Label);
 					if (GotoNodeIdx == -1)
 					{
 						if (!bSilent)
-							Logger->Logf(ELogVerbosity::Warning, TEXT("Error in %s line %d: Goto label '%s' was not found, references to it will goto End"), *NameForErrors, Node.SourceLineNo, *Node.Identifier);
+							Logger->Logf(ELogVerbosity::Warning, TEXT("Error in %s line %d: Goto label '%s' was not found, references to it will goto End"), *NameForErrors, Node.SourceLineNo, *Label);
 					}
 				}
 			}
@@ -1570,7 +1823,7 @@ void FSUDSScriptImporter::ConnectRemainingNodes(FSUDSScriptImporter::ParsedTree&
 				// Find the next node which is at a higher indent level than this
 				// For a select node missing else, treat the indent as 1 inward, since it's really falling through from a nested part of the select
 				const int IndentLessThan = bIsSelectNodeMissingElse ? Node.OriginalIndent + 1 : Node.OriginalIndent;
-				const auto FallthroughIdx = FindFallthroughNodeIndex(Tree, i+1, Node.ChoicePath, Node.ConditionalPath);
+				const int FallthroughIdx = FallthroughIndexes[i];
 				if (Tree.Nodes.IsValidIndex(FallthroughIdx))
 				{
 					Node.Edges.Add(FSUDSParsedEdge(i, FallthroughIdx, Node.SourceLineNo));
@@ -1588,7 +1841,7 @@ void FSUDSScriptImporter::ConnectRemainingNodes(FSUDSScriptImporter::ParsedTree&
 				if (!Tree.Nodes.IsValidIndex(Edge.TargetNodeIdx))
 				{
 					// Usually this is a choice line without anything under it, or a condition with nothing in it
-					const auto FallthroughIdx = FindFallthroughNodeIndex(Tree, i+1, Node.ChoicePath, Node.ConditionalPath);
+					const int FallthroughIdx = FallthroughIndexes[i];
 					if (Tree.Nodes.IsValidIndex(FallthroughIdx))
 					{
 						Edge.TargetNodeIdx = FallthroughIdx;
@@ -1604,10 +1857,8 @@ void FSUDSScriptImporter::ConnectRemainingNodes(FSUDSScriptImporter::ParsedTree&
 	}
 }
 
-int FSUDSScriptImporter::FindFallthroughNodeIndex(FSUDSScriptImporter::ParsedTree& Tree,
-                                                  int StartNodeIndex,
-                                                  const FString& FromChoicePath,
-                                                  const FString& FromConditionalPath)
+void FSUDSScriptImporter::FindFallthroughNodeIndexes(const FSUDSScriptImporter::ParsedTree& Tree,
+                                                     TArray<int>& OutFallthroughIdx)
 {
 	// In order to be a valid fallthrough, also needs to be on the same choice (or select) path
 	// E.g. it's possible to have:
@@ -1642,24 +1893,45 @@ int FSUDSScriptImporter::FindFallthroughNodeIndex(FSUDSScriptImporter::ParsedTre
 	//  - Point T2 is on /C2 which is NOT a subset of /C1 so not OK 
 	//  - Point T3 is on / which is a subset of /C1 so OK
 
-	// We'll form these paths just from node indexes rather than C1/C2 etc. Nesting can be for a choice or a select
-	for (int i = StartNodeIndex; i < Tree.Nodes.Num(); ++i)
-	{
-		auto N = Tree.Nodes[i];
-		// We used to require that N.OriginalIndent < IndentLessThan here
-		// However, this is actually not needed, since indentation only controls association with choice paths, otherwise
-		// it's irrelevant. And we already check that things only fall through if they're on the same choice/conditional
-		// path (or a superset of it). 
-		if (N.AllowFallthrough &&
-			FromChoicePath.StartsWith(N.ChoicePath) &&
-			FromConditionalPath.StartsWith(N.ConditionalPath))
+	// Nesting can be for a choice or a select, so both the choice path and the conditional path must be a subset.
+	//
+	// We used to require that the target's OriginalIndent < the source's indent here
+	// However, this is actually not needed, since indentation only controls association with choice paths, otherwise
+	// it's irrelevant. And we already check that things only fall through if they're on the same choice/conditional
+	// path (or a superset of it).
+	//
+	// Rather than scanning forwards from every node (quadratic on long scripts), we walk backwards once, remembering
+	// the nearest valid fallthrough target for each exact (choice path, conditional path) pair seen so far. The
+	// fallthrough for a node is then the nearest of those entries over every ancestor pair of its own paths, which
+	// costs only as much as the nesting depth.
+	OutFallthroughIdx.SetNumUninitialized(Tree.Nodes.Num());
+	TMap<TPair<int, int>, int> NearestByPath;
+	for (int i = Tree.Nodes.Num() - 1; i >= 0; --i)
+	{
+		const auto& N = Tree.Nodes[i];
+
+		// Only nodes *after* this one are candidates, so look up before registering this node
+		int FallthroughIdx = -1;
+		for (int ChoiceId = N.ChoicePathId; ChoiceId != -1; ChoiceId = Tree.ChoicePaths.GetParent(ChoiceId))
 		{
-			return i;
+			for (int CondId = N.ConditionalPathId; CondId != -1; CondId = Tree.ConditionalPaths.GetParent(CondId))
+			{
+				if (const int* pIdx = NearestByPath.Find(TPair<int, int>(ChoiceId, CondId)))
+				{
+					if (FallthroughIdx == -1 || *pIdx < FallthroughIdx)
+					{
+						FallthroughIdx = *pIdx;
+					}
+				}
+			}
 		}
-		
-	}
+		OutFallthroughIdx[i] = FallthroughIdx;
 
-	return -1;
+		if (N.AllowFallthrough)
+		{
+			NearestByPath.Add(TPair<int, int>(N.ChoicePathId, N.ConditionalPathId), i);
+		}
+	}
 }
 
 const FSUDSParsedNode* FSUDSScriptImporter::GetNode(const FSUDSScriptImporter::ParsedTree& Tree, int Index)
@@ -1682,6 +1954,34 @@ const FSUDSParsedNode* FSUDSScriptImporter::GetNode(int Index)
 	return GetNode(BodyTree, Index);
 }
 
+SIZE_T FSUDSScriptImporter::GetAllocatedSize() const
+{
+	SIZE_T Ret = StringArena.GetAllocatedSize();
+	for (const ParsedTree* Tree : { &HeaderTree, &BodyTree })
+	{
+		Ret += Tree->Nodes.GetAllocatedSize();
+		for (const auto& Node : Tree->Nodes)
+		{
+			Ret += Node.Edges.GetAllocatedSize();
+			Ret += Node.EventArgs.GetAllocatedSize();
+		}
+		Ret += Tree->GotoLabelList.GetAllocatedSize();
+		Ret += Tree->ChoicePaths.Entries.GetAllocatedSize() + Tree->ChoicePaths.Lookup.GetAllocatedSize();
+		Ret += Tree->ConditionalPaths.Entries.GetAllocatedSize() + Tree->ConditionalPaths.Lookup.GetAllocatedSize();
+	}
+	return Ret;
+}
+
+FString FSUDSScriptImporter::GetChoicePath(const FSUDSParsedNode* Node) const
+{
+	return Node ? BodyTree.ChoicePaths.ToString(Node->ChoicePathId) : FString();
+}
+
+FString FSUDSScriptImporter::GetConditionalPath(const FSUDSParsedNode* Node) const
+{
+	return Node ? BodyTree.ConditionalPaths.ToString(Node->ConditionalPathId) : FString();
+}
+
 int FSUDSScriptImporter::GetGotoTargetNodeIndex(const FString& InLabel)
 {
 	// Assume Body for this public version
@@ -1706,7 +2006,7 @@ int FSUDSScriptImporter::GetGotoTargetNodeIndex(const ParsedTree& Tree, const FS
 	
 }
 
-void FSUDSScriptImporter::PopulateAsset(USUDSScript* Asset, UStringTable* StringTable)
+void FSUDSScriptImporter::PopulateAsset(USUDSScript* Asset, UStringTable* StringTable, bool bOptimise)
 {
 	// This is only called if the parsing was successful
 	// Populate the runtime asset
@@ -1719,8 +2019,25 @@ void FSUDSScriptImporter::PopulateAsset(USUDSScript* Asset, UStringTable* String
 
 	pOutSpeakers->Append(ReferencedSpeakers);
 
-	PopulateAssetFromTree(Asset, HeaderTree, pOutHeaderNodes, pOutHeaderLabels, StringTable);
-	PopulateAssetFromTree(Asset, BodyTree, pOutNodes, pOutLabels, StringTable);
+	// Strings go in first, in one pass, so they all exist by the time texts referencing them are created
+	GatherStrings();
+	CommitStrings(StringTable);
+
+	PopulateAssetFromTree(Asset, HeaderTree, pOutHeaderNodes, pOutHeaderLabels, Asset->GetImportBlocks(true), StringTable);
+	PopulateAssetFromTree(Asset, BodyTree, pOutNodes, pOutLabels, Asset->GetImportBlocks(false), StringTable);
+
+	if (bOptimise)
+	{
+		const FSUDSScriptOptimiser::FStats Stats = FSUDSScriptOptimiser::Optimise(Asset, *pOutNodes, *pOutLabels, *pOutHeaderNodes, *pOutHeaderLabels);
+		UE_LOG(LogSUDSImporter, Log, TEXT("Optimised %s: %d nodes -> %d (%d edges threaded, %d set nodes merged, %d dead nodes removed, %d gosubs resolved)"),
+		       *Asset->GetName(),
+		       Stats.NodesBefore,
+		       Stats.NodesAfter,
+		       Stats.EdgesThreaded,
+		       Stats.SetNodesMerged,
+		       Stats.DeadNodesRemoved,
+		       Stats.GosubsResolved);
+	}
 
 	Asset->FinishImport();
 }
@@ -1737,19 +2054,295 @@ FMD5Hash FSUDSScriptImporter::CalculateHash(const TCHAR* Buffer, int32 Len)
 	
 }
 
+FMD5Hash FSUDSScriptImporter::CalculateHash(const TArray<uint8>& FileBytes)
+{
+	FMD5Hash Hash;
+	FMD5 MD5;
+
+	MD5.Update(FileBytes.GetData(), FileBytes.Num());
+
+	Hash.Set(MD5);
+	return Hash;
+}
+
+namespace
+{
+	void HashImportString(FMD5& MD5, const FStringView& Str)
+	{
+		// Length first so that adjacent strings can't run into each other
+		const int32 Len = Str.Len();
+		MD5.Update((const uint8*)&Len, sizeof(Len));
+		MD5.Update((const uint8*)Str.GetData(), Len * sizeof(TCHAR));
+	}
+
+	void HashImportMetadata(FMD5& MD5, const FSUDSParsedMetadataPtr& Metadata)
+	{
+		if (Metadata.IsValid())
+		{
+			for (auto& Pair : *Metadata)
+			{
+				HashImportString(MD5, Pair.Key.ToString());
+				HashImportString(MD5, Pair.Value);
+			}
+		}
+	}
+
+	/// Re-use an existing node if it's exactly the right class, otherwise create a new one
+	template<typename T>
+	T* ReuseOrCreateNode(USUDSScript* Asset, USUDSScriptNode* Existing)
+	{
+		if (Existing && Existing->GetClass() == T::StaticClass() && Existing->GetOuter() == Asset)
+		{
+			return static_cast<T*>(Existing);
+		}
+		return NewObject<T>(Asset);
+	}
+}
+
+void FSUDSScriptImporter::BuildImportBlocks(const ParsedTree& Tree,
+                                            TArray<FSUDSScriptImportBlock>& OutBlocks,
+                                            TArray<int>& OutNodeBlocks)
+{
+	// Nodes are in source order, so each labelled node starts a new block which runs until the next label
+	// The hash covers everything that goes into the node objects & string table, but not line numbers, so that
+	// edits in one block don't invalidate every block below it
+	// Several labels can lead to the same node (aliases), pick one consistently
+	TMap<int, const FString*> LabelsByNode;
+	for (auto& Elem : Tree.GotoLabelList)
+	{
+		const FString*& pLabel = LabelsByNode.FindOrAdd(Elem.Value);
+		if (!pLabel || Elem.Key < *pLabel)
+		{
+			pLabel = &Elem.Key;
+		}
+	}
+	
+	OutBlocks.Reset();
+	OutNodeBlocks.Reset(Tree.Nodes.Num());
+	TArray<FMD5> Hashers;
+	for (int i = 0; i < Tree.Nodes.Num(); ++i)
+	{
+		const FSUDSParsedNode& InNode = Tree.Nodes[i];
+		const FString* const* ppLabel = LabelsByNode.Find(i);
+		if (OutBlocks.Num() == 0 || ppLabel)
+		{
+			FSUDSScriptImportBlock& Block = OutBlocks.AddDefaulted_GetRef();
+			Block.Label = ppLabel ? FName(**ppLabel) : NAME_None;
+			Hashers.AddDefaulted();
+		}
+		OutNodeBlocks.Add(OutBlocks.Num() - 1);
+
+		FMD5& MD5 = Hashers.Last();
+		const uint8 Type = (uint8)InNode.NodeType;
+		MD5.Update(&Type, 1);
+		HashImportString(MD5, InNode.Identifier);
+		HashImportString(MD5, InNode.Text);
+		HashImportString(MD5, InNode.TextID);
+		HashImportMetadata(MD5, InNode.TextMetadata);
+		HashImportString(MD5, InNode.Expression.GetSourceString());
+		for (const auto& Arg : InNode.EventArgs)
+		{
+			HashImportString(MD5, Arg.GetSourceString());
+		}
+		const int32 NumEdges = InNode.Edges.Num();
+		MD5.Update((const uint8*)&NumEdges, sizeof(NumEdges));
+		for (const auto& InEdge : InNode.Edges)
+		{
+			HashImportString(MD5, InEdge.Text);
+			HashImportString(MD5, InEdge.TextID);
+			HashImportMetadata(MD5, InEdge.TextMetadata);
+			HashImportString(MD5, InEdge.ConditionExpression.GetSourceString());
+		}
+	}
+
+	for (int i = 0; i < OutBlocks.Num(); ++i)
+	{
+		FMD5Hash Hash;
+		Hash.Set(Hashers[i]);
+		OutBlocks[i].Hash = LexToString(Hash);
+	}
+}
+
+void FSUDSScriptImporter::GatherStrings()
+{
+	int NumStrings = 0;
+	for (const ParsedTree* Tree : { &HeaderTree, &BodyTree })
+	{
+		for (const auto& InNode : Tree->Nodes)
+		{
+			NumStrings += InNode.TextID.IsEmpty() ? 0 : 1;
+			NumStrings += InNode.Edges.Num();
+		}
+	}
+	PendingStrings.Reset();
+	PendingStrings.Reserve(NumStrings);
+
+	static const FString ChoiceSpeaker(TEXT("Player (Choice)"));
+	for (const ParsedTree* Tree : { &HeaderTree, &BodyTree })
+	{
+		for (const auto& InNode : Tree->Nodes)
+		{
+			if (InNode.NodeType == ESUDSParsedNodeType::Text)
+			{
+				// Always include speaker metadata
+				PendingStrings.Add(FString(InNode.TextID),
+				                   PendingStringTableEntry{ FString(InNode.Text), FString(InNode.Identifier), InNode.TextMetadata });
+			}
+			else if (InNode.NodeType == ESUDSParsedNodeType::SetVariable && InNode.Expression.IsTextLiteral())
+			{
+				PendingStrings.Add(FString(InNode.TextID),
+				                   PendingStringTableEntry{ InNode.Expression.GetTextLiteralValue().ToString(), FString(), nullptr });
+			}
+			
+			for (const auto& InEdge : InNode.Edges)
+			{
+				if (!InEdge.TextID.IsEmpty() && !InEdge.Text.IsEmpty())
+				{
+					// Always include speaker metadata, always the player in a choice
+					// Identify that it's a choice so translators know that there may be more limited space
+					PendingStrings.Add(FString(InEdge.TextID),
+					                   PendingStringTableEntry{ FString(InEdge.Text), ChoiceSpeaker, InEdge.TextMetadata });
+				}
+			}
+		}
+	}
+}
+
+bool FSUDSScriptImporter::IsStringTableEntryUnchanged(const FStringTable& Table,
+                                                      const FString& Key,
+                                                      const PendingStringTableEntry& Entry)
+{
+	FString ExistingSource;
+	if (!Table.GetSourceString(*Key, ExistingSource) || !ExistingSource.Equals(Entry.SourceString, ESearchCase::CaseSensitive))
+	{
+		return false;
+	}
+
+	TMap<FName, FString, TInlineSetAllocator<4>> ExpectedMetadata;
+	if (!Entry.Speaker.IsEmpty())
+	{
+		ExpectedMetadata.Add(NAME_SpeakerMetadata, Entry.Speaker);
+	}
+	if (Entry.Metadata.IsValid())
+	{
+		for (auto& Pair : *Entry.Metadata)
+		{
+			ExpectedMetadata.Add(Pair.Key, Pair.Value);
+		}
+	}
+	bool bSame = true;
+	int NumMatched = 0;
+	Table.EnumerateMetaData(*Key, [&](FName Id, const FString& Value)
+	{
+		const FString* pExpected = ExpectedMetadata.Find(Id);
+		if (!pExpected || !pExpected->Equals(Value, ESearchCase::CaseSensitive))
+		{
+			bSame = false;
+			return false;
+		}
+		++NumMatched;
+		return true;
+	});
+	return bSame && NumMatched == ExpectedMetadata.Num();
+}
+
+void FSUDSScriptImporter::CommitStrings(UStringTable* StringTable)
+{
+	FStringTableRef Table = StringTable->GetMutableStringTable();
+
+	// Tables are re-used on reimport, so remove any keys that no longer exist in the script
+	TArray<FString> StaleKeys;
+	Table->EnumerateSourceStrings([this, &StaleKeys](const FString& Key, const FString&)
+	{
+		if (!PendingStrings.Contains(Key))
+		{
+			StaleKeys.Add(Key);
+		}
+		return true;
+	});
+	for (const FString& Key : StaleKeys)
+	{
+		Table->RemoveSourceString(*Key);
+	}
+
+	// Only write entries which have actually changed, so that reimports don't churn the table (or loc gathers)
+	int NumWritten = 0;
+	for (const auto& Pair : PendingStrings)
+	{
+		const PendingStringTableEntry& Entry = Pair.Value;
+		if (IsStringTableEntryUnchanged(*Table, Pair.Key, Entry))
+		{
+			continue;
+		}
+		Table->SetSourceString(Pair.Key, Entry.SourceString);
+		Table->ClearMetaData(*Pair.Key);
+		if (!Entry.Speaker.IsEmpty())
+		{
+			Table->SetMetaData(*Pair.Key, NAME_SpeakerMetadata, Entry.Speaker);
+		}
+		if (Entry.Metadata.IsValid())
+		{
+			for (auto& MetaPair : *Entry.Metadata)
+			{
+				Table->SetMetaData(*Pair.Key, MetaPair.Key, MetaPair.Value);	
+			}
+		}
+		++NumWritten;
+	}
+
+	UE_LOG(LogSUDSImporter, Verbose, TEXT("%s: %d strings, %d written, %d removed"),
+	       *StringTable->GetName(), PendingStrings.Num(), NumWritten, StaleKeys.Num());
+}
+
 void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
                                                 const FSUDSScriptImporter::ParsedTree& Tree,
                                                 TArray<USUDSScriptNode*>* pOutNodes,
                                                 TMap<FName, int>* pOutLabels,
+                                                TArray<FSUDSScriptImportBlock>& InOutBlocks,
                                                 UStringTable* StringTable)
 {
 	if (pOutNodes && pOutLabels)
 	{
+		// Work out which blocks are unchanged since the last import; those keep their node objects. Everything is
+		// still re-initialised & relinked since line numbers, speaker indexes and edges can all change when other
+		// blocks do.
+		
+		TArray<FSUDSScriptImportBlock> NewBlocks;
+		TArray<int> NodeBlocks;
+		BuildImportBlocks(Tree, NewBlocks, NodeBlocks);
+		TArray<const FSUDSScriptImportBlock*> ReusableBlocks;
+		ReusableBlocks.SetNumZeroed(NewBlocks.Num());
+		{
+			TMap<FName, const FSUDSScriptImportBlock*> PrevBlocksByLabel;
+			for (const auto& Block : InOutBlocks)
+			{
+				PrevBlocksByLabel.Add(Block.Label, &Block);
+			}
+			for (int b = 0; b < NewBlocks.Num(); ++b)
+			{
+				if (const FSUDSScriptImportBlock* const* ppPrev = PrevBlocksByLabel.Find(NewBlocks[b].Label))
+				{
+					if ((*ppPrev)->Hash == NewBlocks[b].Hash)
+					{
+						ReusableBlocks[b] = *ppPrev;
+					}
+				}
+			}
+		}
+		
 		TArray<int> IndexRemap;
 		int OutIndex = 0;
 		// First pass, create all the nodes
-		for (const auto& InNode : Tree.Nodes)
+		for (int i = 0; i < Tree.Nodes.Num(); ++i)
 		{
+			const FSUDSParsedNode& InNode = Tree.Nodes[i];
+			FSUDSScriptImportBlock& Block = NewBlocks[NodeBlocks[i]];
+			const FSUDSScriptImportBlock* ReuseBlock = ReusableBlocks[NodeBlocks[i]];
+			USUDSScriptNode* ReuseNode = nullptr;
+			if (ReuseBlock && ReuseBlock->Nodes.IsValidIndex(Block.Nodes.Num()))
+			{
+				ReuseNode = ReuseBlock->Nodes[Block.Nodes.Num()];
+			}
 			// Gotos are dealt with in the node that references them, so ignore them
 			// We're going to be removing Goto nodes in the parse structure, because they were useful while parsing
 			// (letting you fallthrough to a goto node) but in the final runtime we just want them to be edges
@@ -1768,66 +2361,62 @@ void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
 				{
 				case ESUDSParsedNodeType::Text:
 					{
-						StringTable->GetMutableStringTable()->SetSourceString(InNode.TextID, InNode.Text);
-						// Always include speaker metadata
-						StringTable->GetMutableStringTable()->SetMetaData(InNode.TextID, FName("Speaker"), InNode.Identifier);
-						// Other metadata
-						for (auto Pair : InNode.TextMetadata)
-						{
-							StringTable->GetMutableStringTable()->SetMetaData(InNode.TextID, Pair.Key, Pair.Value);	
-						}
-						
-						auto TextNode = NewObject<USUDSScriptNodeText>(Asset);
-						TextNode->Init(InNode.Identifier, FText::FromStringTable (StringTable->GetStringTableId(), InNode.TextID), InNode.SourceLineNo);
+						// Strings were already committed to the table by CommitStrings
+						const FString TextID(InNode.TextID);
+						const FString Speaker(InNode.Identifier);
+						auto TextNode = ReuseOrCreateNode<USUDSScriptNodeText>(Asset, ReuseNode);
+						// Speakers are interned, nodes just reference the index
+						const int SpeakerIdx = Asset->GetSpeakers().IndexOfByKey(Speaker);
+						TextNode->Init(SpeakerIdx, FText::FromStringTable (StringTable->GetStringTableId(), TextID), InNode.SourceLineNo);
 						Node = TextNode;
 						break;
 					}
 				case ESUDSParsedNodeType::Choice:
 					{
-						auto ChoiceNode = NewObject<USUDSScriptNode>(Asset);
+						auto ChoiceNode = ReuseOrCreateNode<USUDSScriptNode>(Asset, ReuseNode);
 						ChoiceNode->InitChoice(InNode.SourceLineNo);
 						Node = ChoiceNode;
 						break;
 					}
 				case ESUDSParsedNodeType::Select:
 					{
-						auto SelectNode = NewObject<USUDSScriptNode>(Asset);
+						auto SelectNode = ReuseOrCreateNode<USUDSScriptNode>(Asset, ReuseNode);
 						SelectNode->InitSelect(InNode.SourceLineNo);
 						Node = SelectNode;
 						break;
 					}
 				case ESUDSParsedNodeType::SetVariable:
 					{
-						auto SetNode = NewObject<USUDSScriptNodeSet>(Asset);
+						auto SetNode = ReuseOrCreateNode<USUDSScriptNodeSet>(Asset, ReuseNode);
 						// For text literals, re-point to string table
 						FSUDSExpression Expr = InNode.Expression;
 						if (Expr.IsTextLiteral())
 						{
-							StringTable->GetMutableStringTable()->SetSourceString(InNode.TextID, Expr.GetTextLiteralValue().ToString());
-							Expr.SetTextLiteralValue(FText::FromStringTable (StringTable->GetStringTableId(), InNode.TextID));
+							const FString TextID(InNode.TextID);
+							Expr.SetTextLiteralValue(FText::FromStringTable (StringTable->GetStringTableId(), TextID));
 						}
-						SetNode->Init(InNode.Identifier, Expr, InNode.SourceLineNo);
+						SetNode->Init(FString(InNode.Identifier), Expr, InNode.SourceLineNo);
 						Node = SetNode;
 						break;
 					}
 				case ESUDSParsedNodeType::Event:
 					{
-						auto EvtNode = NewObject<USUDSScriptNodeEvent>(Asset);
-						EvtNode->Init(InNode.Identifier, InNode.EventArgs, InNode.SourceLineNo);
+						auto EvtNode = ReuseOrCreateNode<USUDSScriptNodeEvent>(Asset, ReuseNode);
+						EvtNode->Init(FString(InNode.Identifier), InNode.EventArgs, InNode.SourceLineNo);
 						Node = EvtNode;
 						break;
 					}
 				case ESUDSParsedNodeType::Gosub:
 					{
 						// Validate gosub label at this point
-						auto GosubNode = NewObject<USUDSScriptNodeGosub>(Asset);
-						GosubNode->Init(InNode.Identifier, InNode.TextID, InNode.SourceLineNo);
+						auto GosubNode = ReuseOrCreateNode<USUDSScriptNodeGosub>(Asset, ReuseNode);
+						GosubNode->Init(FString(InNode.Identifier), FString(InNode.TextID), InNode.SourceLineNo);
 						Node = GosubNode;
 						break;
 					}
 				case ESUDSParsedNodeType::Return:
 					{
-						auto ReturnNode = NewObject<USUDSScriptNode>(Asset);
+						auto ReturnNode = ReuseOrCreateNode<USUDSScriptNode>(Asset, ReuseNode);
 						ReturnNode->InitReturn(InNode.SourceLineNo);
 						Node = ReturnNode;
 						break;
@@ -1839,6 +2428,7 @@ void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
 				}
 
 				pOutNodes->Add(Node);
+				Block.Nodes.Add(Node);
 
 			}
 		}
@@ -1850,7 +2440,8 @@ void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
 			if (InNode.NodeType != ESUDSParsedNodeType::Goto)
 			{
 				USUDSScriptNode* Node = (*pOutNodes)[IndexRemap[i]];
-				// Edges
+				// Edges (always rebuilt, targets may be in blocks which were replaced)
+				Node->ResetEdges();
 				if (InNode.Edges.Num() == 0)
 				{
 					// This normally happens with the final node in the script
@@ -1909,7 +2500,7 @@ void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
 							if (InTargetNode->NodeType == ESUDSParsedNodeType::Goto)
 							{
 								// Resolve GOTOs immediately, point them directly at node goto points to
-								int Idx = GetGotoTargetNodeIndex(Tree, InTargetNode->Identifier);
+								int Idx = GetGotoTargetNodeIndex(Tree, FString(InTargetNode->Identifier));
 								// -1 means "Goto end", leave target null in that case
 								if (Idx != -1)
 								{
@@ -1931,16 +2522,8 @@ void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
 
 						if (!InEdge.TextID.IsEmpty() && !InEdge.Text.IsEmpty())
 						{
-							StringTable->GetMutableStringTable()->SetSourceString(InEdge.TextID, InEdge.Text);
-							NewEdge.SetText(FText::FromStringTable(StringTable->GetStringTableId(), InEdge.TextID));
-							// Always include speaker metadata, always the player in a choice
-							// Identify that it's a choice so translators know that there may be more limited space
-							StringTable->GetMutableStringTable()->SetMetaData(InEdge.TextID, FName("Speaker"), "Player (Choice)");
-							// Other metadata
-							for (auto Pair : InEdge.TextMetadata)
-							{
-								StringTable->GetMutableStringTable()->SetMetaData(InEdge.TextID, Pair.Key, Pair.Value);	
-							}
+							const FString TextID(InEdge.TextID);
+							NewEdge.SetText(FText::FromStringTable(StringTable->GetStringTableId(), TextID));
 						}
 
 						Node->AddEdge(NewEdge);
@@ -1958,8 +2541,8 @@ void FSUDSScriptImporter::PopulateAssetFromTree(USUDSScript* Asset,
 			pOutLabels->Add(FName(Elem.Key), NewIndex);
 		}
 
+		InOutBlocks = MoveTemp(NewBlocks);
+
 	}
 	
 }
-
-PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
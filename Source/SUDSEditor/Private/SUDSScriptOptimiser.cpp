@@ -0,0 +1,220 @@
+﻿#include "SUDSScriptOptimiser.h"
+
+#include "SUDSScript.h"
+#include "SUDSScriptNode.h"
+#include "SUDSScriptNodeGosub.h"
+#include "SUDSScriptNodeSet.h"
+
+FSUDSScriptOptimiser::FStats FSUDSScriptOptimiser::Optimise(USUDSScript* Script,
+                                                            TArray<USUDSScriptNode*>& Nodes,
+                                                            TMap<FName, int>& Labels,
+                                                            TArray<USUDSScriptNode*>& HeaderNodes,
+                                                            TMap<FName, int>& HeaderLabels)
+{
+	FStats Stats;
+	Stats.NodesBefore = Nodes.Num() + HeaderNodes.Num();
+
+	// Order matters; threading & merging leave nodes behind which the dead node passes then remove.
+	// Bypassed selects must be gone before merging, since it counts incoming edges from every node in the list
+	ThreadJumps(HeaderNodes, Stats);
+	ThreadJumps(Nodes, Stats);
+	RemoveDeadNodes(HeaderNodes, HeaderLabels, Stats);
+	RemoveDeadNodes(Nodes, Labels, Stats);
+	MergeSetNodes(HeaderNodes, HeaderLabels, Stats);
+	MergeSetNodes(Nodes, Labels, Stats);
+	RemoveDeadNodes(HeaderNodes, HeaderLabels, Stats);
+	RemoveDeadNodes(Nodes, Labels, Stats);
+	// Gosub labels are always looked up in the body, whether the gosub is in the header or not
+	ResolveGosubs(Script, HeaderNodes, Stats);
+	ResolveGosubs(Script, Nodes, Stats);
+
+	Stats.NodesAfter = Nodes.Num() + HeaderNodes.Num();
+	return Stats;
+}
+
+bool FSUDSScriptOptimiser::IsPassThroughSelect(const USUDSScriptNode* Node)
+{
+	if (Node->GetNodeType() != ESUDSScriptNodeType::Select || Node->GetEdgeCount() == 0)
+	{
+		return false;
+	}
+	// The first edge is always taken if it has no condition, or a literal true one; neither requests variables
+	const FSUDSExpression& Condition = Node->GetEdge(0)->GetCondition();
+	if (Condition.IsEmpty())
+	{
+		// Edges with no condition are default constructed, which is valid; a failed parse also leaves the
+		// expression empty, but that can't run at all, so leave it for the runtime to report
+		return Condition.IsValid();
+	}
+	return Condition.IsLiteral() &&
+		Condition.GetLiteralValue().GetType() == ESUDSValueType::Boolean &&
+		Condition.GetBooleanLiteralValue();
+}
+
+void FSUDSScriptOptimiser::ThreadJumps(const TArray<USUDSScriptNode*>& Nodes, FStats& Stats)
+{
+	for (USUDSScriptNode* Node : Nodes)
+	{
+		for (FSUDSScriptEdge& Edge : Node->GetMutableEdges())
+		{
+			USUDSScriptNode* Target = Edge.GetTargetNode().Get();
+			USUDSScriptNode* NewTarget = Target;
+			// Hop limit in case of a loop made only of pass-through selects
+			int Hops = 0;
+			while (NewTarget && IsPassThroughSelect(NewTarget) && Hops++ < Nodes.Num())
+			{
+				NewTarget = NewTarget->GetEdge(0)->GetTargetNode().Get();
+			}
+			if (NewTarget != Target)
+			{
+				Edge.SetTargetNode(NewTarget);
+				if (Node->GetNodeType() == ESUDSScriptNodeType::Text)
+				{
+					// Text -> Choice is chained, as the importer does it
+					Edge.SetType(NewTarget && NewTarget->GetNodeType() == ESUDSScriptNodeType::Choice
+						             ? ESUDSEdgeType::Chained
+						             : ESUDSEdgeType::Continue);
+				}
+				++Stats.EdgesThreaded;
+			}
+		}
+	}
+}
+
+void FSUDSScriptOptimiser::MergeSetNodes(const TArray<USUDSScriptNode*>& Nodes,
+                                         const TMap<FName, int>& Labels,
+                                         FStats& Stats)
+{
+	// A set node can only be merged into the previous one if that's the only way to get to it
+	TMap<const USUDSScriptNode*, int> IncomingEdges;
+	for (const USUDSScriptNode* Node : Nodes)
+	{
+		for (const FSUDSScriptEdge& Edge : Node->GetEdges())
+		{
+			if (const USUDSScriptNode* Target = Edge.GetTargetNode().Get())
+			{
+				++IncomingEdges.FindOrAdd(Target);
+			}
+		}
+	}
+	TSet<const USUDSScriptNode*> EntryNodes;
+	if (Nodes.Num() > 0)
+	{
+		EntryNodes.Add(Nodes[0]);
+	}
+	for (const auto& Pair : Labels)
+	{
+		if (Nodes.IsValidIndex(Pair.Value))
+		{
+			EntryNodes.Add(Nodes[Pair.Value]);
+		}
+	}
+
+	TSet<const USUDSScriptNode*> MergedNodes;
+	for (USUDSScriptNode* Node : Nodes)
+	{
+		USUDSScriptNodeSet* SetNode = Cast<USUDSScriptNodeSet>(Node);
+		if (!SetNode || MergedNodes.Contains(SetNode))
+		{
+			continue;
+		}
+		while (SetNode->GetEdgeCount() == 1)
+		{
+			const USUDSScriptNodeSet* NextSet = Cast<USUDSScriptNodeSet>(SetNode->GetEdge(0)->GetTargetNode().Get());
+			if (!NextSet ||
+				NextSet == SetNode ||
+				EntryNodes.Contains(NextSet) ||
+				IncomingEdges.FindRef(NextSet) != 1)
+			{
+				break;
+			}
+			SetNode->AppendAssignments(NextSet);
+			// Carry on from wherever the merged node went
+			SetNode->GetMutableEdges() = NextSet->GetEdges();
+			MergedNodes.Add(NextSet);
+			++Stats.SetNodesMerged;
+		}
+	}
+}
+
+void FSUDSScriptOptimiser::RemoveDeadNodes(TArray<USUDSScriptNode*>& Nodes, TMap<FName, int>& Labels, FStats& Stats)
+{
+	// Dialogue can start at the first node or any label; everything else has to be reached through edges
+	// Returns go back to the node after their gosub, which is an edge of the gosub
+	TSet<const USUDSScriptNode*> Reachable;
+	TArray<const USUDSScriptNode*> Stack;
+	if (Nodes.Num() > 0)
+	{
+		Stack.Add(Nodes[0]);
+	}
+	for (const auto& Pair : Labels)
+	{
+		if (Nodes.IsValidIndex(Pair.Value))
+		{
+			Stack.Add(Nodes[Pair.Value]);
+		}
+	}
+	while (Stack.Num() > 0)
+	{
+		const USUDSScriptNode* Node = Stack.Pop(false);
+		bool bAlreadyVisited = false;
+		Reachable.Add(Node, &bAlreadyVisited);
+		if (bAlreadyVisited)
+		{
+			continue;
+		}
+		for (const FSUDSScriptEdge& Edge : Node->GetEdges())
+		{
+			if (const USUDSScriptNode* Target = Edge.GetTargetNode().Get())
+			{
+				Stack.Add(Target);
+			}
+		}
+	}
+
+	if (Reachable.Num() == Nodes.Num())
+	{
+		return;
+	}
+
+	TArray<int> IndexRemap;
+	IndexRemap.SetNumUninitialized(Nodes.Num());
+	TArray<USUDSScriptNode*> LiveNodes;
+	LiveNodes.Reserve(Reachable.Num());
+	for (int i = 0; i < Nodes.Num(); ++i)
+	{
+		if (Reachable.Contains(Nodes[i]))
+		{
+			IndexRemap[i] = LiveNodes.Add(Nodes[i]);
+		}
+		else
+		{
+			IndexRemap[i] = -1;
+			++Stats.DeadNodesRemoved;
+		}
+	}
+	for (auto& Pair : Labels)
+	{
+		if (IndexRemap.IsValidIndex(Pair.Value))
+		{
+			Pair.Value = IndexRemap[Pair.Value];
+		}
+	}
+	Nodes = MoveTemp(LiveNodes);
+}
+
+void FSUDSScriptOptimiser::ResolveGosubs(const USUDSScript* Script, const TArray<USUDSScriptNode*>& Nodes, FStats& Stats)
+{
+	for (USUDSScriptNode* Node : Nodes)
+	{
+		if (USUDSScriptNodeGosub* GosubNode = Cast<USUDSScriptNodeGosub>(Node))
+		{
+			// Missing labels stay unresolved, so that the runtime still reports the error
+			if (USUDSScriptNode* Target = Script->GetNodeByLabel(GosubNode->GetLabelName()))
+			{
+				GosubNode->SetTargetNode(Target);
+				++Stats.GosubsResolved;
+			}
+		}
+	}
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "SUDSMessageLogger.h"
+#include "SUDSScriptImporter.h"
+
+class USUDSScript;
+
+/**
+ * Imports many .sud files at once. Loading & parsing the source files is independent per file (each one gets its own
+ * FSUDSScriptImporter) so that part runs concurrently on worker threads; creating the UObjects then happens on the
+ * game thread in a single pass afterwards.
+ */
+class SUDSEDITOR_API FSUDSBatchImporter
+{
+public:
+	/// The result of loading & parsing one source file
+	struct FParseResult
+	{
+		FString Filename;
+		FString NameForErrors;
+		FSUDSScriptImporter Importer;
+		/// Messages from this file; never writes to the message log itself, merge into another logger for that
+		FSUDSMessageLogger Logger { false };
+		FMD5Hash Hash;
+		/// Contents of the source file; may be filled in (with bLoaded & Hash) before ParseResults to skip loading.
+		/// Released once parsed.
+		TArray<uint8> SourceBytes;
+		bool bLoaded = false;
+		bool bParsed = false;
+	};
+
+	/**
+	 * Load and parse a set of source files in parallel.
+	 * @param Filenames Source files to parse
+	 * @param NamesForErrors Names to use in messages, one per filename
+	 * @param OutResults One result per filename, in the same order
+	 */
+	static void ParseFiles(const TArray<FString>& Filenames,
+	                       const TArray<FString>& NamesForErrors,
+	                       TArray<TUniquePtr<FParseResult>>& OutResults);
+
+	/**
+	 * Parse a set of already created results in parallel. Results which aren't marked as loaded are loaded from
+	 * their Filename first; those which are keep their SourceBytes & Hash, so callers which have already read the
+	 * file don't read it again.
+	 * @param Results The results to parse
+	 */
+	static void ParseResults(TArray<TUniquePtr<FParseResult>>& Results);
+
+	/**
+	 * Reimport scripts from their source files, parsing in parallel.
+	 * @param Scripts The script assets to reimport
+	 * @param Logger Logger which receives messages for all scripts
+	 * @return The number of scripts successfully reimported
+	 */
+	static int ReimportScripts(const TArray<USUDSScript*>& Scripts, FSUDSMessageLogger& Logger);
+
+	/// Reimport every script asset in the project
+	static int ReimportAllScripts(FSUDSMessageLogger& Logger);
+};
@@ -0,0 +1,27 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SUDSCompileCommandlet.generated.h"
+
+/**
+ * Headless compile of .sud scripts, for build machines & pre-submit checks.
+ * Scripts whose source hash matches the hash stored in their asset's import data are skipped, everything else is
+ * parsed in parallel, imported & (optionally) saved, and a JSON report of the results is written.
+ *
+ * Usage: UnrealEditor-Cmd <Project> -run=SUDSCompile [-Path=/Game/Dialogue] [-Report=<file>] [-Force] [-NoSave]
+ *   -Path    Content path to scan recursively (default /Game)
+ *   -Report  Where to write the JSON report (default <Project>/Saved/SUDS/CompileReport.json)
+ *   -Force   Compile every script, even if unchanged
+ *   -NoSave  Validate only, don't save any assets
+ * Returns non-zero if any script had errors.
+ */
+UCLASS()
+class SUDSEDITOR_API USUDSCompileCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	USUDSCompileCommandlet();
+	virtual int32 Main(const FString& Params) override;
+};
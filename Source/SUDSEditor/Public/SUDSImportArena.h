@@ -0,0 +1,45 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Bump allocator for the character data referenced by a parse tree.
+ * The importer copies its source text in here once, then parsed nodes hold FStringViews into it; only strings which
+ * don't exist verbatim in the source (generated text IDs, lower-cased labels, joined continuation lines) need any
+ * extra space, and that comes from the same blocks. Everything is released together on Reset().
+ */
+class SUDSEDITOR_API FSUDSImportStringArena
+{
+public:
+	explicit FSUDSImportStringArena(int32 InBlockSize = 64 * 1024) : BlockSize(InBlockSize) {}
+
+	FSUDSImportStringArena(const FSUDSImportStringArena&) = delete;
+	FSUDSImportStringArena& operator=(const FSUDSImportStringArena&) = delete;
+
+	/// Get space for Len characters (not null terminated), valid until Reset()
+	TCHAR* Allocate(int32 Len);
+
+	/// Copy a string into the arena, returning a view which is valid until Reset()
+	FStringView Store(const FStringView& Str);
+
+	/// Release all strings. The first block is kept for re-use.
+	void Reset();
+
+	/// Number of characters handed out since the last Reset()
+	int64 GetNumCharsUsed() const { return NumCharsUsed; }
+	/// Number of blocks currently allocated
+	int32 GetNumBlocks() const { return Blocks.Num(); }
+	/// Total bytes reserved by the arena, whether used or not
+	SIZE_T GetAllocatedSize() const;
+
+protected:
+	struct FBlock
+	{
+		TUniquePtr<TCHAR[]> Data;
+		int32 Size = 0;
+		int32 Used = 0;
+	};
+	TArray<FBlock> Blocks;
+	int32 BlockSize;
+	int64 NumCharsUsed = 0;
+};
@@ -13,9 +13,12 @@ public:
 
 	void SetWriteToMessageLog(bool bWrite) { bWriteToMessageLog = bWrite; }
 	bool HasErrors() const;
+	const TArray<TSharedRef<FTokenizedMessage>>& GetMessages() const { return ErrorMessages; }
 	int NumErrors() const;
 	
 	void AddMessage(EMessageSeverity::Type Severity, const FText& Text);
+	/// Add all the messages from another logger, e.g. one used on a worker thread
+	void Append(const FSUDSMessageLogger& Other);
 	template <typename FmtType, typename... Types>
 	FORCEINLINE void Logf(ELogVerbosity::Type Verbosity, const FmtType& Fmt, Types... Args)
 	{
@@ -29,6 +29,7 @@ public:
 
 protected:
 	void WriteBackTextIDs(TArray<TWeakObjectPtr<USUDSScript>> Scripts);
+	void BatchReimport(TArray<TWeakObjectPtr<USUDSScript>> Scripts);
 	void WriteBackTextIDs(USUDSScript* Script, FSUDSMessageLogger& Logger);
 	bool WriteBackTextIDsFromNodes(const TArray<USUDSScriptNode*> Nodes, TArray<FString>& Lines, const FString& NameForErrors, FSUDSMessageLogger& Logger);
 	bool WriteBackTextID(const FText& AssetText, int LineNo, TArray<FString>& Lines, const FString& NameForErrors, FSUDSMessageLogger& Logger);
@@ -16,6 +16,14 @@ class SUDSEDITOR_API USUDSScriptFactory : public UFactory
 
 public:
 	USUDSScriptFactory();
+
+	/// Create (or replace) the script asset and its string table from an importer which has already parsed the source
+	static USUDSScript* CreateScriptAssets(FSUDSScriptImporter& Importer,
+	                                       UObject* InParent,
+	                                       FName InName,
+	                                       EObjectFlags Flags,
+	                                       const FString& SourceFilename,
+	                                       const FMD5Hash& SourceHash);
 protected:
 	virtual UObject* FactoryCreateText(UClass* InClass,
 		UObject* InParent,
@@ -2,20 +2,27 @@
 
 #include "CoreMinimal.h"
 #include "SUDSExpression.h"
+#include "SUDSImportArena.h"
 
 struct FSUDSMessageLogger;
 class USUDSScript;
+class FRegexMatcher;
 DECLARE_LOG_CATEGORY_EXTERN(LogSUDSImporter, Verbose, All);
 
+/// Metadata for a line of text; shared between all the lines it applies to, since it's usually the same for many lines
+typedef TSharedPtr<const TMap<FName, FString>> FSUDSParsedMetadataPtr;
+
+/// Note: string views in parsed edges & nodes point into the importer's string arena, and are only valid for the
+/// lifetime of the FSUDSScriptImporter (until the next import)
 struct SUDSEDITOR_API FSUDSParsedEdge
 {
 public:
 	/// Text associated with this edge (if a player choice option)
-	FString Text;
+	FStringView Text;
 	/// Identifier of the text, for the string table
-	FString TextID;
-	/// Metadata associated with text, for translator comments
-	TMap<FName, FString> TextMetadata;
+	FStringView TextID;
+	/// Metadata associated with text, for translator comments (null if none)
+	FSUDSParsedMetadataPtr TextMetadata;
 	/// The line this edge was created on
 	int SourceLineNo;
 	/// Condition expression that applies to this edge (for select nodes)
@@ -26,7 +33,7 @@ public:
 
 	FSUDSParsedEdge(int LineNo) : SourceLineNo(LineNo){}
 
-	FSUDSParsedEdge(int FromNodeIdx, int ToNodeIdx, int LineNo, const FString& InText, const FString& InTextID, const TMap<FName, FString>& Metadata)
+	FSUDSParsedEdge(int FromNodeIdx, int ToNodeIdx, int LineNo, const FStringView& InText, const FStringView& InTextID, const FSUDSParsedMetadataPtr& Metadata)
 		: Text(InText),
 		  TextID(InTextID),
 		  TextMetadata(Metadata),
@@ -81,13 +88,13 @@ public:
 	ESUDSParsedNodeType NodeType;
 	int OriginalIndent;
 	/// Identifier is speaker ID, goto label, variable name etc
-	FString Identifier;
+	FStringView Identifier;
 	/// Text in native language
-	FString Text;
+	FStringView Text;
 	/// Identifier of the text, for the string table
-	FString TextID;
-	/// Metadata associated with text, for translator comments
-	TMap<FName, FString> TextMetadata;
+	FStringView TextID;
+	/// Metadata associated with text, for translator comments (null if none)
+	FSUDSParsedMetadataPtr TextMetadata;
 	/// Expression, for nodes that use it (e.g. set)
 	FSUDSExpression Expression;
 	/// Event arguments, for event nodes
@@ -101,12 +108,12 @@ public:
 	/// Whether this is a valid fall-through target
 	bool AllowFallthrough = true;
 
-	// Path hierarchy of choice nodes leading to this node, of the form "/C002/C006" etc, not including this node index
+	// Path hierarchy of choice nodes leading to this node, as an ID in the tree's choice path table (/C002/C006 etc)
 	// This helps us identify valid fallthroughs
-	FString ChoicePath;
-	// Path hierarchy of select nodes leading to this node, of the form "/S002/S006" etc, not including this node index
+	int ChoicePathId = 0;
+	// Path hierarchy of conditional blocks leading to this node, as an ID in the tree's conditional path table
 	// This helps us identify valid fallthroughs
-	FString ConditionalPath;
+	int ConditionalPathId = 0;
 
 	/// Although multiple edges can lead here, this index is for the auto-connected parent (may be nothing)
 	int ParentNodeIdx = -1;
@@ -117,8 +124,8 @@ public:
 	{
 	}
 
-	FSUDSParsedNode(const FString& Label,
-	                const FString& GosubID,
+	FSUDSParsedNode(const FStringView& Label,
+	                const FStringView& GosubID,
 	                int Indent,
 	                int LineNo) : NodeType(ESUDSParsedNodeType::Gosub),
 	                              OriginalIndent(Indent),
@@ -128,7 +135,7 @@ public:
 	{
 	}
 
-	FSUDSParsedNode(const FString& InSpeaker, const FString& InText, const FString& InTextID, const TMap<FName, FString>& Metadata, int Indent, int LineNo)
+	FSUDSParsedNode(const FStringView& InSpeaker, const FStringView& InText, const FStringView& InTextID, const FSUDSParsedMetadataPtr& Metadata, int Indent, int LineNo)
 		: NodeType(ESUDSParsedNodeType::Text),
 		  OriginalIndent(Indent),
 		  Identifier(InSpeaker),
@@ -139,12 +146,12 @@ public:
 	{
 	}
 
-	FSUDSParsedNode(const FString& GotoLabel, int Indent, int LineNo)
+	FSUDSParsedNode(const FStringView& GotoLabel, int Indent, int LineNo)
 		: NodeType(ESUDSParsedNodeType::Goto), OriginalIndent(Indent), Identifier(GotoLabel), SourceLineNo(LineNo)
 	{
 	}
 
-	FSUDSParsedNode(const FString& VariableName, const FSUDSExpression& InExpr, int Indent, int LineNo)
+	FSUDSParsedNode(const FStringView& VariableName, const FSUDSExpression& InExpr, int Indent, int LineNo)
 		: NodeType(ESUDSParsedNodeType::SetVariable),
 		  OriginalIndent(Indent),
 		  Identifier(VariableName),
@@ -153,9 +160,9 @@ public:
 	{
 	}
 
-	FSUDSParsedNode(const FString& VariableName,
+	FSUDSParsedNode(const FStringView& VariableName,
 	                const FSUDSExpression& InExpr,
-	                const FString& InTextID,
+	                const FStringView& InTextID,
 	                int Indent,
 	                int LineNo)
 		: NodeType(ESUDSParsedNodeType::SetVariable),
@@ -171,12 +178,55 @@ class SUDSEDITOR_API FSUDSScriptImporter
 {
 public:
 	bool ImportFromBuffer(const TCHAR* Buffer, int32 Len, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
-	void PopulateAsset(USUDSScript* Asset, UStringTable* StringTable);
+	/// Import directly from UTF-8 bytes (e.g. a .sud file loaded as-is), without converting the whole file to TCHAR first.
+	/// A leading UTF-8 BOM is skipped.
+	bool ImportFromUTF8Buffer(const UTF8CHAR* Buffer, int32 Len, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
+	/// Create the runtime nodes & strings from the parsed script. If bOptimise is set, the graph is run through
+	/// FSUDSScriptOptimiser before the asset finishes importing.
+	void PopulateAsset(USUDSScript* Asset, UStringTable* StringTable, bool bOptimise = false);
 	static FMD5Hash CalculateHash(const TCHAR* Buffer, int32 Len);
+	/// Hash the raw bytes of a source file, as stored in the asset import data. Same as FMD5Hash::HashFile on that file.
+	static FMD5Hash CalculateHash(const TArray<uint8>& FileBytes);
 	static const FString EndGotoLabel;
 protected:
 	static const FString TreePathSeparator;
 
+	/// Interned table of paths, so that nodes can refer to their place in the choice / conditional hierarchy by ID
+	/// rather than by string. Each path is its parent path plus one segment; "is this path a prefix of that path" then
+	/// becomes an ancestor check, which only costs as much as the nesting depth.
+	struct ParsedPathTable
+	{
+	public:
+		static constexpr int RootId = 0;
+
+		struct Entry
+		{
+			int ParentId;
+			int Depth;
+			FString Segment;
+		};
+		TArray<Entry> Entries;
+		TMap<TPair<int, FString>, int> Lookup;
+
+		ParsedPathTable() { Reset(); }
+
+		void Reset()
+		{
+			Entries.Reset();
+			Lookup.Reset();
+			Entries.Add(Entry { -1, 0, FString() });
+		}
+
+		/// Get the ID of the path formed by adding Segment to ParentId, adding it if not already present
+		int Intern(int ParentId, const FString& Segment);
+		/// Get the parent path ID, or -1 for the root
+		int GetParent(int Id) const { return Entries[Id].ParentId; }
+		/// Whether AncestorId is the same as, or a parent of, Id (equivalent to a string path prefix test)
+		bool IsAncestorOrSelf(int AncestorId, int Id) const;
+		/// Convert back to the "/A/B/" string form, for debugging & tests
+		FString ToString(int Id) const;
+	};
+
 	enum class EConditionalStage : uint8
 	{
 		IfStage,
@@ -201,12 +251,15 @@ protected:
 		EConditionalStage Stage;
 		/// String of current condition 
 		FString ConditionStr;
+		/// Conditional path ID of this block (changes with elseif / else)
+		int PathId = ParsedPathTable::RootId;
 
-		ConditionalContext(int InSelectNodeIdx, int InPrevBlockIdx, EConditionalStage InStage, const FString& InCondStr) :
+		ConditionalContext(int InSelectNodeIdx, int InPrevBlockIdx, EConditionalStage InStage, const FString& InCondStr, int InPathId) :
 			SelectNodeIdx(InSelectNodeIdx),
 			PreviousBlockIdx(InPrevBlockIdx),
 			Stage(InStage),
-			ConditionStr(InCondStr)
+			ConditionStr(InCondStr),
+			PathId(InPathId)
 		{
 		}
 
@@ -232,10 +285,10 @@ protected:
 
 		int LastTextNodeIdx = -1;
 
-		/// The path entry for this indent, to be combined with all previous levels to provide full path context
-		FString PathEntry;
+		/// The choice path ID for this indent, which includes all previous levels to provide full path context
+		int PathId = ParsedPathTable::RootId;
 
-		IndentContext(int NodeIdx, int Indent, const FString& Path) : LastNodeIdx(NodeIdx), ThresholdIndent(Indent), LastTextNodeIdx(-1), PathEntry(Path) {}
+		IndentContext(int NodeIdx, int Indent, int InPathId) : LastNodeIdx(NodeIdx), ThresholdIndent(Indent), LastTextNodeIdx(-1), PathId(InPathId) {}
 
 	};
 
@@ -269,6 +322,10 @@ protected:
 		/// Index of the current conditional block, if any
 		int CurrentConditionalBlockIdx = -1;
 
+		/// Paths referenced by FSUDSParsedNode::ChoicePathId / ConditionalPathId
+		ParsedPathTable ChoicePaths;
+		ParsedPathTable ConditionalPaths;
+
 		void Reset()
 		{
 			IndentLevelStack.Reset();
@@ -279,6 +336,8 @@ protected:
 			AliasedGotoLabels.Reset();
 			ConditionalBlocks.Reset();
 			CurrentConditionalBlockIdx = -1;
+			ChoicePaths.Reset();
+			ConditionalPaths.Reset();
 		}
 	};
 
@@ -305,6 +364,11 @@ protected:
 	TMap<FName, TArray<ParsedMetadata>> PersistentMetadata;
 	/// Metadata applied just to the next speaker line or choice
 	TMap<FName, ParsedMetadata> TransientMetadata;
+	/// The last metadata handed out, re-used while it's unchanged
+	FSUDSParsedMetadataPtr LastTextMetadata;
+
+	/// Storage for the source text & any strings synthesized while parsing, which parsed nodes have views into
+	FSUDSImportStringArena StringArena;
 	
 	/// List of speakers, detected during parsing of lines of text 
 	TArray<FString> ReferencedSpeakers;
@@ -321,6 +385,12 @@ protected:
 	int GosubIDHighestNumber = 0;
 	/// Parse a single line
 	bool ParseLine(const FStringView& Line, int LineNo, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
+	/// Parse a single line which has already been trimmed & had its indent calculated
+	bool ParseLine(const FStringView& Line, const FStringView& TrimmedLine, int IndentLevel, int LineNo, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
+	/// Reset all parse state ready to import
+	void ResetImportState();
+	/// Connect up nodes once all lines have been parsed
+	void FinishParsing(const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
 	bool ParseHeaderLine(const FStringView& Line, int IndentLevel, int LineNo, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
 	bool ParseBodyLine(const FStringView& Line, int IndentLevel, int LineNo, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
 	bool ParseCommentMetadataLine(const FStringView& Line, int IndentLevel, int LineNo, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
@@ -413,38 +483,73 @@ protected:
 	                   const FString& NameForErrors,
 	                   FSUDSMessageLogger* Logger,
 	                   bool bSilent);
-	TMap<FName, FString> GetTextMetadataForNextEntry(int CurrentLineIndent);
+	FSUDSParsedMetadataPtr GetTextMetadataForNextEntry(int CurrentLineIndent);
 	bool IsCommentLine(const FStringView& TrimmedLine);
 	FStringView TrimLine(const FStringView& Line, int& OutIndentLevel) const;
 	int FindChoiceAfterTextNode(const FSUDSScriptImporter::ParsedTree& Tree, int TextNodeIdx);
 	int FindLastChoiceNode(const ParsedTree& Tree, int IndentLevel);
-	int FindLastChoiceNode(const ParsedTree& Tree, int IndentLevel, int FromIndex, const FString& ConditionPath);
+	int FindLastChoiceNode(const ParsedTree& Tree, int IndentLevel, int FromIndex, int ConditionalPathId);
 	void PopIndent(ParsedTree& Tree);
 	void PushIndent(ParsedTree& Tree, int NodeIdx, int Indent, const FString& Path);
-	FString GetCurrentTreePath(const FSUDSScriptImporter::ParsedTree& Tree);
-	FString GetCurrentTreeConditionalPath(const FSUDSScriptImporter::ParsedTree& Tree);
+	int GetCurrentTreePathId(const FSUDSScriptImporter::ParsedTree& Tree);
+	int GetCurrentTreeConditionalPathId(const FSUDSScriptImporter::ParsedTree& Tree);
+	int GetConditionalBlockPathId(FSUDSScriptImporter::ParsedTree& Tree, int PreviousBlockIdx, const FString& ConditionStr);
 	void SetFallthroughForNewNode(FSUDSScriptImporter::ParsedTree& Tree, FSUDSParsedNode& NewNode);
 	int AppendNode(ParsedTree& Tree, const FSUDSParsedNode& InNode);
 	bool SelectNodeIsMissingElsePath(const FSUDSScriptImporter::ParsedTree& Tree, const FSUDSParsedNode& Node);
 	void ConnectRemainingNodes(ParsedTree& Tree, const FString& NameForErrors, FSUDSMessageLogger* Logger, bool bSilent);
-	int FindFallthroughNodeIndex(ParsedTree& Tree, int StartNodeIndex, const FString& FromChoicePath, const FString& FromConditionalPath);
-	void RetrieveAndRemoveOrGenerateTextID(FStringView& InOutLine, FString& OutTextID);
-	bool RetrieveAndRemoveTextID(FStringView& InOutLine, FString& OutTextID);
-	bool RetrieveAndRemoveGosubID(FStringView& InOutLine, FString& OutTextID);
-	FString GenerateTextID(const FStringView& Line);
+	void FindFallthroughNodeIndexes(const ParsedTree& Tree, TArray<int>& OutFallthroughIdx);
+	void RetrieveAndRemoveOrGenerateTextID(FStringView& InOutLine, FStringView& OutTextID);
+	bool RetrieveAndRemoveTextID(FStringView& InOutLine, FStringView& OutTextID);
+	bool RetrieveAndRemoveGosubID(FStringView& InOutLine, FStringView& OutTextID);
+	FStringView GenerateTextID(const FStringView& Line);
+	/// Get a view of a regex capture group, within the line the matcher was run on
+	static FStringView GetCaptureGroupView(const FStringView& Line, FRegexMatcher& Matcher, int32 Group);
 	const FSUDSParsedNode* GetNode(const ParsedTree& Tree, int Index = 0);
 	int GetGotoTargetNodeIndex(const ParsedTree& Tree, const FString& InLabel);
 	void PopulateAssetFromTree(USUDSScript* Asset,
 	                           const ParsedTree& Tree,
 	                           TArray<class USUDSScriptNode*>* pOutNodes,
 	                           TMap<FName, int>* pOutLabels,
+	                           TArray<struct FSUDSScriptImportBlock>& InOutBlocks,
 	                           UStringTable* StringTable);
+	/// Split a tree into label-delimited blocks & hash them; OutNodeBlocks is the block index of each parsed node
+	static void BuildImportBlocks(const ParsedTree& Tree,
+	                              TArray<struct FSUDSScriptImportBlock>& OutBlocks,
+	                              TArray<int>& OutNodeBlocks);
+
+	/// A string table entry gathered from the parsed trees, so the table can be updated in one pass
+	struct PendingStringTableEntry
+	{
+		FString SourceString;
+		/// Value of the "Speaker" metadata, if any
+		FString Speaker;
+		FSUDSParsedMetadataPtr Metadata;
+	};
+	/// All string table entries for the current import, by text ID
+	TMap<FString, PendingStringTableEntry> PendingStrings;
+	void GatherStrings();
+	void CommitStrings(UStringTable* StringTable);
+	static bool IsStringTableEntryUnchanged(const class FStringTable& Table,
+	                                        const FString& Key,
+	                                        const PendingStringTableEntry& Entry);
 
 public:
 	const FSUDSParsedNode* GetNode(int Index = 0);
 	const FSUDSParsedNode* GetHeaderNode(int Index = 0);
+	/// Get the choice path of a body node in string form, e.g. "/C002/C006/" (for debugging & tests)
+	FString GetChoicePath(const FSUDSParsedNode* Node) const;
+	/// Get the conditional path of a body node in string form (for debugging & tests)
+	FString GetConditionalPath(const FSUDSParsedNode* Node) const;
 	/// Resolve a goto label to a target index (after import), or -1 if not resolvable
 	int GetGotoTargetNodeIndex(const FString& Label);
+	int GetGotoTargetNodeIndex(const FStringView& Label) { return GetGotoTargetNodeIndex(FString(Label)); }
 	static bool RetrieveTextIDFromLine(FStringView& InOutLine, FString& OutTextID, int& OutNumber);
+	static bool RetrieveTextIDFromLine(FStringView& InOutLine, FStringView& OutTextID, int& OutNumber);
 	static bool RetrieveGosubIDFromLine(FStringView& InOutLine, FString& OutID, int& OutNumber);
+	static bool RetrieveGosubIDFromLine(FStringView& InOutLine, FStringView& OutID, int& OutNumber);
+	/// Approximate memory held by the parse trees, including the string arena
+	SIZE_T GetAllocatedSize() const;
+	/// Storage behind all the string views in the parse trees
+	const FSUDSImportStringArena& GetStringArena() const { return StringArena; }
 };
@@ -0,0 +1,42 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+
+class USUDSScript;
+class USUDSScriptNode;
+
+/**
+ * Optional passes over a script's runtime graph, run after FSUDSScriptImporter has created the nodes and before
+ * USUDSScript::FinishImport. Dialogue behaves exactly the same, there are just fewer nodes to walk at runtime:
+ *  - Jump threading: edges into selects whose first path is unconditional go straight to that path's target
+ *  - Set merging: runs of set nodes become one node with several assignments, each keeping its own line number
+ *  - Dead node elimination: nodes which can't be reached from the start, a label or the header are removed
+ *  - Gosub resolution: gosubs reference their target node directly instead of looking up the label every call
+ */
+class SUDSEDITOR_API FSUDSScriptOptimiser
+{
+public:
+	struct FStats
+	{
+		int NodesBefore = 0;
+		int NodesAfter = 0;
+		int EdgesThreaded = 0;
+		int SetNodesMerged = 0;
+		int DeadNodesRemoved = 0;
+		int GosubsResolved = 0;
+	};
+
+	/// Optimise body & header nodes in place; label indexes are updated to match
+	static FStats Optimise(USUDSScript* Script,
+	                       TArray<USUDSScriptNode*>& Nodes,
+	                       TMap<FName, int>& Labels,
+	                       TArray<USUDSScriptNode*>& HeaderNodes,
+	                       TMap<FName, int>& HeaderLabels);
+
+protected:
+	static bool IsPassThroughSelect(const USUDSScriptNode* Node);
+	static void ThreadJumps(const TArray<USUDSScriptNode*>& Nodes, FStats& Stats);
+	static void MergeSetNodes(const TArray<USUDSScriptNode*>& Nodes, const TMap<FName, int>& Labels, FStats& Stats);
+	static void RemoveDeadNodes(TArray<USUDSScriptNode*>& Nodes, TMap<FName, int>& Labels, FStats& Stats);
+	static void ResolveGosubs(const USUDSScript* Script, const TArray<USUDSScriptNode*>& Nodes, FStats& Stats);
+};
@@ -2,6 +2,8 @@
 #include "SUDSMessageLogger.h"
 #include "SUDSScript.h"
 #include "SUDSScriptImporter.h"
+#include "SUDSScriptNodeText.h"
+#include "TestEventSub.h"
 #include "TestUtils.h"
 
 PRAGMA_DISABLE_OPTIMIZATION
@@ -871,4 +873,291 @@ bool FTestMultipleOptionalChoicesWithLinesBetweenTextAndChoice::RunTest(const FS
 }
 
 
+const FString HypotheticalChoicesInput = R"RAWSUD(
+===
+[set Extra 0]
+===
+NPC: Hello
+[set Bonus 1]
+[event SomeEvent]
+    * Choice 1?
+        Player: Choice 1
+    [if {Opt2}]
+    * Optional Choice 2?
+        Player: Choice 2
+    [endif]
+    [if {Bonus} + {Extra} > 2]
+    * Rich Choice
+        Player: Rich
+    [endif]
+    * Back
+        Player: going back
+NPC: Fallthrough
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestHypotheticalChoices,
+                                 "SUDSTest.TestHypotheticalChoices",
+                                 EAutomationTestFlags::EditorContext |
+                                 EAutomationTestFlags::ClientContext |
+                                 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestHypotheticalChoices::RunTest(const FString& Parameters)
+{
+    FSUDSMessageLogger Logger(false);
+    FSUDSScriptImporter Importer;
+    TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(HypotheticalChoicesInput), HypotheticalChoicesInput.Len(), "HypotheticalChoicesInput", &Logger, true));
+
+    auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+    const ScopedStringTableHolder StringTableHolder;
+    Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+    auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+    UTestEventSub* EvtSub = NewObject<UTestEventSub>();
+    EvtSub->Init(Dlg);
+    Dlg->Start();
+
+    TestDialogueText(this, "Text node", Dlg, "NPC", "Hello");
+    TestEqual("Number of choices", Dlg->GetNumberOfChoices(), 2);
+    const int NumEvents = EvtSub->EventRecords.Num();
+    const int NumVarChanges = EvtSub->SetVarRecords.Num();
+
+    TMap<FName, FSUDSValue> Overrides;
+    TArray<FSUDSScriptEdge> Choices = Dlg->GetHypotheticalChoices(Overrides);
+    TestEqual("No overrides should match real choices", Choices.Num(), 2);
+
+    Overrides.Add("Opt2", FSUDSValue(true));
+    Choices = Dlg->GetHypotheticalChoices(Overrides);
+    if (TestEqual("Opt2 hypothetical choices", Choices.Num(), 3))
+    {
+        TestEqual("Choice text 0", Choices[0].GetText().ToString(), "Choice 1?");
+        TestEqual("Choice text 1", Choices[1].GetText().ToString(), "Optional Choice 2?");
+        TestEqual("Choice text 2", Choices[2].GetText().ToString(), "Back");
+    }
+
+    // Set node between text & choices has already run for real, so overrides apply on top of it
+    Overrides.Reset();
+    Overrides.Add("Bonus", 10);
+    Overrides.Add("Extra", 2);
+    TArray<const FSUDSScriptEdge*> ChoicePtrs;
+    if (TestEqual("Rich hypothetical choices", Dlg->FindHypotheticalChoices(Overrides, ChoicePtrs), 3))
+    {
+        TestEqual("Choice text 1", ChoicePtrs[1]->GetText().ToString(), "Rich Choice");
+    }
+
+    FSUDSExpression Expr;
+    TestTrue("Parse expression", Expr.ParseFromString("{Bonus} + {Extra}", nullptr));
+    TestEqual("Hypothetical expression", Dlg->EvaluateHypothetical(Expr, Overrides).GetIntValue(), 12);
+    TestEqual("Real expression", Expr.Evaluate(Dlg->GetVariables()).GetIntValue(), 1);
+
+    // Nothing should have changed in the real dialogue
+    TestEqual("Real number of choices", Dlg->GetNumberOfChoices(), 2);
+    TestFalse("Opt2 not set", Dlg->IsVariableSet("Opt2"));
+    TestEqual("Bonus unchanged", Dlg->GetVariableInt("Bonus"), 1);
+    TestEqual("Extra unchanged", Dlg->GetVariableInt("Extra"), 0);
+    TestEqual("No events raised", EvtSub->EventRecords.Num(), NumEvents);
+    TestEqual("No variable changes raised", EvtSub->SetVarRecords.Num(), NumVarChanges);
+    TestDialogueText(this, "Still on text node", Dlg, "NPC", "Hello");
+
+    Script->MarkAsGarbage();
+    return true;
+}
+
+const FString HypotheticalIncrementInput = R"RAWSUD(
+===
+[set Counter 0]
+===
+NPC: Counting
+[set Counter {Counter} + 1]
+    * Always
+        Player: Always
+    [if {Counter} == 1]
+    * Only the first time
+        Player: First
+    [endif]
+NPC: Done
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestHypotheticalChoicesAfterIncrement,
+                                 "SUDSTest.TestHypotheticalChoicesAfterIncrement",
+                                 EAutomationTestFlags::EditorContext |
+                                 EAutomationTestFlags::ClientContext |
+                                 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestHypotheticalChoicesAfterIncrement::RunTest(const FString& Parameters)
+{
+    FSUDSMessageLogger Logger(false);
+    FSUDSScriptImporter Importer;
+    TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(HypotheticalIncrementInput), HypotheticalIncrementInput.Len(), "HypotheticalIncrementInput", &Logger, true));
+
+    auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+    const ScopedStringTableHolder StringTableHolder;
+    Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+    auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+    Dlg->Start();
+
+    TestDialogueText(this, "Text node", Dlg, "NPC", "Counting");
+    TestEqual("Counter incremented once", Dlg->GetVariableInt("Counter"), 1);
+    TestEqual("Real number of choices", Dlg->GetNumberOfChoices(), 2);
+
+    // The increment has already run, it mustn't be applied again hypothetically
+    TMap<FName, FSUDSValue> Overrides;
+    TArray<FSUDSScriptEdge> Choices = Dlg->GetHypotheticalChoices(Overrides);
+    if (TestEqual("No overrides should match real choices", Choices.Num(), 2))
+    {
+        TestEqual("Choice text 0", Choices[0].GetText().ToString(), "Always");
+        TestEqual("Choice text 1", Choices[1].GetText().ToString(), "Only the first time");
+    }
+    Overrides.Add("Counter", 5);
+    Choices = Dlg->GetHypotheticalChoices(Overrides);
+    TestEqual("Overridden counter hides choice", Choices.Num(), 1);
+    TestEqual("Counter unchanged", Dlg->GetVariableInt("Counter"), 1);
+
+    Script->MarkAsGarbage();
+    return true;
+}
+
+
+const FString ChoicePlanInput = R"RAWSUD(
+NPC: Hello
+[set Asked true]
+[event Asking]
+    * Plain choice
+        NPC: Plain
+[if {y} == 1]
+    * Conditional choice
+        NPC: Conditional
+    [if {q} == 10]
+        * Nested choice
+            NPC: Nested
+            NPC: Nested again
+    [endif]
+[else]
+    * Else choice
+        NPC: Else
+[endif]
+[gosub Sub]
+NPC: After sub
+    * Choice after sub
+[goto end]
+:Sub
+NPC: In sub
+[return]
+)RAWSUD";
+
+static const USUDSScriptNodeText* FindTextNode(const USUDSScript* Script, const FString& Text)
+{
+    for (const auto Node : Script->GetNodes())
+    {
+        if (const auto TextNode = Cast<USUDSScriptNodeText>(Node))
+        {
+            if (TextNode->GetText().ToString() == Text)
+            {
+                return TextNode;
+            }
+        }
+    }
+    return nullptr;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestChoicePlans,
+                                 "SUDSTest.TestChoicePlans",
+                                 EAutomationTestFlags::EditorContext |
+                                 EAutomationTestFlags::ClientContext |
+                                 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestChoicePlans::RunTest(const FString& Parameters)
+{
+    FSUDSMessageLogger Logger(false);
+    FSUDSScriptImporter Importer;
+    TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(ChoicePlanInput), ChoicePlanInput.Len(), "ChoicePlanInput", &Logger, true));
+
+    auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+    const ScopedStringTableHolder StringTableHolder;
+    Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+    // Choices after the first line are flattened, with the set & event before them
+    const auto HelloNode = FindTextNode(Script, "Hello");
+    if (TestNotNull("Hello node", HelloNode))
+    {
+        const FSUDSChoicePlan& Plan = HelloNode->GetChoicePlan();
+        TestTrue("Hello plan valid", Plan.bIsValid);
+        TestNotNull("Hello root choice", Plan.RootChoiceNode);
+        TestEqual("Hello prelude", Plan.PreludeNodes.Num(), 2);
+        TestEqual("Hello conditions", Plan.Conditions.Num(), 3);
+        if (TestEqual("Hello choices", Plan.Choices.Num(), 4))
+        {
+            // Plain, conditional (y == 1), nested (y == 1 and q == 10), else (not y == 1, else)
+            TestEqual("Plain guards", Plan.Choices[0].NumGuards, 0);
+            TestEqual("Conditional guards", Plan.Choices[1].NumGuards, 1);
+            TestEqual("Nested guards", Plan.Choices[2].NumGuards, 2);
+            if (TestEqual("Else guards", Plan.Choices[3].NumGuards, 2))
+            {
+                TestFalse("Else needs if to fail", Plan.Guards[Plan.Choices[3].FirstGuard].bExpected);
+                TestTrue("Else needs else", Plan.Guards[Plan.Choices[3].FirstGuard + 1].bExpected);
+            }
+        }
+    }
+    const auto InSubNode = FindTextNode(Script, "In sub");
+    if (TestNotNull("In sub node", InSubNode))
+    {
+        // Return depends on the call site
+        TestFalse("In sub plan invalid", InSubNode->GetChoicePlan().bIsValid);
+    }
+    // Lines which lead into nothing but another line have an empty plan
+    const auto NestedNode = FindTextNode(Script, "Nested");
+    if (TestNotNull("Nested node", NestedNode))
+    {
+        TestTrue("Nested plan valid", NestedNode->GetChoicePlan().bIsValid);
+        TestNull("Nested plan has no choices", NestedNode->GetChoicePlan().RootChoiceNode);
+    }
+    const auto AfterSubNode = FindTextNode(Script, "After sub");
+    if (TestNotNull("After sub node", AfterSubNode))
+    {
+        TestTrue("After sub plan valid", AfterSubNode->GetChoicePlan().bIsValid);
+        TestEqual("After sub choices", AfterSubNode->GetChoicePlan().Choices.Num(), 1);
+    }
+
+    // Running uses the plans, should get the same results as walking the graph
+    auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+    Dlg->SetVariableInt("y", 1);
+    Dlg->SetVariableInt("q", 10);
+    Dlg->Start();
+    TestDialogueText(this, "Text node", Dlg, "NPC", "Hello");
+    TestTrue("Prelude run", Dlg->GetVariableBoolean("Asked"));
+    if (TestEqual("Number of choices", Dlg->GetNumberOfChoices(), 3))
+    {
+        TestEqual("Choice text 0", Dlg->GetChoiceText(0).ToString(), "Plain choice");
+        TestEqual("Choice text 1", Dlg->GetChoiceText(1).ToString(), "Conditional choice");
+        TestEqual("Choice text 2", Dlg->GetChoiceText(2).ToString(), "Nested choice");
+    }
+    Dlg->SetVariableInt("q", 0);
+    Dlg->Restart(false);
+    if (TestEqual("Number of choices", Dlg->GetNumberOfChoices(), 2))
+    {
+        TestEqual("Choice text 0", Dlg->GetChoiceText(0).ToString(), "Plain choice");
+        TestEqual("Choice text 1", Dlg->GetChoiceText(1).ToString(), "Conditional choice");
+    }
+    Dlg->SetVariableInt("y", 0);
+    Dlg->Restart(false);
+    if (TestEqual("Number of choices", Dlg->GetNumberOfChoices(), 2))
+    {
+        TestEqual("Choice text 0", Dlg->GetChoiceText(0).ToString(), "Plain choice");
+        TestEqual("Choice text 1", Dlg->GetChoiceText(1).ToString(), "Else choice");
+    }
+    TestTrue("Choose", Dlg->Choose(1));
+    TestDialogueText(this, "Else node", Dlg, "NPC", "Else");
+    TestTrue("Continue", Dlg->Continue());
+    TestDialogueText(this, "Sub node", Dlg, "NPC", "In sub");
+    TestTrue("Continue", Dlg->Continue());
+    TestDialogueText(this, "After sub node", Dlg, "NPC", "After sub");
+    TestEqual("Number of choices", Dlg->GetNumberOfChoices(), 1);
+
+    Script->MarkAsGarbage();
+    return true;
+}
+
 PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
@@ -1,6 +1,7 @@
 ﻿#include "TestEventSub.h"
 
 #include "SUDSDialogue.h"
+#include "SUDSSubsystem.h"
 
 void UTestEventSub::Init(USUDSDialogue* Dlg)
 {
@@ -9,6 +10,16 @@ void UTestEventSub::Init(USUDSDialogue* Dlg)
 
 }
 
+void UTestEventSub::InitSpeakerLine(USUDSDialogue* Dlg)
+{
+	Dlg->OnSpeakerLine.AddDynamic(this, &UTestEventSub::OnSpeakerLine);
+}
+
+void UTestEventSub::InitGlobalVariables(USUDSSubsystem* Sub)
+{
+	Sub->OnGlobalVariableChanged.AddDynamic(this, &UTestEventSub::OnGlobalVariableChanged);
+}
+
 void UTestEventSub::OnEvent(USUDSDialogue* Dlg, FName EventName, const TArray<FSUDSValue>& Args)
 {
 	EventRecords.Add(FEventRecord { EventName, Args });
@@ -18,3 +29,13 @@ void UTestEventSub::OnVariableChanged(USUDSDialogue* Dlg, FName VarName, const F
 {
 	SetVarRecords.Add(FSetVarRecord { VarName, Value, bFromScript });
 }
+
+void UTestEventSub::OnSpeakerLine(USUDSDialogue* Dlg)
+{
+	++SpeakerLineCount;
+}
+
+void UTestEventSub::OnGlobalVariableChanged(FName VarName, const FSUDSValue& Value, bool bFromScript)
+{
+	SetVarRecords.Add(FSetVarRecord { VarName, Value, bFromScript });
+}
@@ -6,6 +6,7 @@
 #include "TestEventSub.generated.h"
 
 class USUDSDialogue;
+class USUDSSubsystem;
 UCLASS()
 class SUDSTEST_API UTestEventSub : public UObject
 {
@@ -13,6 +14,8 @@ class SUDSTEST_API UTestEventSub : public UObject
 
 public:
 	void Init(USUDSDialogue* Dlg);
+	void InitSpeakerLine(USUDSDialogue* Dlg);
+	void InitGlobalVariables(USUDSSubsystem* Sub);
 
 	struct FEventRecord
 	{
@@ -28,6 +31,7 @@ public:
 
 	TArray<FEventRecord> EventRecords;
 	TArray<FSetVarRecord> SetVarRecords;
+	int SpeakerLineCount = 0;
 
 	UFUNCTION()
 	void OnEvent(USUDSDialogue* Dlg, FName EventName, const TArray<FSUDSValue>& Args);
@@ -35,5 +39,11 @@ public:
 	UFUNCTION()
 	void OnVariableChanged(USUDSDialogue* Dlg, FName VarName, const FSUDSValue& Value, bool bFromScript);
 
+	UFUNCTION()
+	void OnSpeakerLine(USUDSDialogue* Dlg);
+
+	UFUNCTION()
+	void OnGlobalVariableChanged(FName VarName, const FSUDSValue& Value, bool bFromScript);
+
 	
 };
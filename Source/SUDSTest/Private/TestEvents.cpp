@@ -3,6 +3,7 @@
 #include "SUDSMessageLogger.h"
 #include "SUDSScript.h"
 #include "SUDSScriptImporter.h"
+#include "SUDSScriptNodeEvent.h"
 #include "TestEventSub.h"
 #include "TestParticipant.h"
 #include "TestUtils.h"
@@ -259,4 +260,241 @@ bool FTestEvents::RunTest(const FString& Parameters)
 	return true;
 }
 
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestDeferredEvents,
+								 "SUDSTest.TestDeferredEvents",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestDeferredEvents::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(EventParsingInput), EventParsingInput.Len(), "EventParsingInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	auto EvtSub = NewObject<UTestEventSub>();
+	EvtSub->Init(Dlg);
+
+	Dlg->SetEventDispatchMode(ESUDSEventDispatchMode::DeferredManual);
+	Dlg->Start();
+	TestDialogueText(this, "Line 1", Dlg, "Player", "Ow do?");
+	TestTrue("Continue", Dlg->Continue());
+	TestDialogueText(this, "Line 2", Dlg, "NPC", "Alreet chook");
+
+	// Nothing delivered yet
+	TestEqual("No events yet", EvtSub->EventRecords.Num(), 0);
+	TestEqual("No var changes yet", EvtSub->SetVarRecords.Num(), 0);
+	TestTrue("Should have queued events", Dlg->GetNumQueuedEvents() > 0);
+
+	Dlg->FlushQueuedEvents();
+	TestEqual("Queue should be empty", Dlg->GetNumQueuedEvents(), 0);
+	if (TestEqual("Event should have been delivered", EvtSub->EventRecords.Num(), 1))
+	{
+		TestEqual("Event name", EvtSub->EventRecords[0].Name.ToString(), "SummatHappened");
+		if (TestEqual("Event arg count", EvtSub->EventRecords[0].Args.Num(), 6))
+		{
+			TestEqual("Event arg 3 value", EvtSub->EventRecords[0].Args[3].GetIntValue(), 2);
+			TestEqual("Event arg 4 value", EvtSub->EventRecords[0].Args[4].GetIntValue(), 42);
+		}
+	}
+	if (TestEqual("Var changes should have been delivered in order", EvtSub->SetVarRecords.Num(), 3))
+	{
+		TestEqual("Var 0", EvtSub->SetVarRecords[0].Name.ToString(), "IntVar");
+		TestEqual("Var 1", EvtSub->SetVarRecords[1].Name.ToString(), "FloatVar");
+		TestEqual("Var 2", EvtSub->SetVarRecords[2].Name.ToString(), "StringVar");
+		TestTrue("Var 2 from script", EvtSub->SetVarRecords[2].bFromScript);
+	}
+
+	// Auto flush delivers at the end of the call
+	Dlg->SetEventDispatchMode(ESUDSEventDispatchMode::DeferredAutoFlush);
+	TestTrue("Continue", Dlg->Continue());
+	TestEqual("Queue should be empty", Dlg->GetNumQueuedEvents(), 0);
+	if (TestEqual("Events should have been delivered", EvtSub->EventRecords.Num(), 3))
+	{
+		TestEqual("Event name", EvtSub->EventRecords[1].Name.ToString(), "WellBlowMeDown");
+		TestEqual("Event name", EvtSub->EventRecords[2].Name.ToString(), "Calculated");
+		TestEqual("Event arg 0 value", EvtSub->EventRecords[2].Args[0].GetFloatValue(), 76.67f);
+	}
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString EventThroughputInput = R"RAWSUD(
+:start
+NPC: Action
+[event CameraCut "Wide", 1.5, true]
+[event PlayAnim {Speed}, "Wave"]
+NPC: Cut
+[goto start]
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestEventThroughput,
+								 "SUDSTest.TestEventThroughput",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestEventThroughput::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(EventThroughputInput), EventThroughputInput.Len(), "EventThroughputInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	// Literal-only args should have been pre-built
+	for (auto Node : Script->GetNodes())
+	{
+		if (auto EvtNode = Cast<USUDSScriptNodeEvent>(Node))
+		{
+			if (EvtNode->GetEventName() == "CameraCut")
+			{
+				TestTrue("CameraCut args are literal", EvtNode->AreArgsAllLiteral());
+				TestEqual("CameraCut literal args", EvtNode->GetLiteralArgs().Num(), 3);
+			}
+			else
+			{
+				TestFalse("PlayAnim args are not literal", EvtNode->AreArgsAllLiteral());
+			}
+		}
+	}
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	auto EvtSub = NewObject<UTestEventSub>();
+	EvtSub->Init(Dlg);
+	Dlg->SetVariableFloat("Speed", 2.f);
+	Dlg->Start();
+	TestTrue("Continue", Dlg->Continue());
+	if (TestEqual("Events", EvtSub->EventRecords.Num(), 2))
+	{
+		TestEqual("Literal arg", EvtSub->EventRecords[0].Args[0].GetTextValue().ToString(), "Wide");
+		TestEqual("Literal arg", EvtSub->EventRecords[0].Args[1].GetFloatValue(), 1.5f);
+		TestEqual("Evaluated arg", EvtSub->EventRecords[1].Args[0].GetFloatValue(), 2.f);
+	}
+
+	// Throughput, without the subscriber recording everything
+	auto Dlg2 = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg2->SetVariableFloat("Speed", 2.f);
+	Dlg2->Start();
+	const int NumLoops = 10000;
+	const double StartTime = FPlatformTime::Seconds();
+	for (int i = 0; i < NumLoops; ++i)
+	{
+		Dlg2->Continue();
+		Dlg2->Continue();
+	}
+	const double Elapsed = FPlatformTime::Seconds() - StartTime;
+	const int NumEvents = NumLoops * 2;
+	AddInfo(FString::Printf(TEXT("Event throughput: %d events in %.2fms, %.0f events/sec"),
+	                        NumEvents,
+	                        Elapsed * 1000.0,
+	                        Elapsed > 0 ? NumEvents / Elapsed : 0.0));
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestNativeEvents,
+								 "SUDSTest.TestNativeEvents",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestNativeEvents::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(EventThroughputInput), EventThroughputInput.Len(), "EventThroughputInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	// Native and dynamic listeners should see the same things
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	auto EvtSub = NewObject<UTestEventSub>();
+	EvtSub->Init(Dlg);
+	EvtSub->InitSpeakerLine(Dlg);
+	int NativeSpeakerLines = 0;
+	TArray<FName> NativeEventNames;
+	TArray<FSUDSValue> NativeEventArgs;
+	bool bNativeStarting = false;
+	Dlg->OnSpeakerLineNative.AddLambda([&NativeSpeakerLines](USUDSDialogue*)
+	{
+		++NativeSpeakerLines;
+	});
+	Dlg->OnEventNative.AddLambda([&](USUDSDialogue*, FName EventName, TArrayView<const FSUDSValue> Args)
+	{
+		NativeEventNames.Add(EventName);
+		NativeEventArgs.Append(Args.GetData(), Args.Num());
+	});
+	Dlg->OnStartingNative.AddLambda([&bNativeStarting](USUDSDialogue*, FName)
+	{
+		bNativeStarting = true;
+	});
+	Dlg->SetVariableFloat("Speed", 2.f);
+	Dlg->Start();
+	TestTrue("Native starting", bNativeStarting);
+	TestTrue("Continue", Dlg->Continue());
+	TestEqual("Native speaker lines", NativeSpeakerLines, EvtSub->SpeakerLineCount);
+	TestEqual("Native speaker lines", NativeSpeakerLines, 2);
+	if (TestEqual("Native events", NativeEventNames.Num(), EvtSub->EventRecords.Num()))
+	{
+		TestEqual("Native event name", NativeEventNames[0], FName("CameraCut"));
+		TestEqual("Native event name", NativeEventNames[1], FName("PlayAnim"));
+	}
+	if (TestEqual("Native event args", NativeEventArgs.Num(), 5))
+	{
+		TestEqual("Native literal arg", NativeEventArgs[1].GetFloatValue(), 1.5f);
+		TestEqual("Native evaluated arg", NativeEventArgs[3].GetFloatValue(), 2.f);
+	}
+
+	// Per-line overhead, dynamic vs native
+	const int NumLines = 10000;
+	auto DynDlg = USUDSLibrary::CreateDialogue(Script, Script);
+	auto DynSub = NewObject<UTestEventSub>();
+	DynSub->InitSpeakerLine(DynDlg);
+	DynDlg->Start();
+	double StartTime = FPlatformTime::Seconds();
+	for (int i = 0; i < NumLines; ++i)
+	{
+		DynDlg->Continue();
+	}
+	const double DynamicTime = FPlatformTime::Seconds() - StartTime;
+
+	auto NativeDlg = USUDSLibrary::CreateDialogue(Script, Script);
+	int NativeCount = 0;
+	NativeDlg->OnSpeakerLineNative.AddLambda([&NativeCount](USUDSDialogue*)
+	{
+		++NativeCount;
+	});
+	NativeDlg->Start();
+	StartTime = FPlatformTime::Seconds();
+	for (int i = 0; i < NumLines; ++i)
+	{
+		NativeDlg->Continue();
+	}
+	const double NativeTime = FPlatformTime::Seconds() - StartTime;
+
+	TestEqual("Same number of lines", NativeCount, DynSub->SpeakerLineCount);
+	AddInfo(FString::Printf(TEXT("Per-line cost over %d lines: dynamic %.3fus, native %.3fus"),
+	                        NumLines,
+	                        DynamicTime * 1000000.0 / NumLines,
+	                        NativeTime * 1000000.0 / NumLines));
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
 PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
@@ -413,5 +413,64 @@ bool FTestGosubBetweenSpeakerAndChoice2::RunTest(const FString& Parameters)
 	return true;
 }
 
+const FString RecursiveGosubBeforeChoiceInput = R"RAWSUD(
+[set Recurse false]
+Player: Hello there
+[gosub Outer]
+* Option A
+    Player: Picked A
+* Option B
+[goto end]
+
+:Outer
+[if {Recurse}]
+    [gosub Inner]
+[endif]
+[return]
+
+:Inner
+[if {Recurse}]
+    [goto Inner]
+[endif]
+[gosub Outer]
+[return]
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestRecursiveGosubBeforeChoice,
+								 "SUDSTest.TestRecursiveGosubBeforeChoice",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestRecursiveGosubBeforeChoice::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(RecursiveGosubBeforeChoiceInput), RecursiveGosubBeforeChoiceInput.Len(), "RecursiveGosubBeforeChoiceInput", &Logger, true));
+
+	// Looking ahead for choices at import has to cope with the gosubs calling each other and the goto loop
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg->Start();
+
+	TestDialogueText(this, "Start node", Dlg, "Player", "Hello there");
+	if (TestEqual("Choice Count", Dlg->GetNumberOfChoices(), 2))
+	{
+		TestEqual("Choice 1", Dlg->GetChoiceText(0).ToString(), "Option A");
+		TestEqual("Choice 2", Dlg->GetChoiceText(1).ToString(), "Option B");
+	}
+	TestTrue("Choose", Dlg->Choose(0));
+	TestDialogueText(this, "Choice node", Dlg, "Player", "Picked A");
+	TestTrue("Plain continue", Dlg->IsSimpleContinue());
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
 
 PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
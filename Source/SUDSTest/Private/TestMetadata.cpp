@@ -130,4 +130,63 @@ bool FTestMetadata::RunTest(const FString& Parameters)
 	
 }
 
+const FString MetadataReimportInput = R"RAWSUD(
+#= Translator note
+Player: Hello there @001@
+NPC: Unchanged @002@
+	* A choice @003@
+		NPC: Bye @004@
+)RAWSUD";
+
+const FString MetadataReimportEditedInput = R"RAWSUD(
+Vendor: Hello there @001@
+NPC: Unchanged @002@
+	#= Choice note
+	* A choice @003@
+		NPC: Bye @004@
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestMetadataReimport,
+								 "SUDSTest.TestMetadataReimport",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestMetadataReimport::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	auto StrTable = StringTableHolder.StringTable->GetMutableStringTable();
+
+	{
+		FSUDSScriptImporter Importer;
+		TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(MetadataReimportInput), MetadataReimportInput.Len(), "MetadataReimportInput", &Logger, true));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	}
+	TestEqual("Line 1 Comment", StrTable->GetMetaData(FTextKey("@001@"), FName("Comment")), "Translator note");
+	TestEqual("Line 1 Speaker", StrTable->GetMetaData(FTextKey("@001@"), FName("Speaker")), "Player");
+	TestEqual("Choice Comment", StrTable->GetMetaData(FTextKey("@003@"), FName("Comment")), "");
+
+	// Reimporting into the same table has to pick up metadata changes (including removals) on existing keys
+	{
+		FSUDSScriptImporter Importer;
+		TestTrue("Reimport should succeed", Importer.ImportFromBuffer(GetData(MetadataReimportEditedInput), MetadataReimportEditedInput.Len(), "MetadataReimportEditedInput", &Logger, true));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	}
+	TestEqual("Line 1 Comment removed", StrTable->GetMetaData(FTextKey("@001@"), FName("Comment")), "");
+	TestEqual("Line 1 Speaker changed", StrTable->GetMetaData(FTextKey("@001@"), FName("Speaker")), "Vendor");
+	TestEqual("Line 2 Speaker", StrTable->GetMetaData(FTextKey("@002@"), FName("Speaker")), "NPC");
+	TestEqual("Choice Comment added", StrTable->GetMetaData(FTextKey("@003@"), FName("Comment")), "Choice note");
+	TestEqual("Choice Speaker", StrTable->GetMetaData(FTextKey("@003@"), FName("Speaker")), "Player (Choice)");
+	FString Source;
+	TestTrue("Line 4 still present", StrTable->GetSourceString(FTextKey("@004@"), Source));
+	TestEqual("Line 4 source", Source, "Bye");
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
 PRAGMA_ENABLE_OPTIMIZATION
@@ -0,0 +1,241 @@
+﻿#include "SUDSLibrary.h"
+#include "SUDSMessageLogger.h"
+#include "SUDSScript.h"
+#include "SUDSScriptImporter.h"
+#include "SUDSScriptNodeGosub.h"
+#include "SUDSScriptNodeSet.h"
+#include "TestScriptGenerator.h"
+#include "TestUtils.h"
+#include "Misc/AutomationTest.h"
+
+const FString OptimiserInput = R"RAWSUD(
+===
+[set HeaderA 1]
+[set HeaderB 2]
+===
+NPC: Hello
+[set a 1]
+[set b 2]
+[set c {a} + {b}]
+[if true]
+	NPC: Always here
+[endif]
+[gosub sub]
+NPC: Back again
+	* Choice one
+		[set d 4]
+		[set e 5]
+		NPC: One
+	* Choice two
+		NPC: Two
+[goto end]
+:sub
+NPC: In sub
+[return]
+)RAWSUD";
+
+const FString OptimiserThreadedSetInput = R"RAWSUD(
+NPC: Hello
+[set a 1]
+[if true]
+	[set b 2]
+[endif]
+NPC: Done
+)RAWSUD";
+
+static int CountNodesOfType(const TArray<USUDSScriptNode*>& Nodes, ESUDSScriptNodeType Type)
+{
+	int Count = 0;
+	for (const auto Node : Nodes)
+	{
+		Count += Node->GetNodeType() == Type ? 1 : 0;
+	}
+	return Count;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestOptimiser,
+								 "SUDSTest.TestOptimiser",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestOptimiser::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(OptimiserInput), OptimiserInput.Len(), "OptimiserInput", &Logger, true));
+
+	const ScopedStringTableHolder StringTableHolder;
+	auto Plain = NewObject<USUDSScript>(GetTransientPackage(), "Plain");
+	Importer.PopulateAsset(Plain, StringTableHolder.StringTable);
+	auto Optimised = NewObject<USUDSScript>(GetTransientPackage(), "Optimised");
+	Importer.PopulateAsset(Optimised, StringTableHolder.StringTable, true);
+
+	AddInfo(FString::Printf(TEXT("Nodes: %d -> %d, header nodes: %d -> %d"),
+	                        Plain->GetNodes().Num(), Optimised->GetNodes().Num(),
+	                        Plain->GetHeaderNodes().Num(), Optimised->GetHeaderNodes().Num()));
+	TestTrue("Fewer nodes", Optimised->GetNodes().Num() < Plain->GetNodes().Num());
+	TestTrue("Header sets merged", Optimised->GetHeaderNodes().Num() < Plain->GetHeaderNodes().Num());
+	TestEqual("Pass-through select removed", CountNodesOfType(Optimised->GetNodes(), ESUDSScriptNodeType::Select), 0);
+	TestEqual("Set runs merged", CountNodesOfType(Optimised->GetNodes(), ESUDSScriptNodeType::SetVariable), 2);
+	TestEqual("Text nodes kept",
+	          CountNodesOfType(Optimised->GetNodes(), ESUDSScriptNodeType::Text),
+	          CountNodesOfType(Plain->GetNodes(), ESUDSScriptNodeType::Text));
+
+	// Merged assignments keep their own lines
+	auto SetNode = Cast<USUDSScriptNodeSet>(Optimised->GetNextNode(Optimised->GetFirstNode()));
+	if (TestNotNull("Set node after first line", SetNode))
+	{
+		TestEqual("First assignment", SetNode->GetIdentifier(), FName("a"));
+		if (TestEqual("Merged assignments", SetNode->GetMergedAssignments().Num(), 2))
+		{
+			TestEqual("Merged 1", SetNode->GetMergedAssignments()[0].Identifier, FName("b"));
+			TestEqual("Merged 1 line", SetNode->GetMergedAssignments()[0].SourceLineNo, SetNode->GetSourceLineNo() + 1);
+			TestEqual("Merged 2", SetNode->GetMergedAssignments()[1].Identifier, FName("c"));
+			TestEqual("Merged 2 line", SetNode->GetMergedAssignments()[1].SourceLineNo, SetNode->GetSourceLineNo() + 2);
+		}
+	}
+
+	// Gosubs point straight at their label
+	for (const auto Node : Optimised->GetNodes())
+	{
+		if (const auto GosubNode = Cast<USUDSScriptNodeGosub>(Node))
+		{
+			TestTrue("Gosub resolved", GosubNode->GetTargetNode() == Optimised->GetNodeByLabel("sub"));
+		}
+	}
+
+	// Same behaviour either way: run both versions through the same steps & compare the state they end up in
+	for (int Choice = 0; Choice < 2; ++Choice)
+	{
+		auto PlainDlg = USUDSLibrary::CreateDialogue(Plain, Plain);
+		auto OptDlg = USUDSLibrary::CreateDialogue(Optimised, Optimised);
+		for (auto Dlg : { PlainDlg, OptDlg })
+		{
+			const FString Prefix = Dlg == OptDlg ? TEXT("Optimised ") : TEXT("Plain ");
+			Dlg->Start();
+			TestEqual(Prefix + "Header A", Dlg->GetVariable("HeaderA").GetIntValue(), 1);
+			TestEqual(Prefix + "Header B", Dlg->GetVariable("HeaderB").GetIntValue(), 2);
+			TestDialogueText(this, Prefix + "Line 1", Dlg, "NPC", "Hello");
+			TestTrue(Prefix + "Continue", Dlg->Continue());
+			TestDialogueText(this, Prefix + "Line 2", Dlg, "NPC", "Always here");
+			TestEqual(Prefix + "c", Dlg->GetVariable("c").GetIntValue(), 3);
+			TestTrue(Prefix + "Continue", Dlg->Continue());
+			TestDialogueText(this, Prefix + "Line 3", Dlg, "NPC", "In sub");
+			TestTrue(Prefix + "Continue", Dlg->Continue());
+			TestDialogueText(this, Prefix + "Line 4", Dlg, "NPC", "Back again");
+			TestEqual(Prefix + "Choices", Dlg->GetNumberOfChoices(), 2);
+			TestTrue(Prefix + "Choose", Dlg->Choose(Choice));
+			TestDialogueText(this, Prefix + "Line 5", Dlg, "NPC", Choice == 0 ? "One" : "Two");
+			if (Choice == 0)
+			{
+				TestEqual(Prefix + "d", Dlg->GetVariable("d").GetIntValue(), 4);
+				TestEqual(Prefix + "e", Dlg->GetVariable("e").GetIntValue(), 5);
+			}
+			TestFalse(Prefix + "Continue", Dlg->Continue());
+			TestTrue(Prefix + "Ended", Dlg->IsEnded());
+		}
+
+		// Every variable must match, not just the ones checked above
+		const auto& PlainVars = PlainDlg->GetVariables();
+		const auto& OptVars = OptDlg->GetVariables();
+		TestEqual("Same number of variables", OptVars.Num(), PlainVars.Num());
+		for (const auto& Pair : PlainVars)
+		{
+			const auto OptValue = OptVars.Find(Pair.Key);
+			if (TestNotNull(Pair.Key.ToString() + " set in both", OptValue))
+			{
+				TestEqual(Pair.Key.ToString() + " same value", OptValue->ToString(), Pair.Value.ToString());
+			}
+		}
+		TArray<FString> PlainChoices = PlainDlg->GetSavedState().GetChoicesTaken();
+		TArray<FString> OptChoices = OptDlg->GetSavedState().GetChoicesTaken();
+		PlainChoices.Sort();
+		OptChoices.Sort();
+		TestTrue("Same choices taken", PlainChoices == OptChoices);
+	}
+
+	Plain->MarkAsGarbage();
+	Optimised->MarkAsGarbage();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestOptimiserGenerated,
+								 "SUDSTest.TestOptimiserGenerated",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestOptimiserGenerated::RunTest(const FString& Parameters)
+{
+	// Optimised generated scripts must play out exactly the same as unoptimised ones
+	const ScopedStringTableHolder StringTableHolder;
+	FSUDSScriptGeneratorSettings Settings;
+	Settings.TargetLines = 1000;
+	for (int32 Seed = 1; Seed <= 5; ++Seed)
+	{
+		Settings.Seed = Seed;
+		Settings.MaxConditionalDepth = Seed % 4;
+		Settings.MaxGosubDepth = Seed % 3;
+		const FString Input = FSUDSScriptGenerator(Settings).Generate();
+
+		FSUDSMessageLogger Logger(false);
+		FSUDSScriptImporter Importer;
+		const FString Name = FString::Printf(TEXT("Generated%d"), Seed);
+		if (!TestTrue(Name + " should import", Importer.ImportFromBuffer(GetData(Input), Input.Len(), Name, &Logger, true)))
+			continue;
+
+		auto Plain = NewObject<USUDSScript>(GetTransientPackage(), FName(*(Name + TEXT("Plain"))));
+		Importer.PopulateAsset(Plain, StringTableHolder.StringTable);
+		auto Optimised = NewObject<USUDSScript>(GetTransientPackage(), FName(*(Name + TEXT("Optimised"))));
+		Importer.PopulateAsset(Optimised, StringTableHolder.StringTable, true);
+		AddInfo(FString::Printf(TEXT("%s: %d nodes -> %d"), *Name, Plain->GetNodes().Num(), Optimised->GetNodes().Num()));
+		TestTrue(Name + " no extra nodes", Optimised->GetNodes().Num() <= Plain->GetNodes().Num());
+
+		for (int32 RunSeed = 0; RunSeed < 3; ++RunSeed)
+		{
+			TArray<FString> PlainLines, OptimisedLines;
+			RunGeneratedDialogue(USUDSLibrary::CreateDialogue(Plain, Plain), RunSeed, 10000, &PlainLines);
+			RunGeneratedDialogue(USUDSLibrary::CreateDialogue(Optimised, Optimised), RunSeed, 10000, &OptimisedLines);
+			TestTrue(Name + " same dialogue", PlainLines == OptimisedLines);
+		}
+		Plain->MarkAsGarbage();
+		Optimised->MarkAsGarbage();
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestOptimiserThreadedSet,
+								 "SUDSTest.TestOptimiserThreadedSet",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestOptimiserThreadedSet::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(OptimiserThreadedSetInput), OptimiserThreadedSetInput.Len(), "OptimiserThreadedSetInput", &Logger, true));
+
+	const ScopedStringTableHolder StringTableHolder;
+	auto Optimised = NewObject<USUDSScript>(GetTransientPackage(), "Optimised");
+	Importer.PopulateAsset(Optimised, StringTableHolder.StringTable, true);
+
+	// Once the select is threaded past, the second set is only reached from the first, so they merge
+	TestEqual("Pass-through select removed", CountNodesOfType(Optimised->GetNodes(), ESUDSScriptNodeType::Select), 0);
+	TestEqual("Sets either side of the select merged", CountNodesOfType(Optimised->GetNodes(), ESUDSScriptNodeType::SetVariable), 1);
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Optimised, Optimised);
+	Dlg->Start();
+	TestDialogueText(this, "Line 1", Dlg, "NPC", "Hello");
+	TestTrue("Continue", Dlg->Continue());
+	TestDialogueText(this, "Line 2", Dlg, "NPC", "Done");
+	TestEqual("a", Dlg->GetVariable("a").GetIntValue(), 1);
+	TestEqual("b", Dlg->GetVariable("b").GetIntValue(), 2);
+
+	Optimised->MarkAsGarbage();
+	return true;
+}
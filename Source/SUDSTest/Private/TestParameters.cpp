@@ -3,6 +3,8 @@
 #include "SUDSMessageLogger.h"
 #include "SUDSScript.h"
 #include "SUDSScriptImporter.h"
+#include "SUDSSubsystem.h"
+#include "TestEventSub.h"
 #include "TestParticipant.h"
 #include "TestUtils.h"
 #include "Misc/AutomationTest.h"
@@ -126,4 +128,172 @@ bool FTestParametersPriority::RunTest(const FString& Parameters)
 	return true;	
 }
 
+const FString ParamsCacheInput = R"RAWSUD(
+NPC: You have {NumCats} {NumCats}|plural(one=cat,other=cats), {Name}
+	* Give {Name} a cat
+	* Keep the cats
+NPC: Bye
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestParametersCache,
+								 "SUDSTest.TestParametersCache",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+bool FTestParametersCache::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(ParamsCacheInput), ParamsCacheInput.Len(), "ParamsCacheInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg->SetVariableInt("NumCats", 2);
+	Dlg->SetVariableText("Name", FText::FromString("Bob"));
+	Dlg->Start();
+
+	int Hits, Misses;
+	TestDialogueText(this, "Line 1", Dlg, "NPC", "You have 2 cats, Bob");
+	TestDialogueText(this, "Line 1 again", Dlg, "NPC", "You have 2 cats, Bob");
+	Dlg->GetTextCacheStats(Hits, Misses);
+	TestEqual("Second request should hit the cache", Hits, 1);
+	TestEqual("First request should miss the cache", Misses, 1);
+
+	// Unrelated variable shouldn't invalidate
+	Dlg->SetVariableInt("Unrelated", 5);
+	TestDialogueText(this, "Line 1 unrelated change", Dlg, "NPC", "You have 2 cats, Bob");
+	// Setting the same value shouldn't either
+	Dlg->SetVariableInt("NumCats", 2);
+	TestDialogueText(this, "Line 1 same value", Dlg, "NPC", "You have 2 cats, Bob");
+	Dlg->GetTextCacheStats(Hits, Misses);
+	TestEqual("Unchanged params should hit the cache", Hits, 3);
+	TestEqual("Unchanged params should not miss the cache", Misses, 1);
+
+	Dlg->SetVariableInt("NumCats", 1);
+	TestDialogueText(this, "Line 1 changed", Dlg, "NPC", "You have 1 cat, Bob");
+	Dlg->GetTextCacheStats(Hits, Misses);
+	TestEqual("Changed param should miss the cache", Misses, 2);
+
+	// Choices are cached separately
+	TestEqual("Choice 1", Dlg->GetChoiceText(0).ToString(), "Give Bob a cat");
+	TestEqual("Choice 1 again", Dlg->GetChoiceText(0).ToString(), "Give Bob a cat");
+	Dlg->SetVariableText("Name", FText::FromString("Alice"));
+	TestEqual("Choice 1 changed", Dlg->GetChoiceText(0).ToString(), "Give Alice a cat");
+	TestDialogueText(this, "Line 1 name changed", Dlg, "NPC", "You have 1 cat, Alice");
+
+	// Bulk changes invalidate everything
+	Dlg->GetTextCacheStats(Hits, Misses);
+	const int MissesBeforeRestore = Misses;
+	Dlg->RestoreSavedState(Dlg->GetSavedState());
+	TestDialogueText(this, "Line 1 after restore", Dlg, "NPC", "You have 1 cat, Alice");
+	Dlg->GetTextCacheStats(Hits, Misses);
+	TestEqual("Restore should invalidate the cache", Misses, MissesBeforeRestore + 1);
+
+	TestTrue("Hit rate should be sensible", Dlg->GetTextCacheHitRate() > 0.f && Dlg->GetTextCacheHitRate() < 1.f);
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString GlobalVariablesInput = R"RAWSUD(
+NPC: Welcome to chapter {global.Chapter}
+[if {global.MetBlacksmith}]
+	NPC: Good to see you again
+[else]
+	NPC: Nice to meet you
+[endif]
+[set global.MetBlacksmith true]
+[set NextChapter {global.Chapter} + 1]
+NPC: Next is chapter {NextChapter}
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestGlobalVariables,
+								 "SUDSTest.TestGlobalVariables",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+bool FTestGlobalVariables::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(GlobalVariablesInput), GlobalVariablesInput.Len(), "GlobalVariablesInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	// No game instance in tests, so just use a standalone subsystem
+	auto Sub = NewObject<USUDSSubsystem>();
+	Sub->SetGlobalVariable("Chapter", 3);
+	TestTrue("Prefix should be added", Sub->IsGlobalVariableSet("global.Chapter"));
+
+	const uint32 VersionBefore = Sub->GetGlobalVariablesVersion();
+	
+	auto Dlg = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TestDialogueText(this, "Line 1", Dlg, "NPC", "Welcome to chapter 3");
+	TestTrue("Continue", Dlg->Continue());
+	TestDialogueText(this, "Line 2", Dlg, "NPC", "Nice to meet you");
+	TestTrue("Continue", Dlg->Continue());
+	TestDialogueText(this, "Line 3", Dlg, "NPC", "Next is chapter 4");
+	TestTrue("Global set by script", Sub->GetGlobalVariable("MetBlacksmith").GetBooleanValue());
+	TestFalse("Global should not be in local state", Dlg->GetVariables().Contains("global.MetBlacksmith"));
+	TestTrue("Dialogue getters read globals", Dlg->IsVariableSet("global.MetBlacksmith"));
+	TestTrue("Dialogue getters read globals", Dlg->GetVariableBoolean("global.MetBlacksmith"));
+	TestEqual("Dialogue getters read globals", Dlg->GetVariableInt("global.Chapter"), 3);
+	TestEqual("Dialogue getters read globals", Dlg->GetVariable("global.Chapter").GetIntValue(), 3);
+	TestFalse("Unprefixed name is local", Dlg->IsVariableSet("Chapter"));
+	TestEqual("One global change", Sub->GetGlobalVariablesVersion(), VersionBefore + 1);
+
+	// A second dialogue sees the same globals
+	auto Dlg2 = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TestTrue("Continue", Dlg2->Continue());
+	TestDialogueText(this, "Line 2 second dialogue", Dlg2, "NPC", "Good to see you again");
+
+	// Cached text picks up global changes
+	Dlg2->Restart();
+	TestDialogueText(this, "Line 1 second dialogue", Dlg2, "NPC", "Welcome to chapter 3");
+	Sub->SetGlobalVariable("Chapter", 4);
+	TestDialogueText(this, "Line 1 after global change", Dlg2, "NPC", "Welcome to chapter 4");
+
+	// Save / restore, both of which notify like setting does
+	auto EvtSub = NewObject<UTestEventSub>();
+	EvtSub->InitGlobalVariables(Sub);
+	const FSUDSGlobalState Saved = Sub->GetSavedGlobalState();
+	Sub->UnSetGlobalVariable("MetBlacksmith");
+	TestFalse("Unset", Sub->IsGlobalVariableSet("MetBlacksmith"));
+	TestFalse("Unset via dialogue", Dlg2->IsVariableSet("global.MetBlacksmith"));
+	if (TestEqual("Unset should notify", EvtSub->SetVarRecords.Num(), 1))
+	{
+		TestEqual("Unset notify name", EvtSub->SetVarRecords[0].Name, FName("global.MetBlacksmith"));
+		TestTrue("Unset notify value", EvtSub->SetVarRecords[0].Value.IsEmpty());
+	}
+	EvtSub->SetVarRecords.Empty();
+	Sub->RestoreSavedGlobalState(Saved);
+	TestTrue("Restored", Sub->GetGlobalVariable("MetBlacksmith").GetBooleanValue());
+	TestEqual("Restored", Sub->GetGlobalVariable("Chapter").GetIntValue(), 4);
+	// Only the variable which differed from the saved state
+	if (TestEqual("Restore should notify changed variables", EvtSub->SetVarRecords.Num(), 1))
+	{
+		TestEqual("Restore notify name", EvtSub->SetVarRecords[0].Name, FName("global.MetBlacksmith"));
+		TestTrue("Restore notify value", EvtSub->SetVarRecords[0].Value.GetBooleanValue());
+	}
+	EvtSub->SetVarRecords.Empty();
+	Sub->SetGlobalVariable("Extra", 1);
+	EvtSub->SetVarRecords.Empty();
+	Sub->RestoreSavedGlobalState(Saved);
+	if (TestEqual("Restore should notify removed variables", EvtSub->SetVarRecords.Num(), 1))
+	{
+		TestEqual("Restore remove name", EvtSub->SetVarRecords[0].Name, FName("global.Extra"));
+		TestTrue("Restore remove value", EvtSub->SetVarRecords[0].Value.IsEmpty());
+	}
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
 PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
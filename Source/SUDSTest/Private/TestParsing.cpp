@@ -2,8 +2,12 @@
 #include "SUDSScript.h"
 #include "Misc/AutomationTest.h"
 #include "SUDSScriptImporter.h"
+#include "SUDSLibrary.h"
 #include "SUDSScriptNode.h"
+#include "SUDSScriptNodeSet.h"
+#include "SUDSScriptNodeText.h"
 #include "TestUtils.h"
+#include "Internationalization/StringTableCore.h"
 
 PRAGMA_DISABLE_OPTIMIZATION
 
@@ -154,9 +158,9 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 		return false;
 
 	TestEqual("Root node type", RootNode->NodeType, ESUDSParsedNodeType::Text);
-	TestEqual("Root node speaker", RootNode->Identifier, "Player");
-	TestEqual("Root node text", RootNode->Text, "Excuse me?");
-	TestEqual("Root node path", RootNode->ChoicePath, "/");
+	TestEqual("Root node speaker", FString(RootNode->Identifier), "Player");
+	TestEqual("Root node text", FString(RootNode->Text), "Excuse me?");
+	TestEqual("Root node path", Importer.GetChoicePath(RootNode), "/");
 	TestEqual("Root node edges", RootNode->Edges.Num(), 1);
 
 	auto NextNode = Importer.GetNode(RootNode->Edges[0].TargetNodeIdx);
@@ -164,9 +168,9 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 		return false;
 
 	TestEqual("Second node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-	TestEqual("Second node speaker", NextNode->Identifier, "NPC");
-	TestEqual("Second node text", NextNode->Text, "Well, hello there. This is a test.");
-	TestEqual("Second node path", RootNode->ChoicePath, "/");
+	TestEqual("Second node speaker", FString(NextNode->Identifier), "NPC");
+	TestEqual("Second node text", FString(NextNode->Text), "Well, hello there. This is a test.");
+	TestEqual("Second node path", Importer.GetChoicePath(RootNode), "/");
 	TestEqual("Second node edges", NextNode->Edges.Num(), 1);
 
 	NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
@@ -174,39 +178,39 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 		return false;
 	TestEqual("Third node type", NextNode->NodeType, ESUDSParsedNodeType::Choice);
 	// Choice itself is still at root, only the edges (individual choices) introduce new path levels
-	TestEqual("Third node path", NextNode->ChoicePath, "/");
+	TestEqual("Third node path", Importer.GetChoicePath(NextNode), "/");
 	TestEqual("Third node edges", NextNode->Edges.Num(), 2);
 
 	auto Choice1Node = NextNode;
 	const FSUDSParsedNode* FallthroughNode = nullptr;
 	if (NextNode->Edges.Num() >= 2)
 	{
-		TestEqual("Choice 1 node edge 0 text", Choice1Node->Edges[0].Text, "A test?");
-		TestEqual("Choice 1 node edge 1 text", Choice1Node->Edges[1].Text, "Another option");
+		TestEqual("Choice 1 node edge 0 text", FString(Choice1Node->Edges[0].Text), "A test?");
+		TestEqual("Choice 1 node edge 1 text", FString(Choice1Node->Edges[1].Text), "Another option");
 		// Follow choice 1
 		NextNode = Importer.GetNode(Choice1Node->Edges[0].TargetNodeIdx);
 		if (TestNotNull("Next node should exist", NextNode))
 		{
 			TestEqual("Choice 1 1st text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-			TestEqual("Choice 1 1st text node speaker", NextNode->Identifier, "NPC");
-			TestEqual("Choice 1 1st text node text", NextNode->Text, "Yes, a test. This is some indented continuation text.");
-			TestEqual("Choice 1 1st text node path", NextNode->ChoicePath, "/C001/");
+			TestEqual("Choice 1 1st text node speaker", FString(NextNode->Identifier), "NPC");
+			TestEqual("Choice 1 1st text node text", FString(NextNode->Text), "Yes, a test. This is some indented continuation text.");
+			TestEqual("Choice 1 1st text node path", Importer.GetChoicePath(NextNode), "/C001/");
 			TestEqual("Choice 1 1st text node edges", NextNode->Edges.Num(), 1);
 			NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 			if (TestNotNull("Next node should exist", NextNode))
 			{
 				TestEqual("Choice 1 2nd text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-				TestEqual("Choice 1 2nd text node speaker", NextNode->Identifier, "Player");
-				TestEqual("Choice 1 2nd text node text", NextNode->Text, "Oh I see, thank you.");
-				TestEqual("Choice 1 2nd text node path", NextNode->ChoicePath, "/C001/");
+				TestEqual("Choice 1 2nd text node speaker", FString(NextNode->Identifier), "Player");
+				TestEqual("Choice 1 2nd text node text", FString(NextNode->Text), "Oh I see, thank you.");
+				TestEqual("Choice 1 2nd text node path", Importer.GetChoicePath(NextNode), "/C001/");
 				TestEqual("Choice 1 2nd text node edges", NextNode->Edges.Num(), 1);
 				NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 				if (TestNotNull("Next node should exist", NextNode))
 				{
 					TestEqual("Choice 1 3rd text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-					TestEqual("Choice 1 3rd text node speaker", NextNode->Identifier, "NPC");
-					TestEqual("Choice 1 3rd text node text", NextNode->Text, "You're welcome.");
-					TestEqual("Choice 1 3rd text node path", NextNode->ChoicePath, "/C001/");
+					TestEqual("Choice 1 3rd text node speaker", FString(NextNode->Identifier), "NPC");
+					TestEqual("Choice 1 3rd text node text", FString(NextNode->Text), "You're welcome.");
+					TestEqual("Choice 1 3rd text node path", Importer.GetChoicePath(NextNode), "/C001/");
 
 					// Should fall through, all the way to the end and not to "level 2 fallthrough" since that's deeper level
 					TestEqual("Choice 1 3rd text node edges", NextNode->Edges.Num(), 1);
@@ -215,7 +219,7 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 						auto LinkedNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 						if (TestNotNull("Choice 1 3rd text linked node", LinkedNode))
 						{
-							TestTrue("Choice 1 3rd text target node", LinkedNode->Text.StartsWith("Well, that's all for now"));
+							TestTrue("Choice 1 3rd text target node", LinkedNode->Text.StartsWith(TEXT("Well, that's all for now")));
 							FallthroughNode = LinkedNode;
 						}
 					}
@@ -230,9 +234,9 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 			return false;
 		
 		TestEqual("Choice 2 1st text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-		TestEqual("Choice 2 1st text node speaker", NextNode->Identifier, "NPC");
-		TestEqual("Choice 2 1st text node text", NextNode->Text, "This is another option with an embedded choice.");
-		TestEqual("Choice 2 2nd text node path", NextNode->ChoicePath, "/C002/");
+		TestEqual("Choice 2 1st text node speaker", FString(NextNode->Identifier), "NPC");
+		TestEqual("Choice 2 1st text node text", FString(NextNode->Text), "This is another option with an embedded choice.");
+		TestEqual("Choice 2 2nd text node path", Importer.GetChoicePath(NextNode), "/C002/");
 		TestEqual("Choice 2 1st text node edges", NextNode->Edges.Num(), 1);
 		NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 		if (!TestNotNull("Next node should exist", NextNode))
@@ -244,17 +248,17 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 		auto NestedChoiceNode = NextNode;
 		if (NestedChoiceNode->Edges.Num() >= 3)
 		{
-			TestEqual("Nested choice edge text 0", NestedChoiceNode->Edges[0].Text, "How far can this go?");
+			TestEqual("Nested choice edge text 0", FString(NestedChoiceNode->Edges[0].Text), "How far can this go?");
 			
 			NextNode = Importer.GetNode(NestedChoiceNode->Edges[0].TargetNodeIdx);
 			if (TestNotNull("Next node should exist", NextNode))
 			{
 				TestEqual("Nested Choice 1st text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-				TestEqual("Nested Choice 1st text node speaker", NextNode->Identifier, "NPC");
-				TestEqual("Nested Choice 1st text node text", NextNode->Text, "Theoretically forever but who knows?");
+				TestEqual("Nested Choice 1st text node speaker", FString(NextNode->Identifier), "NPC");
+				TestEqual("Nested Choice 1st text node text", FString(NextNode->Text), "Theoretically forever but who knows?");
 				// Choice edges are assigned unique numbers in ascending order, but nested
 				// This helps with fallthrough
-				TestEqual("Nested Choice 1st text node path", NextNode->ChoicePath, "/C002/C003/");
+				TestEqual("Nested Choice 1st text node path", Importer.GetChoicePath(NextNode), "/C002/C003/");
 
 				if (TestEqual("Nested Choice 1st text node edges", NextNode->Edges.Num(), 1))
 				{
@@ -262,19 +266,19 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 					auto LinkedNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 					if (TestNotNull("Nested Choice 1st linked node", LinkedNode))
 					{
-						TestEqual("Nested Choice 1st text target node", LinkedNode->Text, "This is a level 2 fallthrough");
+						TestEqual("Nested Choice 1st text target node", FString(LinkedNode->Text), "This is a level 2 fallthrough");
 					}
 				}
 			}
 
-			TestEqual("Nested choice edge text 1", NestedChoiceNode->Edges[1].Text, "This is an extra question");
+			TestEqual("Nested choice edge text 1", FString(NestedChoiceNode->Edges[1].Text), "This is an extra question");
 			NextNode = Importer.GetNode(NestedChoiceNode->Edges[1].TargetNodeIdx);
 			if (TestNotNull("Next node should exist", NextNode))
 			{
 				TestEqual("Nested Choice 2nd text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-				TestEqual("Nested Choice 2nd text node speaker", NextNode->Identifier, "NPC");
-				TestEqual("Nested Choice 2nd text node text", NextNode->Text, "That should have been added to the previous choice");
-				TestEqual("Nested Choice 2nd text node path", NextNode->ChoicePath, "/C002/C004/");
+				TestEqual("Nested Choice 2nd text node speaker", FString(NextNode->Identifier), "NPC");
+				TestEqual("Nested Choice 2nd text node text", FString(NextNode->Text), "That should have been added to the previous choice");
+				TestEqual("Nested Choice 2nd text node path", Importer.GetChoicePath(NextNode), "/C002/C004/");
 				TestEqual("Nested Choice 2nd text node edges", NextNode->Edges.Num(), 1);
 				if (TestEqual("Nested Choice 2nd text node edges", NextNode->Edges.Num(), 1))
 				{
@@ -282,19 +286,19 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 					auto LinkedNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 					if (TestNotNull("Nested Choice 2nd linked node", LinkedNode))
 					{
-						TestEqual("Nested Choice 2nd text target node", LinkedNode->Text, "This is a level 2 fallthrough");
+						TestEqual("Nested Choice 2nd text target node", FString(LinkedNode->Text), "This is a level 2 fallthrough");
 					}
 				}
 			}
 			
-			TestEqual("Nested choice edge text 2", NestedChoiceNode->Edges[2].Text, "Another question?");
+			TestEqual("Nested choice edge text 2", FString(NestedChoiceNode->Edges[2].Text), "Another question?");
 			NextNode = Importer.GetNode(NestedChoiceNode->Edges[2].TargetNodeIdx);
 			if (TestNotNull("Next node should exist", NextNode))
 			{
 				TestEqual("Nested Choice 3rd text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-				TestEqual("Nested Choice 3rd text node speaker", NextNode->Identifier, "NPC");
-				TestEqual("Nested Choice 3rd text node text", NextNode->Text, "Yep, this one too");
-				TestEqual("Nested Choice 3rd text node path", NextNode->ChoicePath, "/C002/C005/");
+				TestEqual("Nested Choice 3rd text node speaker", FString(NextNode->Identifier), "NPC");
+				TestEqual("Nested Choice 3rd text node text", FString(NextNode->Text), "Yep, this one too");
+				TestEqual("Nested Choice 3rd text node path", Importer.GetChoicePath(NextNode), "/C002/C005/");
 				if (TestEqual("Nested Choice 3rd text node edges", NextNode->Edges.Num(), 1))
 				{
 					// Double nested
@@ -305,44 +309,44 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 						if (TestEqual("Double Nested Choice node edges", DoubleChoiceNode->Edges.Num(), 3))
 						{
 							
-							TestEqual("Double Nested choice edge text 0", DoubleChoiceNode->Edges[0].Text, "A third level of questions?");
+							TestEqual("Double Nested choice edge text 0", FString(DoubleChoiceNode->Edges[0].Text), "A third level of questions?");
 							NextNode = Importer.GetNode(DoubleChoiceNode->Edges[0].TargetNodeIdx);
 							if (TestNotNull("Double Nested Choice node option 0", NextNode))
 							{
 								TestEqual("Double Nested Choice option 0 text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-								TestEqual("Double Nested Choice option 0 text node speaker", NextNode->Identifier, "NPC");
-								TestEqual("Double Nested Choice option 0 text node text", NextNode->Text, "Yes, really!");
+								TestEqual("Double Nested Choice option 0 text node speaker", FString(NextNode->Identifier), "NPC");
+								TestEqual("Double Nested Choice option 0 text node text", FString(NextNode->Text), "Yes, really!");
 								// Should fall through
 								if (TestEqual("Double Nested Choice option 0 text edge", NextNode->Edges.Num(), 1))
 								NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 								if (TestNotNull("Double Nested Choice option 0 text linked node", NextNode))
 								{
-									TestEqual("Double Nested Choice option 0 text linked node", NextNode->Text, "This is a level 2 fallthrough");
+									TestEqual("Double Nested Choice option 0 text linked node", FString(NextNode->Text), "This is a level 2 fallthrough");
 								}
 							}
 							
-							TestEqual("Double Nested choice edge text 1", DoubleChoiceNode->Edges[1].Text, "Wow");
+							TestEqual("Double Nested choice edge text 1", FString(DoubleChoiceNode->Edges[1].Text), "Wow");
 							NextNode = Importer.GetNode(DoubleChoiceNode->Edges[1].TargetNodeIdx);
 							if (TestNotNull("Double Nested Choice node option 1", NextNode))
 							{
 								TestEqual("Double Nested Choice option 1 text node type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-								TestEqual("Double Nested Choice option 1 text node speaker", NextNode->Identifier, "NPC");
-								TestEqual("Double Nested Choice option 1 text node text", NextNode->Text, "IKR");
+								TestEqual("Double Nested Choice option 1 text node speaker", FString(NextNode->Identifier), "NPC");
+								TestEqual("Double Nested Choice option 1 text node text", FString(NextNode->Text), "IKR");
 								// Should fall through
 								if (TestEqual("Double Nested Choice option 1 text edge", NextNode->Edges.Num(), 1))
 									NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 								if (TestNotNull("Double Nested Choice option 0 text linked node", NextNode))
 								{
-									TestEqual("Double Nested Choice option 0 text linked node", NextNode->Text, "This is a level 2 fallthrough");
+									TestEqual("Double Nested Choice option 0 text linked node", FString(NextNode->Text), "This is a level 2 fallthrough");
 								}
 							}
 							
 							// Last Should fall through
-							TestEqual("Double Nested choice edge text 2", DoubleChoiceNode->Edges[2].Text, "Continuation with no response, just fallthrough");
+							TestEqual("Double Nested choice edge text 2", FString(DoubleChoiceNode->Edges[2].Text), "Continuation with no response, just fallthrough");
 							auto LinkedNode = Importer.GetNode(DoubleChoiceNode->Edges[2].TargetNodeIdx);
 							if (TestNotNull("Nested Choice 3rd linked node", LinkedNode))
 							{
-								TestEqual("Nested Choice 3rd text target node", LinkedNode->Text, "This is a level 2 fallthrough");
+								TestEqual("Nested Choice 3rd text target node", FString(LinkedNode->Text), "This is a level 2 fallthrough");
 							}
 						}
 						
@@ -357,16 +361,16 @@ bool FTestSimpleParsing::RunTest(const FString& Parameters)
 		{
 			// Test the final fallthrough
 			TestEqual("Fallthrough node type", FallthroughNode->NodeType, ESUDSParsedNodeType::Text);
-			TestEqual("Fallthrough node speaker", FallthroughNode->Identifier, "Player");
-			TestEqual("Fallthrough node text", FallthroughNode->Text, "Well, that's all for now. This should appear for all paths as a fall-through.\nThis, in fact, is a multi-line piece of text\nWhich is joined to the previous text node with the line breaks");
+			TestEqual("Fallthrough node speaker", FString(FallthroughNode->Identifier), "Player");
+			TestEqual("Fallthrough node text", FString(FallthroughNode->Text), "Well, that's all for now. This should appear for all paths as a fall-through.\nThis, in fact, is a multi-line piece of text\nWhich is joined to the previous text node with the line breaks");
 			if (TestEqual("Fallthrough node edge count", FallthroughNode->Edges.Num(), 1))
 			{
 				NextNode = Importer.GetNode(FallthroughNode->Edges[0].TargetNodeIdx);
 				if (TestNotNull("Fallthrough node next node not null", NextNode))
 				{
 					TestEqual("Fallthrough node 2 type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-					TestEqual("Fallthrough node 2 speaker", NextNode->Identifier, "NPC");
-					TestEqual("Fallthrough node 2 text", NextNode->Text, "Bye!");
+					TestEqual("Fallthrough node 2 speaker", FString(NextNode->Identifier), "NPC");
+					TestEqual("Fallthrough node 2 text", FString(NextNode->Text), "Bye!");
 					// Should have no further edges since is at end
 					TestEqual("Fallthrough node 2 edge count", NextNode->Edges.Num(), 0);
 				}
@@ -400,8 +404,8 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 		return false;
 
 	TestEqual("Root node type", RootNode->NodeType, ESUDSParsedNodeType::Text);
-	TestEqual("Root node speaker", RootNode->Identifier, "Player");
-	TestEqual("Root node text", RootNode->Text, "This is the start");
+	TestEqual("Root node speaker", FString(RootNode->Identifier), "Player");
+	TestEqual("Root node text", FString(RootNode->Text), "This is the start");
 	TestEqual("Root node edges", RootNode->Edges.Num(), 1);
 
 	auto NextNode = Importer.GetNode(RootNode->Edges[0].TargetNodeIdx);
@@ -412,32 +416,32 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 	if (TestEqual("Choice node edges", NextNode->Edges.Num(), 2))
 	{
 		auto ChoiceNode = NextNode;
-		TestEqual("Choice 1 text", ChoiceNode->Edges[0].Text, "Go to end");
+		TestEqual("Choice 1 text", FString(ChoiceNode->Edges[0].Text), "Go to end");
 		NextNode = Importer.GetNode(ChoiceNode->Edges[0].TargetNodeIdx);
 		if (TestNotNull("Next node should not be null", NextNode))
 		{
 			TestEqual("Goto End node text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-			TestEqual("Goto End node text speaker", NextNode->Identifier, "NPC");
-			TestEqual("Goto End node text text", NextNode->Text, "How rude, bye then");
+			TestEqual("Goto End node text speaker", FString(NextNode->Identifier), "NPC");
+			TestEqual("Goto End node text text", FString(NextNode->Text), "How rude, bye then");
 			if (TestEqual("Goto End node text edges", NextNode->Edges.Num(), 1))
 			{
 				NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 				if (TestNotNull("Goto node should not be null", NextNode))
 				{
 					TestEqual("Goto End node type", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-					TestEqual("Goto End node label", NextNode->Identifier, FSUDSScriptImporter::EndGotoLabel);
+					TestEqual("Goto End node label", FString(NextNode->Identifier), FSUDSScriptImporter::EndGotoLabel);
 				}
 				
 			}
 			
 		}
-		TestEqual("Choice 2 text", ChoiceNode->Edges[1].Text, "Nested option");
+		TestEqual("Choice 2 text", FString(ChoiceNode->Edges[1].Text), "Nested option");
 		NextNode = Importer.GetNode(ChoiceNode->Edges[1].TargetNodeIdx);
 		if (TestNotNull("Next node should not be null", NextNode))
 		{
 			TestEqual("Choice 2 node text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-			TestEqual("Choice 2 node text speaker", NextNode->Identifier, "NPC");
-			TestEqual("Choice 2 node text text", NextNode->Text, "Some nested text with <Bounce>formatting</>");
+			TestEqual("Choice 2 node text speaker", FString(NextNode->Identifier), "NPC");
+			TestEqual("Choice 2 node text text", FString(NextNode->Text), "Some nested text with <Bounce>formatting</>");
 			if (TestEqual("Choice 2 node text edges", NextNode->Edges.Num(), 1))
 			{
 				NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
@@ -447,13 +451,13 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 					auto NestedChoice = NextNode;
 					if (TestEqual("Nested Choice node edges", NextNode->Edges.Num(), 3))
 					{
-						TestEqual("Nested choice 0 text", NestedChoice->Edges[0].Text, "Go to goodbye");
+						TestEqual("Nested choice 0 text", FString(NestedChoice->Edges[0].Text), "Go to goodbye");
 						NextNode = Importer.GetNode(NestedChoice->Edges[0].TargetNodeIdx);
 						if (TestNotNull("Should not be null", NextNode))
 						{
 							TestEqual("Nested choice 0 text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-							TestEqual("Nested choice 0 text speaker", NextNode->Identifier, "Player");
-							TestEqual("Nested choice 0 text text", NextNode->Text, "Gotta go!");
+							TestEqual("Nested choice 0 text speaker", FString(NextNode->Identifier), "Player");
+							TestEqual("Nested choice 0 text text", FString(NextNode->Text), "Gotta go!");
 
 							if (TestEqual("Nested Choice textnode edges", NextNode->Edges.Num(), 1))
 							{
@@ -462,26 +466,26 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 								{
 									// This is the goto
 									TestEqual("Nested choice 0 goto type", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-									TestEqual("Nested choice 0 goto label", NextNode->Identifier, "goodbye");
+									TestEqual("Nested choice 0 goto label", FString(NextNode->Identifier), "goodbye");
 									const int DestIdx = Importer.GetGotoTargetNodeIndex(NextNode->Identifier);
 									TestNotEqual("Label should be valid", DestIdx, -1);
 									NextNode = Importer.GetNode(DestIdx);
 									if (TestNotNull("Goto dest node", NextNode))
 									{
 										TestEqual("Goto dest text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-										TestEqual("Goto dest text speaker", NextNode->Identifier, "NPC");
-										TestEqual("Goto dest text text", NextNode->Text, "Bye!");
+										TestEqual("Goto dest text speaker", FString(NextNode->Identifier), "NPC");
+										TestEqual("Goto dest text text", FString(NextNode->Text), "Bye!");
 									}
 								}
 							}
 						}
-						TestEqual("Nested choice 1 text", NestedChoice->Edges[1].Text, "Skip");
+						TestEqual("Nested choice 1 text", FString(NestedChoice->Edges[1].Text), "Skip");
 						NextNode = Importer.GetNode(NestedChoice->Edges[1].TargetNodeIdx);
 						if (TestNotNull("Should not be null", NextNode))
 						{
 							// This one goes straight to goto
 							TestEqual("Nested choice 1 goto type", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-							TestEqual("Nested choice 1 goto label", NextNode->Identifier, "secondchoice");
+							TestEqual("Nested choice 1 goto label", FString(NextNode->Identifier), "secondchoice");
 
 							const int DestIdx = Importer.GetGotoTargetNodeIndex(NextNode->Identifier);
 							TestNotEqual("Label should be valid", DestIdx, -1);
@@ -489,18 +493,18 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 							if (TestNotNull("Goto dest node", NextNode))
 							{
 								TestEqual("Goto dest text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-								TestEqual("Goto dest text speaker", NextNode->Identifier, "NPC");
-								TestEqual("Goto dest text text", NextNode->Text, "Yep, this one too");
+								TestEqual("Goto dest text speaker", FString(NextNode->Identifier), "NPC");
+								TestEqual("Goto dest text text", FString(NextNode->Text), "Yep, this one too");
 										
 							}
 						}
-						TestEqual("Nested choice 2 text", NestedChoice->Edges[2].Text, "This is a <Bounce>mistake</>");
+						TestEqual("Nested choice 2 text", FString(NestedChoice->Edges[2].Text), "This is a <Bounce>mistake</>");
 						NextNode = Importer.GetNode(NestedChoice->Edges[2].TargetNodeIdx);
 						if (TestNotNull("Should not be null", NextNode))
 						{
 							TestEqual("Nested choice 2 text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-							TestEqual("Nested choice 2 text speaker", NextNode->Identifier, "NPC");
-							TestEqual("Nested choice 2 text text", NextNode->Text, "Oh no");
+							TestEqual("Nested choice 2 text speaker", FString(NextNode->Identifier), "NPC");
+							TestEqual("Nested choice 2 text text", FString(NextNode->Text), "Oh no");
 
 							if (TestEqual("Nested Choice text node edges", NextNode->Edges.Num(), 1))
 							{
@@ -509,7 +513,7 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 								{
 									// This is the goto
 									TestEqual("Nested choice 0 goto type", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-									TestEqual("Nested choice 0 goto label", NextNode->Identifier, "this_is_an_error");
+									TestEqual("Nested choice 0 goto label", FString(NextNode->Identifier), "this_is_an_error");
 									TestEqual("Label should go nowhere", Importer.GetGotoTargetNodeIndex(NextNode->Identifier), -1);
 								}
 							}
@@ -528,8 +532,8 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 		if (TestNotNull("End choice node should not be null", NextNode))
 		{
 			TestEqual("End choice node text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-			TestEqual("End choice node text speaker", NextNode->Identifier, "NPC");
-			TestEqual("End choice node text text", NextNode->Text, "Yep, this one too");
+			TestEqual("End choice node text speaker", FString(NextNode->Identifier), "NPC");
+			TestEqual("End choice node text text", FString(NextNode->Text), "Yep, this one too");
 			if (TestEqual("End choice node text edges", NextNode->Edges.Num(), 1))
 			{
 				NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
@@ -540,20 +544,20 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 					if (TestEqual("End choice node edges", NextNode->Edges.Num(), 3))
 					{
 						auto EndChoiceNode = NextNode;
-						TestEqual("End choice 0 text", EndChoiceNode->Edges[0].Text, "Go back to choice");
+						TestEqual("End choice 0 text", FString(EndChoiceNode->Edges[0].Text), "Go back to choice");
 						NextNode = Importer.GetNode(EndChoiceNode->Edges[0].TargetNodeIdx);
 						if (TestNotNull("", NextNode))
 						{
 							TestEqual("Node text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-							TestEqual("Node text speaker", NextNode->Identifier, "NPC");
-							TestEqual("Node text text", NextNode->Text, "Okay!");
+							TestEqual("Node text speaker", FString(NextNode->Identifier), "NPC");
+							TestEqual("Node text text", FString(NextNode->Text), "Okay!");
 							if (TestEqual("Next node edges", NextNode->Edges.Num(), 1))
 							{
 								NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 								if (TestNotNull("", NextNode))
 								{
 									TestEqual("Should be goto node", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-									TestEqual("Goto label", NextNode->Identifier, "choice");
+									TestEqual("Goto label", FString(NextNode->Identifier), "choice");
 									
 									// This should lead back to a choice node, ie letting the previous text node use the same choices
 									// without repeating the text (loop with context)
@@ -566,7 +570,7 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 										// Just make sure it's the right choice node
 										if (TestEqual("Goto dest choice edges", NextNode->Edges.Num(), 2))
 										{
-											TestEqual("Goto dest choice check edge", NextNode->Edges[0].Text, "Go to end");
+											TestEqual("Goto dest choice check edge", FString(NextNode->Edges[0].Text), "Go to end");
 										}
 									}
 									
@@ -577,15 +581,15 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 							if (TestNotNull("", NextNode))
 							{
 								TestEqual("Node text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-								TestEqual("Node text speaker", NextNode->Identifier, "NPC");
-								TestEqual("Node text text", NextNode->Text, "Gotcha");
+								TestEqual("Node text speaker", FString(NextNode->Identifier), "NPC");
+								TestEqual("Node text text", FString(NextNode->Text), "Gotcha");
 								if (TestEqual("Next node edges", NextNode->Edges.Num(), 1))
 								{
 									NextNode = Importer.GetNode(NextNode->Edges[0].TargetNodeIdx);
 									if (TestNotNull("", NextNode))
 									{
 										TestEqual("Should be goto node", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-										TestEqual("Goto label", NextNode->Identifier, "start");
+										TestEqual("Goto label", FString(NextNode->Identifier), "start");
 									
 										// This should lead back to a choice node, ie letting the previous text node use the same choices
 										// without repeating the text (loop with context)
@@ -596,8 +600,8 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 										{
 											// Just make sure it's the right node
 											TestEqual("Goto dest text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-											TestEqual("Node text speaker", NextNode->Identifier, "Player");
-											TestEqual("Node text text", NextNode->Text, "This is the start");
+											TestEqual("Node text speaker", FString(NextNode->Identifier), "Player");
+											TestEqual("Node text text", FString(NextNode->Text), "This is the start");
 										}
 									
 									}
@@ -608,7 +612,7 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 							{
 								// Straight to goto
 								TestEqual("Should be goto node", NextNode->NodeType, ESUDSParsedNodeType::Goto);
-								TestEqual("Goto label", NextNode->Identifier, "alsostart");
+								TestEqual("Goto label", FString(NextNode->Identifier), "alsostart");
 							
 								// This should lead back to a choice node, ie letting the previous text node use the same choices
 								// without repeating the text (loop with context)
@@ -619,8 +623,8 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 								{
 									// Just make sure it's the right node
 									TestEqual("Goto dest text type", NextNode->NodeType, ESUDSParsedNodeType::Text);
-									TestEqual("Node text speaker", NextNode->Identifier, "Player");
-									TestEqual("Node text text", NextNode->Text, "This is the start");
+									TestEqual("Node text speaker", FString(NextNode->Identifier), "Player");
+									TestEqual("Node text text", FString(NextNode->Text), "This is the start");
 								}
 							}
 						}
@@ -638,8 +642,8 @@ bool FTestGotoParsing::RunTest(const FString& Parameters)
 		if (TestNotNull("Second choice node should not be null", StartNode))
 		{
 			TestEqual("Start node text type", StartNode->NodeType, ESUDSParsedNodeType::Text);
-			TestEqual("Start node text speaker", StartNode->Identifier, "Player");
-			TestEqual("Start node text text", StartNode->Text, "This is the start");
+			TestEqual("Start node text speaker", FString(StartNode->Identifier), "Player");
+			TestEqual("Start node text text", FString(StartNode->Text), "This is the start");
 		}
 		const int AlsoStartNodeIdx = Importer.GetGotoTargetNodeIndex("alsostart");
 		TestEqual("start and alsostart should reference the same node", AlsoStartNodeIdx, StartNodeIdx);
@@ -894,19 +898,355 @@ bool FTestPartiallyLocalised::RunTest(const FString& Parameters)
 		TestGetParsedNextNode(this, "Next", NextNode, Importer, false, &NextNode);
 		TestParsedGoto(this, "Goto", NextNode, Importer, &NextNode);
 		TestParsedText(this, "Next node", NextNode, "Vagabond", "Mayhaps we could travel together a while, and share a tale or two?\nWhat do you say?");
-		TestEqual("TextID should be correct", NextNode->TextID, "@0007@");
+		TestEqual("TextID should be correct", FString(NextNode->TextID), "@0007@");
 	}
 
 	NextNode = Importer.GetNode(0);
 	TestGetParsedNextNode(this, "Next", NextNode, Importer, false, &NextNode);
 	if (TestParsedChoice(this, "First choice", NextNode, 2))
 	{
-		TestEqual("TextID should be correct", NextNode->Edges[1].TextID, "@0004@");
+		TestEqual("TextID should be correct", FString(NextNode->Edges[1].TextID), "@0004@");
 		TestParsedChoiceEdge(this, "First choice", NextNode, 1, "Jog on, mate", Importer, &NextNode);
 		TestParsedText(this, "Next node", NextNode, "Vagabond", "Well, really! Good day then sir!");
-		TestEqual("TextID should be correct", NextNode->TextID, "@0005@");
+		TestEqual("TextID should be correct", FString(NextNode->TextID), "@0005@");
 	}
 	
 	return true;
 }
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestUTF8Parsing,
+								 "SUDSTest.TestUTF8Parsing",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestUTF8Parsing::RunTest(const FString& Parameters)
+{
+	// Mixed line endings, tabs, trailing whitespace, non-ASCII text and no final newline
+	const FString Input = TEXT("NPC: Hello\r\n")
+		TEXT("\t* Choice one\r\n")
+		TEXT("\t\tPlayer: Café au lait   \r")
+		TEXT("\t* Choice two\n")
+		TEXT("\t\tPlayer: „Grüße“\n")
+		TEXT("\r\n")
+		TEXT("[set x 1]\n")
+		TEXT("NPC: Done");
+
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter WideImporter;
+	TestTrue("Import should succeed", WideImporter.ImportFromBuffer(GetData(Input), Input.Len(), "UTF8Input", &Logger, true));
+
+	// Same thing as UTF-8 with a BOM
+	const FTCHARToUTF8 Converted(*Input);
+	TArray<uint8> UTF8Bytes = { 0xEF, 0xBB, 0xBF };
+	UTF8Bytes.Append(reinterpret_cast<const uint8*>(Converted.Get()), Converted.Length());
+	FSUDSScriptImporter UTF8Importer;
+	TestTrue("UTF-8 import should succeed", UTF8Importer.ImportFromUTF8Buffer(reinterpret_cast<const UTF8CHAR*>(UTF8Bytes.GetData()), UTF8Bytes.Num(), "UTF8Input", &Logger, true));
+
+	int NumNodes = 0;
+	while (const FSUDSParsedNode* Node = WideImporter.GetNode(NumNodes))
+	{
+		const FSUDSParsedNode* UTF8Node = UTF8Importer.GetNode(NumNodes);
+		if (!TestNotNull("UTF-8 node", UTF8Node))
+			break;
+		TestEqual("Node type", UTF8Node->NodeType, Node->NodeType);
+		TestEqual("Identifier", FString(UTF8Node->Identifier), Node->Identifier);
+		TestEqual("Text", FString(UTF8Node->Text), Node->Text);
+		TestEqual("Indent", UTF8Node->OriginalIndent, Node->OriginalIndent);
+		TestEqual("Line", UTF8Node->SourceLineNo, Node->SourceLineNo);
+		TestEqual("Edges", UTF8Node->Edges.Num(), Node->Edges.Num());
+		++NumNodes;
+	}
+	TestNull("No extra UTF-8 nodes", UTF8Importer.GetNode(NumNodes));
+
+	auto NextNode = WideImporter.GetNode(0);
+	if (!TestParsedText(this, "First node", NextNode, "NPC", "Hello") || !TestEqual("First node edges", NextNode->Edges.Num(), 1))
+		return false;
+	TestParsedChoice(this, "Choice node", WideImporter.GetNode(NextNode->Edges[0].TargetNodeIdx), 2);
+	const FSUDSParsedNode* ChoiceNode = WideImporter.GetNode(NextNode->Edges[0].TargetNodeIdx);
+	TestParsedChoiceEdge(this, "Choice 1", ChoiceNode, 0, "Choice one", WideImporter, &NextNode);
+	TestParsedText(this, "Choice 1 text", NextNode, "Player", TEXT("Café au lait"));
+	TestParsedChoiceEdge(this, "Choice 2", ChoiceNode, 1, "Choice two", WideImporter, &NextNode);
+	TestParsedText(this, "Choice 2 text", NextNode, "Player", TEXT("„Grüße“"));
+	
+	return true;
+}
+
+const FString IncrementalReimportInput = R"RAWSUD(
+NPC: Hello
+:first
+NPC: First block
+	* Go on
+		[goto second]
+	* Stay
+		NPC: Staying
+:second
+NPC: Second block
+Player: The end
+)RAWSUD";
+
+const FString IncrementalReimportEditedInput = R"RAWSUD(
+# A comment which moves everything down a line
+NPC: Hello
+:first
+NPC: First block
+	* Go on
+		[goto second]
+	* Stay
+		NPC: Staying
+:second
+NPC: Second block, edited
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestIncrementalReimport,
+								 "SUDSTest.TestIncrementalReimport",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestIncrementalReimport::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	auto CountStrings = [&StringTableHolder]()
+	{
+		int Count = 0;
+		StringTableHolder.StringTable->GetStringTable()->EnumerateSourceStrings([&Count](const FString&, const FString&)
+		{
+			++Count;
+			return true;
+		});
+		return Count;
+	};
+
+	{
+		FSUDSScriptImporter Importer;
+		TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(IncrementalReimportInput), IncrementalReimportInput.Len(), "IncrementalReimportInput", &Logger, true));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	}
+	const TArray<FSUDSScriptImportBlock> FirstBlocks = Script->GetImportBlocks(false);
+	if (!TestEqual("Block count", FirstBlocks.Num(), 3))
+		return false;
+	TestEqual("Block 0 label", FirstBlocks[0].Label, FName(NAME_None));
+	TestEqual("Block 1 label", FirstBlocks[1].Label, FName("first"));
+	TestEqual("Block 2 label", FirstBlocks[2].Label, FName("second"));
+	TestEqual("String count", CountStrings(), 7);
+	USUDSScriptNode* FirstNode = Script->GetNodeByLabel("first");
+	const int FirstLineNo = FirstNode ? FirstNode->GetSourceLineNo() : 0;
+
+	{
+		FSUDSScriptImporter Importer;
+		TestTrue("Reimport should succeed", Importer.ImportFromBuffer(GetData(IncrementalReimportEditedInput), IncrementalReimportEditedInput.Len(), "IncrementalReimportEditedInput", &Logger, true));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	}
+	const TArray<FSUDSScriptImportBlock>& SecondBlocks = Script->GetImportBlocks(false);
+	if (!TestEqual("Block count", SecondBlocks.Num(), 3))
+		return false;
+
+	// Unchanged blocks keep their nodes, but pick up new line numbers
+	TestEqual("Block 0 unchanged", SecondBlocks[0].Hash, FirstBlocks[0].Hash);
+	TestTrue("Block 0 nodes kept", SecondBlocks[0].Nodes == FirstBlocks[0].Nodes);
+	TestEqual("Block 1 unchanged", SecondBlocks[1].Hash, FirstBlocks[1].Hash);
+	TestTrue("Block 1 nodes kept", SecondBlocks[1].Nodes == FirstBlocks[1].Nodes);
+	TestTrue("Label node kept", Script->GetNodeByLabel("first") == FirstNode);
+	TestEqual("Line number updated", FirstNode ? FirstNode->GetSourceLineNo() : 0, FirstLineNo + 1);
+	// Changed block is rebuilt
+	TestNotEqual("Block 2 changed", SecondBlocks[2].Hash, FirstBlocks[2].Hash);
+	for (auto Node : SecondBlocks[2].Nodes)
+	{
+		TestFalse("Block 2 node replaced", FirstBlocks[2].Nodes.Contains(Node));
+	}
+	// Removed line's string is gone
+	TestEqual("String count", CountStrings(), 6);
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg->Start();
+	TestDialogueText(this, "Start", Dlg, "NPC", "Hello");
+	TestTrue("Continue", Dlg->Continue());
+	TestDialogueText(this, "Kept block", Dlg, "NPC", "First block");
+	TestEqual("Choices", Dlg->GetNumberOfChoices(), 2);
+	TestTrue("Choose", Dlg->Choose(0));
+	TestDialogueText(this, "Rebuilt block", Dlg, "NPC", "Second block, edited");
+	TestFalse("Continue", Dlg->Continue());
+	TestTrue("Ended", Dlg->IsEnded());
+
+	// Reimporting unchanged blocks into a table which doesn't have their strings (e.g. recreated) must still write them
+	{
+		UStringTable* FreshTable = NewObject<UStringTable>(GetTransientPackage(), "FreshStrings");
+		FSUDSScriptImporter Importer;
+		TestTrue("Reimport should succeed", Importer.ImportFromBuffer(GetData(IncrementalReimportEditedInput), IncrementalReimportEditedInput.Len(), "IncrementalReimportEditedInput", &Logger, true));
+		Importer.PopulateAsset(Script, FreshTable);
+		TestTrue("Nodes still kept", Script->GetImportBlocks(false)[1].Nodes == FirstBlocks[1].Nodes);
+		int Count = 0;
+		FreshTable->GetStringTable()->EnumerateSourceStrings([&Count](const FString&, const FString&)
+		{
+			++Count;
+			return true;
+		});
+		TestEqual("Fresh table has every string", Count, 6);
+		auto FreshDlg = USUDSLibrary::CreateDialogue(Script, Script);
+		FreshDlg->Start();
+		TestDialogueText(this, "Unchanged line from fresh table", FreshDlg, "NPC", "Hello");
+		FreshTable->MarkAsGarbage();
+	}
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString VariableAccessInput = R"RAWSUD(
+===
+[set Mood 1]
+===
+NPC: Hello {PlayerName}
+[set Counter {Counter} + 1]
+[event Greeted {Mood}]
+	* Buy something for {Price}
+		NPC: Thanks
+[if {Gold} > 10]
+	* Pay more
+		[set Gold {Gold} - 10]
+		NPC: Cheers
+[endif]
+NPC: Bye
+)RAWSUD";
+
+static bool NamesMatch(TConstArrayView<FName> Names, const TArray<FName>& Expected)
+{
+	if (Names.Num() != Expected.Num())
+		return false;
+	for (const auto& Name : Expected)
+	{
+		if (!Names.Contains(Name))
+			return false;
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestVariableAccess,
+								 "SUDSTest.TestVariableAccess",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestVariableAccess::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(VariableAccessInput), VariableAccessInput.Len(), "VariableAccessInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	const USUDSScriptNodeText* HelloNode = nullptr;
+	const USUDSScriptNodeText* ThanksNode = nullptr;
+	const USUDSScriptNodeSet* CounterNode = nullptr;
+	const USUDSScriptNodeSet* GoldNode = nullptr;
+	for (const auto Node : Script->GetNodes())
+	{
+		if (const auto TextNode = Cast<USUDSScriptNodeText>(Node))
+		{
+			if (TextNode->GetText().ToString().StartsWith("Hello"))
+				HelloNode = TextNode;
+			else if (TextNode->GetText().ToString() == "Thanks")
+				ThanksNode = TextNode;
+		}
+		else if (const auto SetNode = Cast<USUDSScriptNodeSet>(Node))
+		{
+			if (SetNode->GetIdentifier() == FName("Counter"))
+				CounterNode = SetNode;
+			else if (SetNode->GetIdentifier() == FName("Gold"))
+				GoldNode = SetNode;
+		}
+	}
+
+	if (TestNotNull("Hello node", HelloNode))
+	{
+		TestTrue("Hello reads", NamesMatch(Script->GetNodeVariableReads(HelloNode), { "PlayerName" }));
+		TestEqual("Hello writes", Script->GetNodeVariableWrites(HelloNode).Num(), 0);
+		// Set & event between text and choices, choice text and conditions, but not what happens after choices
+		TestTrue("Hello choice reads", NamesMatch(Script->GetChoiceRegionVariableReads(HelloNode), { "Counter", "Mood", "Price", "Gold" }));
+		TestTrue("Hello choice writes", NamesMatch(Script->GetChoiceRegionVariableWrites(HelloNode), { "Counter" }));
+	}
+	if (TestNotNull("Thanks node", ThanksNode))
+	{
+		TestEqual("Thanks choice reads", Script->GetChoiceRegionVariableReads(ThanksNode).Num(), 0);
+		TestEqual("Thanks choice writes", Script->GetChoiceRegionVariableWrites(ThanksNode).Num(), 0);
+	}
+	if (TestNotNull("Counter node", CounterNode))
+	{
+		TestTrue("Counter reads", NamesMatch(Script->GetNodeVariableReads(CounterNode), { "Counter" }));
+		TestTrue("Counter writes", NamesMatch(Script->GetNodeVariableWrites(CounterNode), { "Counter" }));
+	}
+	if (TestNotNull("Gold node", GoldNode))
+	{
+		TestTrue("Gold reads", NamesMatch(Script->GetNodeVariableReads(GoldNode), { "Gold" }));
+		TestTrue("Gold writes", NamesMatch(Script->GetNodeVariableWrites(GoldNode), { "Gold" }));
+	}
+	if (TestNotNull("Header node", Script->GetHeaderNode()))
+	{
+		TestEqual("Header reads", Script->GetNodeVariableReads(Script->GetHeaderNode()).Num(), 0);
+		TestTrue("Header writes", NamesMatch(Script->GetNodeVariableWrites(Script->GetHeaderNode()), { "Mood" }));
+	}
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString ReimportWhileRunningInput = R"RAWSUD(
+NPC: Pick one
+	* Choice A
+		NPC: Picked A
+	* Choice B
+		NPC: Picked B
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestReimportWhileRunning,
+								 "SUDSTest.TestReimportWhileRunning",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestReimportWhileRunning::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	{
+		FSUDSScriptImporter Importer;
+		TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(ReimportWhileRunningInput), ReimportWhileRunningInput.Len(), "ReimportWhileRunningInput", &Logger, true));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	}
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg->Start();
+	TestDialogueText(this, "Start", Dlg, "NPC", "Pick one");
+	TestEqual("Choices", Dlg->GetNumberOfChoices(), 2);
+
+	// Reimporting the same script keeps the nodes but rebuilds their edges, which the dialogue's choices came from
+	{
+		FSUDSScriptImporter Importer;
+		TestTrue("Reimport should succeed", Importer.ImportFromBuffer(GetData(ReimportWhileRunningInput), ReimportWhileRunningInput.Len(), "ReimportWhileRunningInput", &Logger, true));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	}
+	// As happens on a culture change
+	Dlg->NotifyTextFormatsChanged();
+	if (TestEqual("Choices", Dlg->GetNumberOfChoices(), 2))
+	{
+		TestEqual("Choice 1", Dlg->GetChoiceText(0).ToString(), "Choice A");
+		TestEqual("Choice 2", Dlg->GetChoiceText(1).ToString(), "Choice B");
+	}
+	TestTrue("Choose", Dlg->Choose(1));
+	TestDialogueText(this, "Chosen", Dlg, "NPC", "Picked B");
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
 PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
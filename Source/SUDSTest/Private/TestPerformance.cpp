@@ -0,0 +1,394 @@
+﻿#include "SUDSExpression.h"
+#include "SUDSLibrary.h"
+#include "SUDSMessageLogger.h"
+#include "SUDSScript.h"
+#include "SUDSScriptImporter.h"
+#include "TestScriptGenerator.h"
+#include "TestUtils.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Interfaces/IPluginManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+
+// Performance suite, in the Perf filter so it doesn't run with the functional tests. Results are written to
+// Saved/Automation/SUDS/PerfResults.json; to make a new baseline, copy that file to Resources/PerfBaseline.json
+// in the plugin (or point SUDS.Perf.Baseline at it). Baselines are only meaningful on the same hardware.
+
+static TAutoConsoleVariable<float> CVarSUDSPerfRegressionThreshold(
+	TEXT("SUDS.Perf.RegressionThreshold"),
+	0.2f,
+	TEXT("Fraction by which a SUDS performance metric can be worse than the baseline before the perf test fails (0.2 = 20%)"));
+
+static TAutoConsoleVariable<FString> CVarSUDSPerfBaseline(
+	TEXT("SUDS.Perf.Baseline"),
+	TEXT(""),
+	TEXT("Path of the SUDS performance baseline JSON to compare against. Defaults to Resources/PerfBaseline.json in the plugin"));
+
+/// Collects timing samples for one metric, and reports percentiles
+struct FSUDSPerfMetric
+{
+	FString Name;
+	FString Unit;
+	bool bHigherIsBetter = false;
+	TArray<double> Samples;
+
+	double Percentile(double P) const
+	{
+		if (Samples.IsEmpty())
+			return 0;
+		TArray<double> Sorted = Samples;
+		Sorted.Sort();
+		// Nearest rank
+		const int Idx = FMath::Clamp(FMath::CeilToInt(P * Sorted.Num()) - 1, 0, Sorted.Num() - 1);
+		return Sorted[Idx];
+	}
+};
+
+/// Runs benchmarks with warm-up, and writes / compares results as JSON
+class FSUDSPerfSuite
+{
+public:
+	int NumWarmUp = 5;
+	int NumSamples = 50;
+	TArray<FSUDSPerfMetric> Metrics;
+
+	/// Run SampleFunc warm-up + sample times; it returns the value of one sample in the metric's unit
+	template <typename F>
+	const FSUDSPerfMetric& Measure(const FString& Name, const FString& Unit, bool bHigherIsBetter, F SampleFunc)
+	{
+		for (int i = 0; i < NumWarmUp; ++i)
+		{
+			SampleFunc();
+		}
+		FSUDSPerfMetric& M = Metrics.AddDefaulted_GetRef();
+		M.Name = Name;
+		M.Unit = Unit;
+		M.bHigherIsBetter = bHigherIsBetter;
+		M.Samples.Reserve(NumSamples);
+		for (int i = 0; i < NumSamples; ++i)
+		{
+			M.Samples.Add(SampleFunc());
+		}
+		return M;
+	}
+
+	void Report(FAutomationTestBase* T) const
+	{
+		for (auto& M : Metrics)
+		{
+			T->AddInfo(FString::Printf(TEXT("%s: p50 %.2f, p90 %.2f, p99 %.2f %s"),
+			                           *M.Name,
+			                           M.Percentile(0.5),
+			                           M.Percentile(0.9),
+			                           M.Percentile(0.99),
+			                           *M.Unit));
+		}
+	}
+
+	TSharedRef<FJsonObject> ToJson() const
+	{
+		auto Root = MakeShared<FJsonObject>();
+		Root->SetStringField("Platform", FPlatformProperties::IniPlatformName());
+		Root->SetNumberField("Samples", NumSamples);
+		auto MetricsObj = MakeShared<FJsonObject>();
+		for (auto& M : Metrics)
+		{
+			auto Obj = MakeShared<FJsonObject>();
+			Obj->SetStringField("Unit", M.Unit);
+			Obj->SetBoolField("HigherIsBetter", M.bHigherIsBetter);
+			Obj->SetNumberField("P50", M.Percentile(0.5));
+			Obj->SetNumberField("P90", M.Percentile(0.9));
+			Obj->SetNumberField("P99", M.Percentile(0.99));
+			MetricsObj->SetObjectField(M.Name, Obj);
+		}
+		Root->SetObjectField("Metrics", MetricsObj);
+		return Root;
+	}
+
+	bool WriteJson(const FString& Path) const
+	{
+		FString Out;
+		auto Writer = TJsonWriterFactory<>::Create(&Out);
+		FJsonSerializer::Serialize(ToJson(), Writer);
+		return FFileHelper::SaveStringToFile(Out, *Path);
+	}
+
+	/// Compare median values against a baseline file, failing the test for any which regressed past the threshold
+	void CompareToBaseline(FAutomationTestBase* T, const FString& Path, float Threshold) const
+	{
+		FString In;
+		if (!FFileHelper::LoadFileToString(In, *Path))
+		{
+			T->AddWarning(FString::Printf(TEXT("No performance baseline at %s, skipping comparison. Copy the results file written by this test there to create one."), *Path));
+			return;
+		}
+		TSharedPtr<FJsonObject> Root;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(In), Root) || !Root.IsValid())
+		{
+			T->AddError(FString::Printf(TEXT("Performance baseline %s is not valid JSON"), *Path));
+			return;
+		}
+		const TSharedPtr<FJsonObject>* BaselineMetrics;
+		if (!Root->TryGetObjectField("Metrics", BaselineMetrics))
+		{
+			T->AddError(FString::Printf(TEXT("Performance baseline %s has no Metrics"), *Path));
+			return;
+		}
+
+		for (auto& M : Metrics)
+		{
+			const TSharedPtr<FJsonObject>* Baseline;
+			double BaseValue;
+			if (!(*BaselineMetrics)->TryGetObjectField(M.Name, Baseline) ||
+				!(*Baseline)->TryGetNumberField("P50", BaseValue))
+			{
+				T->AddInfo(FString::Printf(TEXT("%s: not in baseline"), *M.Name));
+				continue;
+			}
+
+			const double Value = M.Percentile(0.5);
+			const bool bRegressed = M.bHigherIsBetter
+				                        ? Value < BaseValue * (1.0 - Threshold)
+				                        : Value > BaseValue * (1.0 + Threshold);
+			const FString Msg = FString::Printf(TEXT("%s: %.2f %s vs baseline %.2f"), *M.Name, Value, *M.Unit, BaseValue);
+			if (bRegressed)
+			{
+				T->AddError(FString::Printf(TEXT("Performance regression, %s"), *Msg));
+			}
+			else
+			{
+				T->AddInfo(Msg);
+			}
+		}
+	}
+};
+
+/// A script with lots of sections and choices, some of them conditional, which loops forever
+static FString MakeBranchingPerfScript(int NumSections, int NumChoices)
+{
+	FString Script;
+	Script.Append(TEXT("[set Visits 0]\n"));
+	for (int S = 0; S < NumSections; ++S)
+	{
+		const int Next = (S + 1) % NumSections;
+		Script.Appendf(TEXT(":s%d\n"), S);
+		Script.Append(TEXT("[set Visits {Visits} + 1]\n"));
+		Script.Appendf(TEXT("NPC: Section %d, visit {Visits}\n"), S);
+		for (int C = 0; C < NumChoices; ++C)
+		{
+			const bool bConditional = C % 2 == 1;
+			if (bConditional)
+			{
+				Script.Appendf(TEXT("[if {Visits} > %d]\n"), C);
+			}
+			Script.Appendf(TEXT("    * Choice %d.%d\n"), S, C);
+			Script.Appendf(TEXT("        Player: Reply %d.%d\n"), S, C);
+			Script.Appendf(TEXT("        [goto s%d]\n"), Next);
+			if (bConditional)
+			{
+				Script.Append(TEXT("[endif]\n"));
+			}
+		}
+	}
+	return Script;
+}
+
+static int CountLines(const FString& Str)
+{
+	int Lines = 0;
+	for (const TCHAR C : Str)
+	{
+		if (C == '\n')
+			++Lines;
+	}
+	return Lines;
+}
+
+static USUDSScript* ImportPerfScript(FAutomationTestBase* T, const FString& Input, const ScopedStringTableHolder& StringTableHolder)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	T->TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(Input), Input.Len(), "PerfInput", &Logger, true));
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "PerfTest");
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+	return Script;
+}
+
+static double CyclesToMs(uint64 Cycles)
+{
+	return FPlatformTime::ToMilliseconds64(Cycles);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestPerformance,
+								 "SUDSTest.Performance",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::PerfFilter)
+
+
+bool FTestPerformance::RunTest(const FString& Parameters)
+{
+	FSUDSPerfSuite Suite;
+	const ScopedStringTableHolder StringTableHolder;
+
+	const FString BranchingInput = MakeBranchingPerfScript(200, 8);
+	const int NumLines = CountLines(BranchingInput);
+
+	// Import throughput
+	Suite.Measure("ImportLinesPerSec", "lines/s", true, [&]()
+	{
+		FSUDSMessageLogger Logger(false);
+		FSUDSScriptImporter Importer;
+		const uint64 Start = FPlatformTime::Cycles64();
+		Importer.ImportFromBuffer(GetData(BranchingInput), BranchingInput.Len(), "PerfInput", &Logger, true);
+		const double Secs = CyclesToMs(FPlatformTime::Cycles64() - Start) * 0.001;
+		return Secs > 0 ? NumLines / Secs : 0;
+	});
+
+	// Import throughput on a production-sized script, with gosubs, conditionals and nested choices
+	{
+		FSUDSScriptGeneratorSettings GenSettings;
+		GenSettings.TargetLines = 10000;
+		GenSettings.MaxGosubDepth = 4;
+		FSUDSScriptGenerator Generator(GenSettings);
+		const FString GeneratedInput = Generator.Generate();
+		const int GeneratedLines = Generator.GetNumLines();
+		Suite.Measure("ImportGenerated10kLinesPerSec", "lines/s", true, [&]()
+		{
+			FSUDSMessageLogger Logger(false);
+			FSUDSScriptImporter Importer;
+			const uint64 Start = FPlatformTime::Cycles64();
+			Importer.ImportFromBuffer(GetData(GeneratedInput), GeneratedInput.Len(), "PerfGenerated", &Logger, true);
+			const double Secs = CyclesToMs(FPlatformTime::Cycles64() - Start) * 0.001;
+			return Secs > 0 ? GeneratedLines / Secs : 0;
+		});
+
+		// Same, straight from UTF-8 as it would be on disk
+		const FTCHARToUTF8 GeneratedUTF8(*GeneratedInput);
+		Suite.Measure("ImportGenerated10kUTF8LinesPerSec", "lines/s", true, [&]()
+		{
+			FSUDSMessageLogger Logger(false);
+			FSUDSScriptImporter Importer;
+			const uint64 Start = FPlatformTime::Cycles64();
+			Importer.ImportFromUTF8Buffer(reinterpret_cast<const UTF8CHAR*>(GeneratedUTF8.Get()), GeneratedUTF8.Length(), "PerfGenerated", &Logger, true);
+			const double Secs = CyclesToMs(FPlatformTime::Cycles64() - Start) * 0.001;
+			return Secs > 0 ? GeneratedLines / Secs : 0;
+		});
+	}
+
+	// Expression evaluation
+	{
+		FSUDSExpression Expr;
+		TestTrue("Expression parse", Expr.ParseFromString("({x} + 3) * {y} > 10 and not {z}", nullptr));
+		TMap<FName, FSUDSValue> Vars;
+		Vars.Add("x", FSUDSValue(2));
+		Vars.Add("y", FSUDSValue(4.5f));
+		Vars.Add("z", FSUDSValue(false));
+		const int OpsPerSample = 10000;
+		// Results are accumulated so the evaluation can't be optimised away
+		int NumTrue = 0;
+		Suite.Measure("ExpressionEvalNs", "ns/op", false, [&]()
+		{
+			const uint64 Start = FPlatformTime::Cycles64();
+			for (int i = 0; i < OpsPerSample; ++i)
+			{
+				NumTrue += Expr.Evaluate(Vars, nullptr).GetBooleanValue() ? 1 : 0;
+			}
+			return CyclesToMs(FPlatformTime::Cycles64() - Start) * 1000000.0 / OpsPerSample;
+		});
+		TestTrue("Expression result", NumTrue > 0);
+	}
+
+	auto Script = ImportPerfScript(this, BranchingInput, StringTableHolder);
+
+	// Choose latency
+	{
+		auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+		Dlg->Start();
+		int ChoiceIdx = 0;
+		Suite.Measure("ChooseUs", "us", false, [&]()
+		{
+			if (Dlg->IsEnded())
+			{
+				Dlg->Restart();
+			}
+			const int NumChoices = Dlg->GetNumberOfChoices();
+			const int Idx = NumChoices > 0 ? ++ChoiceIdx % NumChoices : 0;
+			const uint64 Start = FPlatformTime::Cycles64();
+			// Choice, then continue from the player reply back to the next section, that's one "turn"
+			Dlg->Choose(Idx);
+			Dlg->Continue();
+			return CyclesToMs(FPlatformTime::Cycles64() - Start) * 1000.0;
+		});
+	}
+
+	// Save & restore
+	{
+		auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+		Dlg->Start();
+		for (int i = 0; i < 50; ++i)
+		{
+			Dlg->Choose(i % FMath::Max(1, Dlg->GetNumberOfChoices()));
+			Dlg->Continue();
+		}
+		FSUDSDialogueState State;
+		Suite.Measure("GetSavedStateUs", "us", false, [&]()
+		{
+			const uint64 Start = FPlatformTime::Cycles64();
+			State = Dlg->GetSavedState();
+			return CyclesToMs(FPlatformTime::Cycles64() - Start) * 1000.0;
+		});
+		Suite.Measure("RestoreSavedStateUs", "us", false, [&]()
+		{
+			const uint64 Start = FPlatformTime::Cycles64();
+			Dlg->RestoreSavedState(State);
+			return CyclesToMs(FPlatformTime::Cycles64() - Start) * 1000.0;
+		});
+	}
+
+	// Memory per dialogue, after some choices have been taken
+	Suite.Measure("DialogueBytes", "bytes", false, [&]()
+	{
+		auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+		Dlg->Start();
+		for (int i = 0; i < 20; ++i)
+		{
+			Dlg->Choose(0);
+			Dlg->Continue();
+		}
+		const double Bytes = Dlg->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+		Dlg->MarkAsGarbage();
+		return Bytes;
+	});
+
+	Suite.Report(this);
+
+	const FString ResultsPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Automation"), TEXT("SUDS"), TEXT("PerfResults.json"));
+	if (Suite.WriteJson(ResultsPath))
+	{
+		AddInfo(FString::Printf(TEXT("Wrote performance results to %s"), *FPaths::ConvertRelativePathToFull(ResultsPath)));
+	}
+	else
+	{
+		AddError(FString::Printf(TEXT("Unable to write performance results to %s"), *ResultsPath));
+	}
+
+	FString BaselinePath = CVarSUDSPerfBaseline.GetValueOnGameThread();
+	if (BaselinePath.IsEmpty())
+	{
+		if (auto Plugin = IPluginManager::Get().FindPlugin("SUDS"))
+		{
+			BaselinePath = FPaths::Combine(Plugin->GetBaseDir(), TEXT("Resources"), TEXT("PerfBaseline.json"));
+		}
+	}
+	if (!BaselinePath.IsEmpty())
+	{
+		Suite.CompareToBaseline(this, BaselinePath, CVarSUDSPerfRegressionThreshold.GetValueOnGameThread());
+	}
+
+	Script->MarkAsGarbage();
+	return true;
+}
@@ -3,6 +3,7 @@
 #include "SUDSMessageLogger.h"
 #include "SUDSScript.h"
 #include "SUDSScriptImporter.h"
+#include "SUDSSubsystem.h"
 #include "TestUtils.h"
 #include "Misc/AutomationTest.h"
 
@@ -353,6 +354,17 @@ bool FTestSpeakerNames::RunTest(const FString& Parameters)
 	TestTrue("Continue", Dlg->Continue());
 	TestDialogueText(this, "Text 4", Dlg, "NPC", "Aha!");
 	TestEqual("NPC speaker name should have changed", Dlg->GetSpeakerDisplayName().ToString(), "Actually A Villain");
+	TestEqual("Repeated speaker name should be the same", Dlg->GetSpeakerDisplayName().ToString(), "Actually A Villain");
+
+	// Speaker display names are cached per speaker, make sure changing / removing the variable mid-line is picked up
+	Dlg->SetVariableText("SpeakerName.NPC", FText::FromString("Changed From Code"));
+	TestEqual("NPC speaker name changed from code", Dlg->GetSpeakerDisplayName().ToString(), "Changed From Code");
+	Dlg->UnSetVariable("SpeakerName.NPC");
+	TestEqual("NPC speaker name unset", Dlg->GetSpeakerDisplayName().ToString(), "NPC");
+
+	// Speaker IDs are interned on the script
+	TestEqual("Speaker index", Script->GetSpeakerID(Script->GetSpeakers().IndexOfByKey("NPC")), FString("NPC"));
+	TestEqual("Speaker display name key", Script->GetSpeakerDisplayNameKey(Script->GetSpeakers().IndexOfByKey("NPC")), FName("SpeakerName.NPC"));
 
 
 	Script->MarkAsGarbage();
@@ -458,4 +470,345 @@ bool FTestLinesBetweenTextAndChoice::RunTest(const FString& Parameters)
 	return true;
 }
 
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestDialoguePooling,
+								 "SUDSTest.TestDialoguePooling",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestDialoguePooling::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(SetVariableRunnerInput), SetVariableRunnerInput.Len(), "SetVariableRunnerInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	// No game instance in tests, so just use a standalone subsystem
+	auto Sub = NewObject<USUDSSubsystem>();
+
+	auto Dlg = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TestDialogueText(this, "First acquire", Dlg, "Player", "Hello");
+	TestEqual("Header var", Dlg->GetVariableFloat("SomeFloat"), 12.5f);
+	TestTrue("Continue", Dlg->Continue());
+	TestDialogueText(this, "First acquire", Dlg, "NPC", "Wotcha");
+	TestEqual("Script var", Dlg->GetVariableInt("SomeInt"), 99);
+	Dlg->SetVariableInt("CodeInt", 5);
+	Dlg->SetEventDispatchMode(ESUDSEventDispatchMode::DeferredManual);
+
+	Sub->ReleaseDialogue(Dlg);
+	TestTrue("Released dialogue should be ended", Dlg->IsEnded());
+	TestEqual("Pooled", Sub->GetDialoguePoolStats().Pooled, 1);
+
+	auto Dlg2 = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TestEqual("Should have reused the instance", Dlg2, Dlg);
+	TestDialogueText(this, "Second acquire", Dlg2, "Player", "Hello");
+	TestFalse("Code var should have been reset", Dlg2->IsVariableSet("CodeInt"));
+	TestFalse("Script var should have been reset", Dlg2->IsVariableSet("SomeInt"));
+	TestEqual("Header var", Dlg2->GetVariableFloat("SomeFloat"), 12.5f);
+	TestTrue("Event dispatch mode should have been reset", Dlg2->GetEventDispatchMode() == ESUDSEventDispatchMode::Immediate);
+
+	// A second concurrent dialogue must be a new instance
+	auto Dlg3 = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TestNotEqual("Concurrent dialogue should be new", Dlg3, Dlg2);
+
+	auto Stats = Sub->GetDialoguePoolStats();
+	TestEqual("Acquired", Stats.Acquired, 3);
+	TestEqual("Created", Stats.Created, 2);
+	TestEqual("Reused", Stats.Reused, 1);
+	TestEqual("Pooled", Stats.Pooled, 0);
+
+	// Pool size limit
+	Sub->SetMaxPooledDialoguesPerScript(1);
+	Sub->ReleaseDialogue(Dlg2);
+	Sub->ReleaseDialogue(Dlg3);
+	Stats = Sub->GetDialoguePoolStats();
+	TestEqual("Released", Stats.Released, 3);
+	TestEqual("Discarded", Stats.Discarded, 1);
+	TestEqual("Pooled", Stats.Pooled, 1);
+
+	Sub->EmptyDialoguePools();
+	TestEqual("Pooled", Sub->GetDialoguePoolStats().Pooled, 0);
+
+	// Pooled dialogues must not keep their script alive, and pools for scripts which have gone are dropped
+	auto OtherScript = NewObject<USUDSScript>(GetTransientPackage(), "OtherTest");
+	Importer.PopulateAsset(OtherScript, StringTableHolder.StringTable);
+	auto OtherDlg = Sub->AcquireDialogue(OtherScript, TArray<UObject*>(), true);
+	Sub->ReleaseDialogue(OtherDlg);
+	TestNull("Released dialogue should not reference its script", OtherDlg->GetScript());
+	TestEqual("Pooled", Sub->GetDialoguePoolStats().Pooled, 1);
+	AddExpectedError("already released", EAutomationExpectedErrorFlags::Contains, 1);
+	Sub->ReleaseDialogue(OtherDlg);
+	TestEqual("Double release ignored", Sub->GetDialoguePoolStats().Pooled, 1);
+	OtherScript->MarkAsGarbage();
+	Sub->ReleaseDialogue(Sub->AcquireDialogue(Script, TArray<UObject*>(), true));
+	TestEqual("Pool for unloaded script pruned", Sub->GetDialoguePoolStats().Pooled, 1);
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString BudgetedExecutionInput = R"RAWSUD(
+NPC: Start
+[set Count 0]
+:loop
+[set Count {Count} + 1]
+[if {Count} < {Target}]
+	[goto loop]
+[endif]
+NPC: Counted to {Count}
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestBudgetedExecution,
+								 "SUDSTest.TestBudgetedExecution",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestBudgetedExecution::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(BudgetedExecutionInput), BudgetedExecutionInput.Len(), "BudgetedExecutionInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg->SetVariableInt("Target", 10);
+	Dlg->SetExecutionBudget(5, 0);
+	Dlg->Start();
+	TestDialogueText(this, "First line", Dlg, "NPC", "Start");
+	TestFalse("Nothing pending yet", Dlg->IsExecutionPending());
+
+	TestTrue("Continue", Dlg->Continue());
+	TestTrue("Should have yielded", Dlg->IsExecutionPending());
+	TestDialogueText(this, "Still on first line", Dlg, "NPC", "Start");
+	AddExpectedError("while execution is pending", EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse("Can't continue while pending", Dlg->Continue());
+
+	int Resumes = 0;
+	while (Dlg->ResumeExecution() && Resumes < 100)
+	{
+		++Resumes;
+	}
+	TestTrue("Should have needed several resumes", Resumes > 1);
+	TestFalse("Should have finished", Dlg->IsExecutionPending());
+	TestDialogueText(this, "Second line", Dlg, "NPC", "Counted to 10");
+
+	// Unlimited budget runs straight through
+	Dlg->SetExecutionBudget(0, 0);
+	Dlg->Restart();
+	TestTrue("Continue", Dlg->Continue());
+	TestFalse("Should not have yielded", Dlg->IsExecutionPending());
+	TestDialogueText(this, "Second line", Dlg, "NPC", "Counted to 10");
+
+	// Runaway loop
+	Dlg->SetRunawayStepLimit(100);
+	Dlg->SetVariableInt("Target", 1000000);
+	Dlg->Restart();
+	AddExpectedError("probably an infinite loop", EAutomationExpectedErrorFlags::Contains, 1);
+	TestFalse("Runaway should end dialogue", Dlg->Continue());
+	TestTrue("Runaway should end dialogue", Dlg->IsEnded());
+
+	// Restoring while pending must cancel the pending execution
+	Dlg->SetRunawayStepLimit(0);
+	Dlg->SetVariableInt("Target", 10);
+	Dlg->SetExecutionBudget(5, 0);
+	Dlg->Restart();
+	const FSUDSDialogueState SavedState = Dlg->GetSavedState();
+	TestTrue("Continue", Dlg->Continue());
+	TestTrue("Should have yielded", Dlg->IsExecutionPending());
+	Dlg->RestoreSavedState(SavedState);
+	TestFalse("Restore clears pending", Dlg->IsExecutionPending());
+	TestFalse("Nothing to resume", Dlg->ResumeExecution());
+	TestDialogueText(this, "Restored line", Dlg, "NPC", "Start");
+	Dlg->SetExecutionBudget(0, 0);
+	TestTrue("Can continue after restore", Dlg->Continue());
+	TestDialogueText(this, "Second line", Dlg, "NPC", "Counted to 10");
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString RunawayChoiceLookaheadInput = R"RAWSUD(
+[gosub sub]
+NPC: After sub
+[goto end]
+:sub
+NPC: In sub
+:spin
+[if {Spin}]
+	[goto spin]
+[endif]
+[return]
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestRunawayChoiceLookahead,
+								 "SUDSTest.TestRunawayChoiceLookahead",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestRunawayChoiceLookahead::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(RunawayChoiceLookaheadInput), RunawayChoiceLookaheadInput.Len(), "RunawayChoiceLookaheadInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	// Inside a gosub, the line looks ahead for choices, which runs into the loop
+	auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+	Dlg->SetRunawayStepLimit(100);
+	Dlg->SetVariableBoolean("Spin", true);
+	AddExpectedError("probably an infinite loop", EAutomationExpectedErrorFlags::Contains, 1);
+	Dlg->Start();
+	TestDialogueText(this, "Line in sub", Dlg, "NPC", "In sub");
+	TestEqual("No choices found", Dlg->GetNumberOfChoices(), 1);
+	TestTrue("Simple continue", Dlg->IsSimpleContinue());
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
+const FString AmbientDialogueInput = R"RAWSUD(
+NPC: Line A
+NPC: Line B
+)RAWSUD";
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestAmbientDialogues,
+								 "SUDSTest.TestAmbientDialogues",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestAmbientDialogues::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(AmbientDialogueInput), AmbientDialogueInput.Len(), "AmbientDialogueInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	// No game instance in tests, so use a standalone subsystem and tick it manually
+	auto Sub = NewObject<USUDSSubsystem>();
+	auto Low = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	auto High = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	auto Mid = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	Sub->AddAmbientDialogue(Low, 1.f, 0.f);
+	Sub->AddAmbientDialogue(High, 1.f, 5.f);
+	Sub->AddAmbientDialogue(Mid, 1.f, 1.f);
+	TestEqual("Active", Sub->GetAmbientDialogueMetrics().ActiveCount, 3);
+
+	Sub->Tick(0.5f);
+	TestEqual("Nothing due yet", Sub->GetAmbientDialogueMetrics().StepsLastFrame, 0);
+
+	// Zero budget still steps one dialogue per frame, highest priority first
+	Sub->SetAmbientStepBudget(0);
+	Sub->Tick(0.6f);
+	TestEqual("Steps", Sub->GetAmbientDialogueMetrics().StepsLastFrame, 1);
+	TestEqual("Deferred", Sub->GetAmbientDialogueMetrics().DeferredLastFrame, 2);
+	TestDialogueText(this, "High priority stepped", High, "NPC", "Line B");
+	TestDialogueText(this, "Mid priority deferred", Mid, "NPC", "Line A");
+
+	Sub->Tick(0.f);
+	TestDialogueText(this, "Mid priority stepped", Mid, "NPC", "Line B");
+	TestDialogueText(this, "Low priority deferred", Low, "NPC", "Line A");
+	TestEqual("Max deferred frames", Sub->GetAmbientDialogueMetrics().MaxDeferredFrames, 2);
+
+	Sub->SetAmbientStepBudget(1000.f);
+	Sub->Tick(0.f);
+	TestDialogueText(this, "Low priority stepped", Low, "NPC", "Line B");
+
+	// All finish, and go back to the pool
+	Sub->Tick(1.1f);
+	const auto Metrics = Sub->GetAmbientDialogueMetrics();
+	TestEqual("Steps", Metrics.StepsLastFrame, 3);
+	TestEqual("Active", Metrics.ActiveCount, 0);
+	TestEqual("Total steps", Metrics.TotalSteps, 6);
+	TestEqual("Released to pool", Sub->GetDialoguePoolStats().Pooled, 3);
+	
+	Script->MarkAsGarbage();
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestAmbientDialogueRelease,
+								 "SUDSTest.TestAmbientDialogueRelease",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+
+bool FTestAmbientDialogueRelease::RunTest(const FString& Parameters)
+{
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(AmbientDialogueInput), AmbientDialogueInput.Len(), "AmbientDialogueInput", &Logger, true));
+
+	auto Script = NewObject<USUDSScript>(GetTransientPackage(), "Test");
+	const ScopedStringTableHolder StringTableHolder;
+	Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+
+	auto Sub = NewObject<USUDSSubsystem>();
+
+	// Releasing an ambient dialogue must stop it being stepped, even if it's handed out again before the next tick
+	auto Bark = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	Sub->AddAmbientDialogue(Bark, 1.f);
+	Sub->ReleaseDialogue(Bark);
+	TestEqual("No longer ambient", Sub->GetAmbientDialogueMetrics().ActiveCount, 0);
+	auto Reacquired = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TestTrue("Same dialogue reused", Reacquired == Bark);
+	Sub->Tick(1.1f);
+	TestEqual("Nothing stepped", Sub->GetAmbientDialogueMetrics().StepsLastFrame, 0);
+	TestDialogueText(this, "New owner's dialogue untouched", Reacquired, "NPC", "Line A");
+	Sub->Tick(1.1f);
+	TestFalse("Still running for the new owner", Reacquired->IsEnded());
+	TestEqual("Not put back in the pool", Sub->GetDialoguePoolStats().Pooled, 0);
+	Sub->ReleaseDialogue(Reacquired);
+
+	// Notifications are held back until every due dialogue has been stepped
+	auto A = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	auto B = Sub->AcquireDialogue(Script, TArray<UObject*>(), true);
+	TArray<int> StepsWhenNotified;
+	for (auto Dlg : { A, B })
+	{
+		Dlg->OnSpeakerLineNative.AddLambda([Sub, &StepsWhenNotified](USUDSDialogue*)
+		{
+			StepsWhenNotified.Add(Sub->GetAmbientDialogueMetrics().StepsLastFrame);
+		});
+		Sub->AddAmbientDialogue(Dlg, 1.f);
+	}
+	Sub->Tick(1.1f);
+	TestEqual("Both stepped", Sub->GetAmbientDialogueMetrics().StepsLastFrame, 2);
+	if (TestEqual("Both notified", StepsWhenNotified.Num(), 2))
+	{
+		TestEqual("A notified after stepping", StepsWhenNotified[0], 2);
+		TestEqual("B notified after stepping", StepsWhenNotified[1], 2);
+	}
+	TestDialogueText(this, "A stepped", A, "NPC", "Line B");
+	TestDialogueText(this, "B stepped", B, "NPC", "Line B");
+	TestTrue("A dispatch mode restored", A->GetEventDispatchMode() == ESUDSEventDispatchMode::Immediate);
+	TestEqual("Nothing left queued", A->GetNumQueuedEvents() + B->GetNumQueuedEvents(), 0);
+
+	Script->MarkAsGarbage();
+	return true;
+}
+
 PRAGMA_ENABLE_OPTIMIZATION
\ No newline at end of file
@@ -0,0 +1,431 @@
+﻿#include "SUDSBatchImporter.h"
+#include "SUDSLibrary.h"
+#include "SUDSMessageLogger.h"
+#include "SUDSScript.h"
+#include "SUDSScriptImporter.h"
+#include "TestScriptGenerator.h"
+#include "TestUtils.h"
+#include "HAL/MemoryBase.h"
+#include "Misc/FileHelper.h"
+
+PRAGMA_DISABLE_OPTIMIZATION
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestScriptGenerator,
+								 "SUDSTest.TestScriptGenerator",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestScriptGenerator::RunTest(const FString& Parameters)
+{
+	FSUDSScriptGeneratorSettings Settings;
+	Settings.Seed = 42;
+	Settings.TargetLines = 500;
+
+	// Same seed, same script
+	const FString Script1 = FSUDSScriptGenerator(Settings).Generate();
+	const FString Script2 = FSUDSScriptGenerator(Settings).Generate();
+	TestEqual("Same seed should be deterministic", Script1, Script2);
+	Settings.Seed = 43;
+	const FString Script3 = FSUDSScriptGenerator(Settings).Generate();
+	TestNotEqual("Different seed should differ", Script1, Script3);
+
+	// A spread of shapes should all import cleanly and run to the end
+	const ScopedStringTableHolder StringTableHolder;
+	for (int32 Seed = 1; Seed <= 5; ++Seed)
+	{
+		Settings.Seed = Seed;
+		Settings.ChoiceFanOut = 1 + Seed;
+		Settings.MaxChoiceDepth = Seed % 3;
+		Settings.MaxConditionalDepth = Seed % 4;
+		Settings.MaxGosubDepth = Seed % 3;
+		Settings.NumVariables = 2 * Seed;
+		Settings.TextParameterDensity = 0.2f * Seed;
+		FSUDSScriptGenerator Generator(Settings);
+		const FString Input = Generator.Generate();
+		TestTrue("Should generate at least the target lines", Generator.GetNumLines() >= Settings.TargetLines);
+
+		FSUDSMessageLogger Logger(false);
+		FSUDSScriptImporter Importer;
+		const FString Name = FString::Printf(TEXT("Generated%d"), Seed);
+		if (!TestTrue(Name + " should import", Importer.ImportFromBuffer(GetData(Input), Input.Len(), Name, &Logger, true)))
+		{
+			AddInfo(Input);
+			continue;
+		}
+		TestEqual(Name + " errors", Logger.NumErrors(), 0);
+
+		auto Script = NewObject<USUDSScript>(GetTransientPackage(), FName(*Name));
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+		auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+		RunGeneratedDialogue(Dlg, Seed, 100000);
+		TestTrue(Name + " should run to the end", Dlg->IsEnded());
+		Script->MarkAsGarbage();
+	}
+
+	return true;
+}
+
+/// Count the body nodes in an importer
+static int CountParsedNodes(FSUDSScriptImporter& Importer)
+{
+	int Count = 0;
+	while (Importer.GetNode(Count))
+	{
+		++Count;
+	}
+	return Count;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestBatchParse,
+								 "SUDSTest.BatchParse",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::ProductFilter)
+
+
+bool FTestBatchParse::RunTest(const FString& Parameters)
+{
+	// Parsing on worker threads should give exactly the same results as parsing one at a time
+	const FString Dir = FPaths::AutomationTransientDir() / TEXT("SUDSBatchParse");
+	TArray<FString> Filenames;
+	TArray<FString> Names;
+	TArray<FString> Sources;
+	for (int32 Seed = 1; Seed <= 8; ++Seed)
+	{
+		FSUDSScriptGeneratorSettings Settings;
+		Settings.Seed = Seed;
+		Settings.TargetLines = 500;
+		Sources.Add(FSUDSScriptGenerator(Settings).Generate());
+		Names.Add(FString::Printf(TEXT("Batch%d"), Seed));
+		Filenames.Add(Dir / Names.Last() + TEXT(".sud"));
+		TestTrue("Should write source", FFileHelper::SaveStringToFile(Sources.Last(), *Filenames.Last(), FFileHelper::EEncodingOptions::ForceUTF8));
+	}
+	// Missing files should fail cleanly
+	Filenames.Add(Dir / TEXT("DoesNotExist.sud"));
+	Names.Add(TEXT("DoesNotExist"));
+
+	TArray<TUniquePtr<FSUDSBatchImporter::FParseResult>> Results;
+	FSUDSBatchImporter::ParseFiles(Filenames, Names, Results);
+	if (!TestEqual("Result count", Results.Num(), Filenames.Num()))
+		return false;
+
+	for (int i = 0; i < Sources.Num(); ++i)
+	{
+		auto& Result = *Results[i];
+		TestTrue(Names[i] + " should load", Result.bLoaded);
+		TestTrue(Names[i] + " should parse", Result.bParsed);
+		TestEqual(Names[i] + " errors", Result.Logger.NumErrors(), 0);
+		TestTrue(Names[i] + " hash", Result.Hash == FMD5Hash::HashFile(*Filenames[i]));
+
+		FSUDSMessageLogger Logger(false);
+		FSUDSScriptImporter SerialImporter;
+		SerialImporter.ImportFromBuffer(*Sources[i], Sources[i].Len(), Names[i], &Logger, true);
+		const int NumNodes = CountParsedNodes(SerialImporter);
+		if (TestEqual(Names[i] + " node count", CountParsedNodes(Result.Importer), NumNodes))
+		{
+			for (int n = 0; n < NumNodes; ++n)
+			{
+				const FSUDSParsedNode* A = Result.Importer.GetNode(n);
+				const FSUDSParsedNode* B = SerialImporter.GetNode(n);
+				if (A->NodeType != B->NodeType || A->Edges.Num() != B->Edges.Num() || !A->Text.Equals(B->Text))
+				{
+					AddError(FString::Printf(TEXT("%s node %d differs between batch & serial parse"), *Names[i], n));
+					break;
+				}
+			}
+		}
+	}
+	TestFalse("Missing file should not load", Results.Last()->bLoaded);
+	TestEqual("Missing file should log an error", Results.Last()->Logger.NumErrors(), 1);
+
+	// Source already loaded by the caller (e.g. the compile commandlet after hashing) must not be read again
+	{
+		TArray<TUniquePtr<FSUDSBatchImporter::FParseResult>> Preloaded;
+		TUniquePtr<FSUDSBatchImporter::FParseResult> Result = MakeUnique<FSUDSBatchImporter::FParseResult>();
+		Result->Filename = Dir / TEXT("NotOnDisk.sud");
+		Result->NameForErrors = TEXT("Preloaded");
+		const FTCHARToUTF8 UTF8Source(*Sources[0]);
+		Result->SourceBytes.Append(reinterpret_cast<const uint8*>(UTF8Source.Get()), UTF8Source.Length());
+		Result->Hash = FSUDSScriptImporter::CalculateHash(Result->SourceBytes);
+		Result->bLoaded = true;
+		Preloaded.Add(MoveTemp(Result));
+		FSUDSBatchImporter::ParseResults(Preloaded);
+		TestTrue("Preloaded source should parse", Preloaded[0]->bParsed);
+		TestEqual("Preloaded source should not log errors", Preloaded[0]->Logger.NumErrors(), 0);
+		TestEqual("Preloaded node count", CountParsedNodes(Preloaded[0]->Importer), CountParsedNodes(Results[0]->Importer));
+		TestEqual("Source bytes should be released after parsing", Preloaded[0]->SourceBytes.Num(), 0);
+	}
+
+	IFileManager::Get().DeleteDirectory(*Dir, false, true);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestScriptScaling,
+								 "SUDSTest.ScriptScaling",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::PerfFilter)
+
+
+bool FTestScriptScaling::RunTest(const FString& Parameters)
+{
+	// How import & runtime cost scales with script size
+	const ScopedStringTableHolder StringTableHolder;
+	const int Sizes[] = { 1000, 2500, 5000, 10000 };
+	for (const int Size : Sizes)
+	{
+		FSUDSScriptGeneratorSettings Settings;
+		Settings.Seed = 1234;
+		Settings.TargetLines = Size;
+		Settings.MaxGosubDepth = 4;
+		FSUDSScriptGenerator Generator(Settings);
+		const FString Input = Generator.Generate();
+
+		FSUDSMessageLogger Logger(false);
+		FSUDSScriptImporter Importer;
+		double StartTime = FPlatformTime::Seconds();
+		const bool bImported = Importer.ImportFromBuffer(GetData(Input), Input.Len(), "Scaling", &Logger, true);
+		const double ImportTime = FPlatformTime::Seconds() - StartTime;
+		if (!TestTrue("Import should succeed", bImported))
+			continue;
+
+		auto Script = NewObject<USUDSScript>(GetTransientPackage(), FName(*FString::Printf(TEXT("Scaling%d"), Size)));
+		StartTime = FPlatformTime::Seconds();
+		Importer.PopulateAsset(Script, StringTableHolder.StringTable);
+		const double PopulateTime = FPlatformTime::Seconds() - StartTime;
+
+		auto Dlg = USUDSLibrary::CreateDialogue(Script, Script);
+		StartTime = FPlatformTime::Seconds();
+		const int Steps = RunGeneratedDialogue(Dlg, Settings.Seed, 1000000);
+		const double RunTime = FPlatformTime::Seconds() - StartTime;
+
+		AddInfo(FString::Printf(TEXT("%d lines: import %.2fms, populate %.2fms, %d steps in %.2fms (%.2fus/step)"),
+		                        Generator.GetNumLines(),
+		                        ImportTime * 1000.0,
+		                        PopulateTime * 1000.0,
+		                        Steps,
+		                        RunTime * 1000.0,
+		                        Steps > 0 ? RunTime * 1000000.0 / Steps : 0.0));
+		Script->MarkAsGarbage();
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestImportScaling,
+								 "SUDSTest.ImportScaling",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::PerfFilter)
+
+
+bool FTestImportScaling::RunTest(const FString& Parameters)
+{
+	// Import time per line should stay roughly flat as scripts grow; each doubling of size should roughly double the
+	// time, not quadruple it. Fallthrough resolution used to scan forward from every dead end, which did not scale.
+	const int Sizes[] = { 4000, 8000, 16000, 32000 };
+	const int Repeats = 3;
+	TArray<double> MicrosecondsPerLine;
+	for (const int Size : Sizes)
+	{
+		FSUDSScriptGeneratorSettings Settings;
+		Settings.Seed = 5678;
+		Settings.TargetLines = Size;
+		Settings.MaxConditionalDepth = 3;
+		FSUDSScriptGenerator Generator(Settings);
+		const FString Input = Generator.Generate();
+
+		// Best of a few runs, to reduce noise
+		double BestTime = TNumericLimits<double>::Max();
+		for (int i = 0; i < Repeats; ++i)
+		{
+			FSUDSMessageLogger Logger(false);
+			FSUDSScriptImporter Importer;
+			const double StartTime = FPlatformTime::Seconds();
+			const bool bImported = Importer.ImportFromBuffer(GetData(Input), Input.Len(), "ImportScaling", &Logger, true);
+			BestTime = FMath::Min(BestTime, FPlatformTime::Seconds() - StartTime);
+			TestTrue("Import should succeed", bImported);
+		}
+
+		const double PerLine = BestTime * 1000000.0 / Generator.GetNumLines();
+		MicrosecondsPerLine.Add(PerLine);
+		AddInfo(FString::Printf(TEXT("%d lines: import %.2fms (%.3fus/line)"),
+		                        Generator.GetNumLines(),
+		                        BestTime * 1000.0,
+		                        PerLine));
+	}
+
+	// 8x the lines; quadratic growth would make the per-line cost ~8x. Allow generous headroom for noise.
+	const double Growth = MicrosecondsPerLine.Last() / FMath::Max(MicrosecondsPerLine[0], UE_DOUBLE_SMALL_NUMBER);
+	AddInfo(FString::Printf(TEXT("Per-line import cost growth over %dx lines: %.2fx"), Sizes[UE_ARRAY_COUNT(Sizes) - 1] / Sizes[0], Growth));
+	TestTrue("Import time should grow roughly linearly with script size", Growth < 3.0);
+
+	return true;
+}
+
+/// Counts heap allocations made on this thread while in scope, by standing in for GMalloc and forwarding everything.
+/// Other threads keep allocating through it too, they just aren't counted.
+class FScopedAllocationCounter : public FMalloc
+{
+public:
+	FScopedAllocationCounter() : Inner(GMalloc), ThreadId(FPlatformTLS::GetCurrentThreadId())
+	{
+		GMalloc = this;
+	}
+
+	virtual ~FScopedAllocationCounter() override
+	{
+		GMalloc = Inner;
+	}
+
+	int64 GetNumAllocations() const { return NumAllocations; }
+
+	virtual void* Malloc(SIZE_T Size, uint32 Alignment) override
+	{
+		CountAllocation();
+		return Inner->Malloc(Size, Alignment);
+	}
+
+	virtual void* TryMalloc(SIZE_T Size, uint32 Alignment) override
+	{
+		CountAllocation();
+		return Inner->TryMalloc(Size, Alignment);
+	}
+
+	virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override
+	{
+		if (Size > 0)
+		{
+			CountAllocation();
+		}
+		return Inner->Realloc(Original, Size, Alignment);
+	}
+
+	virtual void* TryRealloc(void* Original, SIZE_T Size, uint32 Alignment) override
+	{
+		if (Size > 0)
+		{
+			CountAllocation();
+		}
+		return Inner->TryRealloc(Original, Size, Alignment);
+	}
+
+	virtual void Free(void* Original) override { Inner->Free(Original); }
+	virtual SIZE_T QuantizeSize(SIZE_T Size, uint32 Alignment) override { return Inner->QuantizeSize(Size, Alignment); }
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+	virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+	virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+	virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+	virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+protected:
+	void CountAllocation()
+	{
+		if (FPlatformTLS::GetCurrentThreadId() == ThreadId)
+		{
+			++NumAllocations;
+		}
+	}
+
+	FMalloc* Inner;
+	uint32 ThreadId;
+	int64 NumAllocations = 0;
+};
+
+/// Copy every string in a parse tree into its own FString, the way parsed nodes used to store them
+static void CopyParsedStrings(FSUDSScriptImporter& Importer, TArray<FString>& OutStrings)
+{
+	auto AddString = [&OutStrings](const FStringView& Str)
+	{
+		if (!Str.IsEmpty())
+		{
+			OutStrings.Emplace(Str);
+		}
+	};
+	for (bool bHeader : { true, false })
+	{
+		int Idx = 0;
+		while (const FSUDSParsedNode* Node = bHeader ? Importer.GetHeaderNode(Idx) : Importer.GetNode(Idx))
+		{
+			AddString(Node->Identifier);
+			AddString(Node->Text);
+			AddString(Node->TextID);
+			for (const auto& Edge : Node->Edges)
+			{
+				AddString(Edge.Text);
+				AddString(Edge.TextID);
+			}
+			++Idx;
+		}
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTestImportMemory,
+								 "SUDSTest.ImportMemory",
+								 EAutomationTestFlags::EditorContext |
+								 EAutomationTestFlags::ClientContext |
+								 EAutomationTestFlags::PerfFilter)
+
+
+bool FTestImportMemory::RunTest(const FString& Parameters)
+{
+	// Memory held by the parse tree after importing a large script
+	FSUDSScriptGeneratorSettings Settings;
+	Settings.Seed = 91011;
+	Settings.TargetLines = 10000;
+	FSUDSScriptGenerator Generator(Settings);
+	const FString Input = Generator.Generate();
+
+	const FPlatformMemoryStats StatsBefore = FPlatformMemory::GetStats();
+	FSUDSMessageLogger Logger(false);
+	FSUDSScriptImporter Importer;
+	int64 ImportAllocations = 0;
+	{
+		FScopedAllocationCounter Counter;
+		TestTrue("Import should succeed", Importer.ImportFromBuffer(GetData(Input), Input.Len(), "ImportMemory", &Logger, true));
+		ImportAllocations = Counter.GetNumAllocations();
+	}
+	const FPlatformMemoryStats StatsAfter = FPlatformMemory::GetStats();
+
+	const SIZE_T SourceBytes = Input.Len() * sizeof(TCHAR);
+	const SIZE_T ParsedBytes = Importer.GetAllocatedSize();
+	AddInfo(FString::Printf(TEXT("%d lines (%.1fKB source): parse tree %.1fKB (%.2fx source), process used physical delta %.1fKB"),
+	                        Generator.GetNumLines(),
+	                        SourceBytes / 1024.0,
+	                        ParsedBytes / 1024.0,
+	                        static_cast<double>(ParsedBytes) / FMath::Max<SIZE_T>(SourceBytes, 1),
+	                        (static_cast<double>(StatsAfter.UsedPhysical) - static_cast<double>(StatsBefore.UsedPhysical)) / 1024.0));
+
+	// Parsed strings are views into one copy of the source, plus a little for generated IDs etc, so the tree should
+	// stay proportionate to the source (the node structures themselves are most of it)
+	TestTrue("Parse tree should be proportionate to the source", ParsedBytes < SourceBytes * 20);
+
+	// The old layout had an FString per parsed string; measure what that costs on top of the import today
+	TArray<FString> Strings;
+	Strings.Reserve(Generator.GetNumLines() * 4);
+	int64 StringAllocations = 0;
+	{
+		FScopedAllocationCounter Counter;
+		CopyParsedStrings(Importer, Strings);
+		StringAllocations = Counter.GetNumAllocations();
+	}
+	const int32 ArenaBlocks = Importer.GetStringArena().GetNumBlocks();
+	AddInfo(FString::Printf(TEXT("Import made %lld heap allocations (%.2f per line). Parsed strings: %d in %d arena blocks, ")
+	                        TEXT("vs %lld allocations as separate FStrings; arena saves %.1f%% of the old total"),
+	                        ImportAllocations,
+	                        static_cast<double>(ImportAllocations) / FMath::Max(Generator.GetNumLines(), 1),
+	                        Strings.Num(),
+	                        ArenaBlocks,
+	                        StringAllocations,
+	                        100.0 * (StringAllocations - ArenaBlocks) / FMath::Max<int64>(ImportAllocations + StringAllocations - ArenaBlocks, 1)));
+
+	TestTrue("Separate FStrings should need an allocation each", StringAllocations >= Strings.Num());
+	TestTrue("Arena should hold all parsed strings in a handful of blocks", ArenaBlocks * 100 < StringAllocations);
+
+	return true;
+}
+
+PRAGMA_ENABLE_OPTIMIZATION
@@ -0,0 +1,202 @@
+﻿#include "TestScriptGenerator.h"
+
+FSUDSScriptGenerator::FSUDSScriptGenerator(const FSUDSScriptGeneratorSettings& InSettings)
+	: Settings(InSettings),
+	  Rand(InSettings.Seed)
+{
+	Settings.NumVariables = FMath::Max(1, Settings.NumVariables);
+	Settings.ChoiceFanOut = FMath::Max(1, Settings.ChoiceFanOut);
+	Settings.SubroutinesPerLevel = FMath::Max(1, Settings.SubroutinesPerLevel);
+}
+
+FString FSUDSScriptGenerator::Generate()
+{
+	Rand.Initialize(Settings.Seed);
+	Out.Reset();
+	NumLines = 0;
+	TextCounter = 0;
+	EventCounter = 0;
+
+	for (int i = 0; i < Settings.NumVariables; ++i)
+	{
+		EmitLine(0, FString::Printf(TEXT("[set v%d %d]"), i, Rand.RandRange(0, 5)));
+	}
+	EmitSpeakerLine(0);
+
+	// Main flow gets most of the lines, the rest are shared between subroutines
+	const int NumSubroutines = Settings.MaxGosubDepth * Settings.SubroutinesPerLevel;
+	const int MainLines = NumSubroutines > 0 ? Settings.TargetLines * 4 / 5 : Settings.TargetLines;
+	while (NumLines < MainLines)
+	{
+		EmitBlock(0, 0, 0, 0);
+	}
+	EmitLine(0, TEXT("[goto end]"));
+
+	if (NumSubroutines > 0)
+	{
+		const int LinesPerSub = FMath::Max(3, (Settings.TargetLines - NumLines) / NumSubroutines);
+		for (int Level = 1; Level <= Settings.MaxGosubDepth; ++Level)
+		{
+			for (int i = 0; i < Settings.SubroutinesPerLevel; ++i)
+			{
+				EmitLine(0, TEXT(""));
+				EmitLine(0, FString::Printf(TEXT(":%s"), *SubroutineLabel(Level, i)));
+				const int SubEnd = NumLines + LinesPerSub;
+				EmitSpeakerLine(0);
+				while (NumLines < SubEnd)
+				{
+					EmitBlock(0, 0, 0, Level);
+				}
+				EmitLine(0, TEXT("[return]"));
+			}
+		}
+	}
+
+	return Out;
+}
+
+void FSUDSScriptGenerator::EmitLine(int Indent, const FString& Line)
+{
+	for (int i = 0; i < Indent; ++i)
+	{
+		Out.AppendChar(' ');
+	}
+	Out.Append(Line);
+	Out.AppendChar('\n');
+	++NumLines;
+}
+
+void FSUDSScriptGenerator::EmitBlock(int Indent, int ConditionalDepth, int ChoiceDepth, int GosubLevel)
+{
+	const float R = Rand.GetFraction();
+	if (R < 0.15f && ChoiceDepth < Settings.MaxChoiceDepth)
+	{
+		EmitChoices(Indent, ConditionalDepth, ChoiceDepth, GosubLevel);
+	}
+	else if (R < 0.27f && ConditionalDepth < Settings.MaxConditionalDepth)
+	{
+		EmitConditional(Indent, ConditionalDepth, ChoiceDepth, GosubLevel);
+	}
+	else if (R < 0.35f && GosubLevel < Settings.MaxGosubDepth)
+	{
+		EmitGosub(Indent, GosubLevel);
+	}
+	else if (R < 0.45f)
+	{
+		EmitSet(Indent);
+	}
+	else if (R < 0.5f)
+	{
+		EmitEvent(Indent);
+	}
+	else
+	{
+		EmitSpeakerLine(Indent);
+	}
+}
+
+void FSUDSScriptGenerator::EmitBody(int Indent, int NumBlocks, int ConditionalDepth, int ChoiceDepth, int GosubLevel)
+{
+	// Always start with a speaker line so a body is never just a condition or another choice
+	EmitSpeakerLine(Indent);
+	for (int i = 1; i < NumBlocks; ++i)
+	{
+		EmitBlock(Indent, ConditionalDepth, ChoiceDepth, GosubLevel);
+	}
+}
+
+void FSUDSScriptGenerator::EmitSpeakerLine(int Indent)
+{
+	const TCHAR* Speaker = (TextCounter % 2) ? TEXT("Player") : TEXT("NPC");
+	if (Rand.GetFraction() < Settings.TextParameterDensity)
+	{
+		EmitLine(Indent, FString::Printf(TEXT("%s: Line %d has value {%s}"), Speaker, TextCounter, *RandomVariable()));
+	}
+	else
+	{
+		EmitLine(Indent, FString::Printf(TEXT("%s: Line %d"), Speaker, TextCounter));
+	}
+	++TextCounter;
+}
+
+void FSUDSScriptGenerator::EmitSet(int Indent)
+{
+	if (Rand.GetFraction() < 0.5f)
+	{
+		EmitLine(Indent, FString::Printf(TEXT("[set %s %d]"), *RandomVariable(), Rand.RandRange(0, 10)));
+	}
+	else
+	{
+		EmitLine(Indent, FString::Printf(TEXT("[set %s {%s} + %d]"), *RandomVariable(), *RandomVariable(), Rand.RandRange(1, 3)));
+	}
+}
+
+void FSUDSScriptGenerator::EmitEvent(int Indent)
+{
+	EmitLine(Indent, FString::Printf(TEXT("[event Event%d {%s}, \"Arg\", %d]"), EventCounter++, *RandomVariable(), Rand.RandRange(0, 100)));
+}
+
+void FSUDSScriptGenerator::EmitConditional(int Indent, int ConditionalDepth, int ChoiceDepth, int GosubLevel)
+{
+	EmitLine(Indent, FString::Printf(TEXT("[if %s]"), *RandomCondition()));
+	EmitBody(Indent + 4, Rand.RandRange(1, 3), ConditionalDepth + 1, ChoiceDepth, GosubLevel);
+	if (Rand.GetFraction() < 0.5f)
+	{
+		EmitLine(Indent, FString::Printf(TEXT("[elseif %s]"), *RandomCondition()));
+		EmitBody(Indent + 4, Rand.RandRange(1, 3), ConditionalDepth + 1, ChoiceDepth, GosubLevel);
+	}
+	if (Rand.GetFraction() < 0.5f)
+	{
+		EmitLine(Indent, TEXT("[else]"));
+		EmitBody(Indent + 4, Rand.RandRange(1, 3), ConditionalDepth + 1, ChoiceDepth, GosubLevel);
+	}
+	EmitLine(Indent, TEXT("[endif]"));
+}
+
+void FSUDSScriptGenerator::EmitChoices(int Indent, int ConditionalDepth, int ChoiceDepth, int GosubLevel)
+{
+	EmitSpeakerLine(Indent);
+	for (int c = 0; c < Settings.ChoiceFanOut; ++c)
+	{
+		// First choice is always available
+		const bool bConditional = c > 0 && Rand.GetFraction() < 0.3f;
+		if (bConditional)
+		{
+			EmitLine(Indent, FString::Printf(TEXT("[if %s]"), *RandomCondition()));
+		}
+		EmitLine(Indent + 4, FString::Printf(TEXT("* Choice %d"), TextCounter++));
+		EmitBody(Indent + 8, Rand.RandRange(1, 3), ConditionalDepth, ChoiceDepth + 1, GosubLevel);
+		if (bConditional)
+		{
+			EmitLine(Indent, TEXT("[endif]"));
+		}
+	}
+	// Choices fall through to here; a speaker line keeps anything after unambiguous
+	EmitSpeakerLine(Indent);
+}
+
+void FSUDSScriptGenerator::EmitGosub(int Indent, int GosubLevel)
+{
+	EmitLine(Indent, FString::Printf(TEXT("[gosub %s]"), *SubroutineLabel(GosubLevel + 1, Rand.RandRange(0, Settings.SubroutinesPerLevel - 1))));
+}
+
+FString FSUDSScriptGenerator::RandomVariable()
+{
+	return FString::Printf(TEXT("v%d"), Rand.RandRange(0, Settings.NumVariables - 1));
+}
+
+FString FSUDSScriptGenerator::RandomCondition()
+{
+	static const TCHAR* Ops[] = { TEXT(">"), TEXT("<"), TEXT("=="), TEXT(">="), TEXT("!=") };
+	const FString Cond = FString::Printf(TEXT("{%s} %s %d"), *RandomVariable(), Ops[Rand.RandRange(0, UE_ARRAY_COUNT(Ops) - 1)], Rand.RandRange(0, 10));
+	if (Rand.GetFraction() < 0.3f)
+	{
+		return FString::Printf(TEXT("%s and {%s} < %d"), *Cond, *RandomVariable(), Rand.RandRange(0, 10));
+	}
+	return Cond;
+}
+
+FString FSUDSScriptGenerator::SubroutineLabel(int Level, int Index)
+{
+	return FString::Printf(TEXT("sub%d_%d"), Level, Index);
+}
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/RandomStream.h"
+
+/// Settings for FSUDSScriptGenerator
+struct FSUDSScriptGeneratorSettings
+{
+	/// Same seed + settings always produces the same script
+	int32 Seed = 1;
+	/// Approximate number of lines to generate (the result will be a little over this)
+	int TargetLines = 1000;
+	/// Number of choices under each choice line
+	int ChoiceFanOut = 3;
+	/// How deeply choices can be nested inside other choices
+	int MaxChoiceDepth = 2;
+	/// How deeply [if] blocks (select nodes) can be nested
+	int MaxConditionalDepth = 2;
+	/// How many levels of [gosub] calls there are; 0 for no subroutines
+	int MaxGosubDepth = 2;
+	/// Number of subroutines at each gosub level
+	int SubroutinesPerLevel = 3;
+	/// Number of distinct variables used in conditions, sets, events and text
+	int NumVariables = 8;
+	/// Probability (0-1) that a speaker line includes a variable parameter
+	float TextParameterDensity = 0.3f;
+};
+
+/**
+ * Generates valid .sud script text for scale testing, with a deterministic structure driven by a seed.
+ * Flow always moves forward (no loops), and gosubs only call deeper levels, so running any path will end.
+ */
+class FSUDSScriptGenerator
+{
+public:
+	explicit FSUDSScriptGenerator(const FSUDSScriptGeneratorSettings& InSettings);
+
+	/// Generate the script text
+	FString Generate();
+
+	/// Number of lines in the last generated script
+	int GetNumLines() const { return NumLines; }
+
+protected:
+	FSUDSScriptGeneratorSettings Settings;
+	FRandomStream Rand;
+	FString Out;
+	int NumLines = 0;
+	int TextCounter = 0;
+	int EventCounter = 0;
+
+	void EmitLine(int Indent, const FString& Line);
+	void EmitBlock(int Indent, int ConditionalDepth, int ChoiceDepth, int GosubLevel);
+	void EmitSpeakerLine(int Indent);
+	void EmitSet(int Indent);
+	void EmitEvent(int Indent);
+	void EmitConditional(int Indent, int ConditionalDepth, int ChoiceDepth, int GosubLevel);
+	void EmitChoices(int Indent, int ConditionalDepth, int ChoiceDepth, int GosubLevel);
+	void EmitGosub(int Indent, int GosubLevel);
+	void EmitBody(int Indent, int NumBlocks, int ConditionalDepth, int ChoiceDepth, int GosubLevel);
+	FString RandomVariable();
+	FString RandomCondition();
+	static FString SubroutineLabel(int Level, int Index);
+};
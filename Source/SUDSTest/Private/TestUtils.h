@@ -17,8 +17,8 @@ FORCEINLINE bool TestParsedText(FAutomationTestBase* T, const FString& NameForTe
 	if (T->TestNotNull(NameForTest, Node))
 	{
 		T->TestEqual(NameForTest, Node->NodeType, ESUDSParsedNodeType::Text);
-		T->TestEqual(NameForTest, Node->Identifier, Speaker);
-		T->TestEqual(NameForTest, Node->Text, Text);
+		T->TestEqual(NameForTest, FString(Node->Identifier), Speaker);
+		T->TestEqual(NameForTest, FString(Node->Text), Text);
 		return true;
 	}
 	return false;
@@ -63,7 +63,7 @@ FORCEINLINE bool TestParsedSetLiteral(FAutomationTestBase* T, const FString& Nam
 	if (T->TestNotNull(NameForTest, Node))
 	{
 		T->TestEqual(NameForTest, Node->NodeType, ESUDSParsedNodeType::SetVariable);
-		T->TestEqual(NameForTest, Node->Identifier, VarName);
+		T->TestEqual(NameForTest, FString(Node->Identifier), VarName);
 		if (T->TestTrue(NameForTest, Node->Expression.IsLiteral()))
 		{
 			TestArgValue(T, NameForTest,Node->Expression.GetLiteralValue(), Literal);	
@@ -80,7 +80,7 @@ FORCEINLINE bool TestParsedSetLiteral(FAutomationTestBase* T, const FString& Nam
 	if (T->TestNotNull(NameForTest, Node))
 	{
 		T->TestEqual(NameForTest, Node->NodeType, ESUDSParsedNodeType::SetVariable);
-		T->TestEqual(NameForTest, Node->Identifier, VarName);
+		T->TestEqual(NameForTest, FString(Node->Identifier), VarName);
 		if (T->TestTrue(NameForTest, Node->Expression.IsLiteral()))
 		{
 			T->TestEqual(NameForTest,Node->Expression.GetBooleanLiteralValue(), Literal);	
@@ -97,7 +97,7 @@ FORCEINLINE bool TestParsedSetLiteral(FAutomationTestBase* T, const FString& Nam
 	if (T->TestNotNull(NameForTest, Node))
 	{
 		T->TestEqual(NameForTest, Node->NodeType, ESUDSParsedNodeType::SetVariable);
-		T->TestEqual(NameForTest, Node->Identifier, VarName);
+		T->TestEqual(NameForTest, FString(Node->Identifier), VarName);
 		if (T->TestTrue(NameForTest, Node->Expression.IsLiteral()))
 		{
 			T->TestEqual(NameForTest,Node->Expression.GetNameLiteralValue(), Name);	
@@ -150,7 +150,7 @@ FORCEINLINE bool TestParsedChoiceEdge(FAutomationTestBase* T, const FString& Nam
 	if (Node && Node->Edges.Num() > EdgeIndex)
 	{
 		auto& Edge = Node->Edges[EdgeIndex];
-		T->TestEqual(NameForTest, Edge.Text, Text);
+		T->TestEqual(NameForTest, FString(Edge.Text), Text);
 		const int Idx = Edge.TargetNodeIdx;
 		*OutNode = Importer.GetNode(Idx);
 		return true;
@@ -246,6 +246,33 @@ FORCEINLINE bool TestChoiceEdge(FAutomationTestBase* T, const FString& NameForTe
 	
 }
 
+/// Run a dialogue to the end, taking choices from a seeded stream. Returns the number of steps taken.
+/// Optionally records every speaker line, so that two versions of a script can be compared.
+FORCEINLINE int RunGeneratedDialogue(USUDSDialogue* Dlg, int32 Seed, int MaxSteps, TArray<FString>* OutLines = nullptr)
+{
+	FRandomStream Rand(Seed);
+	Dlg->Start();
+	int Steps = 0;
+	while (!Dlg->IsEnded() && Steps < MaxSteps)
+	{
+		if (OutLines)
+		{
+			OutLines->Add(Dlg->GetSpeakerID() + TEXT(": ") + Dlg->GetText().ToString());
+		}
+		const int NumChoices = Dlg->GetNumberOfChoices();
+		if (NumChoices > 1)
+		{
+			Dlg->Choose(Rand.RandRange(0, NumChoices - 1));
+		}
+		else
+		{
+			Dlg->Continue();
+		}
+		++Steps;
+	}
+	return Steps;
+}
+
 // Helper to provide a string table just in scope
 struct ScopedStringTableHolder
 {
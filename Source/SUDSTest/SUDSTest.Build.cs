@@ -14,6 +14,8 @@ public class SUDSTest : ModuleRules
                 "Core",
                 "CoreUObject",
                 "Engine",
+                "Json",
+                "Projects",
                 "SUDS",
                 "SUDSEditor"
             }